@@ -18,7 +18,12 @@ constexpr uint32_t kForcewakeMaxOffset = 0x00FFFFFF;
 // - Safe defaults used when operations fail
 class ForcewakeGuard {
 public:
-  explicit ForcewakeGuard(volatile uint32_t* mmio) : m(mmio), acquired(false) {
+  explicit ForcewakeGuard(volatile uint32_t* mmio)
+    : ForcewakeGuard(mmio, XeHW::FORCEWAKE_REQ, XeHW::FORCEWAKE_ACK) {}
+
+  // Domain-specific variant (media engines sit in their own VDBOX/VEBOX domains)
+  ForcewakeGuard(volatile uint32_t* mmio, uint32_t reqReg, uint32_t ackReg)
+    : m(mmio), req(reqReg), ack(ackReg), acquired(false) {
     // Safety: skip if mmio is null
     if (!mmio) {
       XeLog("ForcewakeGuard: SKIP - mmio is null\n");
@@ -32,8 +37,8 @@ public:
     }
     
     // Validate register offsets are in range
-    if (XeHW::FORCEWAKE_REQ > kForcewakeMaxOffset || 
-        XeHW::FORCEWAKE_ACK > kForcewakeMaxOffset) {
+    if (req > kForcewakeMaxOffset || 
+        ack > kForcewakeMaxOffset) {
       XeLog("ForcewakeGuard: SKIP - register offsets out of range\n");
       return;
     }
@@ -51,6 +56,8 @@ public:
 
 private:
   volatile uint32_t* m;
+  uint32_t req;
+  uint32_t ack;
   bool acquired;
   
   // Sentinel values for error detection
@@ -78,7 +85,7 @@ private:
     // Write forcewake request with set bit (upper 16 bits are mask)
     // Format: [31:16] = mask, [15:0] = value
     // To set bit 0: write 0x00010001
-    wr(XeHW::FORCEWAKE_REQ, 0x00010001);
+    wr(req, 0x00010001);
     
     // Poll for acknowledgment with timeout (max ~50ms to be safe)
     // Intel documentation recommends ~1ms delays between polls
@@ -86,17 +93,17 @@ private:
     const int delayPerIteration = 1000; // 1ms in microseconds (per Intel docs)
     
     for (int i = 0; i < maxIterations; ++i) {
-      uint32_t ack = rd(XeHW::FORCEWAKE_ACK);
+      uint32_t ackVal = rd(ack);
       
       // Check for invalid read (null mmio or out of range)
-      if (ack == kErrorNullMMIO || ack == kErrorOutOfRange) {
-        XeLog("ForcewakeGuard: ERROR - invalid ACK read (0x%08x)\n", ack);
+      if (ackVal == kErrorNullMMIO || ackVal == kErrorOutOfRange) {
+        XeLog("ForcewakeGuard: ERROR - invalid ACK read (0x%08x)\n", ackVal);
         return;
       }
       
-      if (ack & 0x1) {
+      if (ackVal & 0x1) {
         acquired = true;
-        XeLog("ForcewakeGuard: acquired after %d iterations (ACK=0x%08x)\n", i + 1, ack);
+        XeLog("ForcewakeGuard: acquired after %d iterations (ACK=0x%08x)\n", i + 1, ackVal);
         return;
       }
       
@@ -113,7 +120,7 @@ private:
     XeLog("ForcewakeGuard: releasing forcewake...\n");
     
     // Clear forcewake request (mask=1, value=0)
-    wr(XeHW::FORCEWAKE_REQ, 0x00010000);
+    wr(req, 0x00010000);
     acquired = false;
     
     XeLog("ForcewakeGuard: released\n");
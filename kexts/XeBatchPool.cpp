@@ -0,0 +1,117 @@
+#include "XeBatchPool.hpp"
+
+bool XeBatchPool::init(volatile uint32_t* mmio, XeGGTTSpace* ggttSpace, uint32_t prealloc,
+                       uint32_t bufferBytes) {
+  m = mmio;
+  space = ggttSpace;
+  bytes = (bufferBytes + 0xFFFu) & ~0xFFFu;
+  if (prealloc > kMaxBuffers) prealloc = kMaxBuffers;
+  while (backed < prealloc) {
+    if (!grow()) {
+      XeLog("XeBatchPool::init: ERROR - preallocation stopped at %u/%u buffers\n", backed, prealloc);
+      return false;
+    }
+  }
+  XeLog("XeBatchPool::init: %u x %u byte buffers%s\n", backed, bytes, m ? ", GGTT bound" : "");
+  return true;
+}
+
+void XeBatchPool::destroy() {
+  for (uint32_t i = 0; i < kMaxBuffers; ++i) {
+    if (slots[i].md) unback(i);
+  }
+  freeCount = 0;
+  busyHead = busyCount = 0;
+  backed = peak = 0;
+  m = nullptr;
+  space = nullptr;
+}
+
+// Back the first empty slot with a wired page and bind it
+bool XeBatchPool::grow() {
+  uint32_t i = 0;
+  while (i < kMaxBuffers && slots[i].md) ++i;
+  if (i == kMaxBuffers) return false;
+
+  Buffer& b = slots[i];
+  b.md = IOBufferMemoryDescriptor::withOptions(
+      kIOMemoryKernelUserShared | kIODirectionInOut, bytes, page_size);
+  if (!b.md) {
+    XeLog("XeBatchPool::grow: ERROR - buffer allocation failed\n");
+    return false;
+  }
+  if (m && space) {
+    if (!b.ggtt) b.ggtt = space->alloc(bytes);
+    if (!b.ggtt || !XeGGTT::insertPages(m, b.ggtt, b.md)) {
+      XeLog("XeBatchPool::grow: ERROR - GGTT bind failed\n");
+      b.md->release();
+      b.md = nullptr;
+      return false;
+    }
+  }
+  b.seqno = 0;
+  freeList[freeCount++] = (uint8_t)i;
+  backed++;
+  st.grows++;
+  return true;
+}
+
+// Drop the page behind a slot; its GGTT address stays reserved for it
+void XeBatchPool::unback(uint32_t i) {
+  Buffer& b = slots[i];
+  if (b.ggtt && m) XeGGTT::clearPages(m, b.ggtt, bytes);
+  b.md->release();
+  b.md = nullptr;
+  backed--;
+}
+
+// Requests on one engine complete in order, so the FIFO head retires first
+void XeBatchPool::reclaim(uint32_t completedSeqno) {
+  while (busyCount) {
+    uint8_t i = busy[busyHead];
+    if ((int32_t)(completedSeqno - slots[i].seqno) < 0) break;
+    busyHead = (busyHead + 1) % kMaxBuffers;
+    busyCount--;
+    freeList[freeCount++] = i;
+  }
+}
+
+XeBatchPool::Buffer* XeBatchPool::acquire(uint32_t completedSeqno) {
+  st.acquires++;
+  reclaim(completedSeqno);
+  if (freeCount) {
+    st.hits++;
+  } else if (!grow()) {
+    if (backed == kMaxBuffers) st.exhausted++;
+    return nullptr;
+  }
+  return &slots[freeList[--freeCount]];
+}
+
+void XeBatchPool::commit(Buffer* b, uint32_t seqno) {
+  b->seqno = seqno;
+  busy[(busyHead + busyCount) % kMaxBuffers] = (uint8_t)indexOf(b);
+  busyCount++;
+  if (busyCount > peak) peak = busyCount;
+}
+
+void XeBatchPool::release(Buffer* b) {
+  freeList[freeCount++] = (uint8_t)indexOf(b);
+}
+
+bool XeBatchPool::trim(uint32_t completedSeqno) {
+  reclaim(completedSeqno);
+  uint32_t keep = peak > kMinBuffers ? peak : kMinBuffers;
+  // Oldest entries of the LIFO are the coldest pages
+  uint32_t dropped = 0;
+  while (dropped < freeCount && backed > keep) unback(freeList[dropped++]);
+  if (dropped) {
+    memmove(freeList, freeList + dropped, freeCount - dropped);
+    freeCount -= dropped;
+    st.shrinks += dropped;
+    XeLog("XeBatchPool::trim: released %u buffers, %u left (%u in flight)\n",
+          dropped, backed, busyCount);
+  }
+  peak = busyCount;
+  return backed > kMinBuffers;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "xe_hw_offsets.hpp"
+#include "XeGGTT.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Per-engine pool of kernel batch buffers.
+//
+// Buffers (kBufferBytes unless init() asks for another size) are allocated
+// once, wired and bound into the GGTT, then recycled:
+// a submitted buffer stays in flight until the engine's completed seqno
+// passes the request that used it. The pool grows on demand up to
+// kMaxBuffers and is trimmed from the idle tick back towards the recent
+// in-flight peak (never below kMinBuffers). GGTT ranges are never returned
+// to XeGGTTSpace (it is a bump allocator), so a trimmed slot keeps its
+// address and is re-backed in place when the pool grows again.
+//
+// Not thread-safe; the owner runs everything under its command gate.
+class XeBatchPool {
+public:
+  static constexpr uint32_t kBufferBytes = 4096;
+  static constexpr uint32_t kMaxBuffers  = 64;
+  static constexpr uint32_t kMinBuffers  = 2;
+
+  struct Buffer {
+    IOBufferMemoryDescriptor* md;
+    uint32_t                  ggtt;    // 0 when the pool is not bound
+    uint32_t                  seqno;   // request that last used it
+  };
+
+  struct Stats {
+    uint64_t acquires;
+    uint64_t hits;        // served from the free list, no allocation
+    uint64_t grows;
+    uint64_t shrinks;
+    uint64_t exhausted;   // kMaxBuffers in flight
+  };
+
+  // Bind new buffers at space-allocated GGTT addresses (mmio may be null
+  // for an unbound pool) and pre-populate prealloc of them. bufferBytes is
+  // a page multiple.
+  bool init(volatile uint32_t* mmio, XeGGTTSpace* space, uint32_t prealloc,
+            uint32_t bufferBytes = kBufferBytes);
+  void destroy();
+
+  // Reclaim retired buffers, then hand out a free one (growing if needed).
+  // Returns nullptr when every slot is in flight or allocation failed.
+  Buffer* acquire(uint32_t completedSeqno);
+
+  void commit(Buffer* b, uint32_t seqno);   // in flight until seqno retires
+  void release(Buffer* b);                  // never submitted: free again now
+
+  // Idle tick: drop free buffers above max(kMinBuffers, peak in flight
+  // since the last trim). Returns true while the pool is above kMinBuffers.
+  bool trim(uint32_t completedSeqno);
+
+  uint32_t     bufferBytes() const { return bytes; }
+  uint32_t     buffers() const  { return backed; }
+  uint32_t     inFlight() const { return busyCount; }
+  const Stats& stats() const    { return st; }
+
+private:
+  volatile uint32_t* m {nullptr};
+  XeGGTTSpace*       space {nullptr};
+  uint32_t           bytes {kBufferBytes};
+
+  Buffer   slots[kMaxBuffers] {};
+  uint8_t  freeList[kMaxBuffers] {};   // slot indices, LIFO keeps hot pages hot
+  uint32_t freeCount {0};
+  uint8_t  busy[kMaxBuffers] {};       // slot indices in submission order
+  uint32_t busyHead  {0};
+  uint32_t busyCount {0};
+  uint32_t backed    {0};
+  uint32_t peak      {0};
+  Stats    st {};
+
+  bool     grow();
+  void     reclaim(uint32_t completedSeqno);
+  void     unback(uint32_t slot);
+  uint32_t indexOf(const Buffer* b) const { return (uint32_t)(b - slots); }
+};
@@ -0,0 +1,387 @@
+#include "XeBatchValidator.hpp"
+
+namespace {
+
+// Permission class of a command
+enum CmdClass : uint8_t {
+  kCmdInvalid = 0,      // unknown / reserved opcode
+  kCmdAllow,
+  kCmdPrivileged,       // kernel only
+  kCmdRegister,         // register operands checked against kUserRegs
+  kCmdEnd,              // MI_BATCH_BUFFER_END
+  kCmdBatchStart,       // MI_BATCH_BUFFER_START, chained submissions only
+};
+
+enum : uint8_t {
+  kFlagNoGgtt   = 1u << 0,   // reject when the header selects GGTT addressing
+  kFlagPostSync = 1u << 1,   // reject kernel-only post-sync ops (FLUSH_DW, PIPE_CONTROL)
+  kFlagGgttDw1  = 1u << 2,   // reject when dw1 bit 0 selects GGTT addressing
+};
+
+struct CmdDesc {
+  const char* name    {nullptr};
+  uint8_t     cls     {kCmdInvalid};
+  uint8_t     flags   {0};
+  uint16_t    lenMask {0};   // 0 = single dword, else (hdr & lenMask) + 2
+};
+
+// MI commands, indexed by opcode [28:23]
+struct MiTable {
+  CmdDesc e[XeHW::MI_OPCODE_MASK + 1];
+  constexpr MiTable() : e() {
+    e[0x00] = { "MI_NOOP",                kCmdAllow,      0,             0 };
+    e[0x01] = { "MI_SET_PREDICATE",       kCmdAllow,      0,             0 };
+    e[0x02] = { "MI_USER_INTERRUPT",      kCmdPrivileged, 0,             0 };
+    e[0x03] = { "MI_WAIT_FOR_EVENT",      kCmdPrivileged, 0,             0 };
+    e[0x05] = { "MI_ARB_CHECK",           kCmdAllow,      0,             0 };
+    e[0x06] = { "MI_RS_CONTROL",          kCmdPrivileged, 0,             0 };
+    e[0x07] = { "MI_REPORT_HEAD",         kCmdAllow,      0,             0 };
+    e[0x08] = { "MI_ARB_ON_OFF",          kCmdPrivileged, 0,             0 };
+    e[0x0A] = { "MI_BATCH_BUFFER_END",    kCmdEnd,        0,             0 };
+    e[0x0B] = { "MI_SUSPEND_FLUSH",       kCmdAllow,      0,             0 };
+    e[0x0C] = { "MI_PREDICATE",           kCmdAllow,      0,             0 };
+    e[0x0D] = { "MI_TOPOLOGY_FILTER",     kCmdAllow,      0,             0 };
+    e[0x0E] = { "MI_SET_APPID",           kCmdPrivileged, 0,             0 };
+    e[0x12] = { "MI_LOAD_SCAN_LINES_INCL",kCmdPrivileged, 0,             0x3F };
+    e[0x13] = { "MI_LOAD_SCAN_LINES_EXCL",kCmdPrivileged, 0,             0x3F };
+    e[0x14] = { "MI_DISPLAY_FLIP",        kCmdPrivileged, 0,             0x3F };
+    e[0x16] = { "MI_SEMAPHORE_MBOX",      kCmdPrivileged, 0,             0x3F };
+    e[0x18] = { "MI_SET_CONTEXT",         kCmdPrivileged, 0,             0xFF };
+    e[0x1A] = { "MI_MATH",                kCmdAllow,      0,             0xFF };
+    e[0x1B] = { "MI_SEMAPHORE_SIGNAL",    kCmdPrivileged, 0,             0x3F };
+    e[0x1C] = { "MI_SEMAPHORE_WAIT",      kCmdAllow,      kFlagNoGgtt,   0x3F };
+    e[0x20] = { "MI_STORE_DATA_IMM",      kCmdAllow,      kFlagNoGgtt,   0x3FF };
+    e[0x21] = { "MI_STORE_DATA_INDEX",    kCmdPrivileged, 0,             0x3F };
+    e[0x22] = { "MI_LOAD_REGISTER_IMM",   kCmdRegister,   0,             0xFF };
+    e[0x23] = { "MI_UPDATE_GTT",          kCmdPrivileged, 0,             0x3FF };
+    e[0x24] = { "MI_STORE_REGISTER_MEM",  kCmdRegister,   kFlagNoGgtt,   0xFF };
+    e[0x26] = { "MI_FLUSH_DW",            kCmdAllow,      kFlagPostSync, 0x3F };
+    e[0x27] = { "MI_CLFLUSH",             kCmdPrivileged, 0,             0x3FF };
+    e[0x28] = { "MI_REPORT_PERF_COUNT",   kCmdAllow,      kFlagGgttDw1,  0x3F };
+    e[0x29] = { "MI_LOAD_REGISTER_MEM",   kCmdRegister,   kFlagNoGgtt,   0xFF };
+    e[0x2A] = { "MI_LOAD_REGISTER_REG",   kCmdRegister,   0,             0xFF };
+    e[0x2B] = { "MI_RS_STORE_DATA_IMM",   kCmdPrivileged, 0,             0xFF };
+    e[0x2C] = { "MI_LOAD_URB_MEM",        kCmdPrivileged, 0,             0xFF };
+    e[0x2D] = { "MI_STORE_URB_MEM",       kCmdPrivileged, 0,             0xFF };
+    e[0x2F] = { "MI_ATOMIC",              kCmdAllow,      kFlagNoGgtt,   0xFF };
+    e[0x31] = { "MI_BATCH_BUFFER_START",  kCmdBatchStart, 0,             0xFF };
+    e[0x36] = { "MI_COND_BATCH_BUFFER_END", kCmdAllow,    kFlagNoGgtt,   0xFF };
+  }
+};
+
+// GFXPIPE commands, indexed by subtype [28:27] << 3 | opcode [26:24]
+struct GfxTable {
+  CmdDesc e[32];
+  constexpr GfxTable() : e() {
+    e[(0 << 3) | 0] = { "GFX_COMMON_STATE",   kCmdAllow, 0,             0xFF };
+    e[(0 << 3) | 1] = { "STATE_BASE_ADDRESS", kCmdAllow, 0,             0xFF };
+    e[(1 << 3) | 1] = { "GFX_SINGLE_DW",      kCmdAllow, 0,             0 };     // PIPELINE_SELECT etc.
+    e[(2 << 3) | 0] = { "MEDIA_STATE",        kCmdAllow, 0,             0xFFFF };
+    e[(2 << 3) | 1] = { "MEDIA_OBJECT",       kCmdAllow, 0,             0xFFFF };
+    e[(2 << 3) | 2] = { "MEDIA_GPGPU",        kCmdAllow, 0,             0xFFFF };
+    e[(3 << 3) | 0] = { "3DSTATE",            kCmdAllow, 0,             0xFF };
+    e[(3 << 3) | 1] = { "3DSTATE_NP",         kCmdAllow, 0,             0xFF };
+    e[(3 << 3) | 2] = { "PIPE_CONTROL",       kCmdAllow, kFlagPostSync, 0xFF };
+    e[(3 << 3) | 3] = { "3DPRIMITIVE",        kCmdAllow, 0,             0xFF };
+  }
+};
+
+constexpr MiTable  kMiTable;
+constexpr GfxTable kGfxTable;
+constexpr CmdDesc  kBltDesc = { "XY_BLT", kCmdAllow, 0, 0xFF };
+
+// MI opcodes with register operands
+constexpr uint32_t kOpLri = 0x22;
+constexpr uint32_t kOpSrm = 0x24;
+constexpr uint32_t kOpLrm = 0x29;
+constexpr uint32_t kOpLrr = 0x2A;
+
+// Header bits that rebase a register offset onto the engine's MMIO base
+constexpr uint32_t kCsMmioDst             = 1u << 19;   // LRI/SRM/LRM, LRR destination
+constexpr uint32_t kCsMmioSrc             = 1u << 18;   // LRR source
+
+// Post-sync decode. A GGTT address, the status page (store index), an
+// MMIO write or a user interrupt (notify) are the kernel's alone:
+// FLUSH_DW header bits 21/8 (store index, notify), PIPE_CONTROL dw1
+// bits 23/21/8 (MMIO write, store index, notify).
+constexpr uint32_t kPostSyncOpMask        = 3u << 14;   // FLUSH_DW header / PIPE_CONTROL dw1
+constexpr uint32_t kFlushDwAddrGgtt       = 1u << 2;    // FLUSH_DW dw1
+constexpr uint32_t kFlushDwKernelOnly     = (1u << 21) | (1u << 8);
+constexpr uint32_t kPipeControlAddrGgtt   = 1u << 24;   // PIPE_CONTROL dw1
+constexpr uint32_t kPipeControlKernelOnly = (1u << 23) | (1u << 21) | (1u << 8);
+constexpr uint32_t kGgttDw1               = 1u << 0;    // MI_REPORT_PERF_COUNT dw1
+
+// Registers a user batch may touch
+struct RegRange {
+  uint32_t start;
+  uint32_t bytes;
+  bool     engineRelative;
+  bool     writable;
+  uint32_t caps;              // engine must have one of these (0 = any)
+};
+
+constexpr RegRange kUserRegs[] = {
+  { 0x600,  0x80, true,  true,  0 },                    // CS_GPR0..15 (MI_MATH scratch)
+  { 0x358,  0x08, true,  false, 0 },                    // RING_TIMESTAMP
+  { 0x2400, 0x20, false, true,  kXeEngineCapRender },   // MI_PREDICATE_SRC0/1, DATA, RESULT
+};
+
+} // namespace
+
+const char* XeBatchValidator::resultName(Result r) {
+  switch (r) {
+    case kBatchOk:          return "ok";
+    case kBatchBadCommand:  return "bad-command";
+    case kBatchPrivileged:  return "privileged";
+    case kBatchBadRegister: return "bad-register";
+    case kBatchBadLength:   return "bad-length";
+    case kBatchNoEnd:       return "no-end";
+    case kBatchBadTarget:   return "bad-target";
+    case kBatchBadNesting:  return "bad-nesting";
+  }
+  return "?";
+}
+
+// MI_NOOP is all-zero, so a run can be skipped by OR-ing qwords: eight
+// NOOPs per iteration once aligned. Kernel code can't touch vector
+// registers without saving FP state, so this stays in integer registers.
+uint32_t XeBatchValidator::skipNoops(const uint32_t* dw, uint32_t pos, uint32_t count) {
+  while (pos < count && dw[pos] == XeHW::MI_NOOP && ((uintptr_t)&dw[pos] & 7)) ++pos;
+  if (pos >= count || dw[pos] != XeHW::MI_NOOP) return pos;
+
+  const uint64_t* q = (const uint64_t*)&dw[pos];
+  while (pos + 8 <= count && (q[0] | q[1] | q[2] | q[3]) == 0) { q += 4; pos += 8; }
+  while (pos + 2 <= count && *q == 0) { ++q; pos += 2; }
+  while (pos < count && dw[pos] == XeHW::MI_NOOP) ++pos;
+  return pos;
+}
+
+bool XeBatchValidator::regAllowed(uint32_t reg, bool write) const {
+  for (const RegRange& r : kUserRegs) {
+    uint32_t start = r.engineRelative ? eng->reg(r.start) : r.start;
+    if (reg < start || reg >= start + r.bytes) continue;
+    if (write && !r.writable) return false;
+    if (r.caps && !eng->has(r.caps)) return false;
+    return true;
+  }
+  return false;
+}
+
+XeBatchValidator::Result XeBatchValidator::checkRegisters(uint32_t opcode, const uint32_t* pkt,
+                                                          uint32_t len) const {
+  // A CS-relative offset lands on another register than the one named
+  if (pkt[0] & kCsMmioDst) return kBatchBadRegister;
+  switch (opcode) {
+    case kOpLri:
+      if ((len - 1) & 1) return kBatchBadLength;      // reg/value pairs
+      for (uint32_t i = 1; i < len; i += 2) {
+        if (!regAllowed(pkt[i] & XeHW::MI_LRI_REG_MASK, true)) return kBatchBadRegister;
+      }
+      return kBatchOk;
+    case kOpSrm:
+      return regAllowed(pkt[1] & XeHW::MI_LRI_REG_MASK, false) ? kBatchOk : kBatchBadRegister;
+    case kOpLrm:
+      return regAllowed(pkt[1] & XeHW::MI_LRI_REG_MASK, true) ? kBatchOk : kBatchBadRegister;
+    case kOpLrr:
+      if (len < 3) return kBatchBadLength;
+      if (pkt[0] & kCsMmioSrc) return kBatchBadRegister;
+      if (!regAllowed(pkt[1] & XeHW::MI_LRI_REG_MASK, false)) return kBatchBadRegister;
+      return regAllowed(pkt[2] & XeHW::MI_LRI_REG_MASK, true) ? kBatchOk : kBatchBadRegister;
+  }
+  return kBatchBadCommand;
+}
+
+// MI_BATCH_BUFFER_START must name the GGTT start of a link. A call may
+// target any link, which must then also be valid second-level; a jump only
+// goes forward and ends the current batch.
+XeBatchValidator::Result XeBatchValidator::checkBatchStart(const uint32_t* pkt, uint32_t len,
+                                                           const ChainCtx* chain, Level level) const {
+  if (!chain || level == kLevelInline) return kBatchPrivileged;
+  if (level == kLevelSecond) return kBatchBadNesting;
+  if (len != 3) return kBatchBadLength;
+  if ((pkt[0] & XeHW::MI_BB_START_PPGTT) || pkt[2] != 0) return kBatchBadTarget;
+
+  uint32_t target = pkt[1] & ~3u;
+  bool call = (pkt[0] & XeHW::MI_BB_START_2ND_LEVEL) != 0;
+  const Link& self = chain->links[chain->self];
+  for (uint32_t j = 0; j < chain->n; ++j) {
+    const Link& to = chain->links[j];
+    if (to.ggtt != target) continue;
+    if (!call && j <= chain->self) return kBatchBadTarget;
+    if (to.copyGgtt) {
+      // Never let the engine reach the client's writable original; only
+      // a copy can be patched to point at the target's copy instead
+      if (!self.copyGgtt) return kBatchBadTarget;
+      const_cast<uint32_t*>(pkt)[1] = to.copyGgtt | (pkt[1] & 3u);
+    }
+    chain->needs[j] |= 1u << (call ? kLevelSecond : kLevelFirst);
+    return kBatchOk;
+  }
+  return kBatchBadTarget;
+}
+
+XeBatchValidator::Result XeBatchValidator::validate(const uint32_t* dw, uint32_t count, Report* rep) {
+  return parse(dw, count, rep, nullptr, kLevelInline);
+}
+
+XeBatchValidator::Result XeBatchValidator::parse(const uint32_t* dw, uint32_t count, Report* rep,
+                                                 const ChainCtx* chain, Level level) {
+  Report r {kBatchNoEnd, count, 0, 0, 0, 0};
+  uint32_t pos = 0;
+
+  while (pos < count) {
+    uint32_t hdr = dw[pos];
+    if (hdr == XeHW::MI_NOOP) {
+      uint32_t next = skipNoops(dw, pos, count);
+      r.noopDw += next - pos;
+      pos = next;
+      continue;
+    }
+
+    const CmdDesc* d = nullptr;
+    uint32_t type = hdr >> XeHW::CMD_TYPE_SHIFT;
+    if (type == XeHW::CMD_TYPE_MI) {
+      d = &kMiTable.e[(hdr >> XeHW::MI_OPCODE_SHIFT) & XeHW::MI_OPCODE_MASK];
+    } else if (type == XeHW::CMD_TYPE_GFXPIPE && !eng->has(kXeEngineCapCopy)) {
+      d = &kGfxTable.e[(hdr >> 24) & 0x1F];
+    } else if (type == XeHW::CMD_TYPE_BLT && eng->has(kXeEngineCapCopy)) {
+      d = &kBltDesc;
+    }
+
+    Result res = kBatchOk;
+    uint32_t len = 1;
+    if (!d || d->cls == kCmdInvalid) {
+      res = kBatchBadCommand;
+    } else if (d->cls == kCmdPrivileged) {
+      res = kBatchPrivileged;
+    } else if (d->cls == kCmdEnd) {
+      r.result = kBatchOk;
+      r.offsetDw = pos;
+      r.header = hdr;
+      r.lengthDw = pos;
+      break;
+    } else if (d->cls == kCmdBatchStart) {
+      len = (hdr & d->lenMask) + 2;
+      res = (len > count - pos) ? kBatchBadLength : checkBatchStart(&dw[pos], len, chain, level);
+      if (res == kBatchOk) {
+        r.starts++;
+        if (!(hdr & XeHW::MI_BB_START_2ND_LEVEL)) {
+          // Jump: nothing after it runs
+          r.result = kBatchOk;
+          r.offsetDw = pos;
+          r.header = hdr;
+          r.lengthDw = pos;
+          break;
+        }
+      }
+    } else {
+      if (d->lenMask) len = (hdr & d->lenMask) + 2;
+      if (len > count - pos) {
+        res = kBatchBadLength;
+      } else if ((d->flags & kFlagNoGgtt) && (hdr & XeHW::MI_USE_GGTT)) {
+        res = kBatchPrivileged;
+      } else if (d->flags & kFlagPostSync) {
+        bool kernel = (type == XeHW::CMD_TYPE_MI)
+          ? ((hdr & kPostSyncOpMask) && (dw[pos + 1] & kFlushDwAddrGgtt)) || (hdr & kFlushDwKernelOnly)
+          : ((dw[pos + 1] & kPostSyncOpMask) && (dw[pos + 1] & kPipeControlAddrGgtt)) ||
+            (dw[pos + 1] & kPipeControlKernelOnly);
+        if (kernel) res = kBatchPrivileged;
+      } else if ((d->flags & kFlagGgttDw1) && (dw[pos + 1] & kGgttDw1)) {
+        res = kBatchPrivileged;
+      } else if (d->cls == kCmdRegister) {
+        res = checkRegisters((hdr >> XeHW::MI_OPCODE_SHIFT) & XeHW::MI_OPCODE_MASK, &dw[pos], len);
+      }
+    }
+
+    if (res != kBatchOk) {
+      r.result = res;
+      r.offsetDw = pos;
+      r.header = hdr;
+      XeLog("XeBV::validate: %s rejected: %s at dw %u (hdr=0x%08x %s)\n", eng->name,
+            resultName(res), pos, hdr, d && d->name ? d->name : "unknown");
+      break;
+    }
+    pos += len;
+  }
+
+  st.batches++;
+  st.dwords += (r.result == kBatchOk) ? r.lengthDw : r.offsetDw;
+  st.noopDwords += r.noopDw;
+  if (r.result != kBatchOk) st.rejected++;
+  if (rep) *rep = r;
+  return r.result;
+}
+
+// Only batches without MI_BATCH_BUFFER_START are cached: their verdict
+// holds at every level and does not depend on the rest of a chain.
+bool XeBatchValidator::lookup(uint64_t key, uint32_t generation, uint32_t count, Report* rep) {
+  if (!key) return false;
+  const CacheEntry& e = cache[cacheSlot(key)];
+  if (e.key != key || e.generation != generation || e.count != count) return false;
+  st.cacheHits++;
+  if (rep) *rep = Report {kBatchOk, e.lengthDw, XeHW::MI_BATCH_BUFFER_END, e.lengthDw, 0, 0};
+  return true;
+}
+
+void XeBatchValidator::remember(uint64_t key, uint32_t generation, uint32_t count, const Report& r) {
+  if (key && r.result == kBatchOk && r.starts == 0) {
+    cache[cacheSlot(key)] = CacheEntry {key, generation, count, r.lengthDw};
+  }
+}
+
+XeBatchValidator::Result XeBatchValidator::validateCached(uint64_t key, uint32_t generation,
+                                                          const uint32_t* dw, uint32_t count,
+                                                          Report* rep) {
+  if (lookup(key, generation, count, rep)) return kBatchOk;
+
+  Report r {};
+  Result res = validate(dw, count, &r);
+  remember(key, generation, count, r);
+  if (rep) *rep = r;
+  return res;
+}
+
+// Links are visited in order for first-level use (jumps only go forward,
+// so a jump target is always still ahead), then every link called from
+// somewhere is checked as a second-level batch.
+XeBatchValidator::Result XeBatchValidator::validateChain(const Link* links, uint32_t n,
+                                                         Report* rep, uint32_t* outLink) {
+  if (outLink) *outLink = 0;
+  if (!links || n == 0 || n > kMaxLinks) {
+    if (rep) *rep = Report {kBatchBadTarget, 0, 0, 0, 0, 0};
+    return kBatchBadTarget;
+  }
+  st.chains++;
+
+  uint8_t needs[kMaxLinks] = {};
+  needs[0] = 1u << kLevelFirst;
+  ChainCtx ctx {links, n, 0, needs};
+
+  for (uint32_t level = kLevelFirst; level <= kLevelSecond; ++level) {
+    for (uint32_t i = 0; i < n; ++i) {
+      if (!(needs[i] & (1u << level))) continue;
+      const Link& l = links[i];
+      Report r {};
+      if (!l.copyGgtt && lookup(l.key, l.generation, l.count, &r)) continue;
+      ctx.self = i;
+      Result res = parse(l.dw, l.count, &r, &ctx, (Level)level);
+      remember(l.key, l.generation, l.count, r);
+      if (res != kBatchOk) {
+        if (outLink) *outLink = i;
+        if (rep) *rep = r;
+        return res;
+      }
+    }
+  }
+  if (rep) *rep = Report {kBatchOk, 0, 0, 0, 0, 0};
+  return kBatchOk;
+}
+
+void XeBatchValidator::invalidate(uint64_t key) {
+  CacheEntry& e = cache[cacheSlot(key)];
+  if (e.key == key) e = CacheEntry {};
+}
+
+void XeBatchValidator::invalidateAll() {
+  for (uint32_t i = 0; i < kCacheEntries; ++i) cache[i] = CacheEntry {};
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <stdint.h>
+#include "xe_hw_offsets.hpp"
+#include "XeEngine.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Command parser for user batches.
+//
+// Packets are walked with per-type descriptor tables indexed by opcode; each
+// entry gives the packet length rule and a permission class. Runs of MI_NOOP
+// are skipped a qword at a time. A verdict can be cached by (BO key,
+// generation): the owner must bump the generation whenever the CPU may have
+// written the BO, otherwise pass key 0 to force a full parse.
+//
+// Chained submissions run user batches from their GGTT binding, or from a
+// kernel copy when the client could still write them. Inside a first-level
+// batch MI_BATCH_BUFFER_START may jump to a later link of the same
+// submission or call any link as a second-level batch; second-level
+// batches may not start further batches. Forward-only jumps keep every
+// chain finite. Targets are named by the links' own GGTT addresses; in a
+// copy they are rewritten to the target's copy as they are accepted.
+class XeBatchValidator {
+public:
+  enum Result : uint32_t {
+    kBatchOk = 0,
+    kBatchBadCommand,     // reserved command type or unknown opcode
+    kBatchPrivileged,     // command not allowed from a user batch
+    kBatchBadRegister,    // register access outside the allow-list
+    kBatchBadLength,      // packet runs past the end of the batch
+    kBatchNoEnd,          // no MI_BATCH_BUFFER_END within the batch
+    kBatchBadTarget,      // MI_BATCH_BUFFER_START outside the chain or backwards
+    kBatchBadNesting,     // MI_BATCH_BUFFER_START inside a second-level batch
+  };
+
+  struct Report {
+    Result   result;
+    uint32_t offsetDw;    // first offending dword (or MI_BATCH_BUFFER_END)
+    uint32_t header;      // offending command header
+    uint32_t lengthDw;    // dwords before MI_BATCH_BUFFER_END on success
+    uint32_t noopDw;      // MI_NOOPs skipped
+    uint32_t starts;      // MI_BATCH_BUFFER_STARTs accepted
+  };
+
+  static constexpr uint32_t kMaxLinks = 8;
+
+  // One batch of a chained submission
+  struct Link {
+    const uint32_t* dw;           // CPU view of the batch (of the copy, if there is one)
+    uint32_t        count;        // dwords
+    uint32_t        ggtt;         // the BO's address, as other links' batch starts name it
+    uint64_t        key;          // verdict cache key (0 = none)
+    uint32_t        generation;
+    uint32_t        copyGgtt;     // dw is a kernel copy the engine runs from here; 0 = in place
+
+    uint32_t fetchGgtt() const { return copyGgtt ? copyGgtt : ggtt; }
+  };
+
+  struct Stats {
+    uint64_t batches;
+    uint64_t dwords;
+    uint64_t noopDwords;
+    uint64_t cacheHits;
+    uint64_t rejected;
+    uint64_t chains;
+  };
+
+  void attach(const XeEngineDesc& engine) { eng = &engine; invalidateAll(); }
+
+  // Full parse of count dwords.
+  Result validate(const uint32_t* dw, uint32_t count, Report* rep);
+
+  // Parse unless (key, generation) already passed; key 0 disables caching.
+  Result validateCached(uint64_t key, uint32_t generation,
+                        const uint32_t* dw, uint32_t count, Report* rep);
+
+  // Validate every link reachable from links[0] (n <= kMaxLinks). On
+  // failure *outLink names the link the report refers to.
+  Result validateChain(const Link* links, uint32_t n, Report* rep, uint32_t* outLink);
+
+  void invalidate(uint64_t key);
+  void invalidateAll();
+
+  const Stats& stats() const { return st; }
+  static const char* resultName(Result r);
+
+private:
+  static constexpr uint32_t kCacheEntries = 32;   // direct mapped, power of two
+
+  enum Level : uint8_t {
+    kLevelInline = 0,     // copied into the ring: no batch starts at all
+    kLevelFirst,
+    kLevelSecond,
+  };
+
+  struct ChainCtx {
+    const Link* links;
+    uint32_t    n;
+    uint32_t    self;
+    uint8_t*    needs;    // per link: bit per Level it must be valid at
+  };
+
+  struct CacheEntry {
+    uint64_t key;
+    uint32_t generation;
+    uint32_t count;
+    uint32_t lengthDw;
+  };
+
+  const XeEngineDesc* eng {&kXeEngines[kXeEngineRCS0]};
+  CacheEntry          cache[kCacheEntries] {};
+  Stats               st {};
+
+  Result          parse(const uint32_t* dw, uint32_t count, Report* rep,
+                        const ChainCtx* chain, Level level);
+  Result          checkBatchStart(const uint32_t* pkt, uint32_t len,
+                                  const ChainCtx* chain, Level level) const;
+  bool            lookup(uint64_t key, uint32_t generation, uint32_t count, Report* rep);
+  void            remember(uint64_t key, uint32_t generation, uint32_t count, const Report& r);
+  static uint32_t skipNoops(const uint32_t* dw, uint32_t pos, uint32_t count);
+  bool            regAllowed(uint32_t reg, bool write) const;
+  Result          checkRegisters(uint32_t opcode, const uint32_t* pkt, uint32_t len) const;
+  uint32_t        cacheSlot(uint64_t key) const {
+    return (uint32_t)((key ^ (key >> 17)) & (kCacheEntries - 1));
+  }
+};
@@ -0,0 +1,238 @@
+#include "XeBoPool.hpp"
+
+bool XeBoPool::init(volatile uint32_t* mmio, XeGGTTSpace* ggttSpace) {
+  if (lock) return true;
+  lock = IOLockAlloc();
+  if (!lock) {
+    XeLog("XeBoPool::init: ERROR - lock allocation failed\n");
+    return false;
+  }
+  m = mmio;
+  space = ggttSpace;
+  return true;
+}
+
+void XeBoPool::destroy() {
+  for (uint32_t cls = 0; cls < kClassCount; ++cls) {
+    while (cached[cls]) drop(cls, 0);
+    cachedBytes[cls] = 0;
+    holeCount[cls] = 0;
+  }
+  if (lock) {
+    IOLockFree(lock);
+    lock = nullptr;
+  }
+  XeLog("XeBoPool::destroy: hits=%llu misses=%llu recycled=%llu trimmed=%llu\n",
+        (unsigned long long)st.hits, (unsigned long long)st.misses,
+        (unsigned long long)st.recycled, (unsigned long long)st.trimmed);
+  m = nullptr;
+  space = nullptr;
+}
+
+bool XeBoPool::idle(const Cached& c, const uint32_t completed[kXeEngineCount]) {
+  // A client mapping holds a reference; those pages are still the client's
+  if ((uint32_t)c.md->getRetainCount() > baseRefs) return false;
+  for (uint32_t e = 0; e < kXeEngineCount; ++e) {
+    if ((int32_t)(completed[e] - c.busy[e]) < 0) return false;
+  }
+  return true;
+}
+
+// Remove entry i of a class, keeping the rest in age order (lock held)
+void XeBoPool::take(uint32_t cls, uint32_t i) {
+  Cached* list = cache[cls];
+  cachedBytes[cls] -= list[i].bytes;
+  for (uint32_t j = i + 1; j < cached[cls]; ++j) list[j - 1] = list[j];
+  cached[cls]--;
+}
+
+// Free entry i for good; its GGTT range becomes a hole of the class
+void XeBoPool::drop(uint32_t cls, uint32_t i) {
+  Cached c = cache[cls][i];
+  take(cls, i);
+  if (c.ggtt) {
+    if (m) XeGGTT::clearPages(m, c.ggtt, c.bytes);
+    keepHole(c.ggtt, c.bytes);
+  }
+  c.md->release();
+}
+
+// Remember an unbound range for the next bind of its size (lock held)
+void XeBoPool::keepHole(uint32_t ggtt, uint32_t bytes) {
+  uint32_t cls = classOf(bytes);
+  if (holeCount[cls] < kMaxHoles) {
+    holes[cls][holeCount[cls]++] = Hole {ggtt, bytes};
+  } else {
+    st.ggttLeaked++;
+  }
+}
+
+// An idle cached buffer of exactly bytes and this cache mode, zeroed, or nullptr
+IOBufferMemoryDescriptor* XeBoPool::takeIdle(uint32_t bytes, uint32_t mode, const uint32_t completed[kXeEngineCount],
+                                             uint32_t* outGgtt) {
+  uint32_t cls = classOf(bytes);
+  IOBufferMemoryDescriptor* md = nullptr;
+  IOLockLock(lock);
+  // Newest idle buffer first: the most likely to still be cache-warm
+  for (uint32_t i = cached[cls]; i-- > 0;) {
+    if (cache[cls][i].bytes != bytes || cache[cls][i].mode != mode) continue;
+    if (!idle(cache[cls][i], completed)) {
+      st.busy++;
+      continue;
+    }
+    md = cache[cls][i].md;
+    *outGgtt = cache[cls][i].ggtt;
+    take(cls, i);
+    st.hits++;
+    break;
+  }
+  if (!md) st.misses++;
+  IOLockUnlock(lock);
+
+  // Never hand one client another's data
+  if (md) {
+    bzero(md->getBytesNoCopy(), bytes);
+    XeCacheFlushForGpu(mode, md->getBytesNoCopy(), bytes);
+  }
+  return md;
+}
+
+IOBufferMemoryDescriptor* XeBoPool::acquire(uint32_t bytes, const uint32_t completed[kXeEngineCount],
+                                            uint32_t* outGgtt, uint32_t mode) {
+  bytes = pageBytes(bytes);
+  if (!lock || bytes == 0 || bytes > kMaxBytes || mode >= kXeCacheModeCount || !outGgtt) return nullptr;
+  *outGgtt = 0;
+
+  IOBufferMemoryDescriptor* md = takeIdle(bytes, mode, completed, outGgtt);
+  if (md) return md;
+  // The cache bits set the mode of the kernel mapping (getBytesNoCopy) and
+  // the default of every user mapping
+  md = IOBufferMemoryDescriptor::withOptions(kIOMemoryKernelUserShared | kIODirectionInOut | XeCacheMapOption(mode),
+                                             bytes, page_size);
+  if (md && !baseRefs) __atomic_store_n(&baseRefs, (uint32_t)md->getRetainCount(), __ATOMIC_RELAXED);
+  return md;
+}
+
+IOBufferMemoryDescriptor* XeBoPool::reserve(uint32_t bytes, const uint32_t completed[kXeEngineCount],
+                                            uint32_t* outGgtt, bool* outLazy) {
+  bytes = pageBytes(bytes);
+  if (!lock || bytes == 0 || bytes > kMaxBytes || !outGgtt || !outLazy) return nullptr;
+  *outGgtt = 0;
+
+  // A cached buffer is already resident: nothing left to save
+  IOBufferMemoryDescriptor* md = takeIdle(bytes, kXeCacheWB, completed, outGgtt);
+  *outLazy = md == nullptr;
+  return md ? md : reservation(bytes);
+}
+
+IOBufferMemoryDescriptor* XeBoPool::reservation(uint32_t bytes) {
+  bytes = pageBytes(bytes);
+  if (bytes == 0 || bytes > kMaxBytes) return nullptr;
+  // Pageable kernel memory is only address space until prepare() wires it;
+  // its pages are zero-filled on demand
+  IOBufferMemoryDescriptor* md = IOBufferMemoryDescriptor::withOptions(
+      kIOMemoryPageable | kIOMemoryKernelUserShared | kIODirectionInOut, bytes, page_size);
+  if (md && !baseRefs) __atomic_store_n(&baseRefs, (uint32_t)md->getRetainCount(), __ATOMIC_RELAXED);
+  return md;
+}
+
+void XeBoPool::release(IOBufferMemoryDescriptor* md, uint32_t ggtt, const uint32_t busy[kXeEngineCount],
+                       const uint32_t completed[kXeEngineCount], uint32_t mode) {
+  if (!md) return;
+  uint32_t bytes = (uint32_t)md->getLength();
+  uint32_t cls = classOf(bytes);
+  if (!lock || cls >= kClassCount || pageBytes(bytes) != md->getLength() || mode >= kXeCacheModeCount) {
+    // Not one of ours; only safe to unbind once idle, so keep the range
+    if (ggtt) st.ggttLeaked++;
+    md->release();
+    return;
+  }
+
+  IOLockLock(lock);
+  if (cached[cls] == kMaxPerClass) {
+    // Full: evict the oldest idle buffer, or failing that the oldest one.
+    // A busy buffer's pages are kept alive by the request that uses it;
+    // its GGTT range stays mapped and is never reused.
+    uint32_t victim = 0;
+    while (victim < cached[cls] && !idle(cache[cls][victim], completed)) victim++;
+    if (victim == cached[cls]) {
+      Cached c = cache[cls][0];
+      take(cls, 0);
+      if (c.ggtt) st.ggttLeaked++;
+      c.md->release();
+    } else {
+      drop(cls, victim);
+    }
+    st.trimmed++;
+  }
+  Cached& c = cache[cls][cached[cls]++];
+  c.md = md;
+  c.ggtt = ggtt;
+  c.bytes = bytes;
+  c.mode = mode;
+  cachedBytes[cls] += bytes;
+  for (uint32_t e = 0; e < kXeEngineCount; ++e) c.busy[e] = busy[e];
+  st.recycled++;
+
+  // High watermark: shed the oldest idle buffers
+  for (uint32_t i = 0; i < cached[cls] && cachedBytes[cls] > kClassHighWater;) {
+    if (!idle(cache[cls][i], completed)) {
+      ++i;
+      continue;
+    }
+    drop(cls, i);
+    st.trimmed++;
+  }
+  IOLockUnlock(lock);
+}
+
+uint32_t XeBoPool::allocGgtt(uint32_t bytes) {
+  uint32_t cls = classOf(bytes);
+  if (lock && bytes && cls < kClassCount && pageBytes(bytes) == bytes) {
+    uint32_t addr = 0;
+    IOLockLock(lock);
+    for (uint32_t i = holeCount[cls]; i-- > 0;) {
+      if (holes[cls][i].bytes != bytes) continue;
+      addr = holes[cls][i].ggtt;
+      holes[cls][i] = holes[cls][--holeCount[cls]];
+      st.ggttReused++;
+      break;
+    }
+    IOLockUnlock(lock);
+    if (addr) return addr;
+  }
+  return space ? space->alloc(bytes) : 0;
+}
+
+void XeBoPool::releaseGgtt(uint32_t ggtt, uint32_t bytes) {
+  if (!ggtt || !lock || !bytes || classOf(bytes) >= kClassCount || pageBytes(bytes) != bytes) return;
+  if (m) XeGGTT::clearPages(m, ggtt, bytes);
+  IOLockLock(lock);
+  keepHole(ggtt, bytes);
+  IOLockUnlock(lock);
+}
+
+uint64_t XeBoPool::trim(uint64_t bytes, const uint32_t completed[kXeEngineCount]) {
+  if (!lock || !bytes) return 0;
+  uint64_t freed = 0;
+  IOLockLock(lock);
+  for (uint32_t cls = kClassCount; cls-- > 0 && freed < bytes;) {
+    for (uint32_t i = 0; i < cached[cls] && freed < bytes;) {
+      if (!idle(cache[cls][i], completed)) {
+        ++i;
+        continue;
+      }
+      freed += cache[cls][i].bytes;
+      drop(cls, i);
+      st.trimmed++;
+    }
+  }
+  IOLockUnlock(lock);
+  return freed;
+}
+
+uint64_t XeBoPool::pooledBytes() const {
+  uint64_t total = 0;
+  for (uint32_t cls = 0; cls < kClassCount; ++cls) total += cachedBytes[cls];
+  return total;
+}
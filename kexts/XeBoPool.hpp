@@ -0,0 +1,138 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "XeEngine.hpp"
+#include "XeGGTT.hpp"
+#include "XeCacheMode.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Size-class cache of user BO backing store.
+//
+// Client BOs are only rounded up to whole pages: that is what they
+// allocate, bind and are charged for. The pool files them into
+// power-of-four classes (up to 4K, 16K, ... 64M) to keep lookups short,
+// but a cached buffer or GGTT range is only handed out again for a
+// request of exactly its size.
+//
+// A destroyed BO goes back to its class together with its GGTT binding and
+// the last seqno each engine may still be using it at, and is handed out
+// again (zeroed) only once all of those have retired and no user mapping
+// of it is left (its retain count is back to that of a fresh buffer), and
+// only for a BO of the same size and cache mode (XeCacheMode.hpp). Each
+// class holds at most kMaxPerClass buffers and kClassHighWater bytes;
+// above that the oldest idle buffers are freed. Their GGTT ranges are kept
+// per class (XeGGTTSpace never takes addresses back) and reused by the
+// next bind of that size.
+//
+// acquire() runs on the client's thread and release() under the service's
+// gate, so the pool serializes on its own lock.
+class XeBoPool {
+public:
+  static constexpr uint32_t kClassCount     = 8;
+  static constexpr uint32_t kMinBytes       = 4096;
+  static constexpr uint32_t kMaxBytes       = kMinBytes << (2 * (kClassCount - 1));   // 64M
+  static constexpr uint32_t kMaxPerClass    = 64;
+  static constexpr uint64_t kClassHighWater = 32ull << 20;
+  static constexpr uint32_t kMaxHoles       = 64;
+
+  struct Stats {
+    uint64_t hits;          // served from the cache
+    uint64_t misses;        // fresh IOBufferMemoryDescriptor
+    uint64_t busy;          // cached buffers skipped because the GPU may still use them
+    uint64_t recycled;      // destroyed BOs taken back
+    uint64_t trimmed;       // freed above the high watermark or under memory pressure
+    uint64_t ggttReused;
+    uint64_t ggttLeaked;    // ranges dropped with the hole list full
+  };
+
+  // What a BO of bytes allocates, binds and is charged for
+  static uint32_t pageBytes(uint32_t bytes) { return (bytes + kMinBytes - 1) & ~(kMinBytes - 1); }
+  // The class whose buffers and ranges a size is filed with
+  static uint32_t classOf(uint32_t bytes) {
+    uint32_t cls = 0;
+    while (cls < kClassCount && classBytes(cls) < bytes) cls++;
+    return cls;             // kClassCount: too large
+  }
+  static uint32_t classBytes(uint32_t cls) { return kMinBytes << (2 * cls); }
+
+  bool init(volatile uint32_t* mmio, XeGGTTSpace* space);
+  void destroy();
+
+  // An idle cached buffer of bytes' page-rounded size and this cache mode,
+  // zeroed, or a fresh one of that size. *outGgtt is its existing GGTT
+  // binding (0: unbound).
+  IOBufferMemoryDescriptor* acquire(uint32_t bytes, const uint32_t completed[kXeEngineCount],
+                                    uint32_t* outGgtt, uint32_t mode = kXeCacheWB);
+
+  // As acquire() of a WB buffer, but a miss returns a pageable buffer with no pages
+  // behind it yet (*outLazy set): prepare() it before the GPU or the kernel
+  // touches it. Once prepared it can come back through release().
+  IOBufferMemoryDescriptor* reserve(uint32_t bytes, const uint32_t completed[kXeEngineCount],
+                                    uint32_t* outGgtt, bool* outLazy);
+
+  // A pageable buffer of bytes' page-rounded size with no pages behind it
+  // (what a reserve() miss returns)
+  IOBufferMemoryDescriptor* reservation(uint32_t bytes);
+
+  // True when nothing but its owner's reference holds md: no user mapping
+  bool     unmapped(IOMemoryDescriptor* md) const {
+    uint32_t base = __atomic_load_n(&baseRefs, __ATOMIC_RELAXED);
+    return base && (uint32_t)md->getRetainCount() <= base;
+  }
+
+  // Takes over md's reference and GGTT binding; busy[e] is the last seqno
+  // engine e may touch it at, mode the cache mode it was acquired with.
+  void release(IOBufferMemoryDescriptor* md, uint32_t ggtt, const uint32_t busy[kXeEngineCount],
+               const uint32_t completed[kXeEngineCount], uint32_t mode = kXeCacheWB);
+
+  // GGTT range for binding a BO of this page-rounded size: a recycled hole
+  // of the same size or fresh space. Caller holds the service's gate
+  // (XeGGTTSpace).
+  uint32_t allocGgtt(uint32_t bytes);
+
+  // Unbinds an idle range that allocGgtt handed out for a BO outside the
+  // pool (a userptr, or a failed bind) and keeps it for the next bind of
+  // that size
+  void     releaseGgtt(uint32_t ggtt, uint32_t bytes);
+
+  // Memory pressure: frees idle cached buffers, largest class and oldest
+  // first, until at least bytes are gone. Returns the bytes freed.
+  uint64_t trim(uint64_t bytes, const uint32_t completed[kXeEngineCount]);
+
+  uint64_t     pooledBytes() const;
+  const Stats& stats() const { return st; }
+
+private:
+  struct Cached {
+    IOBufferMemoryDescriptor* md;
+    uint32_t                  ggtt;
+    uint32_t                  bytes;
+    uint32_t                  mode;
+    uint32_t                  busy[kXeEngineCount];
+  };
+
+  struct Hole {
+    uint32_t ggtt;
+    uint32_t bytes;
+  };
+
+  IOLock*            lock {nullptr};
+  volatile uint32_t* m {nullptr};
+  XeGGTTSpace*       space {nullptr};
+  Cached             cache[kClassCount][kMaxPerClass] {};   // oldest first
+  uint32_t           cached[kClassCount] {};
+  uint64_t           cachedBytes[kClassCount] {};
+  Hole               holes[kClassCount][kMaxHoles] {};
+  uint32_t           holeCount[kClassCount] {};
+  uint32_t           baseRefs {0};    // retain count of an unmapped buffer
+  Stats              st {};
+
+  bool        idle(const Cached& c, const uint32_t completed[kXeEngineCount]);
+  IOBufferMemoryDescriptor* takeIdle(uint32_t bytes, uint32_t mode, const uint32_t completed[kXeEngineCount],
+                                     uint32_t* outGgtt);
+  void        take(uint32_t cls, uint32_t i);
+  void        drop(uint32_t cls, uint32_t i);
+  void        keepHole(uint32_t ggtt, uint32_t bytes);
+};
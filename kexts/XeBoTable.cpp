@@ -0,0 +1,186 @@
+#include "XeBoTable.hpp"
+
+uint32_t XeBoTable::sGeneration = 0;
+
+bool XeBoTable::init(XeMemAccount* account) {
+  if (lock) return true;
+  acct = account;
+  lock = IOLockAlloc();
+  if (!lock) {
+    XeLog("XeBoTable::init: ERROR - lock allocation failed\n");
+    return false;
+  }
+  return true;
+}
+
+void XeBoTable::destroy(volatile uint32_t* mmio) {
+  uint32_t released = 0;
+  for (uint32_t c = 0; c < chunkCount; ++c) {
+    Entry* chunk = chunks[c];
+    for (uint32_t i = 0; i < kChunkSlots; ++i) {
+      Entry& e = chunk[i];
+      if (!e.md) continue;
+      if (mmio && e.ggtt) XeGGTT::clearPages(mmio, e.ggtt, (uint32_t)e.md->getLength());
+      if (e.dirty) IOFree(e.dirty, sizeof(XeDirtyRanges));
+      e.md->release();
+      released++;
+    }
+    IOFree(chunk, sizeof(Entry) * kChunkSlots);
+    chunks[c] = nullptr;
+  }
+  if (released) XeLog("XeBoTable::destroy: released %u buffer objects\n", released);
+  chunkCount = 0;
+  freeHead = kNoSlot;
+  live = 0;
+  if (lock) {
+    IOLockFree(lock);
+    lock = nullptr;
+  }
+}
+
+// Called with the lock held and the free list empty
+bool XeBoTable::grow() {
+  if (chunkCount >= kMaxChunks) {
+    XeLog("XeBoTable::grow: ERROR - table full (%u BOs)\n", kMaxChunks * kChunkSlots);
+    return false;
+  }
+  auto chunk = (Entry*)IOMalloc(sizeof(Entry) * kChunkSlots);
+  if (!chunk) return false;
+  bzero(chunk, sizeof(Entry) * kChunkSlots);
+
+  uint32_t base = chunkCount * kChunkSlots;
+  for (uint32_t i = 0; i < kChunkSlots; ++i) {
+    chunk[i].serial = 1;
+    chunk[i].nextFree = (i + 1 < kChunkSlots) ? base + i + 1 : kNoSlot;
+  }
+  // Slots must be initialized before a lock-free lookup can reach them
+  __atomic_store_n(&chunks[chunkCount], chunk, __ATOMIC_RELEASE);
+  chunkCount++;
+  freeHead = base;
+  return true;
+}
+
+uint64_t XeBoTable::insert(IOMemoryDescriptor* md, void* cpu, uint32_t ggtt, XeMemAccount* account,
+                           bool lazy, uint8_t cacheMode, bool stolen) {
+  if (!md || !lock) return 0;
+  IOLockLock(lock);
+  if (shut || (freeHead == kNoSlot && !grow())) {
+    IOLockUnlock(lock);
+    return 0;
+  }
+  uint32_t slot = freeHead;
+  Entry* e = &chunks[slot / kChunkSlots][slot % kChunkSlots];
+  freeHead = e->nextFree;
+  // Start from a value-initialized entry so nothing of the slot's previous
+  // BO survives; only the handle serial carries over. md stays null (the
+  // slot unpublished) until the store below.
+  Entry fresh {};
+  fresh.serial = e->serial;
+  fresh.nextFree = kNoSlot;
+  fresh.ggtt = ggtt;
+  fresh.cpu = cpu;
+  fresh.bytes = (uint32_t)md->getLength();
+  fresh.generation = freshGeneration();
+  fresh.account = account;
+  fresh.lazy = lazy;
+  fresh.cacheMode = cacheMode;
+  fresh.stolen = stolen;
+  *e = fresh;
+  __atomic_store_n(&e->md, md, __ATOMIC_RELEASE);   // publishes the slot
+  live++;
+  uint64_t cookie = ((uint64_t)e->serial << 32) | (slot + 1);
+  IOLockUnlock(lock);
+  return cookie;
+}
+
+uint32_t XeBoTable::drain(DrainFn fn, void* ctx) {
+  if (!lock) return 0;
+  uint32_t drained = 0;
+  IOLockLock(lock);
+  __atomic_store_n(&shut, true, __ATOMIC_RELEASE);
+  freeHead = kNoSlot;
+  // Rebuild the free list back to front so low slots are reused first
+  for (uint32_t c = chunkCount; c-- > 0;) {
+    Entry* chunk = chunks[c];
+    for (uint32_t i = kChunkSlots; i-- > 0;) {
+      Entry& e = chunk[i];
+      if (e.md) {
+        Entry copy = e;
+        __atomic_store_n(&e.md, (IOMemoryDescriptor*)nullptr, __ATOMIC_RELEASE);
+        __atomic_store_n(&e.serial, e.serial + 1, __ATOMIC_RELEASE);
+        e.ggtt = 0;
+        e.stolen = false;
+        if (copy.purgeable) purgeable--;
+        if (fn) fn(ctx, copy);
+        else copy.md->release();
+        drained++;
+      }
+      e.nextFree = freeHead;
+      freeHead = c * kChunkSlots + i;
+    }
+  }
+  live = 0;
+  IOLockUnlock(lock);
+  return drained;
+}
+
+XeBoTable::Entry* XeBoTable::lookup(uint64_t cookie) const {
+  uint32_t low = (uint32_t)cookie;
+  if (!low) return nullptr;
+  return lookupSlot(low - 1, (uint32_t)(cookie >> 32), 32);
+}
+
+XeBoTable::Entry* XeBoTable::lookupSlot(uint32_t slot, uint32_t serial, uint32_t serialBits) const {
+  if (slot / kChunkSlots >= kMaxChunks) return nullptr;
+  Entry* chunk = __atomic_load_n(&chunks[slot / kChunkSlots], __ATOMIC_ACQUIRE);
+  if (!chunk) return nullptr;
+  Entry* e = &chunk[slot % kChunkSlots];
+  if (!__atomic_load_n(&e->md, __ATOMIC_ACQUIRE)) return nullptr;
+  uint32_t mask = serialBits >= 32 ? 0xFFFFFFFFu : (1u << serialBits) - 1;
+  if ((__atomic_load_n(&e->serial, __ATOMIC_RELAXED) & mask) != (serial & mask)) return nullptr;
+  return e;
+}
+
+bool XeBoTable::remove(uint64_t cookie, Entry* out) {
+  if (!lock) return false;
+  IOLockLock(lock);
+  Entry* e = lookup(cookie);
+  if (!e) {
+    IOLockUnlock(lock);
+    return false;
+  }
+  if (out) *out = *e;
+  if (e->purgeable) purgeable--;
+  uint32_t slot = (uint32_t)cookie - 1;
+  __atomic_store_n(&e->md, (IOMemoryDescriptor*)nullptr, __ATOMIC_RELEASE);
+  __atomic_store_n(&e->serial, e->serial + 1, __ATOMIC_RELEASE);
+  e->ggtt = 0;
+  e->stolen = false;
+  e->nextFree = freeHead;
+  freeHead = slot;
+  live--;
+  IOLockUnlock(lock);
+  return true;
+}
+
+void XeBoTable::setPurgeable(Entry* e, bool on) {
+  if (!e || e->purgeable == on) return;
+  e->purgeable = on;
+  if (on) purgeable++;
+  else purgeable--;
+}
+
+// Lock-free like lookup(): chunks never move, and an entry is only
+// visited once its md is published
+void XeBoTable::forEachPurgeable(PurgeFn fn, void* ctx) {
+  if (!fn || !purgeable) return;
+  uint32_t n = __atomic_load_n(&chunkCount, __ATOMIC_ACQUIRE);
+  for (uint32_t c = 0; c < n; ++c) {
+    Entry* chunk = __atomic_load_n(&chunks[c], __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; chunk && i < kChunkSlots; ++i) {
+      Entry* e = &chunk[i];
+      if (!__atomic_load_n(&e->md, __ATOMIC_ACQUIRE) || !e->purgeable) continue;
+      if (!fn(ctx, e)) return;
+    }
+  }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "XeEngine.hpp"
+#include "XeGGTT.hpp"
+#include "XeMemAccount.hpp"
+#include "XeDirtyRanges.hpp"
+
+class XeUserptrCache;
+class XeSubAllocator;
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Buffer object handle table.
+//
+// A cookie is (serial << 32) | (slot + 1). A slot's serial is bumped every
+// time it is freed, so a stale cookie stops matching and is rejected
+// instead of reaching whatever BO took the slot next. Free slots form a
+// LIFO list, so insert, lookup and remove are all O(1).
+//
+// Each user client owns a table; cookies are only meaningful to the table
+// that issued them. Content generations come from one global counter, so a
+// (cookie, generation) validator key never matches across tables or slot
+// reuse.
+//
+// Slots live in fixed-size chunks that never move and are only freed by
+// destroy(), so lookup() takes no lock: it checks the slot's md (acquire)
+// and serial. insert() and remove() serialize on the table's own lock.
+// remove() only makes the cookie unreachable; the caller must not release
+// a BO that a concurrent lookup may still be using (the service removes
+// BOs under its command gate, where submits look them up).
+class XeBoTable {
+public:
+  static constexpr uint32_t kChunkSlots = 256;
+  static constexpr uint32_t kMaxChunks  = 256;          // 64K live BOs
+  static constexpr uint32_t kNoSlot     = 0xFFFFFFFFu;
+
+  struct Entry {
+    IOMemoryDescriptor*       md;        // null while the slot is free
+    void*                     cpu;       // kernel view of the BO's contents
+    uint32_t                  bytes;     // BO size: md's length, or the chunk size of a sub-allocation
+    uint32_t                  offset;    // sub-allocations: chunk offset within md
+    uint32_t                  ggtt;      // 0 until the first chained submit binds it
+    uint32_t                  generation;// content version: keys validator verdicts and
+                                         // must be refreshed whenever the CPU may have written the BO
+    uint32_t                  serial;    // handle generation, carried in the cookie
+    uint32_t                  nextFree;
+    uint32_t                  busy[kXeEngineCount];   // last seqno per engine that reads it
+    uint64_t                  exportName;// shared BOs: name in the service's export table, else 0
+    uint32_t                  holders;   // export table only: client handles referencing it
+    bool                      mapped;    // userspace has (had) a mapping: contents may change any time
+    XeUserptrCache*           userptr;   // imported user memory: the cache that pinned it, else null
+    XeSubAllocator*           sub;       // chunk of a small-BO slab: the allocator it came from, else null
+    XeMemAccount*             account;   // charged for md (and its binding, once bound); null when
+                                         // someone else pays: imports, userptrs, chunks
+    bool                      lazy;      // md is pageable and not prepared yet: no pages behind it
+    uint8_t                   cacheMode; // XeCacheMode of md's kernel mapping and default user mapping
+    XeDirtyRanges*            dirty;     // WB lines written since the last kMethodFlushBuffer; allocated
+                                         // on the first report, freed (IOFree) with the entry
+    bool                      purgeable; // advised DONTNEED: md's pages may be dropped under memory pressure
+    bool                      purged;    // they were, since the last WILLNEED
+    bool                      stolen;    // md describes a range of stolen memory (XeStolen) through
+                                         // the aperture; bound for life, returned by retiring it
+  };
+
+  // Hands a live entry over on drain(); fn owns e.md's reference afterwards
+  typedef void (*DrainFn)(void* ctx, const Entry& e);
+
+  // Visits a purgeable entry; returning false stops the walk
+  typedef bool (*PurgeFn)(void* ctx, Entry* e);
+
+  static uint32_t freshGeneration() { return __atomic_add_fetch(&sGeneration, 1, __ATOMIC_RELAXED); }
+
+  // account: what the table's owner is charged to (see XeMemAccount)
+  bool     init(XeMemAccount* account = nullptr);
+  void     destroy(volatile uint32_t* mmio);   // unbinds and releases every live BO
+  bool     ready() const { return lock != nullptr; }
+  bool     closed() const { return __atomic_load_n(&shut, __ATOMIC_ACQUIRE); }
+
+  // Takes over the caller's reference to md and, for a recycled BO, its
+  // existing GGTT binding, and the charge the caller made to account.
+  // lazy, cacheMode and stolen: see Entry; they are set before the slot
+  // is published. Returns 0 when the table is full or closed.
+  uint64_t insert(IOMemoryDescriptor* md, void* cpu, uint32_t ggtt = 0, XeMemAccount* account = nullptr,
+                  bool lazy = false, uint8_t cacheMode = 0, bool stolen = false);
+
+  // Lock-free; nullptr for a free slot, a stale serial or a malformed cookie
+  Entry*   lookup(uint64_t cookie) const;
+
+  // As lookup(), for callers that only carry the low serialBits of the serial
+  Entry*   lookupSlot(uint32_t slot, uint32_t serial, uint32_t serialBits) const;
+
+  // Unpublishes the cookie and copies the entry out; the caller now owns
+  // out->md's reference and its GGTT binding.
+  bool     remove(uint64_t cookie, Entry* out);
+
+  // Empties the table in one pass, handing every live entry to fn, and
+  // closes it: every later insert fails, so a create racing the owner's
+  // close cannot leave an entry behind. Must not race lookups (the service
+  // drains under its command gate).
+  uint32_t drain(DrainFn fn, void* ctx);
+
+  // Purgeable entries (madvise) are only marked and walked under the
+  // service's gate. The walk goes in slot order.
+  void     setPurgeable(Entry* e, bool purgeable);
+  void     forEachPurgeable(PurgeFn fn, void* ctx);
+  uint32_t purgeableCount() const { return purgeable; }
+
+  // The service's list of tables that have had purgeable entries (gate)
+  XeBoTable* purgeNext {nullptr};
+  bool       purgeListed {false};
+
+  uint32_t      count() const { return live; }
+  XeMemAccount* account() const { return acct; }
+
+private:
+  IOLock*  lock {nullptr};
+  XeMemAccount* acct {nullptr};
+  Entry*   chunks[kMaxChunks] {};
+  uint32_t chunkCount {0};
+  uint32_t freeHead {kNoSlot};
+  uint32_t live {0};
+  uint32_t purgeable {0};
+  bool     shut {false};       // drained for good; written under lock
+
+  static uint32_t sGeneration;
+
+  bool grow();
+};
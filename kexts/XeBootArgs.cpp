@@ -2,7 +2,7 @@
 #include "XeBootArgs.hpp"
 #include <IOKit/IOLib.h>
 #include <pexpert/pexpert.h>
-#include <string.h>   // strcmp, strchr
+#include <string.h>   // strcmp, strncmp, strlen, strchr
 
 XeBootFlags gXeBoot; // global instance
 
@@ -11,6 +11,16 @@ static inline char xe_tolower(char c) {
     return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
 }
 
+// "name=123" -> 123 when token starts with name=; false otherwise
+static bool xe_parse_uint(const char *token, const char *name, uint32_t *out) {
+    size_t n = strlen(name);
+    if (strncmp(token, name, n) != 0 || token[n] != '=') return false;
+    uint32_t v = 0;
+    for (const char *c = token + n + 1; *c >= '0' && *c <= '9'; ++c) v = v * 10 + (uint32_t)(*c - '0');
+    *out = v;
+    return true;
+}
+
 void XeParseBootArgs() {
     char buf[128] = {};
     if (!PE_parse_boot_argn("xepci", buf, sizeof(buf))) {
@@ -34,6 +44,23 @@ void XeParseBootArgs() {
             gXeBoot.disableForcewake = true;
         } else if (strcmp(token, "nocs") == 0) {
             gXeBoot.disableCommandStream = true;
+        } else if (strcmp(token, "execlists") == 0) {
+            gXeBoot.useExeclists = true;
+        } else if (strcmp(token, "nocoalesce") == 0) {
+            gXeBoot.disableCoalescing = true;
+        } else if (strcmp(token, "nohangcheck") == 0) {
+            gXeBoot.disableHangcheck = true;
+        } else if (strcmp(token, "guc") == 0) {
+            gXeBoot.loadGuC = true;
+        } else if (strcmp(token, "nostolen") == 0) {
+            gXeBoot.disableStolen = true;
+        } else if (strcmp(token, "nokpool") == 0) {
+            gXeBoot.disableKernelPool = true;
+        } else if (xe_parse_uint(token, "memsoft", &gXeBoot.memSoftMB) ||
+                   xe_parse_uint(token, "memhard", &gXeBoot.memHardMB) ||
+                   xe_parse_uint(token, "clientmem", &gXeBoot.clientMemMB) ||
+                   xe_parse_uint(token, "guclog", &gXeBoot.gucLogLevel)) {
+            // value already stored
         } else if (strcmp(token, "strictsafe") == 0) {
             gXeBoot.strictSafe = true;
             gXeBoot.disableForcewake = true;
@@ -42,6 +69,10 @@ void XeParseBootArgs() {
         if (!comma) break;
         p = comma + 1;
     }
-    IOLog("XePCI: boot flags: verbose=%d noforcewake=%d nocs=%d strictsafe=%d\n",
-          gXeBoot.verbose, gXeBoot.disableForcewake, gXeBoot.disableCommandStream, gXeBoot.strictSafe);
+    IOLog("XePCI: boot flags: verbose=%d noforcewake=%d nocs=%d strictsafe=%d execlists=%d nocoalesce=%d nohangcheck=%d guc=%d "
+          "nostolen=%d nokpool=%d memsoft=%uMB memhard=%uMB clientmem=%uMB guclog=%u\n",
+          gXeBoot.verbose, gXeBoot.disableForcewake, gXeBoot.disableCommandStream, gXeBoot.strictSafe,
+          gXeBoot.useExeclists, gXeBoot.disableCoalescing,
+          gXeBoot.disableHangcheck, gXeBoot.loadGuC, gXeBoot.disableStolen, gXeBoot.disableKernelPool,
+          gXeBoot.memSoftMB, gXeBoot.memHardMB, gXeBoot.clientMemMB, gXeBoot.gucLogLevel);
 }
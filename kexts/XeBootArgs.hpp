@@ -7,9 +7,22 @@ struct XeBootFlags {
     bool disableForcewake {false};
     bool disableCommandStream {false};
     bool strictSafe {false};
+    bool useExeclists {false};
+    bool disableCoalescing {false};
+    bool disableHangcheck {false};
+    bool loadGuC {false};
+    bool disableStolen {false};
+    bool disableKernelPool {false};
+    // GPU memory limits in MB; 0 means none (see XeMemAccount.hpp)
+    uint32_t memSoftMB {0};
+    uint32_t memHardMB {0};
+    uint32_t clientMemMB {0};
+    // GuC log verbosity + 1 (1..4); 0 leaves the firmware's default
+    uint32_t gucLogLevel {0};
 };
 
 extern XeBootFlags gXeBoot; // defined in XeBootArgs.cpp
 
-// Parse xepci= comma separated boot flags (verbose,noforcewake,nocs)
+// Parse xepci= comma separated boot flags (verbose,noforcewake,nocs,strictsafe,execlists,nocoalesce,nohangcheck,guc,
+// nostolen,nokpool,memsoft=MB,memhard=MB,clientmem=MB,guclog=N)
 void XeParseBootArgs();
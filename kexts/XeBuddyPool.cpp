@@ -0,0 +1,128 @@
+#include "XeBuddyPool.hpp"
+
+bool XeBuddyPool::init(volatile uint32_t* mmio, XeGGTTSpace* space) {
+  if (md) return true;
+  if (!mmio || !space) {
+    XeLog("XeBuddyPool::init: ERROR - invalid arguments\n");
+    return false;
+  }
+
+  // Contiguous, wired and below the 39 bits a GGTT PTE can address
+  for (top = kMaxOrder; top >= kMinOrder; --top) {
+    md = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(kernel_task,
+            kIODirectionInOut | kIOMemoryPhysicallyContiguous, (mach_vm_size_t)kPageBytes << top,
+            0x0000007FFFFFF000ull);
+    if (md) break;
+    XeLog("XeBuddyPool::init: no contiguous %uKB run, halving\n", (kPageBytes << top) >> 10);
+  }
+  if (!md) {
+    XeLog("XeBuddyPool::init: ERROR - no contiguous run of %uKB\n", (kPageBytes << kMinOrder) >> 10);
+    top = 0;
+    return false;
+  }
+  uint32_t bytes = kPageBytes << top;
+  cpuBase = (uint8_t*)md->getBytesNoCopy();
+  base = space->alloc(bytes);
+  if (!base || !XeGGTT::insertPages(mmio, base, md)) {
+    XeLog("XeBuddyPool::init: ERROR - GGTT bind failed\n");
+    // insertPages can stop part way; leave no PTE pointing at the freed run
+    if (base) XeGGTT::clearPages(mmio, base, bytes);
+    md->release();
+    md = nullptr;
+    cpuBase = nullptr;
+    base = 0;
+    top = 0;
+    return false;
+  }
+  m = mmio;
+
+  for (uint32_t o = 0; o <= kMaxOrder; ++o) head[o] = kNone;
+  push(0, top);
+  st = Stats {};
+  XeLog("XeBuddyPool::init: %uKB at phys 0x%llx, GGTT 0x%08x\n", bytes >> 10,
+        (unsigned long long)md->getPhysicalSegment(0, nullptr, kIOMemoryMapperNone), base);
+  return true;
+}
+
+void XeBuddyPool::destroy() {
+  if (!md) return;
+  XeLog("XeBuddyPool::destroy: allocs=%llu frees=%llu failures=%llu peak=%lluKB\n",
+        (unsigned long long)st.allocs, (unsigned long long)st.frees,
+        (unsigned long long)st.failures, (unsigned long long)(st.peakBytes >> 10));
+  // XeGGTTSpace never takes the range back; only the PTEs go
+  if (m) XeGGTT::clearPages(m, base, kPageBytes << top);
+  md->release();
+  md = nullptr;
+  cpuBase = nullptr;
+  base = 0;
+  top = 0;
+  m = nullptr;
+}
+
+uint32_t XeBuddyPool::orderFor(uint32_t bytes) {
+  uint32_t pages = (bytes + kPageBytes - 1) / kPageBytes;
+  uint32_t order = 0;
+  while ((1u << order) < pages) order++;
+  return order;
+}
+
+void XeBuddyPool::push(uint32_t page, uint32_t order) {
+  prev[page] = kNone;
+  next[page] = head[order];
+  if (head[order] != kNone) prev[head[order]] = (uint16_t)page;
+  head[order] = (uint16_t)page;
+  freeOrder[page] = (uint8_t)(order + 1);
+}
+
+void XeBuddyPool::unlink(uint32_t page, uint32_t order) {
+  if (prev[page] != kNone) next[prev[page]] = next[page];
+  else head[order] = next[page];
+  if (next[page] != kNone) prev[next[page]] = prev[page];
+  freeOrder[page] = 0;
+}
+
+bool XeBuddyPool::alloc(uint32_t bytes, uint32_t* outOffset) {
+  if (!md || !bytes || !outOffset) return false;
+  uint32_t order = orderFor(bytes);
+
+  uint32_t o = order;
+  while (o <= top && head[o] == kNone) o++;
+  if (o > top) {
+    st.failures++;
+    return false;
+  }
+  uint32_t page = head[o];
+  unlink(page, o);
+  // Split down, keeping the low half and freeing the high one each time
+  while (o > order) {
+    o--;
+    push(page + (1u << o), o);
+  }
+
+  st.allocs++;
+  st.usedBytes += kPageBytes << order;
+  if (st.usedBytes > st.peakBytes) st.peakBytes = st.usedBytes;
+  *outOffset = page * kPageBytes;
+  return true;
+}
+
+void XeBuddyPool::free(uint32_t offset, uint32_t bytes) {
+  if (!md || !bytes) return;
+  uint32_t order = orderFor(bytes);
+  uint32_t page = offset / kPageBytes;
+  if ((offset & (kPageBytes - 1)) || (page & ((1u << order) - 1)) || page + (1u << order) > (1u << top)) {
+    XeLog("XeBuddyPool::free: ERROR - bad chunk 0x%x+%u\n", offset, bytes);
+    return;
+  }
+
+  st.frees++;
+  st.usedBytes -= kPageBytes << order;
+  while (order < top) {
+    uint32_t buddy = page ^ (1u << order);
+    if (freeOrder[buddy] != order + 1) break;
+    unlink(buddy, order);
+    if (buddy < page) page = buddy;
+    order++;
+  }
+  push(page, order);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "XeGGTT.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// One physically contiguous, wired run of system RAM carved out in the
+// service's start, before any engine comes up, and bound once into the GGTT.
+// Engine-internal blocks (context images, rings, status pages) are cut from
+// it, so bringing up an engine or growing its context pool neither waits on
+// the VM nor fails because physical memory has fragmented since boot.
+//
+// Chunks are power-of-two runs of pages handed out by a binary buddy
+// scheme: alloc() splits the smallest free chunk that fits, free() merges a
+// chunk with its buddy for as long as the buddy is free at the same order.
+// A chunk's GGTT address is the pool's plus its offset, so neither call
+// writes a PTE.
+//
+// The pool asks for kMaxOrder pages and halves the request down to
+// kMinOrder pages until a contiguous run is found.
+//
+// Not locked: like XeKernelMemory, its only client.
+class XeBuddyPool {
+public:
+  static constexpr uint32_t kPageBytes = 4096;
+  static constexpr uint32_t kMaxOrder  = 10;     // 4MB
+  static constexpr uint32_t kMinOrder  = 8;      // 1MB
+  static constexpr uint32_t kMaxPages  = 1u << kMaxOrder;
+
+  struct Stats {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;      // no free chunk large enough: the caller fell back
+    uint64_t usedBytes;     // in whole chunks, so including rounding
+    uint64_t peakBytes;
+  };
+
+  bool init(volatile uint32_t* mmio, XeGGTTSpace* space);
+  void destroy();
+  bool ready() const { return md != nullptr; }
+
+  // bytes is rounded up to a power-of-two number of pages. On success
+  // *outOffset is the chunk's offset into the pool.
+  bool alloc(uint32_t bytes, uint32_t* outOffset);
+  void free(uint32_t offset, uint32_t bytes);
+
+  uint32_t ggtt(uint32_t offset) const { return base + offset; }
+  uint8_t* cpu(uint32_t offset) const  { return cpuBase + offset; }
+  bool     owns(uint32_t ggttAddr) const { return md && ggttAddr - base < (kPageBytes << top); }
+  uint32_t offsetOf(uint32_t ggttAddr) const { return ggttAddr - base; }
+
+  uint64_t     size() const { return md ? (uint64_t)kPageBytes << top : 0; }
+  uint64_t     freeBytes() const { return size() - st.usedBytes; }
+  const Stats& stats() const { return st; }
+
+private:
+  static constexpr uint16_t kNone = 0xFFFF;
+
+  volatile uint32_t*        m {nullptr};
+  IOBufferMemoryDescriptor* md {nullptr};
+  uint8_t*                  cpuBase {nullptr};
+  uint32_t                  base {0};              // GGTT address of offset 0
+  uint32_t                  top {0};               // order of the whole pool
+  uint16_t                  head[kMaxOrder + 1] {};
+  uint16_t                  next[kMaxPages] {};
+  uint16_t                  prev[kMaxPages] {};
+  uint8_t                   freeOrder[kMaxPages] {};  // order + 1 at the first page of a free chunk, else 0
+  Stats                     st {};
+
+  static uint32_t orderFor(uint32_t bytes);
+  void push(uint32_t page, uint32_t order);
+  void unlink(uint32_t page, uint32_t order);
+};
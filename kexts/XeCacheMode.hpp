@@ -0,0 +1,73 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// CPU caching mode of a BO, chosen at creation (kMethodCreateBuffer flags)
+// and applied to both its kernel mapping and, when the client maps it with
+// kIOMapDefaultCache, its user mapping.
+//
+//   WB  write-back. Best for buffers the CPU reads back. The GPU shares the
+//       LLC with the CPU, so GPU reads see CPU writes and vice versa
+//       without flushing; only agents outside the LLC (scanout) need the
+//       lines clflushed (XeClflushRange).
+//   WC  write-combining. Streaming CPU writes, read by the GPU: command
+//       streams, uploads. Writes sit in per-core combining buffers until
+//       an sfence, so the writer must fence before the GPU is told to
+//       read. CPU reads are uncached and slow.
+//   UC  uncached. Every access goes to memory in program order; nothing to
+//       flush, and every access is slow. For debugging coherency issues.
+enum XeCacheMode : uint32_t {
+  kXeCacheWB = 0,
+  kXeCacheWC = 1,
+  kXeCacheUC = 2,
+  kXeCacheModeCount
+};
+
+static inline IOOptionBits XeCacheMapOption(uint32_t mode) {
+  switch (mode) {
+    case kXeCacheWC: return kIOMapWriteCombineCache;
+    case kXeCacheUC: return kIOMapInhibitCache;
+    default:         return kIOMapDefaultCache;
+  }
+}
+
+static inline const char* XeCacheModeName(uint32_t mode) {
+  switch (mode) {
+    case kXeCacheWB: return "wb";
+    case kXeCacheWC: return "wc";
+    case kXeCacheUC: return "uc";
+    default:         return "?";
+  }
+}
+
+// Writes back (and drops) every cache line of [p, p + bytes) without
+// waiting for it; returns the number of lines. clflushopt is only ordered
+// by a fence, so a batch of ranges takes one XeFlushFence() at the end
+// instead of one per line or range. Every CPU this driver runs on (Gen12
+// graphics) has clflushopt.
+static inline uint32_t XeClflushLines(const void* p, size_t bytes) {
+  if (!bytes) return 0;
+  uintptr_t line = (uintptr_t)p & ~(uintptr_t)63;
+  uintptr_t end = (uintptr_t)p + bytes;
+  uint32_t n = 0;
+  for (; line < end; line += 64, ++n) __asm__ volatile("clflushopt (%0)" :: "r"(line) : "memory");
+  return n;
+}
+
+// Waits for every XeClflushLines() before it to reach memory
+static inline void XeFlushFence() { __asm__ volatile("sfence" ::: "memory"); }
+
+static inline void XeClflushRange(const void* p, size_t bytes) {
+  XeClflushLines(p, bytes);
+  XeFlushFence();
+}
+
+// The CPU is done writing [p, p + bytes) through a mapping of this mode;
+// make the data visible to the GPU before it is submitted
+static inline void XeCacheFlushForGpu(uint32_t mode, const void* p, size_t bytes) {
+  (void)p;
+  (void)bytes;
+  if (mode == kXeCacheWC) __asm__ volatile("sfence" ::: "memory");
+  else __asm__ volatile("" ::: "memory");    // WB: LLC-coherent; UC: already in memory
+}
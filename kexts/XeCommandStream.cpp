@@ -1,6 +1,7 @@
 #include "XeCommandStream.hpp"
 #include "XeService.hpp"
 #include "XeBootArgs.hpp"
+#include "XeCacheMode.hpp"
 
 // Maximum safe MMIO offset
 constexpr uint32_t kCSMaxOffset = 0x00FFFFFF;
@@ -12,77 +13,83 @@ static inline uint32_t safeRd(volatile uint32_t* m, uint32_t off) {
   return m[off >> 2];
 }
 
-void XeCommandStream::logRcs0State() const {
-  XeLog("XeCS::logRcs0State: starting\n");
+void XeCommandStream::logRingState() const {
+  XeLog("XeCS::logRingState: starting\n");
   
   if (!m) {
-    XeLog("XeCS::logRcs0State: ERROR - mmio is null\n");
+    XeLog("XeCS::logRingState: ERROR - mmio is null\n");
     return;
   }
 
   if (gXeBoot.disableCommandStream || gXeBoot.strictSafe) {
-    XeLog("XeCS::logRcs0State: SKIP - disabled by boot flags\n");
+    XeLog("XeCS::logRingState: SKIP - disabled by boot flags\n");
     return;
   }
 
+  const uint32_t headReg = eng->reg(XeHW::RING_HEAD_OFF);
+  const uint32_t tailReg = eng->reg(XeHW::RING_TAIL_OFF);
+  const uint32_t ctlReg  = eng->reg(XeHW::RING_CTL_OFF);
+  const uint32_t modeReg = eng->reg(XeHW::RING_MI_MODE_OFF);
+
   // Validate register offsets before access
-  if (XeHW::RCS0_RING_HEAD > kCSMaxOffset || 
-      XeHW::RCS0_RING_TAIL > kCSMaxOffset ||
-      XeHW::RCS0_RING_CTL > kCSMaxOffset) {
-    XeLog("XeCS::logRcs0State: ERROR - ring register offsets out of range\n");
+  if (headReg > kCSMaxOffset || 
+      tailReg > kCSMaxOffset ||
+      ctlReg > kCSMaxOffset) {
+    XeLog("XeCS::logRingState: ERROR - ring register offsets out of range\n");
     return;
   }
 
   // Acquire forcewake to safely read engine registers
-  XeLog("XeCS::logRcs0State: acquiring forcewake for register access\n");
-  ForcewakeGuard fw(m);
+  XeLog("XeCS::logRingState: acquiring forcewake for register access\n");
+  ForcewakeGuard fw(m, eng->forcewakeReq, eng->forcewakeAck);
   
   if (!fw.isAcquired()) {
     if (gXeBoot.disableForcewake) {
-      XeLog("XeCS::logRcs0State: forcewake disabled, reading without it\n");
+      XeLog("XeCS::logRingState: forcewake disabled, reading without it\n");
     } else {
-      XeLog("XeCS::logRcs0State: WARNING - failed to acquire forcewake, reads may be unreliable\n");
+      XeLog("XeCS::logRingState: WARNING - failed to acquire forcewake, reads may be unreliable\n");
     }
   }
 
-  // Read RCS0 ring buffer state using documented registers
-  XeLog("XeCS::logRcs0State: reading ring registers...\n");
+  // Read ring buffer state using documented registers
+  XeLog("XeCS::logRingState: reading %s ring registers at base 0x%05x...\n",
+        eng->name, eng->mmioBase);
   
-  uint32_t ringHead = safeRd(m, XeHW::RCS0_RING_HEAD);
-  uint32_t ringTail = safeRd(m, XeHW::RCS0_RING_TAIL);
-  uint32_t ringCtl = safeRd(m, XeHW::RCS0_RING_CTL);
+  uint32_t ringHead = safeRd(m, headReg);
+  uint32_t ringTail = safeRd(m, tailReg);
+  uint32_t ringCtl = safeRd(m, ctlReg);
   
   // Check for read errors
   if (ringHead == 0xDEADBEEF || ringTail == 0xDEADBEEF || ringCtl == 0xDEADBEEF) {
-    XeLog("XeCS::logRcs0State: ERROR - null mmio during read\n");
+    XeLog("XeCS::logRingState: ERROR - null mmio during read\n");
     return;
   }
   if (ringHead == 0xBAD0FFFF || ringTail == 0xBAD0FFFF || ringCtl == 0xBAD0FFFF) {
-    XeLog("XeCS::logRcs0State: ERROR - offset out of range\n");
+    XeLog("XeCS::logRingState: ERROR - offset out of range\n");
     return;
   }
 
-  XeLog("XeCS::logRcs0State: HEAD=0x%08x TAIL=0x%08x CTL=0x%08x\n",
+  XeLog("XeCS::logRingState: HEAD=0x%08x TAIL=0x%08x CTL=0x%08x\n",
         ringHead, ringTail, ringCtl);
   
   // Read optional registers (may not be valid on all hardware)
-  if (XeHW::RCS0_MI_MODE <= kCSMaxOffset && XeHW::GFX_MODE <= kCSMaxOffset) {
-    uint32_t miMode = safeRd(m, XeHW::RCS0_MI_MODE);
+  if (modeReg <= kCSMaxOffset && XeHW::GFX_MODE <= kCSMaxOffset) {
+    uint32_t miMode = safeRd(m, modeReg);
     uint32_t gfxMode = safeRd(m, XeHW::GFX_MODE);
-    XeLog("XeCS::logRcs0State: MI_MODE=0x%08x GFX_MODE=0x%08x\n", miMode, gfxMode);
+    XeLog("XeCS::logRingState: MI_MODE=0x%08x GFX_MODE=0x%08x\n", miMode, gfxMode);
   }
 
   // Decode ring control register
   bool ringEnabled = (ringCtl & (1u << 0)) != 0;
   uint32_t ringSize = (ringCtl >> 12) & 0x1FF; // Ring size in pages
-  XeLog("XeCS::logRcs0State: ring %s, size=%u pages\n",
+  XeLog("XeCS::logRingState: ring %s, size=%u pages\n",
         ringEnabled ? "ENABLED" : "DISABLED", ringSize);
   
-  XeLog("XeCS::logRcs0State: completed\n");
+  XeLog("XeCS::logRingState: completed\n");
 }
 
-IOReturn XeCommandStream::submitNoop(IOBufferMemoryDescriptor* bo) {
-  XeLog("XeCS::submitNoop: starting\n");
+IOReturn XeCommandStream::submitNoop(IOBufferMemoryDescriptor* bo, bool quiet) {
+  if (!quiet) XeLog("XeCS::submitNoop: starting\n");
   
   // Validate parameters
   if (!m) {
@@ -115,7 +122,8 @@ IOReturn XeCommandStream::submitNoop(IOBufferMemoryDescriptor* bo) {
     return kIOReturnNoSpace;
   }
   
-  XeLog("XeCS::submitNoop: buffer at %p, size=%llu bytes\n", rawAddr, (unsigned long long)bufSize);
+  if (!quiet)
+    XeLog("XeCS::submitNoop: buffer at %p, size=%llu bytes\n", rawAddr, (unsigned long long)bufSize);
 
   // Write MI_NOOP + MI_BATCH_BUFFER_END to the buffer
   volatile uint32_t* cmds = (volatile uint32_t*)rawAddr;
@@ -125,12 +133,16 @@ IOReturn XeCommandStream::submitNoop(IOBufferMemoryDescriptor* bo) {
   cmds[3] = XeHW::MI_BATCH_BUFFER_END;
   OSSynchronizeIO();
 
+  // Pooled submits skip the rest: the dwords are fixed and the ring state
+  // dump is MMIO reads inside the submit latency being measured
+  if (quiet) return kIOReturnSuccess;
+
   XeLog("XeCS::submitNoop: wrote NOOP batch: [0]=0x%08x [1]=0x%08x [2]=0x%08x [3]=0x%08x\n",
         cmds[0], cmds[1], cmds[2], cmds[3]);
 
   // Log current ring state before any submission
   XeLog("XeCS::submitNoop: logging ring state...\n");
-  logRcs0State();
+  logRingState();
 
   // NOTE: Actual ring tail update and batch execution is NOT implemented yet
   // This requires proper GGTT setup and ring initialization first
@@ -139,3 +151,331 @@ IOReturn XeCommandStream::submitNoop(IOBufferMemoryDescriptor* bo) {
   XeLog("XeCS::submitNoop: completed (batch prepared, not executed)\n");
   return kIOReturnSuccess;
 }
+
+// ----------------------------- Execlists -----------------------------
+
+IOReturn XeCommandStream::enableExeclists(XeKernelMemory& mem) {
+  XeLog("XeCS::enableExeclists: starting on %s\n", eng->name);
+
+  if (!m) {
+    XeLog("XeCS::enableExeclists: ERROR - mmio is null\n");
+    return kIOReturnNotReady;
+  }
+  if (gXeBoot.disableCommandStream || gXeBoot.strictSafe) {
+    XeLog("XeCS::enableExeclists: SKIP - disabled by boot flags\n");
+    return kIOReturnNotReady;
+  }
+  if (el.isEnabled()) return kIOReturnSuccess;
+
+  // HW status page: seqno breadcrumbs land here
+  kmem = &mem;
+  if (!mem.alloc(4096, XeKernelMemory::kPlaceAny, &hwsp)) {
+    XeLog("XeCS::enableExeclists: ERROR - HWSP allocation failed\n");
+    disableExeclists();
+    return kIOReturnNoMemory;
+  }
+
+  if (!kctx.create(mem, *eng, kKernelCtxId, kRingBytes)) {
+    XeLog("XeCS::enableExeclists: ERROR - kernel context creation failed\n");
+    disableExeclists();
+    return kIOReturnNoMemory;
+  }
+
+  {
+    ForcewakeGuard fw(m, eng->forcewakeReq, eng->forcewakeAck);
+    if (!el.enable(m, eng->mmioBase, hwsp.ggtt)) {
+      disableExeclists();
+      return kIOReturnNotReady;
+    }
+  }
+
+  // Per-client contexts are cloned from the kernel context as the hardware
+  // saved it; without a completed first run the pool clones the template.
+  if (!primeKernelContext()) {
+    XeLog("XeCS::enableExeclists: WARNING - %s kernel context never switched out, "
+          "context pool uses the template image\n", eng->name);
+  }
+  if (!ctxPool.init(&mem, *eng, kRingBytes, kctx)) {
+    XeLog("XeCS::enableExeclists: WARNING - %s context pool unavailable\n", eng->name);
+  }
+
+  XeLog("XeCS::enableExeclists: SUCCESS - %s hwsp@0x%08x (%s)\n", eng->name, hwsp.ggtt,
+        mem.placement(hwsp));
+  return kIOReturnSuccess;
+}
+
+// One empty request (seqno write only) so the engine loads, runs and saves
+// the kernel context once
+bool XeCommandStream::primeKernelContext() {
+  uint32_t seqno = 0;
+  if (emitRequest(nullptr, 0, nullptr, 0, &seqno) != kIOReturnSuccess) return false;
+  if (kick() != kIOReturnSuccess) return false;
+  for (uint32_t waited = 0; waited <= kPrimeTimeoutUs; waited += 10) {
+    if (pollSeqno(seqno) && kctx.restored) return true;
+    IODelay(10);
+  }
+  return false;
+}
+
+XeLogicalContext* XeCommandStream::acquireContext() {
+  return ctxPool.ready() ? ctxPool.acquire() : nullptr;
+}
+
+void XeCommandStream::releaseContext(XeLogicalContext* ctx) {
+  ctxPool.release(ctx);
+}
+
+void XeCommandStream::disableExeclists() {
+  el.disable();
+  while (reqCount) popRequest();
+  ctxPool.destroy();
+  if (!kmem) return;
+  kctx.destroy(*kmem);
+  kmem->free(&hwsp);
+  kmem = nullptr;
+}
+
+uint32_t XeCommandStream::completedSeqno() const {
+  if (!hwsp.cpu) return 0;
+  volatile uint32_t* page = (volatile uint32_t*)hwsp.cpu;
+  return page[XeHW::HWSP_SEQNO_INDEX];
+}
+
+IOReturn XeCommandStream::emitExeclist(IOBufferMemoryDescriptor* bo, uint64_t boKey, uint32_t boGen,
+                                       uint32_t* outSeqno) {
+  if (!el.isEnabled() || !kctx.valid()) {
+    XeLog("XeCS::emitExeclist: ERROR - execlists not enabled\n");
+    return kIOReturnNotReady;
+  }
+  if (!bo || !outSeqno) return kIOReturnBadArgument;
+
+  const uint32_t* src = (const uint32_t*)bo->getBytesNoCopy();
+  uint32_t srcDw = (uint32_t)(bo->getLength() / 4);
+  if (!src) return kIOReturnNoMemory;
+
+  // Snapshot first so the batch can't change between validation and copy
+  uint32_t snapDw = srcDw < kMaxInlineDw ? srcDw : kMaxInlineDw;
+  memcpy(staging, src, snapDw * 4);
+
+  XeBatchValidator::Report rep {};
+  XeBatchValidator::Result res = validator.validateCached(boKey, boGen, staging, snapDw, &rep);
+  if (res == XeBatchValidator::kBatchNoEnd && srcDw > kMaxInlineDw) {
+    XeLog("XeCS::emitExeclist: ERROR - batch exceeds %u inline dwords\n", kMaxInlineDw);
+    return kIOReturnNoSpace;
+  }
+  if (res != XeBatchValidator::kBatchOk) {
+    XeLog("XeCS::emitExeclist: ERROR - batch rejected (%s at dw %u)\n",
+          XeBatchValidator::resultName(res), rep.offsetDw);
+    return kIOReturnNotPermitted;
+  }
+  uint32_t n = rep.lengthDw;    // up to (not including) MI_BATCH_BUFFER_END
+  return emitRequest(staging, n, nullptr, 0, outSeqno);
+}
+
+IOReturn XeCommandStream::emitChain(const XeBatchValidator::Link* links, uint32_t n,
+                                    OSObject* const* refs, uint32_t* outSeqno) {
+  if (!el.isEnabled() || !kctx.valid()) {
+    XeLog("XeCS::emitChain: ERROR - execlists not enabled\n");
+    return kIOReturnNotReady;
+  }
+  if (!links || !n || n > XeBatchValidator::kMaxLinks || !outSeqno) return kIOReturnBadArgument;
+
+  XeBatchValidator::Report rep {};
+  uint32_t bad = 0;
+  XeBatchValidator::Result res = validator.validateChain(links, n, &rep, &bad);
+  if (res != XeBatchValidator::kBatchOk) {
+    XeLog("XeCS::emitChain: ERROR - link %u rejected (%s at dw %u)\n",
+          bad, XeBatchValidator::resultName(res), rep.offsetDw);
+    return kIOReturnNotPermitted;
+  }
+
+  // First-level start from the ring; GGTT addressing, privileged context
+  uint32_t body[4] = {
+    XeHW::MI_BATCH_BUFFER_START,
+    links[0].fetchGgtt(),
+    0,
+    XeHW::MI_NOOP,
+  };
+  return emitRequest(body, 4, refs, refs ? n : 0, outSeqno);
+}
+
+// Body + seqno write into the kernel ring, tracked as one request
+IOReturn XeCommandStream::emitRequest(const uint32_t* body, uint32_t n,
+                                      OSObject* const* refs, uint32_t refCount,
+                                      uint32_t* outSeqno) {
+  uint32_t seqno = nextSeqno;
+  uint32_t tail[6] = {
+    XeHW::MI_STORE_DATA_IMM_GGTT,
+    hwsp.ggtt + XeHW::HWSP_SEQNO_INDEX * 4,
+    0,
+    seqno,
+    XeHW::MI_USER_INTERRUPT,
+    XeHW::MI_NOOP,                 // keep the tail qword aligned
+  };
+  uint32_t tailDw = (n & 1) ? 5 : 6;
+  if (reqCount == kMaxRequests) retireRequests();
+  if (reqCount == kMaxRequests) {
+    XeLog("XeCS::emitRequest: ERROR - %u requests in flight\n", reqCount);
+    return kIOReturnNoSpace;
+  }
+  if ((n + tailDw) * 4 * 2 > kctx.ringSpace()) {
+    // Factor 2 leaves room for NOOP padding at the wrap point
+    XeLog("XeCS::emitRequest: ERROR - ring full\n");
+    return kIOReturnNoSpace;
+  }
+  uint32_t head = kctx.ringTail;
+  if ((n && !kctx.emit(body, n)) || !kctx.emit(tail, tailDw)) {
+    // Wrap padding can still run out of room: drop the partial request
+    // (nothing past submittedTail has reached the hardware) so no seqno
+    // is handed out that the ring will never write
+    kctx.ringTail = head;
+    XeLog("XeCS::emitRequest: ERROR - %s ring full, request dropped\n", eng->name);
+    return kIOReturnNoSpace;
+  }
+  nextSeqno++;
+
+  Request& rq = reqs[(reqHead + reqCount) % kMaxRequests];
+  rq = Request {seqno, head, kctx.ringTail, refCount, {}};
+  for (uint32_t i = 0; i < refCount; ++i) {
+    rq.refs[i] = refs[i];
+    if (refs[i]) refs[i]->retain();
+  }
+  reqCount++;
+
+  *outSeqno = seqno;
+  XeLog("XeCS::emitRequest: %s seqno=%u tail=0x%x (%u dwords, %u chained)\n",
+        eng->name, seqno, kctx.ringTail, n, refCount);
+  return kIOReturnSuccess;
+}
+
+IOReturn XeCommandStream::kick() {
+  if (!el.isEnabled()) return kIOReturnNotReady;
+  if (kctx.ringTail == kctx.submittedTail) return kIOReturnSuccess;  // nothing new
+
+  ForcewakeGuard fw(m, eng->forcewakeReq, eng->forcewakeAck);
+  el.processCsb();
+  if (!el.submit(&kctx)) {
+    return kIOReturnBusy;
+  }
+  return kIOReturnSuccess;
+}
+
+IOReturn XeCommandStream::submitExeclist(IOBufferMemoryDescriptor* bo, uint64_t boKey, uint32_t boGen,
+                                         uint32_t* outSeqno) {
+  IOReturn kr = emitExeclist(bo, boKey, boGen, outSeqno);
+  if (kr != kIOReturnSuccess) return kr;
+  return kick();
+}
+
+bool XeCommandStream::seqnoPassed(uint32_t seqno) const {
+  return (int32_t)(completedSeqno() - seqno) >= 0;
+}
+
+void XeCommandStream::popRequest() {
+  Request& rq = reqs[reqHead];
+  for (uint32_t i = 0; i < rq.refCount; ++i) {
+    if (rq.refs[i]) rq.refs[i]->release();
+  }
+  rq = Request {};
+  reqHead = (reqHead + 1) % kMaxRequests;
+  reqCount--;
+}
+
+void XeCommandStream::retireRequests() {
+  while (reqCount && seqnoPassed(reqs[reqHead].seqno)) popRequest();
+}
+
+bool XeCommandStream::pollSeqno(uint32_t seqno) {
+  if (!el.isEnabled()) return true;
+  retireRequests();
+  if (seqnoPassed(seqno)) return true;
+
+  // Retire finished ports so queued work reaches the hardware
+  ForcewakeGuard fw(m, eng->forcewakeReq, eng->forcewakeAck);
+  el.processCsb();
+  return seqnoPassed(seqno);
+}
+
+// ----------------------------- Hang recovery -----------------------------
+
+static bool waitReg(volatile uint32_t* m, uint32_t reg, uint32_t mask, uint32_t value,
+                    uint32_t timeoutUs) {
+  for (uint32_t waited = 0; waited <= timeoutUs; waited += 10) {
+    if ((safeRd(m, reg) & mask) == value) return true;
+    IODelay(10);
+  }
+  return false;
+}
+
+bool XeCommandStream::busy() {
+  if (!el.isEnabled()) return false;
+  retireRequests();
+  return reqCount != 0;
+}
+
+uint64_t XeCommandStream::activeHead() const {
+  if (!m) return 0;
+  ForcewakeGuard fw(m, eng->forcewakeReq, eng->forcewakeAck);
+  uint32_t lo = safeRd(m, eng->reg(XeHW::RING_ACTHD_OFF));
+  uint32_t hi = safeRd(m, eng->reg(XeHW::RING_ACTHD_UDW_OFF));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+IOReturn XeCommandStream::resetEngine(uint32_t* outReplayed) {
+  if (outReplayed) *outReplayed = 0;
+  if (!el.isEnabled() || !kctx.valid()) return kIOReturnNotReady;
+
+  retireRequests();
+  if (reqCount == 0) {
+    XeLog("XeCS::resetEngine: %s completed while being checked, no reset\n", eng->name);
+    return kIOReturnSuccess;
+  }
+  const Request guilty = reqs[reqHead];
+  XeLog("XeCS::resetEngine: %s hung on seqno=%u (ring 0x%x..0x%x, completed=%u)\n",
+        eng->name, guilty.seqno, guilty.head, guilty.tail, completedSeqno());
+
+  ForcewakeGuard fw(m, eng->forcewakeReq, eng->forcewakeAck);
+  const uint32_t resetCtl = eng->reg(XeHW::RING_RESET_CTL_OFF);
+
+  // Ask the engine to stop at a command boundary. A truly wedged engine may
+  // never report ready; reset it anyway.
+  wr(resetCtl, XeHW::MASKED_BIT_ENABLE(XeHW::RESET_CTL_REQUEST_RESET));
+  if (!waitReg(m, resetCtl, XeHW::RESET_CTL_READY_TO_RESET, XeHW::RESET_CTL_READY_TO_RESET,
+               kResetReadyUs)) {
+    XeLog("XeCS::resetEngine: WARNING - %s not ready to reset, forcing\n", eng->name);
+  }
+
+  wr(XeHW::GEN6_GDRST, eng->resetDomain);
+  bool done = waitReg(m, XeHW::GEN6_GDRST, eng->resetDomain, 0, kResetDoneUs);
+  wr(resetCtl, XeHW::MASKED_BIT_DISABLE(XeHW::RESET_CTL_REQUEST_RESET));
+  if (!done) {
+    XeLog("XeCS::resetEngine: ERROR - %s GDRST did not clear (0x%08x)\n",
+          eng->name, safeRd(m, XeHW::GEN6_GDRST));
+    return kIOReturnTimeout;
+  }
+
+  // The reset dropped HWSP, mode and CSB programming along with the ports
+  el.disable();
+  if (!el.enable(m, eng->mmioBase, hwsp.ggtt)) return kIOReturnNotReady;
+
+  // Complete the guilty request so its waiters wake, then restart the
+  // context right behind it.
+  volatile uint32_t* page = (volatile uint32_t*)hwsp.cpu;
+  page[XeHW::HWSP_SEQNO_INDEX] = guilty.seqno;
+  XeFlushFence();
+  OSSynchronizeIO();
+  guiltySeqno = guilty.seqno;
+  hasGuilty = true;
+  popRequest();
+
+  kctx.rewind(guilty.tail);
+  uint32_t replayed = reqCount;
+  if (kctx.ringTail != guilty.tail && !el.submit(&kctx)) {
+    XeLog("XeCS::resetEngine: ERROR - %s replay submit failed\n", eng->name);
+    return kIOReturnBusy;
+  }
+
+  if (outReplayed) *outReplayed = replayed;
+  XeLog("XeCS::resetEngine: %s reset done, replaying %u request(s)\n", eng->name, replayed);
+  return kIOReturnSuccess;
+}
@@ -3,17 +3,115 @@
 #include <IOKit/IOBufferMemoryDescriptor.h>
 #include "xe_hw_offsets.hpp"
 #include "ForcewakeGuard.hpp"
+#include "XeExeclists.hpp"
+#include "XeEngine.hpp"
+#include "XeBatchValidator.hpp"
+#include "XeContextPool.hpp"
 
+// Command stream for one engine; every register access goes through the
+// engine descriptor's MMIO base, so RCS0 is just kXeEngines[kXeEngineRCS0].
 class XeCommandStream {
 public:
-  explicit XeCommandStream(volatile uint32_t* mmio) : m(mmio) {}
+  XeCommandStream() = default;
+  explicit XeCommandStream(volatile uint32_t* mmio,
+                           const XeEngineDesc& engine = kXeEngines[kXeEngineRCS0])
+    : m(mmio), eng(&engine) { validator.attach(engine); }
   bool valid() const { return m != nullptr; }
+  void attach(volatile uint32_t* mmio, const XeEngineDesc& engine) {
+    m = mmio; eng = &engine; validator.attach(engine);
+  }
+  const XeEngineDesc& engine() const { return *eng; }
 
-  void logRcs0State() const;
-  IOReturn submitNoop(IOBufferMemoryDescriptor* bo);
+  void logRingState() const;
+  // quiet drops the progress logs and the ring state dump (errors are
+  // still logged); the pooled submit path passes it unless xepci=verbose.
+  IOReturn submitNoop(IOBufferMemoryDescriptor* bo, bool quiet = false);
+
+  // Execlist submission path (xepci=execlists). Work is copied inline into
+  // a kernel logical ring context followed by a seqno write to the HWSP.
+  // emitExeclist() only writes the ring; kick() is the doorbell (tail
+  // update + ELSP write), so a burst of emits can share one kick.
+  // Batches are snapshotted and run through the validator before they
+  // reach the ring; boKey/boGen key the verdict cache (boKey 0 = no cache).
+  // The HWSP, rings and context images come from mem.
+  IOReturn enableExeclists(XeKernelMemory& mem);
+  void     disableExeclists();
+  bool     execlistsEnabled() const { return el.isEnabled(); }
+  IOReturn emitExeclist(IOBufferMemoryDescriptor* bo, uint64_t boKey, uint32_t boGen,
+                        uint32_t* outSeqno);
+  IOReturn kick();
+
+  // Chained path: links run from their GGTT bindings (or from kernel
+  // copies, see XeBatchValidator::Link), so the ring only carries one
+  // MI_BATCH_BUFFER_START plus the seqno write whatever the batch sizes.
+  // refs (n entries, may be null) are retained until the request retires.
+  // The caller must keep the links' contents stable while they are in
+  // flight.
+  IOReturn emitChain(const XeBatchValidator::Link* links, uint32_t n, OSObject* const* refs,
+                     uint32_t* outSeqno);
+  IOReturn submitExeclist(IOBufferMemoryDescriptor* bo, uint64_t boKey, uint32_t boGen,
+                          uint32_t* outSeqno);
+  bool     pollSeqno(uint32_t seqno);          // processes CSB; true once seqno landed
+  bool     seqnoPassed(uint32_t seqno) const;
+  uint32_t completedSeqno() const;
+  const XeExeclists::Stats& execlistStats() const { return el.stats(); }
+  const XeBatchValidator::Stats& validatorStats() const { return validator.stats(); }
+
+  // Hang recovery. busy() is true while any emitted request is unretired.
+  // resetEngine() resets only this engine, completes the guilty request
+  // (its seqno is written to the HWSP) and replays the requests behind it.
+  bool     busy();
+  uint64_t activeHead() const;
+  IOReturn resetEngine(uint32_t* outReplayed);
+  bool     isGuilty(uint32_t seqno) const { return hasGuilty && seqno == guiltySeqno; }
+
+  // Logical contexts for clients, cloned from the golden kernel context
+  XeLogicalContext* acquireContext();
+  void              releaseContext(XeLogicalContext* ctx);
+  const XeContextPool::Stats& contextStats() const { return ctxPool.stats(); }
 
 private:
-  volatile uint32_t* m {nullptr};
+  static constexpr uint32_t kKernelCtxId   = 1;
+  static constexpr uint32_t kRingBytes     = 16 * 1024;
+  static constexpr uint32_t kMaxInlineDw   = 256;
+  static constexpr uint32_t kMaxRequests   = 128;
+  static constexpr uint32_t kResetReadyUs  = 1000;    // engine quiesce before GDRST
+  static constexpr uint32_t kResetDoneUs   = 10000;   // GDRST self-clear
+  static constexpr uint32_t kPrimeTimeoutUs = 10000;  // first kernel context save
+
+  volatile uint32_t*  m {nullptr};
+  const XeEngineDesc* eng {&kXeEngines[kXeEngineRCS0]};
   inline uint32_t rd(uint32_t off) const { return m ? m[off >> 2] : 0; }
   inline void     wr(uint32_t off, uint32_t v) { if (m) { m[off >> 2] = v; OSSynchronizeIO(); } }
+
+  XeExeclists               el;
+  XeLogicalContext          kctx;
+  XeKernelMemory*           kmem {nullptr};
+  XeKernelMemory::Block     hwsp {};
+  uint32_t                  nextSeqno {1};
+
+  // Emitted but unretired requests, oldest first (ring byte offsets)
+  struct Request {
+    uint32_t  seqno;
+    uint32_t  head;
+    uint32_t  tail;
+    uint32_t  refCount;
+    OSObject* refs[XeBatchValidator::kMaxLinks];   // chained batches in flight
+  };
+  Request                   reqs[kMaxRequests] {};
+  uint32_t                  reqHead {0};
+  uint32_t                  reqCount {0};
+  uint32_t                  guiltySeqno {0};
+  bool                      hasGuilty {false};
+  void                      retireRequests();
+  void                      popRequest();
+  IOReturn                  emitRequest(const uint32_t* body, uint32_t bodyDw,
+                                        OSObject* const* refs, uint32_t refCount,
+                                        uint32_t* outSeqno);
+
+  XeContextPool             ctxPool;
+  bool                      primeKernelContext();
+
+  XeBatchValidator          validator;
+  uint32_t                  staging[kMaxInlineDw] {};   // batch snapshot, immune to user rewrites
 };
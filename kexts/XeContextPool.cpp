@@ -0,0 +1,127 @@
+#include "XeContextPool.hpp"
+#include <kern/clock.h>              // mach_absolute_time, absolutetime_to_nanoseconds
+
+bool XeContextPool::init(XeKernelMemory* kmem, const XeEngineDesc& engine, uint32_t ringSize,
+                         const XeLogicalContext& golden) {
+  XeLog("XeCtxPool::init: engine=%s golden=%s\n", engine.name,
+        golden.restored ? "hardware-saved" : "template");
+
+  const uint32_t* src = (const uint32_t*)golden.image.cpu;
+  if (!kmem || !src) {
+    XeLog("XeCtxPool::init: ERROR - invalid arguments\n");
+    return false;
+  }
+
+  mem = kmem;
+  eng = &engine;
+  ringBytes = ringSize;
+
+  goldenBytes = golden.imageBytes;
+  goldenImage = (uint8_t*)IOMalloc(goldenBytes);
+  if (!goldenImage) {
+    XeLog("XeCtxPool::init: ERROR - golden image allocation failed\n");
+    return false;
+  }
+  memcpy(goldenImage, src, goldenBytes);
+  goldenSaved = golden.restored;
+
+  while (created < kPrealloc) {
+    if (!grow()) break;
+  }
+  XeLog("XeCtxPool::init: %u contexts ready (%u byte images)\n", freeCount, goldenBytes);
+  return freeCount != 0;
+}
+
+void XeContextPool::destroy() {
+  for (uint32_t i = 0; i < kMaxContexts; ++i) {
+    if (slots[i].valid()) slots[i].destroy(*mem);
+  }
+  if (goldenImage) {
+    IOFree(goldenImage, goldenBytes);
+    goldenImage = nullptr;
+  }
+  freeCount = retiringCount = created = 0;
+  goldenBytes = 0;
+  mem = nullptr;
+}
+
+// The slow path: allocate, bind and template a context up front
+bool XeContextPool::grow() {
+  if (created == kMaxContexts) return false;
+  uint32_t i = created;
+  if (!slots[i].create(*mem, *eng, kFirstSwId + i, ringBytes)) {
+    XeLog("XeCtxPool::grow: ERROR - context %u creation failed\n", i);
+    return false;
+  }
+  created++;
+  freeList[freeCount++] = (uint8_t)i;
+  st.grows++;
+  return true;
+}
+
+void XeContextPool::reclaim() {
+  uint32_t kept = 0;
+  for (uint32_t k = 0; k < retiringCount; ++k) {
+    uint8_t i = retiring[k];
+    if (slots[i].inPort || slots[i].queued) {
+      retiring[kept++] = i;
+    } else {
+      freeList[freeCount++] = i;
+    }
+  }
+  retiringCount = kept;
+}
+
+// Golden register state over the whole image, then this context's ring
+void XeContextPool::clone(XeLogicalContext& ctx) {
+  memcpy(ctx.image.cpu, goldenImage, goldenBytes);
+
+  uint32_t* regs = ctx.regState();
+  regs[XeHW::CTX_RING_HEAD]  = 0;
+  regs[XeHW::CTX_RING_TAIL]  = 0;
+  regs[XeHW::CTX_RING_START] = ctx.ring.ggtt;
+  regs[XeHW::CTX_RING_CTL]   = (ctx.ringSize - 4096) | XeHW::RING_CTL_VALID;
+  if (goldenSaved) {
+    // The saved slot holds the raw register; restore it like a switched-out context
+    regs[XeHW::CTX_CONTEXT_CONTROL] = XeHW::MASKED_BIT_ENABLE(XeHW::CTX_CTRL_INHIBIT_SYN_SWITCH) |
+                                      XeHW::MASKED_BIT_DISABLE(XeHW::CTX_CTRL_RESTORE_INHIBIT);
+  }
+  OSSynchronizeIO();
+
+  ctx.ringTail = 0;
+  ctx.submittedTail = 0;
+  ctx.inPort = ctx.queued = false;
+  ctx.restored = goldenSaved;
+}
+
+XeLogicalContext* XeContextPool::acquire() {
+  if (!goldenImage) return nullptr;
+  reclaim();
+  if (!freeCount && !grow()) {
+    st.exhausted++;
+    XeLog("XeCtxPool::acquire: ERROR - %s out of contexts (%u)\n", eng->name, created);
+    return nullptr;
+  }
+
+  XeLogicalContext& ctx = slots[freeList[--freeCount]];
+  uint64_t start = mach_absolute_time();
+  clone(ctx);
+  uint64_t ns = 0;
+  absolutetime_to_nanoseconds(mach_absolute_time() - start, &ns);
+
+  st.clones++;
+  st.lastCloneNs = ns;
+  if (ns > st.maxCloneNs) st.maxCloneNs = ns;
+  XeLog("XeCtxPool::acquire: %s swId=%u cloned in %llu ns\n",
+        eng->name, ctx.swCtxId, (unsigned long long)ns);
+  return &ctx;
+}
+
+void XeContextPool::release(XeLogicalContext* ctx) {
+  if (!ctx) return;
+  uint32_t i = indexOf(ctx);
+  if (i >= created) return;
+  st.recycled++;
+  retiring[retiringCount++] = (uint8_t)i;
+  reclaim();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include "xe_hw_offsets.hpp"
+#include "XeGGTT.hpp"
+#include "XeEngine.hpp"
+#include "XeExeclists.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Per-engine pool of logical ring contexts.
+//
+// Images and rings are allocated (XeKernelMemory) and bound ahead of time. A
+// new context is a memcpy of the golden image (the kernel context as the
+// hardware saved it after its first run) with the ring registers patched,
+// so it restores a known-good state instead of starting from a zeroed page.
+// Released contexts are recycled once the hardware has let go of them.
+//
+// Not thread-safe; the owner runs everything under its command gate.
+class XeContextPool {
+public:
+  static constexpr uint32_t kMaxContexts = 32;
+  static constexpr uint32_t kPrealloc    = 4;
+  static constexpr uint32_t kFirstSwId   = 2;    // 1 is the kernel context
+
+  struct Stats {
+    uint64_t clones;
+    uint64_t grows;
+    uint64_t recycled;
+    uint64_t exhausted;
+    uint64_t lastCloneNs;
+    uint64_t maxCloneNs;
+  };
+
+  // Snapshot golden's image and pre-build kPrealloc contexts.
+  bool init(XeKernelMemory* mem, const XeEngineDesc& engine, uint32_t ringBytes,
+            const XeLogicalContext& golden);
+  void destroy();
+  bool ready() const { return goldenImage != nullptr; }
+
+  // A fresh context (empty ring, golden register state), or nullptr.
+  XeLogicalContext* acquire();
+
+  // Give a context back. It is reused only after it left the ports.
+  void release(XeLogicalContext* ctx);
+
+  uint32_t     available() const { return freeCount; }
+  const Stats& stats() const     { return st; }
+
+private:
+  XeKernelMemory*     mem {nullptr};
+  const XeEngineDesc* eng {nullptr};
+  uint32_t            ringBytes {0};
+
+  uint8_t*            goldenImage {nullptr};
+  uint32_t            goldenBytes {0};
+  bool                goldenSaved {false};   // hardware-saved, not the template
+
+  XeLogicalContext    slots[kMaxContexts] {};
+  uint8_t             freeList[kMaxContexts] {};
+  uint32_t            freeCount {0};
+  uint8_t             retiring[kMaxContexts] {};   // released while still in a port
+  uint32_t            retiringCount {0};
+  uint32_t            created {0};
+  Stats               st {};
+
+  bool grow();
+  void reclaim();
+  void clone(XeLogicalContext& ctx);
+  uint32_t indexOf(const XeLogicalContext* ctx) const { return (uint32_t)(ctx - slots); }
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+
+// Byte ranges of a BO the CPU has written since its last flush, as
+// reported by the client (kMethodFlushBuffer), kept at cache-line
+// granularity. Only readers outside the LLC need this: scanout fetches
+// straight from memory, so a WB framebuffer has to have its dirty lines
+// written back before the flip, and flushing only the damaged lines is far
+// cheaper than flushing a whole 16 MB surface every frame.
+//
+// Ranges stay sorted and disjoint; ranges that overlap or touch merge.
+// Once the set is full, the two neighbours with the smallest gap merge:
+// that flushes a few clean lines rather than ever dropping a dirty one.
+//
+// Not locked: the service updates a BO's set under its command gate.
+struct XeDirtyRanges {
+  static constexpr uint32_t kLineBytes = 64;
+  static constexpr uint32_t kMaxRanges = 64;   // one per row of a 64-row damage rect
+
+  struct Range {
+    uint32_t start;   // line aligned
+    uint32_t end;     // line aligned, exclusive
+  };
+
+  Range    range[kMaxRanges + 1] {};   // one spare slot while adding
+  uint32_t count {0};
+
+  // Marks [offset, offset + bytes) dirty, clipped to a BO of limit bytes
+  void add(uint32_t offset, uint32_t bytes, uint32_t limit) {
+    if (!bytes || offset >= limit) return;
+    uint64_t stop = (uint64_t)offset + bytes;
+    if (stop > limit) stop = limit;
+    Range n = { offset & ~(kLineBytes - 1), (uint32_t)((stop + kLineBytes - 1) & ~(uint64_t)(kLineBytes - 1)) };
+
+    // Fold in every range that overlaps or touches n, then insert it in order
+    uint32_t out = 0, at = 0;
+    bool placed = false;
+    for (uint32_t i = 0; i < count; ++i) {
+      Range r = range[i];
+      if (r.end < n.start) { range[out++] = r; continue; }
+      if (r.start > n.end) {
+        if (!placed) { at = out; placed = true; }
+        range[out++] = r;
+        continue;
+      }
+      if (r.start < n.start) n.start = r.start;
+      if (r.end > n.end) n.end = r.end;
+    }
+    if (!placed) at = out;
+    for (uint32_t i = out; i > at; --i) range[i] = range[i - 1];
+    range[at] = n;
+    count = out + 1;
+
+    if (count > kMaxRanges) {
+      uint32_t best = 0;
+      for (uint32_t i = 1; i + 1 < count; ++i) {
+        if (range[i + 1].start - range[i].end < range[best + 1].start - range[best].end) best = i;
+      }
+      range[best].end = range[best + 1].end;
+      for (uint32_t i = best + 1; i + 1 < count; ++i) range[i] = range[i + 1];
+      count--;
+    }
+  }
+
+  uint32_t lines() const {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; ++i) n += (range[i].end - range[i].start) / kLineBytes;
+    return n;
+  }
+
+  void clear() { count = 0; }
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include "xe_hw_offsets.hpp"
+
+// Gen12 engine descriptor table.
+//
+// Every ring/execlist register is addressed as (mmioBase + *_OFF) from
+// xe_hw_offsets.hpp, so one XeCommandStream implementation drives any engine.
+// MMIO bases and forcewake domains follow the Gen11+/Gen12 layout.
+
+enum XeEngineId : uint32_t {
+  kXeEngineRCS0 = 0,
+  kXeEngineBCS0,
+  kXeEngineVCS0,
+  kXeEngineVCS2,
+  kXeEngineVECS0,
+  kXeEngineCCS0,
+  kXeEngineCount
+};
+
+// Hardware engine class (matches the class field in CSB / context ids)
+enum XeEngineClass : uint8_t {
+  kXeClassRender       = 0,
+  kXeClassVideo        = 1,
+  kXeClassVideoEnhance = 2,
+  kXeClassCopy         = 3,
+  kXeClassCompute      = 4,
+};
+
+// Capability bits
+enum : uint32_t {
+  kXeEngineCapRender     = 1u << 0,   // 3D pipeline
+  kXeEngineCapCompute    = 1u << 1,   // GPGPU walker
+  kXeEngineCapCopy       = 1u << 2,   // XY_* blitter commands
+  kXeEngineCapVideoDec   = 1u << 3,   // MFX/HCP decode
+  kXeEngineCapVideoEnc   = 1u << 4,   // VDENC
+  kXeEngineCapVideoEnh   = 1u << 5,   // VEBOX
+  kXeEngineCapOptional   = 1u << 31,  // not fused in on every Gen12 SKU
+};
+
+struct XeEngineDesc {
+  XeEngineId    id;
+  const char*   name;
+  uint32_t      mmioBase;
+  XeEngineClass engineClass;
+  uint8_t       instance;
+  uint32_t      caps;
+  uint32_t      ctxStatePages;   // LRC register state pages (after PPHWSP)
+  uint32_t      forcewakeReq;    // forcewake domain covering this engine
+  uint32_t      forcewakeAck;
+  uint32_t      resetDomain;     // GEN6_GDRST bit for a per-engine reset
+
+  constexpr uint32_t reg(uint32_t off) const { return mmioBase + off; }
+  constexpr bool     has(uint32_t cap) const { return (caps & cap) != 0; }
+};
+
+constexpr XeEngineDesc kXeEngines[kXeEngineCount] = {
+  { kXeEngineRCS0,  "rcs0",  0x00002000, kXeClassRender,       0,
+    kXeEngineCapRender | kXeEngineCapCompute,
+    22, XeHW::FORCEWAKE_REQ, XeHW::FORCEWAKE_ACK, XeHW::GEN11_GRDOM_RENDER },
+  { kXeEngineBCS0,  "bcs0",  0x00022000, kXeClassCopy,         0,
+    kXeEngineCapCopy,
+    2,  XeHW::FORCEWAKE_REQ, XeHW::FORCEWAKE_ACK, XeHW::GEN11_GRDOM_BLT },
+  { kXeEngineVCS0,  "vcs0",  0x001C0000, kXeClassVideo,        0,
+    kXeEngineCapVideoDec | kXeEngineCapVideoEnc,
+    2,  XeHW::FORCEWAKE_MEDIA_VDBOX_REQ(0), XeHW::FORCEWAKE_MEDIA_VDBOX_ACK(0),
+    XeHW::GEN11_GRDOM_MEDIA(0) },
+  { kXeEngineVCS2,  "vcs2",  0x001D0000, kXeClassVideo,        2,
+    kXeEngineCapVideoDec | kXeEngineCapVideoEnc | kXeEngineCapOptional,
+    2,  XeHW::FORCEWAKE_MEDIA_VDBOX_REQ(2), XeHW::FORCEWAKE_MEDIA_VDBOX_ACK(2),
+    XeHW::GEN11_GRDOM_MEDIA(2) },
+  { kXeEngineVECS0, "vecs0", 0x001C8000, kXeClassVideoEnhance, 0,
+    kXeEngineCapVideoEnh,
+    2,  XeHW::FORCEWAKE_MEDIA_VEBOX_REQ(0), XeHW::FORCEWAKE_MEDIA_VEBOX_ACK(0),
+    XeHW::GEN11_GRDOM_VECS(0) },
+  { kXeEngineCCS0,  "ccs0",  0x0001A000, kXeClassCompute,      0,
+    kXeEngineCapCompute | kXeEngineCapOptional,
+    22, XeHW::FORCEWAKE_REQ, XeHW::FORCEWAKE_ACK, XeHW::GEN11_GRDOM_RENDER },  // shares the render domain
+};
+
+constexpr bool XeEngineTableOrdered() {
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (kXeEngines[i].id != i) return false;
+  }
+  return true;
+}
+
+static_assert(XeEngineTableOrdered(), "kXeEngines must be indexed by XeEngineId");
+static_assert(kXeEngines[kXeEngineRCS0].mmioBase == XeHW::RCS0_BASE, "RCS0 base mismatch");
+
+inline constexpr const XeEngineDesc* XeEngineById(uint32_t id) {
+  return id < kXeEngineCount ? &kXeEngines[id] : nullptr;
+}
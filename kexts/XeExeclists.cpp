@@ -0,0 +1,284 @@
+#include "XeExeclists.hpp"
+#include "XeCacheMode.hpp"
+
+// -------------------------- XeLogicalContext --------------------------
+
+bool XeLogicalContext::create(XeKernelMemory& mem, const XeEngineDesc& engine, uint32_t swId,
+                              uint32_t ringBytes) {
+  XeLog("XeLRC::create: engine=%s swId=%u ring=%u bytes\n", engine.name, swId, ringBytes);
+
+  if (swId > XeHW::CTX_DESC_SW_CTX_ID_MAX || ringBytes < 4096 || (ringBytes & (ringBytes - 1))) {
+    XeLog("XeLRC::create: ERROR - invalid arguments\n");
+    return false;
+  }
+
+  const uint32_t engineBase = engine.mmioBase;
+  imageBytes = XeHW::LRC_PPHWSP_BYTES + engine.ctxStatePages * 4096;
+  if (!mem.alloc(imageBytes, XeKernelMemory::kPlacePool | XeKernelMemory::kPlaceSystem, &image) ||
+      !mem.alloc(ringBytes, XeKernelMemory::kPlaceAny, &ring)) {
+    XeLog("XeLRC::create: ERROR - allocation failed\n");
+    destroy(mem);
+    return false;
+  }
+
+  ringSize = ringBytes;
+  ringTail = 0;
+  submittedTail = 0;
+  swCtxId  = swId;
+
+  // Minimal register state: one LRI block carrying the ring registers.
+  // RESTORE_INHIBIT keeps the hardware from loading the (empty) image on
+  // first use; it is dropped once the context has been saved once.
+  uint32_t* regs = regState();
+  regs[0] = XeHW::MI_NOOP;
+  regs[1] = XeHW::MI_LOAD_REGISTER_IMM(5) | XeHW::MI_LRI_FORCE_POSTED;
+  regs[XeHW::CTX_CONTEXT_CONTROL - 1] = engineBase + XeHW::RING_CONTEXT_CONTROL_OFF;
+  regs[XeHW::CTX_CONTEXT_CONTROL]     = XeHW::MASKED_BIT_ENABLE(XeHW::CTX_CTRL_INHIBIT_SYN_SWITCH) |
+                                        XeHW::MASKED_BIT_ENABLE(XeHW::CTX_CTRL_RESTORE_INHIBIT);
+  regs[XeHW::CTX_RING_HEAD - 1]       = engineBase + XeHW::RING_HEAD_OFF;
+  regs[XeHW::CTX_RING_HEAD]           = 0;
+  regs[XeHW::CTX_RING_TAIL - 1]       = engineBase + XeHW::RING_TAIL_OFF;
+  regs[XeHW::CTX_RING_TAIL]           = 0;
+  regs[XeHW::CTX_RING_START - 1]      = engineBase + XeHW::RING_START_OFF;
+  regs[XeHW::CTX_RING_START]          = ring.ggtt;
+  regs[XeHW::CTX_RING_CTL - 1]        = engineBase + XeHW::RING_CTL_OFF;
+  regs[XeHW::CTX_RING_CTL]            = (ringSize - 4096) | XeHW::RING_CTL_VALID;
+  regs[XeHW::CTX_RING_CTL + 1]        = XeHW::MI_BATCH_BUFFER_END;
+  OSSynchronizeIO();
+
+  descriptor = XeHW::CTX_DESC_VALID | XeHW::CTX_DESC_LEGACY_32B | XeHW::CTX_DESC_PRIVILEGE |
+               (uint64_t)image.ggtt |
+               ((uint64_t)swCtxId << XeHW::CTX_DESC_SW_CTX_ID_SHIFT);
+
+  XeLog("XeLRC::create: image@0x%08x (%s) ring@0x%08x (%s) desc=0x%016llx\n", image.ggtt,
+        mem.placement(image), ring.ggtt, mem.placement(ring), (unsigned long long)descriptor);
+  return true;
+}
+
+void XeLogicalContext::destroy(XeKernelMemory& mem) {
+  mem.free(&image);
+  mem.free(&ring);
+  descriptor = 0;
+  inPort = queued = restored = false;
+}
+
+uint32_t* XeLogicalContext::regState() const {
+  if (!image.cpu) return nullptr;
+  return (uint32_t*)(image.cpu + XeHW::LRC_PPHWSP_BYTES);
+}
+
+uint32_t XeLogicalContext::ringSpace() const {
+  uint32_t* regs = regState();
+  if (!regs || !ringSize) return 0;
+  // The saved head lags the live one, so this is a conservative estimate.
+  uint32_t head = regs[XeHW::CTX_RING_HEAD] & (ringSize - 1) & ~7u;
+  return (head - ringTail - 8) & (ringSize - 1);
+}
+
+bool XeLogicalContext::emit(const uint32_t* dw, uint32_t count) {
+  if (!ring.cpu || !dw || count == 0) return false;
+
+  uint32_t bytes = count * 4;
+  uint32_t toEnd = ringSize - ringTail;
+  uint32_t need  = (bytes > toEnd) ? bytes + toEnd : bytes;
+  if (need > ringSpace()) {
+    XeLog("XeLRC::emit: ERROR - ring full (need %u, space %u)\n", need, ringSpace());
+    return false;
+  }
+
+  uint32_t* base = (uint32_t*)ring.cpu;
+  if (bytes > toEnd) {
+    // Never split a packet across the wrap: pad the remainder with NOOPs.
+    for (uint32_t i = 0; i < toEnd / 4; ++i) base[(ringTail / 4) + i] = XeHW::MI_NOOP;
+    ringTail = 0;
+  }
+  for (uint32_t i = 0; i < count; ++i) base[(ringTail / 4) + i] = dw[i];
+  ringTail = (ringTail + bytes) & (ringSize - 1);
+  return true;
+}
+
+void XeLogicalContext::rewind(uint32_t head) {
+  uint32_t* regs = regState();
+  if (!regs) return;
+  // The reset discarded whatever the engine had loaded; the saved image is
+  // still good, only the ring pointers need to skip the guilty request.
+  regs[XeHW::CTX_RING_HEAD] = head;
+  regs[XeHW::CTX_RING_TAIL] = head;
+  OSSynchronizeIO();
+  submittedTail = head;
+  inPort = queued = false;
+}
+
+// ----------------------------- XeExeclists -----------------------------
+
+bool XeExeclists::enable(volatile uint32_t* mmio, uint32_t engineBase, uint32_t hwspGgtt) {
+  XeLog("XeEL::enable: engine=0x%05x hwsp=0x%08x\n", engineBase, hwspGgtt);
+  if (!mmio) {
+    XeLog("XeEL::enable: ERROR - mmio is null\n");
+    return false;
+  }
+
+  m = mmio;
+  base = engineBase;
+  qHead = qCount = 0;
+  port[0] = port[1] = nullptr;
+  st = {};
+
+  wr(XeHW::RING_HWS_PGA_OFF, hwspGgtt);
+  wr(XeHW::RING_MODE_GEN7_OFF, XeHW::MASKED_BIT_ENABLE(XeHW::GFX_DISABLE_LEGACY_MODE));
+
+  // Reset both CSB pointers to the last entry; the first event lands in 0.
+  csbHead = XeHW::EXECLIST_CSB_ENTRIES - 1;
+  wr(XeHW::RING_CSB_PTR_OFF, 0x0F0F0000u | (csbHead << 8) | csbHead);
+
+  XeLog("XeEL::enable: MODE=0x%08x CSB_PTR=0x%08x\n",
+        rd(XeHW::RING_MODE_GEN7_OFF), rd(XeHW::RING_CSB_PTR_OFF));
+  return true;
+}
+
+void XeExeclists::disable() {
+  if (!m) return;
+  XeLog("XeEL::disable: elsp=%llu lite=%llu csb=%llu retired=%llu\n",
+        (unsigned long long)st.elspWrites, (unsigned long long)st.liteRestores,
+        (unsigned long long)st.csbEvents, (unsigned long long)st.retired);
+  for (uint32_t i = 0; i < XeHW::EXECLIST_PORTS; ++i) {
+    if (port[i]) port[i]->inPort = false;
+    port[i] = nullptr;
+  }
+  while (XeLogicalContext* ctx = popContext()) ctx->queued = false;
+  m = nullptr;
+}
+
+bool XeExeclists::pushContext(XeLogicalContext* ctx) {
+  if (ctx->queued) return true;
+  if (qCount == kQueueDepth) {
+    st.queueFull++;
+    return false;
+  }
+  queue[(qHead + qCount) % kQueueDepth] = ctx;
+  qCount++;
+  ctx->queued = true;
+  return true;
+}
+
+XeLogicalContext* XeExeclists::popContext() {
+  if (qCount == 0) return nullptr;
+  XeLogicalContext* ctx = queue[qHead];
+  qHead = (qHead + 1) % kQueueDepth;
+  qCount--;
+  ctx->queued = false;
+  return ctx;
+}
+
+bool XeExeclists::submit(XeLogicalContext* ctx) {
+  if (!m || !ctx || !ctx->valid()) {
+    XeLog("XeEL::submit: ERROR - not ready\n");
+    return false;
+  }
+
+  uint32_t* regs = ctx->regState();
+  regs[XeHW::CTX_RING_TAIL] = ctx->ringTail;
+  // A stolen ring is written through the WC aperture: drain the combining
+  // buffers before the hardware is told about the new tail
+  XeFlushFence();
+  OSSynchronizeIO();
+
+  if (ctx == port[0]) {
+    // Same context already running: rewrite ELSP with the new tail and the
+    // hardware lite-restores it without a full save/restore.
+    st.liteRestores++;
+    ctx->submittedTail = ctx->ringTail;
+    writeElsp();
+    return true;
+  }
+
+  if (ctx->inPort) {
+    // Waiting in port 1: the tail is read from the image when the hardware
+    // switches to it, and anything it misses is requeued on completion.
+    return true;
+  }
+
+  if (!pushContext(ctx)) {
+    XeLog("XeEL::submit: ERROR - queue full\n");
+    return false;
+  }
+  fillPorts();
+  return true;
+}
+
+void XeExeclists::fillPorts() {
+  if (qCount == 0 || port[1]) return;
+
+  if (!port[0]) port[0] = popContext();
+  while (!port[1] && qCount) {
+    // A context must never occupy both ports.
+    XeLogicalContext* next = popContext();
+    if (next != port[0]) port[1] = next;
+  }
+
+  for (uint32_t i = 0; i < XeHW::EXECLIST_PORTS; ++i) {
+    if (!port[i]) continue;
+    port[i]->inPort = true;
+    port[i]->submittedTail = port[i]->ringTail;
+  }
+  writeElsp();
+}
+
+void XeExeclists::writeElsp() {
+  // Gen12 submit queue: stage both ports, then load them in one go.
+  for (uint32_t i = 0; i < XeHW::EXECLIST_PORTS; ++i) {
+    uint64_t desc = port[i] ? port[i]->descriptor : 0;
+    wr(XeHW::RING_EXECLIST_SQ_LO_OFF + i * 8,     (uint32_t)desc);
+    wr(XeHW::RING_EXECLIST_SQ_LO_OFF + i * 8 + 4, (uint32_t)(desc >> 32));
+  }
+  wr(XeHW::RING_EXECLIST_CONTROL_OFF, XeHW::EL_CTRL_LOAD);
+  st.elspWrites++;
+}
+
+uint32_t XeExeclists::processCsb() {
+  if (!m) return 0;
+
+  uint32_t wp = rd(XeHW::RING_CSB_PTR_OFF) & 0xF;
+  if (wp >= XeHW::EXECLIST_CSB_ENTRIES) {
+    // Reads as 0xF/0xB around reset; nothing valid to consume yet.
+    return 0;
+  }
+
+  uint32_t retired = 0;
+  while (csbHead != wp) {
+    csbHead = (csbHead + 1) % XeHW::EXECLIST_CSB_ENTRIES;
+    uint32_t lo = rd(XeHW::RING_CSB_BUF_LO_OFF + csbHead * 8);
+    uint32_t hi = rd(XeHW::RING_CSB_BUF_LO_OFF + csbHead * 8 + 4);
+    st.csbEvents++;
+
+    bool toValid   = ((lo & XeHW::CSB_SW_CTX_ID_MASK) >> XeHW::CSB_SW_CTX_ID_SHIFT) != XeHW::CSB_IDLE_CTX_ID;
+    bool awayValid = ((hi & XeHW::CSB_SW_CTX_ID_MASK) >> XeHW::CSB_SW_CTX_ID_SHIFT) != XeHW::CSB_IDLE_CTX_ID;
+    bool newQueue  = (lo & XeHW::CSB_SWITCHED_TO_NEW_QUEUE) != 0;
+
+    // idle->active and preemption/lite-restore only promote the pending
+    // ports, which the port array already reflects.
+    if ((!awayValid && toValid) || (awayValid && newQueue)) continue;
+
+    // Otherwise the context in port 0 has completed.
+    XeLogicalContext* done = port[0];
+    port[0] = port[1];
+    port[1] = nullptr;
+    if (!done) continue;
+
+    done->inPort = false;
+    if (!done->restored) {
+      uint32_t* regs = done->regState();
+      regs[XeHW::CTX_CONTEXT_CONTROL] = XeHW::MASKED_BIT_ENABLE(XeHW::CTX_CTRL_INHIBIT_SYN_SWITCH) |
+                                        XeHW::MASKED_BIT_DISABLE(XeHW::CTX_CTRL_RESTORE_INHIBIT);
+      done->restored = true;
+    }
+    // Work emitted after it was loaded goes back through the queue.
+    if (done->submittedTail != done->ringTail) pushContext(done);
+    retired++;
+    st.retired++;
+  }
+
+  wr(XeHW::RING_CSB_PTR_OFF, 0x0F000000u | (csbHead << 8));
+  fillPorts();
+  return retired;
+}
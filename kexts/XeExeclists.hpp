@@ -0,0 +1,88 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "xe_hw_offsets.hpp"
+#include "XeGGTT.hpp"
+#include "XeEngine.hpp"
+#include "XeKernelMemory.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Logical ring context (LRC): context image (PPHWSP + register state pages)
+// and the ring it executes. Both are XeKernelMemory blocks, pinned and bound
+// into the GGTT for the lifetime of the context; the ring goes to stolen
+// memory when there is room.
+struct XeLogicalContext {
+  XeKernelMemory::Block image {};
+  XeKernelMemory::Block ring  {};
+  uint32_t imageBytes    {0};
+  uint32_t ringSize      {0};
+  uint32_t ringTail      {0};   // software tail, bytes
+  uint32_t submittedTail {0};   // tail last handed to the hardware
+  uint32_t swCtxId       {0};
+  uint64_t descriptor    {0};
+  bool     inPort        {false};
+  bool     queued        {false};
+  bool     restored      {false}; // has completed once, image is valid
+
+  bool      create(XeKernelMemory& mem, const XeEngineDesc& engine, uint32_t swId, uint32_t ringBytes);
+  void      destroy(XeKernelMemory& mem);
+  bool      valid() const { return image.cpu != nullptr && ring.cpu != nullptr; }
+
+  uint32_t* regState() const;
+  uint32_t  ringSpace() const;
+  bool      emit(const uint32_t* dw, uint32_t count);
+  void      rewind(uint32_t head);   // restart execution at head after an engine reset
+};
+
+// Two-port execlist scheduler for one engine.
+//
+// Port 0 holds the running context, port 1 the one the hardware switches to
+// next. Retirement is driven by the context status buffer (CSB); resubmitting
+// the context in port 0 with a new tail is a lite-restore, so back-to-back
+// work on the same context never drains the pipe.
+class XeExeclists {
+public:
+  struct Stats {
+    uint64_t elspWrites;
+    uint64_t liteRestores;
+    uint64_t csbEvents;
+    uint64_t retired;
+    uint64_t queueFull;
+  };
+
+  bool     enable(volatile uint32_t* mmio, uint32_t engineBase, uint32_t hwspGgtt);
+  void     disable();
+  bool     isEnabled() const { return m != nullptr; }
+
+  // Queue ctx after its ring tail advanced. Caller holds forcewake.
+  bool     submit(XeLogicalContext* ctx);
+
+  // Consume new CSB entries, retire completed ports and refill them.
+  // Returns the number of contexts retired.
+  uint32_t processCsb();
+
+  bool         idle() const { return port[0] == nullptr && qCount == 0; }
+  const Stats& stats() const { return st; }
+
+private:
+  static constexpr uint32_t kQueueDepth = 16;
+
+  volatile uint32_t* m {nullptr};
+  uint32_t           base {0};
+  XeLogicalContext*  port[XeHW::EXECLIST_PORTS] {};
+  XeLogicalContext*  queue[kQueueDepth] {};
+  uint32_t           qHead {0};
+  uint32_t           qCount {0};
+  uint32_t           csbHead {0};
+  Stats              st {};
+
+  bool               pushContext(XeLogicalContext* ctx);
+  XeLogicalContext*  popContext();
+  void               fillPorts();
+  void               writeElsp();
+
+  inline uint32_t rd(uint32_t off) const { return m ? m[(base + off) >> 2] : 0; }
+  inline void     wr(uint32_t off, uint32_t v) { if (m) { m[(base + off) >> 2] = v; OSSynchronizeIO(); } }
+};
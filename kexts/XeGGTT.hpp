@@ -1,6 +1,7 @@
 #pragma once
 #include "xe_hw_offsets.hpp"
 #include <IOKit/IOLib.h>
+#include <IOKit/IOMemoryDescriptor.h>
 
 // Forward declaration for XeLog
 void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
@@ -134,4 +135,107 @@ public:
     
     return info;
   }
+
+  // Write GGTT PTEs mapping md's pages at ggttAddr (4K granularity).
+  // Physical segments are taken without the system mapper (VT-d off).
+  static bool insertPages(volatile uint32_t* mmio, uint32_t ggttAddr, IOMemoryDescriptor* md) {
+    if (!mmio || !md || (ggttAddr & 0xFFFu)) {
+      XeLog("XeGGTT::insertPages: ERROR - invalid arguments\n");
+      return false;
+    }
+
+    IOByteCount len = md->getLength();
+    uint32_t pages = (uint32_t)((len + 0xFFFu) >> 12);
+    uint32_t firstPte = GGTT_PTE_OFFSET(ggttAddr);
+    if (firstPte + pages * 8 - 1 > kGGTTMaxOffset) {
+      XeLog("XeGGTT::insertPages: ERROR - range 0x%08x+%u pages out of GGTT\n", ggttAddr, pages);
+      return false;
+    }
+
+    for (uint32_t i = 0; i < pages; ++i) {
+      IOByteCount segLen = 0;
+      addr64_t phys = md->getPhysicalSegment((IOByteCount)i << 12, &segLen, kIOMemoryMapperNone);
+      if (!phys) {
+        XeLog("XeGGTT::insertPages: ERROR - no physical segment for page %u\n", i);
+        return false;
+      }
+      volatile uint64_t* pte = (volatile uint64_t*)((volatile uint8_t*)mmio + firstPte + i * 8);
+      *pte = (phys & ~0xFFFull) | XeHW::GGTT_PTE_PRESENT;
+    }
+    OSSynchronizeIO();
+    return true;
+  }
+
+  // Write GGTT PTEs mapping the physically contiguous [phys, phys + bytes)
+  // at ggttAddr; for memory no descriptor describes (stolen memory)
+  static bool insertPhys(volatile uint32_t* mmio, uint32_t ggttAddr, uint64_t phys, uint32_t bytes) {
+    if (!mmio || (ggttAddr & 0xFFFu) || (phys & 0xFFFull) || !bytes) {
+      XeLog("XeGGTT::insertPhys: ERROR - invalid arguments\n");
+      return false;
+    }
+    uint32_t pages = (bytes + 0xFFFu) >> 12;
+    uint32_t firstPte = GGTT_PTE_OFFSET(ggttAddr);
+    if (firstPte + pages * 8 - 1 > kGGTTMaxOffset) {
+      XeLog("XeGGTT::insertPhys: ERROR - range 0x%08x+%u pages out of GGTT\n", ggttAddr, pages);
+      return false;
+    }
+    for (uint32_t i = 0; i < pages; ++i) {
+      volatile uint64_t* pte = (volatile uint64_t*)((volatile uint8_t*)mmio + firstPte + i * 8);
+      *pte = (phys + ((uint64_t)i << 12)) | XeHW::GGTT_PTE_PRESENT;
+    }
+    OSSynchronizeIO();
+    return true;
+  }
+
+  // Physical page behind a GGTT address, or 0 if its PTE is not present
+  static uint64_t ptePhys(volatile uint32_t* mmio, uint32_t ggttAddr) {
+    if (!mmio) return 0;
+    uint32_t off = GGTT_PTE_OFFSET(ggttAddr);
+    if (off + 7 > kGGTTMaxOffset) return 0;
+    uint64_t pte = (uint64_t)mmio[off >> 2] | ((uint64_t)mmio[(off + 4) >> 2] << 32);
+    return (pte & XeHW::GGTT_PTE_PRESENT) ? (pte & XeHW::GGTT_PTE_ADDR_MASK) : 0;
+  }
+
+  // Point a GGTT range back at nothing (PTE = 0)
+  static void clearPages(volatile uint32_t* mmio, uint32_t ggttAddr, uint32_t bytes) {
+    if (!mmio || (ggttAddr & 0xFFFu)) return;
+    uint32_t pages = (bytes + 0xFFFu) >> 12;
+    uint32_t firstPte = GGTT_PTE_OFFSET(ggttAddr);
+    if (firstPte + pages * 8 - 1 > kGGTTMaxOffset) return;
+    for (uint32_t i = 0; i < pages; ++i) {
+      *(volatile uint64_t*)((volatile uint8_t*)mmio + firstPte + i * 8) = 0;
+    }
+    OSSynchronizeIO();
+  }
+
+private:
+  static inline uint32_t GGTT_PTE_OFFSET(uint32_t ggttAddr) {
+    return XeHW::GGTT_PTE_BASE + (ggttAddr >> 12) * 8;
+  }
+};
+
+// Linear GGTT address allocator for driver-owned objects (rings, contexts,
+// status pages). Starts above the range the firmware framebuffer uses.
+class XeGGTTSpace {
+public:
+  static constexpr uint32_t kDefaultBase = 0x40000000;  // 1GB
+  static constexpr uint32_t kDefaultEnd  = 0x80000000;  // 2GB
+
+  uint32_t alloc(uint32_t bytes) {
+    uint32_t sz = (bytes + 0xFFFu) & ~0xFFFu;
+    if (sz == 0 || next > end || end - next < sz) {
+      XeLog("XeGGTTSpace::alloc: ERROR - out of GGTT space (%u bytes)\n", bytes);
+      return 0;
+    }
+    uint32_t addr = next;
+    next += sz;
+    return addr;
+  }
+
+  uint32_t used() const { return next - base; }
+
+private:
+  uint32_t base {kDefaultBase};
+  uint32_t next {kDefaultBase};
+  uint32_t end  {kDefaultEnd};
 };
@@ -0,0 +1,470 @@
+#include "XeGuC.hpp"
+#include "ForcewakeGuard.hpp"
+#include <kern/clock.h>              // mach_absolute_time, absolutetime_to_nanoseconds
+
+// Maximum safe MMIO offset
+constexpr uint32_t kGuCMaxOffset = 0x00FFFFFF;
+
+static inline uint32_t safeRd(volatile uint32_t* m, uint32_t off) {
+  if (!m) return 0xDEADBEEF;
+  if (off > kGuCMaxOffset) return 0xBAD0FFFF;
+  return m[off >> 2];
+}
+
+static inline void safeWr(volatile uint32_t* m, uint32_t off, uint32_t v) {
+  if (!m || off > kGuCMaxOffset) return;
+  m[off >> 2] = v;
+  OSSynchronizeIO();
+}
+
+static bool waitReg(volatile uint32_t* m, uint32_t reg, uint32_t mask, uint32_t value,
+                    uint32_t timeoutUs) {
+  for (uint32_t waited = 0; waited <= timeoutUs; waited += 10) {
+    if ((safeRd(m, reg) & mask) == value) return true;
+    IODelay(10);
+  }
+  return false;
+}
+
+bool XeGuC::prepare(volatile uint32_t* mmio, XeGGTTSpace& space, const void* blob, size_t len) {
+  XeLog("XeGuC::prepare: %zu byte blob\n", len);
+  if (!mmio || !blob || image) {
+    XeLog("XeGuC::prepare: ERROR - invalid arguments\n");
+    return false;
+  }
+  m = mmio;
+  planWopcm();
+
+  // The image sits at GUC_DMA_DEST_OFFSET inside the partition; the GuC
+  // also needs its reserved area and stack above it
+  uint32_t overhead = XeHW::GUC_DMA_DEST_OFFSET + XeHW::GUC_WOPCM_RESERVED + XeHW::GUC_WOPCM_STACK_RESERVED;
+  if (wopcmSize <= overhead) {
+    XeLog("XeGuC::prepare: ERROR - GuC WOPCM partition too small (0x%x)\n", wopcmSize);
+    return false;
+  }
+  uint32_t limit = wopcmSize - overhead;
+
+  XeGuCFirmware::Result r = XeGuCFirmware::parse(blob, len, limit, &fw);
+  if (r != XeGuCFirmware::kFwOk) {
+    XeLog("XeGuC::prepare: ERROR - %s (WOPCM room %u bytes)\n", XeGuCFirmware::resultName(r), limit);
+    return false;
+  }
+
+  image = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut, fw.uploadBytes, page_size);
+  imageGgtt = image ? space.alloc(fw.uploadBytes) : 0;
+  ctBlob = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut, XeGuCCT::kBlobBytes, page_size);
+  ctGgtt = ctBlob ? space.alloc(XeGuCCT::kBlobBytes) : 0;
+  logBuf = IOBufferMemoryDescriptor::withOptions(kIOMemoryKernelUserShared | kIODirectionInOut,
+                                                 kLogBytes, page_size);
+  logGgtt = logBuf ? space.alloc(kLogBytes) : 0;
+  if (!image || !imageGgtt || !XeGGTT::insertPages(m, imageGgtt, image) ||
+      !ctBlob || !ctGgtt || !XeGGTT::insertPages(m, ctGgtt, ctBlob) ||
+      !logBuf || !logGgtt || !XeGGTT::insertPages(m, logGgtt, logBuf)) {
+    XeLog("XeGuC::prepare: ERROR - allocation or GGTT bind failed\n");
+    destroy();
+    return false;
+  }
+  memcpy(image->getBytesNoCopy(), blob, fw.uploadBytes);
+  memcpy(rsa, (const uint8_t*)blob + fw.rsaOffset, fw.rsaBytes);
+  bzero(logBuf->getBytesNoCopy(), kLogBytes);
+  OSSynchronizeIO();
+
+  // Section sizes in 4K units - 1; the GuC raises a flush event at half full
+  params[XeHW::GUC_CTL_LOG_PARAMS] =
+      XeHW::GUC_LOG_VALID | XeHW::GUC_LOG_NOTIFY_ON_HALF_FULL |
+      ((XeHW::GUC_LOG_CRASH_BYTES / XeHW::GUC_LOG_UNIT_BYTES - 1) << XeHW::GUC_LOG_CRASH_SHIFT) |
+      ((XeHW::GUC_LOG_DEBUG_BYTES / XeHW::GUC_LOG_UNIT_BYTES - 1) << XeHW::GUC_LOG_DEBUG_SHIFT) |
+      ((XeHW::GUC_LOG_CAPTURE_BYTES / XeHW::GUC_LOG_UNIT_BYTES - 1) << XeHW::GUC_LOG_CAPTURE_SHIFT) |
+      ((logGgtt >> 12) << XeHW::GUC_LOG_BUF_ADDR_SHIFT);
+  if (relay) {
+    relay->describeGuC(kLogDebugOffset, XeHW::GUC_LOG_DEBUG_BYTES, kLogCrashOffset, XeHW::GUC_LOG_CRASH_BYTES);
+  }
+
+  XeLog("XeGuC::prepare: v%u.%u.%u uCode=%u rsa=%u private=%u bytes, image@0x%08x log@0x%08x\n",
+        fw.major, fw.minor, fw.patch, fw.ucodeBytes, fw.rsaBytes, fw.privateBytes, imageGgtt, logGgtt);
+  return true;
+}
+
+void XeGuC::destroy() {
+  disableCT();
+  if (ctBlob) {
+    if (m && ctGgtt) XeGGTT::clearPages(m, ctGgtt, XeGuCCT::kBlobBytes);
+    ctBlob->release();
+    ctBlob = nullptr;
+  }
+  ctGgtt = 0;
+  if (logBuf) {
+    if (m && logGgtt) XeGGTT::clearPages(m, logGgtt, kLogBytes);
+    logBuf->release();
+    logBuf = nullptr;
+  }
+  logGgtt = 0;
+  params[XeHW::GUC_CTL_LOG_PARAMS] = 0;
+  if (relay) relay->describeGuC(0, 0, 0, 0);
+  if (image) {
+    if (m && imageGgtt) XeGGTT::clearPages(m, imageGgtt, fw.uploadBytes);
+    image->release();
+    image = nullptr;
+  }
+  imageGgtt = 0;
+  isRunning = false;
+  bzero(rsa, sizeof(rsa));
+  fw = {};
+}
+
+// WOPCM holds, bottom up: a reserved area (HuC goes here once we load it),
+// the GuC partition, and the hardware context save area. The partition
+// registers are write-once until the next GT power cycle, so adopt them
+// if something already locked them.
+void XeGuC::planWopcm() {
+  uint32_t size = safeRd(m, XeHW::GUC_WOPCM_SIZE);
+  uint32_t base = safeRd(m, XeHW::DMA_GUC_WOPCM_OFFSET);
+  if ((size & XeHW::GUC_WOPCM_SIZE_LOCKED) && (base & XeHW::GUC_WOPCM_OFFSET_VALID)) {
+    wopcmSize = size & XeHW::GUC_WOPCM_SIZE_MASK;
+    wopcmBase = base & XeHW::GUC_WOPCM_OFFSET_MASK;
+    XeLog("XeGuC::planWopcm: locked partition base=0x%x size=0x%x\n", wopcmBase, wopcmSize);
+    return;
+  }
+  wopcmBase = XeHW::WOPCM_RESERVED_BYTES;
+  wopcmSize = (XeHW::GEN11_WOPCM_BYTES - XeHW::WOPCM_HW_CTX_RESERVED - wopcmBase) &
+              XeHW::GUC_WOPCM_SIZE_MASK;
+  XeLog("XeGuC::planWopcm: partition base=0x%x size=0x%x\n", wopcmBase, wopcmSize);
+}
+
+bool XeGuC::programWopcm() {
+  uint32_t size = safeRd(m, XeHW::GUC_WOPCM_SIZE);
+  uint32_t base = safeRd(m, XeHW::DMA_GUC_WOPCM_OFFSET);
+  if (!(size & XeHW::GUC_WOPCM_SIZE_LOCKED)) {
+    safeWr(m, XeHW::GUC_WOPCM_SIZE, wopcmSize | XeHW::GUC_WOPCM_SIZE_LOCKED);
+    size = safeRd(m, XeHW::GUC_WOPCM_SIZE);
+  }
+  if (!(base & XeHW::GUC_WOPCM_OFFSET_VALID)) {
+    safeWr(m, XeHW::DMA_GUC_WOPCM_OFFSET, wopcmBase | XeHW::HUC_LOADING_AGENT_GUC);
+    base = safeRd(m, XeHW::DMA_GUC_WOPCM_OFFSET);
+  }
+  if ((size & XeHW::GUC_WOPCM_SIZE_MASK) != wopcmSize ||
+      (base & XeHW::GUC_WOPCM_OFFSET_MASK) != wopcmBase ||
+      !(size & XeHW::GUC_WOPCM_SIZE_LOCKED) || !(base & XeHW::GUC_WOPCM_OFFSET_VALID)) {
+    XeLog("XeGuC::programWopcm: ERROR - partition mismatch (size=0x%08x offset=0x%08x)\n", size, base);
+    return false;
+  }
+  return true;
+}
+
+IOReturn XeGuC::resetGuC() {
+  safeWr(m, XeHW::GEN6_GDRST, XeHW::GEN11_GRDOM_GUC);
+  if (!waitReg(m, XeHW::GEN6_GDRST, XeHW::GEN11_GRDOM_GUC, 0, kResetTimeoutUs)) {
+    XeLog("XeGuC::resetGuC: ERROR - GDRST did not clear\n");
+    return kIOReturnTimeout;
+  }
+  uint32_t st = safeRd(m, XeHW::GUC_STATUS);
+  if (!(st & XeHW::GS_MIA_IN_RESET)) {
+    XeLog("XeGuC::resetGuC: ERROR - GuC not in reset (GUC_STATUS=0x%08x)\n", st);
+    return kIOReturnIOError;
+  }
+  return kIOReturnSuccess;
+}
+
+// Header + uCode go through the DMA engine in one transfer
+IOReturn XeGuC::dmaImage() {
+  safeWr(m, XeHW::DMA_ADDR_0_LOW, imageGgtt);
+  safeWr(m, XeHW::DMA_ADDR_0_HIGH, 0);
+  safeWr(m, XeHW::DMA_ADDR_1_LOW, XeHW::GUC_DMA_DEST_OFFSET);
+  safeWr(m, XeHW::DMA_ADDR_1_HIGH, XeHW::DMA_ADDRESS_SPACE_WOPCM);
+  safeWr(m, XeHW::DMA_COPY_SIZE, fw.uploadBytes);
+  safeWr(m, XeHW::DMA_CTRL, XeHW::MASKED_BIT_ENABLE(XeHW::DMA_CTRL_UOS_MOVE | XeHW::DMA_CTRL_START));
+
+  bool done = waitReg(m, XeHW::DMA_CTRL, XeHW::DMA_CTRL_START, 0, kDmaTimeoutUs);
+  safeWr(m, XeHW::DMA_CTRL, XeHW::MASKED_BIT_DISABLE(XeHW::DMA_CTRL_UOS_MOVE));
+  if (!done) {
+    XeLog("XeGuC::dmaImage: ERROR - DMA timed out (DMA_CTRL=0x%08x)\n", safeRd(m, XeHW::DMA_CTRL));
+    return kIOReturnTimeout;
+  }
+  return kIOReturnSuccess;
+}
+
+// The boot ROM checks the signature, then the uKernel initializes itself
+IOReturn XeGuC::waitBoot() {
+  for (uint32_t ms = 0; ms <= kBootTimeoutMs; ++ms) {
+    lastStatus = safeRd(m, XeHW::GUC_STATUS);
+    if ((lastStatus & XeHW::GS_UKERNEL_MASK) == XeHW::GS_UKERNEL_READY) return kIOReturnSuccess;
+    if ((lastStatus & XeHW::GS_BOOTROM_MASK) == XeHW::GS_BOOTROM_RSA_FAILED) {
+      XeLog("XeGuC::waitBoot: ERROR - firmware signature rejected\n");
+      return kIOReturnNotPermitted;
+    }
+    IOSleep(1);
+  }
+  XeLog("XeGuC::waitBoot: ERROR - no uKernel ready (GUC_STATUS=0x%08x)\n", lastStatus);
+  return kIOReturnTimeout;
+}
+
+IOReturn XeGuC::upload() {
+  if (!image || !m) return kIOReturnNotReady;
+  uint64_t start = mach_absolute_time();
+  isRunning = false;
+  ctReady = false;
+
+  ForcewakeGuard fwg(m);
+  IOReturn kr = resetGuC();
+  if (kr != kIOReturnSuccess) return kr;
+  if (!programWopcm()) return kIOReturnNotPermitted;
+  restartLog();
+
+  // Must be programmed before the DMA
+  uint32_t shim = XeHW::GUC_ENABLE_READ_CACHE_LOGIC | XeHW::GUC_ENABLE_READ_CACHE_FOR_SRAM_DATA |
+                  XeHW::GUC_ENABLE_READ_CACHE_FOR_WOPCM_DATA | XeHW::GUC_ENABLE_MIA_CLOCK_GATING |
+                  XeHW::GUC_DISABLE_SRAM_INIT_TO_ZEROES | XeHW::GUC_ENABLE_MIA_CACHING;
+  safeWr(m, XeHW::GUC_SHIM_CONTROL, shim);
+  safeWr(m, XeHW::GEN9_GT_PM_CONFIG, XeHW::GT_DOORBELL_ENABLE);
+
+  safeWr(m, XeHW::SOFT_SCRATCH(0), 0);
+  for (uint32_t i = 0; i < XeHW::GUC_CTL_MAX_DWORDS; ++i) {
+    safeWr(m, XeHW::SOFT_SCRATCH(1 + i), params[i]);
+  }
+  for (uint32_t i = 0; i < fw.rsaBytes / 4; ++i) {
+    safeWr(m, XeHW::UOS_RSA_SCRATCH(i), rsa[i]);
+  }
+
+  kr = dmaImage();
+  if (kr == kIOReturnSuccess) kr = waitBoot();
+  if (kr != kIOReturnSuccess) return kr;
+
+  uint64_t us = 0;
+  absolutetime_to_nanoseconds(mach_absolute_time() - start, &us);
+  us /= 1000;
+  isRunning = true;
+  uploadCount++;
+  XeLog("XeGuC::upload: v%u.%u.%u running after %llu us (upload #%u)\n",
+        fw.major, fw.minor, fw.patch, (unsigned long long)us, uploadCount);
+
+  kr = enableCT();
+  if (kr != kIOReturnSuccess) XeLog("XeGuC::upload: WARNING - CT channel unavailable (0x%x)\n", kr);
+  return kr;
+}
+
+// ---------------------------- CT channel ----------------------------
+
+// One request through the SOFT_SCRATCH mailbox; only used to bring the CT
+// channel up and down, everything else goes through the CT buffers.
+IOReturn XeGuC::sendMmio(const uint32_t* request, uint32_t dw, uint32_t* outData) {
+  if (!request || dw == 0 || dw > XeHW::GEN11_SOFT_SCRATCH_COUNT) return kIOReturnBadArgument;
+  for (uint32_t i = 0; i < XeHW::GEN11_SOFT_SCRATCH_COUNT; ++i) {
+    safeWr(m, XeHW::GEN11_SOFT_SCRATCH(i), i < dw ? request[i] : 0);
+  }
+  (void)safeRd(m, XeHW::GEN11_SOFT_SCRATCH(dw - 1));   // post the request before the trigger
+  safeWr(m, XeHW::GEN11_GUC_HOST_INTERRUPT, XeHW::GUC_SEND_TRIGGER);
+
+  uint32_t reply = 0;
+  for (uint32_t waited = 0; waited <= kMmioTimeoutUs; waited += 10) {
+    reply = safeRd(m, XeHW::GEN11_SOFT_SCRATCH(0));
+    uint32_t type = (reply & XeHW::GUC_HXG_TYPE_MASK) >> XeHW::GUC_HXG_TYPE_SHIFT;
+    if ((reply & XeHW::GUC_HXG_ORIGIN_GUC) && type != XeHW::GUC_HXG_TYPE_NO_RESPONSE_BUSY) {
+      if (type == XeHW::GUC_HXG_TYPE_RESPONSE_SUCCESS) {
+        if (outData) *outData = reply & XeHW::GUC_HXG_RESPONSE_DATA0_MASK;
+        return kIOReturnSuccess;
+      }
+      XeLog("XeGuC::sendMmio: ERROR - action 0x%04x rejected (0x%08x)\n",
+            request[0] & XeHW::GUC_HXG_ACTION_MASK, reply);
+      return kIOReturnIOError;
+    }
+    IODelay(10);
+  }
+  XeLog("XeGuC::sendMmio: ERROR - action 0x%04x timed out (0x%08x)\n",
+        request[0] & XeHW::GUC_HXG_ACTION_MASK, reply);
+  return kIOReturnTimeout;
+}
+
+IOReturn XeGuC::enableCT() {
+  if (!ctBlob || !isRunning) return kIOReturnNotReady;
+  ct.init(ctBlob->getBytesNoCopy(), &XeGuC::ringDoorbell, this, &XeGuC::onEvent);
+  OSSynchronizeIO();
+
+  static const struct { uint32_t type, descOffset, bufOffset, bytes; } kBuffers[] = {
+    { XeHW::GUC_CTB_TYPE_HOST2GUC, XeGuCCT::kH2GDescOffset, XeGuCCT::kH2GOffset, XeGuCCT::kH2GBytes },
+    { XeHW::GUC_CTB_TYPE_GUC2HOST, XeGuCCT::kG2HDescOffset, XeGuCCT::kG2HOffset, XeGuCCT::kG2HBytes },
+  };
+  for (const auto& b : kBuffers) {
+    uint32_t req[4] = {
+      XeHW::GUC_HXG_REQUEST(XeHW::GUC_ACTION_REGISTER_CTB, 0),
+      ((b.bytes / 4096 - 1) << XeHW::GUC_REGISTER_CTB_SIZE_SHIFT) | b.type,
+      ctGgtt + b.descOffset,
+      ctGgtt + b.bufOffset,
+    };
+    IOReturn kr = sendMmio(req, 4, nullptr);
+    if (kr != kIOReturnSuccess) return kr;
+  }
+  uint32_t ctl[2] = { XeHW::GUC_HXG_REQUEST(XeHW::GUC_ACTION_CONTROL_CTB, 0), XeHW::GUC_CTB_CONTROL_ENABLE };
+  IOReturn kr = sendMmio(ctl, 2, nullptr);
+  if (kr != kIOReturnSuccess) return kr;
+
+  ctReady = true;
+  XeLog("XeGuC::enableCT: H2G %u + G2H %u bytes @0x%08x\n",
+        XeGuCCT::kH2GBytes, XeGuCCT::kG2HBytes, ctGgtt);
+  return kIOReturnSuccess;
+}
+
+void XeGuC::disableCT() {
+  if (!ctReady) return;
+  ctReady = false;
+  if (!isRunning || !m) return;
+  ForcewakeGuard fwg(m);
+  uint32_t ctl[2] = { XeHW::GUC_HXG_REQUEST(XeHW::GUC_ACTION_CONTROL_CTB, 0), XeHW::GUC_CTB_CONTROL_DISABLE };
+  sendMmio(ctl, 2, nullptr);
+}
+
+void XeGuC::ringDoorbell(void* context) {
+  auto self = (XeGuC*)context;
+  safeWr(self->m, XeHW::GEN11_GUC_HOST_INTERRUPT, XeHW::GUC_SEND_TRIGGER);
+}
+
+static IOReturn ctReturn(XeGuCCT::Result r) {
+  switch (r) {
+    case XeGuCCT::kCTOk:         return kIOReturnSuccess;
+    case XeGuCCT::kCTPending:    return kIOReturnTimeout;
+    case XeGuCCT::kCTNoSpace:    return kIOReturnNoSpace;
+    case XeGuCCT::kCTBusy:
+    case XeGuCCT::kCTRetry:      return kIOReturnBusy;
+    case XeGuCCT::kCTBadMessage: return kIOReturnBadArgument;
+    default:                     return kIOReturnIOError;
+  }
+}
+
+IOReturn XeGuC::send(const uint32_t* hxg, uint32_t dw, uint32_t* response, uint32_t* responseDw,
+                     uint32_t timeoutUs) {
+  if (!ctReady) return kIOReturnNotReady;
+  ForcewakeGuard fwg(m);
+  uint16_t fence = 0;
+  XeGuCCT::Result r = ct.send(hxg, dw, &fence);
+  if (r != XeGuCCT::kCTOk) return ctReturn(r);
+  ct.flush();
+
+  for (uint32_t waited = 0;; waited += 10) {
+    ct.process();
+    r = ct.poll(fence, response, responseDw);
+    if (r != XeGuCCT::kCTPending || waited >= timeoutUs) break;
+    IODelay(10);
+  }
+  if (r == XeGuCCT::kCTPending) {
+    ct.cancel(fence);
+    XeLog("XeGuC::send: ERROR - action 0x%04x fence %u timed out\n", hxg[0] & XeHW::GUC_HXG_ACTION_MASK, fence);
+  } else if (r == XeGuCCT::kCTFailed) {
+    XeLog("XeGuC::send: ERROR - action 0x%04x failed (error 0x%x)\n",
+          hxg[0] & XeHW::GUC_HXG_ACTION_MASK, response ? response[0] : 0);
+  } else if (r == XeGuCCT::kCTBroken) {
+    XeLog("XeGuC::send: ERROR - CT channel faulted, needs a GuC reload\n");
+  }
+  if (logFlushPending) serviceLog();
+  return ctReturn(r);
+}
+
+// ------------------------------ GuC log ------------------------------
+
+// A freshly booted GuC writes each section from the start again; keep the
+// relay position monotonic by declaring the rest of the current lap padding.
+void XeGuC::restartLog() {
+  if (!logBuf) return;
+  bzero(logBuf->getBytesNoCopy(), XeHW::GUC_LOG_STATE_BYTES);
+  uint32_t off = (uint32_t)(logPos % XeHW::GUC_LOG_DEBUG_BYTES);
+  if (off) {
+    logWrap = off;
+    logPos += XeHW::GUC_LOG_DEBUG_BYTES - off;
+  }
+  logFull = 0;
+  logFlushPending = false;
+  if (relay) relay->publishGuC(logPos, logWrap, logLost, logFlushes, crashDumps);
+}
+
+// Catch up with the GuC's debug log write pointer. Every full count the
+// GuC reports is a lap we never saw; the reader finds those bytes gone.
+// read_ptr is acked right away: the kernel keeps no copy, so from the
+// GuC's point of view everything sampled has been consumed.
+void XeGuC::sampleLog() {
+  if (!logBuf) return;
+  const uint32_t size = XeHW::GUC_LOG_DEBUG_BYTES;
+  auto st = (volatile XeGuCLogState*)((uint8_t*)logBuf->getBytesNoCopy() +
+                                      XeHW::GUC_LOG_BUFFER_DEBUG * sizeof(XeGuCLogState));
+  uint32_t wr = st->writePtr;
+  uint32_t wrap = st->wrapOffset;
+  uint32_t full = (st->flags & XeHW::GUC_LOG_BUFFER_FULL_MASK) >> XeHW::GUC_LOG_BUFFER_FULL_SHIFT;
+  if (wr >= size) {
+    XeLog("XeGuC::sampleLog: ERROR - write pointer 0x%x out of range\n", wr);
+    return;
+  }
+
+  uint64_t before = logPos;
+  uint32_t off = (uint32_t)(logPos % size);
+  uint32_t laps = (full - logFull) & (XeHW::GUC_LOG_BUFFER_FULL_MASK >> XeHW::GUC_LOG_BUFFER_FULL_SHIFT);
+  logLost += laps;
+  logFull = full;
+  if (wr < off) laps++;
+  if (laps) logWrap = (wrap && wrap <= size) ? wrap : size;
+  logPos = logPos - off + (uint64_t)laps * size + wr;
+  st->readPtr = wr;
+  OSSynchronizeIO();
+
+  if (logPos == before) return;
+  logFlushes++;
+  if (relay) {
+    relay->publishGuC(logPos, logWrap, logLost, logFlushes, crashDumps);
+    relay->emit(mach_absolute_time(), kXeLogGuCFlush, XeLogRelay::kEngineGuC,
+                (uint32_t)(logPos - before), (uint32_t)logLost);
+  }
+}
+
+// Answer a flush notification; caller holds forcewake
+void XeGuC::serviceLog() {
+  logFlushPending = false;
+  sampleLog();
+  if (!ctReady) return;
+  uint32_t ack[2] = {
+    XeHW::GUC_HXG_REQUEST(XeHW::GUC_ACTION_LOG_BUFFER_FILE_FLUSH_COMPLETE, 0), XeHW::GUC_LOG_BUFFER_DEBUG,
+  };
+  if (ct.send(ack, 2, nullptr) == XeGuCCT::kCTOk) ct.flush();
+}
+
+// Runs from CT processing, so it only records what has to be done; the
+// flush ack is a CT send of its own and goes out from serviceLog().
+void XeGuC::onEvent(void* context, const uint32_t* hxg, uint32_t dw) {
+  auto self = (XeGuC*)context;
+  if (!dw) return;
+  switch (hxg[0] & XeHW::GUC_HXG_ACTION_MASK) {
+    case XeHW::GUC_ACTION_NOTIFY_FLUSH_LOG_BUFFER_TO_FILE:
+      self->logFlushPending = true;
+      break;
+    case XeHW::GUC_ACTION_NOTIFY_CRASH_DUMP_POSTED:
+      self->crashDumps++;
+      XeLog("XeGuC::onEvent: GuC posted a crash dump (#%llu)\n", (unsigned long long)self->crashDumps);
+      if (self->relay) {
+        self->relay->emit(mach_absolute_time(), kXeLogGuCCrash, XeLogRelay::kEngineGuC,
+                          (uint32_t)self->crashDumps);
+      }
+      self->logFlushPending = true;
+      break;
+    default:
+      break;
+  }
+}
+
+IOReturn XeGuC::setLogVerbosity(uint32_t verbosity) {
+  if (verbosity > 3) return kIOReturnBadArgument;
+  uint32_t request[2] = {
+    XeHW::GUC_HXG_REQUEST(XeHW::GUC_ACTION_UK_LOG_ENABLE_LOGGING, 0),
+    XeHW::GUC_LOG_CONTROL_LOGGING_ENABLED | XeHW::GUC_LOG_CONTROL_DEFAULT_LOGGING |
+        (verbosity << XeHW::GUC_LOG_CONTROL_VERBOSITY_SHIFT),
+  };
+  IOReturn kr = send(request, 2, nullptr, nullptr);
+  XeLog("XeGuC::setLogVerbosity: %u (0x%x)\n", verbosity, kr);
+  return kr;
+}
+
+// No GuC interrupt yet: the owner calls this from its own timer
+void XeGuC::poll() {
+  if (!isRunning) return;
+  if (ctReady) ct.process();
+  if (logFlushPending) {
+    ForcewakeGuard fwg(m);
+    serviceLog();
+  } else {
+    sampleLog();
+  }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "xe_hw_offsets.hpp"
+#include "XeGGTT.hpp"
+#include "XeGuCFirmware.hpp"
+#include "XeGuCCT.hpp"
+#include "XeLogRelay.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// GuC firmware loader.
+//
+// prepare() runs once per driver lifetime: it validates the blob, copies
+// header + uCode into a pinned buffer bound into the GGTT and keeps the RSA
+// signature aside. upload() resets the GuC and streams that pinned image
+// through the uC DMA engine, so it can be repeated after a GT reset or a
+// power transition without the blob or a re-parse.
+//
+// Once the uKernel is up, the CT channel is registered over the MMIO
+// mailbox and every further request goes through the CT buffers, which
+// live in a second pinned buffer allocated alongside the image.
+//
+// The GuC log lives in a third pinned buffer that userspace may map
+// read-only; poll() turns the firmware's ring offsets into the monotonic
+// position XeLogRelay publishes, so nothing is ever copied out of it.
+//
+// Not thread-safe; the owner runs everything under its command gate.
+
+// Per-section state header at the start of the GuC log buffer (firmware ABI)
+struct XeGuCLogState {
+  uint32_t marker[2];
+  uint32_t readPtr;          // host: bytes consumed
+  uint32_t writePtr;         // GuC: bytes written
+  uint32_t size;
+  uint32_t sampledWritePtr;
+  uint32_t wrapOffset;       // where the GuC stopped before wrapping to 0
+  uint32_t flags;            // [0] flush to file, [4:1] buffer full count
+  uint32_t version;
+};
+
+class XeGuC {
+public:
+  static constexpr const char* kFirmwareName = "tgl_guc_70.bin";  // kext Resources
+  static constexpr uint32_t kResetTimeoutUs  = 1000;
+  static constexpr uint32_t kDmaTimeoutUs    = 100000;
+  static constexpr uint32_t kBootTimeoutMs   = 200;
+  static constexpr uint32_t kMmioTimeoutUs   = 10000;
+  static constexpr uint32_t kCTTimeoutUs     = 100000;
+  static constexpr uint32_t kPollMs          = 10;       // owner's poll() period while running()
+  static constexpr uint32_t kLogDebugOffset  = XeHW::GUC_LOG_STATE_BYTES;
+  static constexpr uint32_t kLogCrashOffset  = kLogDebugOffset + XeHW::GUC_LOG_DEBUG_BYTES;
+  static constexpr uint32_t kLogBytes        = kLogCrashOffset + XeHW::GUC_LOG_CRASH_BYTES +
+                                               XeHW::GUC_LOG_CAPTURE_BYTES;
+
+  bool     prepare(volatile uint32_t* mmio, XeGGTTSpace& space, const void* blob, size_t len);
+  IOReturn upload();
+  void     destroy();
+
+  bool     prepared() const { return image != nullptr; }
+  bool     running() const  { return isRunning; }
+  uint32_t status() const   { return lastStatus; }
+  uint32_t uploads() const  { return uploadCount; }
+  const XeGuCFirmware::Layout& layout() const { return fw; }
+
+  // Synchronous CT request: queue, ring, and wait for the response.
+  // Callers with many independent requests should queue them on channel()
+  // and flush() once instead.
+  IOReturn send(const uint32_t* hxg, uint32_t dw, uint32_t* response, uint32_t* responseDw,
+                uint32_t timeoutUs = kCTTimeoutUs);
+  bool     ctEnabled() const { return ctReady; }
+  XeGuCCT& channel()         { return ct; }
+
+  // Debug log verbosity 0..3 over CT (send()); an upload resets it
+  IOReturn setLogVerbosity(uint32_t verbosity);
+
+  // Relay that mirrors the GuC log position and receives GuC events; set
+  // before prepare(). poll() drains G2H and refreshes the log position;
+  // the owner calls it every kPollMs for as long as the GuC is running.
+  void     attachRelay(XeLogRelay* r) { relay = r; }
+  void     poll();
+  IOBufferMemoryDescriptor* logMemory() const { return logBuf; }
+  uint64_t logWritten() const   { return logPos; }
+  uint64_t logOverflows() const { return logLost; }
+
+  // GUC_CTL boot parameters, written to SOFT_SCRATCH(1..) on every upload
+  uint32_t params[XeHW::GUC_CTL_MAX_DWORDS] {};
+
+private:
+  volatile uint32_t*        m {nullptr};
+  IOBufferMemoryDescriptor* image {nullptr};    // CSS header + uCode
+  uint32_t                  imageGgtt {0};
+  uint32_t                  rsa[XeHW::UOS_RSA_SCRATCH_COUNT] {};
+  XeGuCFirmware::Layout     fw {};
+  uint32_t                  wopcmBase {0};      // GuC partition inside WOPCM
+  uint32_t                  wopcmSize {0};
+  bool                      isRunning {false};
+  uint32_t                  lastStatus {0};
+  uint32_t                  uploadCount {0};
+
+  IOBufferMemoryDescriptor* ctBlob {nullptr};   // XeGuCCT::kBlobBytes, shared with the GuC
+  uint32_t                  ctGgtt {0};
+  XeGuCCT                   ct;
+  bool                      ctReady {false};
+
+  IOBufferMemoryDescriptor* logBuf {nullptr};   // kLogBytes, mappable read-only by userspace
+  uint32_t                  logGgtt {0};
+  XeLogRelay*               relay {nullptr};
+  uint64_t                  logPos {0};         // monotonic debug log position
+  uint32_t                  logWrap {0};        // wrap offset of the last lap that ended
+  uint32_t                  logFull {0};        // last buffer full count seen (4 bits)
+  uint64_t                  logLost {0};
+  uint64_t                  logFlushes {0};
+  uint64_t                  crashDumps {0};
+  bool                      logFlushPending {false};
+
+  void     planWopcm();
+  bool     programWopcm();
+  IOReturn resetGuC();
+  IOReturn dmaImage();
+  IOReturn waitBoot();
+  IOReturn sendMmio(const uint32_t* request, uint32_t dw, uint32_t* outData);
+  IOReturn enableCT();
+  void     disableCT();
+  static void ringDoorbell(void* context);
+  static void onEvent(void* context, const uint32_t* hxg, uint32_t dw);
+  void     restartLog();
+  void     sampleLog();
+  void     serviceLog();
+};
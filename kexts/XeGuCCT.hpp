@@ -0,0 +1,319 @@
+// XeGuCCT.hpp - GuC command transport (CT) buffers
+//
+// Header-only and free of IOKit: the kext drives it against the GuC, and
+// userspace/xeguc.cpp drives it against a simulated GuC on another thread.
+//
+// A CT buffer is a single-producer / single-consumer ring of dwords in
+// shared memory plus a descriptor. Each side owns one offset: the producer
+// publishes tail (release) after the message is in place, the consumer
+// publishes head (release) after it has copied the message out. Neither
+// side ever writes the other's offset, so no lock is needed across the
+// host / GuC boundary.
+//
+// XeGuCCT pairs a host-to-GuC (H2G) and a GuC-to-host (G2H) buffer in one
+// shared blob. Requests carry a 16-bit fence and stay outstanding until the
+// matching G2H response arrives, so many requests can be in flight at once
+// instead of serializing on the MMIO mailbox. The doorbell is batched: it
+// is rung on flush() or after kDoorbellBatch unannounced requests.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "xe_hw_offsets.hpp"
+
+struct XeGuCCTDesc {
+  uint32_t head;          // consumer offset (dwords)
+  uint32_t tail;          // producer offset (dwords)
+  uint32_t status;        // GUC_CTB_STATUS_*, set by whichever side saw a fault
+  uint32_t reserved[13];
+};
+static_assert(sizeof(XeGuCCTDesc) == 64, "CT descriptor is 16 dwords");
+
+class XeGuCCTBuffer {
+public:
+  // Take ownership of fresh memory (zeroes it) or join an existing ring
+  void init(XeGuCCTDesc* d, uint32_t* c, uint32_t dwords) {
+    memset(d, 0, sizeof(*d));
+    memset(c, 0, (size_t)dwords * 4);
+    attach(d, c, dwords);
+  }
+  void attach(XeGuCCTDesc* d, uint32_t* c, uint32_t dwords) {
+    desc = d;
+    cmds = c;
+    size = dwords;
+    head = __atomic_load_n(&d->head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&d->tail, __ATOMIC_ACQUIRE);
+  }
+
+  bool broken() const { return !desc || __atomic_load_n(&desc->status, __ATOMIC_RELAXED) != 0; }
+
+  // Producer: free dwords (one is kept empty so full != empty)
+  uint32_t space() {
+    uint32_t h = __atomic_load_n(&desc->head, __ATOMIC_ACQUIRE);
+    if (h >= size) {
+      fault(XeHW::GUC_CTB_STATUS_MISMATCH);
+      return 0;
+    }
+    return (h + size - tail - 1) % size;
+  }
+
+  // Producer: append one whole message or nothing
+  bool write(const uint32_t* msg, uint32_t dw) {
+    if (broken() || dw == 0 || dw > space()) return false;
+    for (uint32_t i = 0; i < dw; ++i) cmds[(tail + i) % size] = msg[i];
+    tail = (tail + dw) % size;
+    __atomic_store_n(&desc->tail, tail, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Consumer: copy the next message (header + payload) into out, which
+  // must hold GUC_CTB_HXG_MSG_MAX_DW dwords. Returns its length, 0 if empty.
+  uint32_t read(uint32_t* out) {
+    if (broken()) return 0;
+    uint32_t t = __atomic_load_n(&desc->tail, __ATOMIC_ACQUIRE);
+    if (t >= size) {
+      fault(XeHW::GUC_CTB_STATUS_MISMATCH);
+      return 0;
+    }
+    uint32_t avail = (t + size - head) % size;
+    if (avail == 0) return 0;
+    uint32_t dw = 1 + (cmds[head] & XeHW::GUC_CTB_MSG_NUM_DWORDS_MASK);
+    if (dw > avail) {
+      fault(XeHW::GUC_CTB_STATUS_UNDERFLOW);
+      return 0;
+    }
+    for (uint32_t i = 0; i < dw; ++i) out[i] = cmds[(head + i) % size];
+    head = (head + dw) % size;
+    __atomic_store_n(&desc->head, head, __ATOMIC_RELEASE);
+    return dw;
+  }
+
+private:
+  XeGuCCTDesc* desc {nullptr};
+  uint32_t*    cmds {nullptr};
+  uint32_t     size {0};
+  uint32_t     head {0};     // ours when consuming
+  uint32_t     tail {0};     // ours when producing
+
+  void fault(uint32_t status) { __atomic_fetch_or(&desc->status, status, __ATOMIC_RELAXED); }
+};
+
+class XeGuCCT {
+public:
+  // Blob layout (GuC v70): two descriptors, then the H2G and G2H rings
+  static constexpr uint32_t kDescBytes      = 2048;
+  static constexpr uint32_t kH2GBytes       = 4096;
+  static constexpr uint32_t kG2HBytes       = 4 * kH2GBytes;
+  static constexpr uint32_t kH2GDescOffset  = 0;
+  static constexpr uint32_t kG2HDescOffset  = kDescBytes;
+  static constexpr uint32_t kH2GOffset      = 2 * kDescBytes;
+  static constexpr uint32_t kG2HOffset      = kH2GOffset + kH2GBytes;
+  static constexpr uint32_t kBlobBytes      = kG2HOffset + kG2HBytes;
+
+  static constexpr uint32_t kMaxOutstanding = 32;
+  static constexpr uint32_t kDoorbellBatch  = 8;
+  static constexpr uint32_t kMaxRequestDw   = 16;    // HXG dwords per request
+  static constexpr uint32_t kMaxResponseDw  = 4;     // HXG dwords kept per response
+
+  enum Result : uint32_t {
+    kCTOk = 0,
+    kCTPending,           // no response yet
+    kCTNoSpace,           // H2G ring full even after draining G2H
+    kCTBusy,              // kMaxOutstanding requests already in flight
+    kCTFailed,            // RESPONSE_FAILURE; error code in response[0]
+    kCTRetry,             // NO_RESPONSE_RETRY: the GuC asks for a resend
+    kCTBroken,            // a ring reported a fault; the channel needs a reset
+    kCTBadFence,          // fence not outstanding
+    kCTBadMessage,        // request too long or malformed
+  };
+
+  struct Stats {
+    uint64_t sends;
+    uint64_t doorbells;
+    uint64_t responses;
+    uint64_t events;
+    uint64_t failures;
+    uint64_t retries;
+    uint64_t unmatched;      // responses with no outstanding fence
+    uint64_t maxOutstanding;
+  };
+
+  typedef void (*DoorbellFn)(void* context);
+  typedef void (*EventFn)(void* context, const uint32_t* hxg, uint32_t dw);
+
+  // blob: kBlobBytes of memory shared with the GuC (zeroed here)
+  void init(void* blob, DoorbellFn bell, void* context, EventFn onEvent = nullptr) {
+    uint8_t* b = (uint8_t*)blob;
+    h2g.init((XeGuCCTDesc*)(b + kH2GDescOffset), (uint32_t*)(b + kH2GOffset), kH2GBytes / 4);
+    g2h.init((XeGuCCTDesc*)(b + kG2HDescOffset), (uint32_t*)(b + kG2HOffset), kG2HBytes / 4);
+    doorbell = bell;
+    ctx = context;
+    eventFn = onEvent;
+    memset(reqs, 0, sizeof(reqs));
+    inFlight = 0;
+    unannounced = 0;
+    st = {};
+  }
+
+  // Queue an HXG request (hxg[0] from GUC_HXG_REQUEST). With outFence the
+  // request is tracked until its response; without, it goes out as a fast
+  // request and the GuC sends nothing back unless it fails.
+  Result send(const uint32_t* hxg, uint32_t dw, uint16_t* outFence) {
+    if (!hxg || dw == 0 || dw > kMaxRequestDw) return kCTBadMessage;
+    if (h2g.broken() || g2h.broken()) return kCTBroken;
+
+    Request* r = nullptr;
+    if (outFence) {
+      r = freeSlot();
+      if (!r) {
+        process();
+        r = freeSlot();
+      }
+      if (!r) return kCTBusy;
+    }
+
+    while (find(nextFence)) nextFence++;   // 16-bit fences wrap; skip live ones
+    uint16_t fence = nextFence++;
+    uint32_t msg[1 + kMaxRequestDw];
+    msg[0] = ((uint32_t)fence << XeHW::GUC_CTB_MSG_FENCE_SHIFT) |
+             (XeHW::GUC_CTB_FORMAT_HXG << XeHW::GUC_CTB_MSG_FORMAT_SHIFT) | dw;
+    memcpy(&msg[1], hxg, (size_t)dw * 4);
+    if (!outFence) {
+      msg[1] = (msg[1] & ~XeHW::GUC_HXG_TYPE_MASK) |
+               (XeHW::GUC_HXG_TYPE_FAST_REQUEST << XeHW::GUC_HXG_TYPE_SHIFT);
+    }
+
+    if (!h2g.write(msg, 1 + dw)) {
+      // Let the GuC catch up on what is already queued, then try once more
+      flush();
+      process();
+      if (!h2g.write(msg, 1 + dw)) return h2g.broken() ? kCTBroken : kCTNoSpace;
+    }
+
+    if (r) {
+      r->fence = fence;
+      r->state = kReqPending;
+      *outFence = fence;
+      if (++inFlight > st.maxOutstanding) st.maxOutstanding = inFlight;
+    }
+    st.sends++;
+    if (++unannounced >= kDoorbellBatch) flush();
+    return kCTOk;
+  }
+
+  // Ring the doorbell once for everything queued since the last one
+  void flush() {
+    if (!unannounced) return;
+    unannounced = 0;
+    st.doorbells++;
+    if (doorbell) doorbell(ctx);
+  }
+
+  // Drain G2H: complete outstanding requests, hand events to the handler.
+  // Returns the number of messages consumed.
+  uint32_t process() {
+    uint32_t n = 0, dw;
+    while ((dw = g2h.read(rx)) != 0) {
+      n++;
+      if (dw < 2) continue;
+      uint16_t fence = (uint16_t)(rx[0] >> XeHW::GUC_CTB_MSG_FENCE_SHIFT);
+      const uint32_t* hxg = &rx[1];
+      uint32_t type = (hxg[0] & XeHW::GUC_HXG_TYPE_MASK) >> XeHW::GUC_HXG_TYPE_SHIFT;
+
+      if (type == XeHW::GUC_HXG_TYPE_EVENT) {
+        st.events++;
+        if (eventFn) eventFn(ctx, hxg, dw - 1);
+        continue;
+      }
+      if (type == XeHW::GUC_HXG_TYPE_NO_RESPONSE_BUSY) continue;   // still working on it
+
+      Request* r = pending(fence);
+      if (!r) {
+        st.unmatched++;
+        continue;
+      }
+      r->len = dw - 1 < kMaxResponseDw ? dw - 1 : kMaxResponseDw;
+      memcpy(r->data, hxg, r->len * 4);
+      if (type == XeHW::GUC_HXG_TYPE_RESPONSE_SUCCESS) {
+        r->data[0] = hxg[0] & XeHW::GUC_HXG_RESPONSE_DATA0_MASK;
+        r->result = kCTOk;
+      } else if (type == XeHW::GUC_HXG_TYPE_NO_RESPONSE_RETRY) {
+        r->result = kCTRetry;
+        st.retries++;
+      } else {
+        r->data[0] = hxg[0] & XeHW::GUC_HXG_FAILURE_ERROR_MASK;
+        r->result = kCTFailed;
+        st.failures++;
+      }
+      r->state = kReqDone;
+      st.responses++;
+    }
+    return n;
+  }
+
+  // Collect the response for fence. kCTPending until it arrived; after
+  // that the fence is released and response holds up to kMaxResponseDw
+  // dwords (response[0] = data0 on success, error code on failure).
+  Result poll(uint16_t fence, uint32_t* response, uint32_t* responseDw) {
+    Request* r = find(fence);
+    if (!r) return kCTBadFence;
+    if (r->state == kReqPending) return (h2g.broken() || g2h.broken()) ? kCTBroken : kCTPending;
+    if (response) memcpy(response, r->data, r->len * 4);
+    if (responseDw) *responseDw = r->len;
+    Result res = r->result;
+    r->state = kReqFree;
+    inFlight--;
+    return res;
+  }
+
+  // Give up on fence (timed out); a late response then counts as unmatched
+  void cancel(uint16_t fence) {
+    Request* r = find(fence);
+    if (!r) return;
+    r->state = kReqFree;
+    inFlight--;
+  }
+
+  uint32_t     outstanding() const { return inFlight; }
+  bool         broken() const      { return h2g.broken() || g2h.broken(); }
+  const Stats& stats() const       { return st; }
+
+private:
+  enum : uint8_t { kReqFree = 0, kReqPending, kReqDone };
+  struct Request {
+    uint16_t fence;
+    uint8_t  state;
+    Result   result;
+    uint32_t len;
+    uint32_t data[kMaxResponseDw];
+  };
+
+  XeGuCCTBuffer h2g;
+  XeGuCCTBuffer g2h;
+  DoorbellFn    doorbell {nullptr};
+  EventFn       eventFn {nullptr};
+  void*         ctx {nullptr};
+  Request       reqs[kMaxOutstanding] {};
+  uint32_t      inFlight {0};
+  uint32_t      unannounced {0};
+  uint16_t      nextFence {1};
+  uint32_t      rx[XeHW::GUC_CTB_HXG_MSG_MAX_DW] {};
+  Stats         st {};
+
+  Request* freeSlot() {
+    for (uint32_t i = 0; i < kMaxOutstanding; ++i) {
+      if (reqs[i].state == kReqFree) return &reqs[i];
+    }
+    return nullptr;
+  }
+  Request* find(uint16_t fence) {
+    for (uint32_t i = 0; i < kMaxOutstanding; ++i) {
+      if (reqs[i].state != kReqFree && reqs[i].fence == fence) return &reqs[i];
+    }
+    return nullptr;
+  }
+  Request* pending(uint16_t fence) {
+    Request* r = find(fence);
+    return (r && r->state == kReqPending) ? r : nullptr;
+  }
+};
@@ -0,0 +1,110 @@
+// XeGuCFirmware.hpp - GuC firmware blob parser
+//
+// Header-only and free of IOKit so the same code validates blobs in the
+// kext and on the host (userspace/xeguc.cpp).
+//
+// A GuC blob is laid out as:
+//
+//   [ CSS header (128 bytes) | uCode | RSA signature | modulus | exponent ]
+//
+// The DMA engine copies header + uCode into WOPCM in one transfer; the RSA
+// signature goes separately through the UOS_RSA_SCRATCH registers. All
+// sizes in the header are in dwords and must agree with each other and with
+// the blob length before anything is handed to the hardware.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "xe_hw_offsets.hpp"
+
+struct XeGuCCssHeader {
+  uint32_t moduleType;
+  uint32_t headerSizeDw;     // header + key + modulus + exponent
+  uint32_t headerVersion;
+  uint32_t moduleId;
+  uint32_t moduleVendor;
+  uint32_t date;             // BCD yyyymmdd
+  uint32_t sizeDw;           // headerSizeDw + uCode
+  uint32_t keySizeDw;
+  uint32_t modulusSizeDw;
+  uint32_t exponentSizeDw;
+  uint32_t time;             // BCD hhmmss
+  char     username[8];
+  char     buildNumber[12];
+  uint32_t swVersion;        // [23:16] major [15:8] minor [7:0] patch
+  uint32_t vfVersion;
+  uint32_t reserved0[12];
+  uint32_t privateDataSize;  // GuC scratch it expects above the image in WOPCM
+  uint32_t headerInfo;
+};
+static_assert(sizeof(XeGuCCssHeader) == 128, "CSS header is 32 dwords");
+
+class XeGuCFirmware {
+public:
+  enum Result : uint32_t {
+    kFwOk = 0,
+    kFwTruncated,         // blob shorter than the CSS header
+    kFwBadHeaderSize,     // header sizes do not add up to a 128-byte CSS header
+    kFwBadUcodeSize,      // empty uCode or sizeDw below headerSizeDw
+    kFwBadRsaSize,        // signature does not fit the RSA scratch registers
+    kFwShortBlob,         // header + uCode + RSA run past the blob
+    kFwTooLarge,          // image does not fit the GuC WOPCM partition
+  };
+
+  struct Layout {
+    uint32_t ucodeOffset;    // == sizeof(XeGuCCssHeader)
+    uint32_t ucodeBytes;
+    uint32_t rsaOffset;
+    uint32_t rsaBytes;
+    uint32_t uploadBytes;    // header + uCode: one DMA transfer
+    uint32_t privateBytes;
+    uint32_t major, minor, patch;
+  };
+
+  static const char* resultName(Result r) {
+    switch (r) {
+      case kFwOk:            return "ok";
+      case kFwTruncated:     return "truncated";
+      case kFwBadHeaderSize: return "bad header size";
+      case kFwBadUcodeSize:  return "bad uCode size";
+      case kFwBadRsaSize:    return "bad RSA size";
+      case kFwShortBlob:     return "short blob";
+      case kFwTooLarge:      return "too large for WOPCM";
+    }
+    return "?";
+  }
+
+  // Validate blob and describe where its sections are. wopcmLimit is the
+  // room the GuC partition offers above the DMA destination offset (0 skips
+  // the check, e.g. on the host).
+  static Result parse(const void* blob, size_t len, uint32_t wopcmLimit, Layout* out) {
+    if (!blob || !out || len < sizeof(XeGuCCssHeader)) return kFwTruncated;
+    XeGuCCssHeader css;
+    memcpy(&css, blob, sizeof(css));     // blob may not be dword aligned
+
+    // Every field is a dword count from an untrusted file: do the sums in
+    // 64 bits so a huge value cannot wrap into a plausible one
+    uint64_t keyDw = (uint64_t)css.keySizeDw + css.modulusSizeDw + css.exponentSizeDw;
+    if (css.headerSizeDw < keyDw ||
+        (css.headerSizeDw - keyDw) * 4 != sizeof(XeGuCCssHeader)) return kFwBadHeaderSize;
+    if (css.sizeDw <= css.headerSizeDw) return kFwBadUcodeSize;
+    uint64_t ucode = ((uint64_t)css.sizeDw - css.headerSizeDw) * 4;
+    uint64_t rsa   = (uint64_t)css.keySizeDw * 4;
+    if (rsa == 0 || rsa > XeHW::UOS_RSA_SCRATCH_COUNT * 4) return kFwBadRsaSize;
+    if (sizeof(XeGuCCssHeader) + ucode + rsa > len) return kFwShortBlob;
+
+    uint64_t upload = sizeof(XeGuCCssHeader) + ucode;
+    if (wopcmLimit && upload + css.privateDataSize > wopcmLimit) return kFwTooLarge;
+
+    out->ucodeOffset  = sizeof(XeGuCCssHeader);
+    out->ucodeBytes   = (uint32_t)ucode;
+    out->rsaOffset    = (uint32_t)upload;
+    out->rsaBytes     = (uint32_t)rsa;
+    out->uploadBytes  = (uint32_t)upload;
+    out->privateBytes = css.privateDataSize;
+    out->major        = (css.swVersion >> 16) & 0xFF;
+    out->minor        = (css.swVersion >> 8) & 0xFF;
+    out->patch        = css.swVersion & 0xFF;
+    return kFwOk;
+  }
+};
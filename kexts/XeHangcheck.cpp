@@ -0,0 +1,29 @@
+#include "XeHangcheck.hpp"
+
+bool XeHangcheck::sample(uint64_t acthd, uint32_t seqno) {
+  st.samples++;
+  if (!primed || acthd != lastActhd || seqno != lastSeqno) {
+    lastActhd = acthd;
+    lastSeqno = seqno;
+    primed = true;
+    stalled = 0;
+    return false;
+  }
+  if (++stalled < kHangPeriods) return false;
+
+  st.hangs++;
+  stalled = 0;
+  return true;
+}
+
+void XeHangcheck::noteReset(bool ok, uint32_t replayed, uint64_t downtimeUs) {
+  if (!ok) {
+    st.resetFailures++;
+    return;
+  }
+  st.resets++;
+  st.replayed += replayed;
+  st.lastDowntimeUs = downtimeUs;
+  if (downtimeUs > st.maxDowntimeUs) st.maxDowntimeUs = downtimeUs;
+  idle();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <IOKit/IOLib.h>
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Per-engine hang detector.
+//
+// The service samples every busy engine once per period. An engine is only
+// declared hung when neither its active head (ACTHD) nor its completed
+// seqno moved for kHangPeriods samples in a row, so a long batch that is
+// still making progress is never reset. The caller owns the timer and the
+// reset; this class only keeps the sample history and the counters.
+class XeHangcheck {
+public:
+  static constexpr uint32_t kPeriodMs    = 500;
+  static constexpr uint32_t kHangPeriods = 4;    // 2s without progress
+
+  struct Stats {
+    uint64_t samples;
+    uint64_t hangs;
+    uint64_t resets;           // successful per-engine resets
+    uint64_t resetFailures;
+    uint64_t replayed;         // requests resubmitted after a reset
+    uint64_t lastDowntimeUs;   // hang declared -> engine resubmitted
+    uint64_t maxDowntimeUs;
+  };
+
+  // Record one sample of a busy engine. Returns true when it is hung.
+  bool sample(uint64_t acthd, uint32_t seqno);
+
+  // Engine went idle (or was just reset): forget the history.
+  void idle() { stalled = 0; primed = false; }
+
+  void noteReset(bool ok, uint32_t replayed, uint64_t downtimeUs);
+
+  const Stats& stats() const { return st; }
+
+private:
+  uint64_t lastActhd {0};
+  uint32_t lastSeqno {0};
+  uint32_t stalled   {0};
+  bool     primed    {false};
+  Stats    st {};
+};
@@ -0,0 +1,72 @@
+#include "XeKernelMemory.hpp"
+
+void XeKernelMemory::init(volatile uint32_t* mmio, XeGGTTSpace* ggttSpace, XeStolen* dsm, XeBuddyPool* buddy) {
+  m = mmio;
+  space = ggttSpace;
+  stolen = (dsm && dsm->ready()) ? dsm : nullptr;
+  pool = (buddy && buddy->ready()) ? buddy : nullptr;
+}
+
+bool XeKernelMemory::alloc(uint32_t bytes, uint32_t placement, Block* out) {
+  if (!m || !out || !bytes) return false;
+  uint32_t sz = (bytes + 0xFFFu) & ~0xFFFu;
+
+  uint32_t offset = 0;
+  if ((placement & kPlaceStolen) && stolen && stolen->alloc(sz, XeStolen::kPageBytes, &offset)) {
+    *out = Block {stolen->cpu(offset), stolen->ggtt(offset), sz, nullptr};
+    bzero(out->cpu, sz);
+    st.stolenBlocks++;
+    st.stolenBytes += sz;
+    return true;
+  }
+  if ((placement & kPlacePool) && pool && pool->alloc(sz, &offset)) {
+    *out = Block {pool->cpu(offset), pool->ggtt(offset), sz, nullptr};
+    bzero(out->cpu, sz);
+    st.poolBlocks++;
+    st.poolBytes += sz;
+    return true;
+  }
+  if (!(placement & kPlaceSystem) || !space) return false;
+
+  IOBufferMemoryDescriptor* md = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut, sz, page_size);
+  if (!md) {
+    XeLog("XeKernelMemory::alloc: ERROR - %u byte allocation failed\n", sz);
+    return false;
+  }
+  bzero(md->getBytesNoCopy(), sz);
+  uint32_t ggtt = space->alloc(sz);
+  if (!ggtt || !XeGGTT::insertPages(m, ggtt, md)) {
+    XeLog("XeKernelMemory::alloc: ERROR - GGTT bind failed\n");
+    md->release();
+    return false;
+  }
+  *out = Block {(uint8_t*)md->getBytesNoCopy(), ggtt, sz, md};
+  st.systemBlocks++;
+  st.systemBytes += sz;
+  return true;
+}
+
+void XeKernelMemory::free(Block* b) {
+  if (!b || !b->cpu) return;
+  if (b->md) {
+    // XeGGTTSpace never takes the range back; only the PTEs go
+    if (m) XeGGTT::clearPages(m, b->ggtt, b->bytes);
+    b->md->release();
+    st.systemBlocks--;
+    st.systemBytes -= b->bytes;
+  } else if (pool && pool->owns(b->ggtt)) {
+    pool->free(pool->offsetOf(b->ggtt), b->bytes);
+    st.poolBlocks--;
+    st.poolBytes -= b->bytes;
+  } else if (stolen) {
+    stolen->free(stolen->offsetOf(b->ggtt), b->bytes);
+    st.stolenBlocks--;
+    st.stolenBytes -= b->bytes;
+  }
+  *b = Block {};
+}
+
+const char* XeKernelMemory::placement(const Block& b) const {
+  if (b.md) return "system";
+  return (pool && pool->owns(b.ggtt)) ? "pool" : "stolen";
+}
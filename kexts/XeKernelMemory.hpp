@@ -0,0 +1,66 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "XeGGTT.hpp"
+#include "XeStolen.hpp"
+#include "XeBuddyPool.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Memory the driver itself hands the GPU: rings, status pages, context
+// images. A block is zeroed, pinned and bound into the GGTT for its whole
+// life. The placement mask says where it may live, tried in order:
+//
+//   stolen  XeStolen: contiguous, already bound, CPU view write-combined
+//   pool    XeBuddyPool: contiguous, already bound, CPU view write-back
+//   system  a wired IOBufferMemoryDescriptor bound in XeGGTTSpace
+//
+// Only the last touches the VM; it is the fallback once both carve-outs
+// are full. Blocks the CPU reads back a lot (context images: the ring head
+// is read from them on every emit) stay out of stolen memory.
+//
+// Not locked: engines come up and go down in the service's start and stop,
+// and contexts grow under its command gate.
+class XeKernelMemory {
+public:
+  enum : uint32_t {
+    kPlaceStolen = 1u << 0,
+    kPlacePool   = 1u << 1,
+    kPlaceSystem = 1u << 2,
+    kPlaceAny    = kPlaceStolen | kPlacePool | kPlaceSystem,
+  };
+
+  struct Block {
+    uint8_t*                  cpu;    // kernel view
+    uint32_t                  ggtt;
+    uint32_t                  bytes;  // page multiple
+    IOBufferMemoryDescriptor* md;     // system RAM; null in a carve-out
+  };
+
+  struct Stats {               // live blocks by placement
+    uint64_t stolenBlocks;
+    uint64_t stolenBytes;
+    uint64_t poolBlocks;
+    uint64_t poolBytes;
+    uint64_t systemBlocks;
+    uint64_t systemBytes;
+  };
+
+  void init(volatile uint32_t* mmio, XeGGTTSpace* space, XeStolen* stolen, XeBuddyPool* pool);
+
+  bool alloc(uint32_t bytes, uint32_t placement, Block* out);
+  void free(Block* b);
+
+  // "stolen", "pool" or "system", for logs
+  const char* placement(const Block& b) const;
+
+  const Stats& stats() const { return st; }
+
+private:
+  volatile uint32_t* m {nullptr};
+  XeGGTTSpace*       space {nullptr};
+  XeStolen*          stolen {nullptr};
+  XeBuddyPool*       pool {nullptr};
+  Stats              st {};
+};
@@ -0,0 +1,263 @@
+// XeLogRelay.hpp - driver event log and GuC log relay shared with userspace
+//
+// Header-only and free of IOKit: the kext writes it, userspace maps it
+// read-only (clientMemoryForType kXeMemoryLogRelay) and streams it with no
+// syscall per record and no kernel-side copy.
+//
+// Because readers never write to the mapping, the kernel cannot know where
+// they are and never waits for them. Records are overwritten oldest first;
+// every slot carries the sequence number of the record in it, stored last,
+// so a reader that finds another number there (before or after copying)
+// knows it was lapped and counts the gap as lost.
+//
+// The header also mirrors the GuC's debug log position. The log bytes
+// themselves stay where the GuC writes them (kXeMemoryGuCLog); the kernel
+// only turns the firmware's ring offsets into a monotonic byte position.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+enum XeLogEvent : uint16_t {
+  kXeLogSubmit = 1,        // arg0 = seqno, arg1 = submit flags
+  kXeLogDoorbell,          // arg0 = XeSubmitCoalescer::FlushReason, arg1 = submits covered
+  kXeLogRetire,            // arg0 = completed seqno (sampled on the hangcheck tick)
+  kXeLogHang,              // arg0 = ACTHD, arg1 = completed seqno
+  kXeLogReset,             // arg0 = IOReturn, arg1 = requests replayed, arg2 = downtime (us)
+  kXeLogGuCFlush,          // arg0 = new debug log bytes, arg1 = GuC overflows so far
+  kXeLogGuCCrash,          // crash dump section updated
+};
+
+struct XeLogRecord {
+  uint64_t seq;            // 1-based record number, 0 while the slot is rewritten
+  uint64_t time;           // mach_absolute_time()
+  uint16_t type;           // XeLogEvent
+  uint16_t engine;         // index into kXeEngines, 0xFFFF for GuC events
+  uint32_t arg0;
+  uint32_t arg1;
+  uint32_t arg2;
+};
+static_assert(sizeof(XeLogRecord) == 32, "relay records are 32 bytes");
+
+struct XeLogRelayHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t recordBytes;
+  uint32_t capacity;       // records, power of two
+  uint32_t recordsOffset;  // from the start of the mapping
+  uint32_t gucDebugOffset; // debug section inside kXeMemoryGuCLog (0: no GuC log)
+  uint32_t gucDebugBytes;
+  uint32_t gucCrashOffset;
+  uint32_t gucCrashBytes;
+  uint32_t reserved0;
+
+  uint64_t head;           // records written so far (write pointer)
+
+  // GuC debug log mirror, guarded by gucSeq (odd while being updated).
+  // Position p lives at gucDebugOffset + p % gucDebugBytes. When the GuC
+  // wraps it skips the end of the section: [lap * size + wrapOffset,
+  // (lap + 1) * size) for the lap that ended last is padding.
+  uint32_t gucSeq;
+  uint32_t gucWrapOffset;
+  uint64_t gucWritten;     // bytes the GuC has written, monotonic
+  uint64_t gucOverflows;   // times the GuC found its log full (lost in firmware)
+  uint64_t gucFlushes;     // samples that found new bytes
+  uint64_t gucCrashDumps;
+};
+
+class XeLogRelay {
+public:
+  static constexpr uint32_t kMagic         = 0x584C4F47;   // 'XLOG'
+  static constexpr uint32_t kVersion       = 1;
+  static constexpr uint32_t kRecordsOffset = 4096;
+  static constexpr uint32_t kCapacity      = 4096;
+  static constexpr uint32_t kBytes         = kRecordsOffset + kCapacity * sizeof(XeLogRecord);
+  static constexpr uint16_t kEngineGuC     = 0xFFFF;
+  static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+  static_assert(sizeof(XeLogRelayHeader) <= kRecordsOffset, "header fits its page");
+
+  // ---------------------------- writer (kext) ----------------------------
+  // One writer, serialized by the owner (the service's command gate).
+
+  void init(void* mem) {
+    memset(mem, 0, kBytes);
+    hdr = (XeLogRelayHeader*)mem;
+    records = (XeLogRecord*)((uint8_t*)mem + kRecordsOffset);
+    hdr->magic = kMagic;
+    hdr->version = kVersion;
+    hdr->recordBytes = sizeof(XeLogRecord);
+    hdr->capacity = kCapacity;
+    hdr->recordsOffset = kRecordsOffset;
+    head = 0;
+  }
+  void reset() { hdr = nullptr; records = nullptr; head = 0; }
+  bool ready() const { return hdr != nullptr; }
+
+  void emit(uint64_t time, uint16_t type, uint16_t engine, uint32_t arg0, uint32_t arg1 = 0,
+            uint32_t arg2 = 0) {
+    if (!hdr) return;
+    XeLogRecord* r = &records[head & (kCapacity - 1)];
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->time = time;
+    r->type = type;
+    r->engine = engine;
+    r->arg0 = arg0;
+    r->arg1 = arg1;
+    r->arg2 = arg2;
+    __atomic_store_n(&r->seq, head + 1, __ATOMIC_RELEASE);
+    head++;
+    __atomic_store_n(&hdr->head, head, __ATOMIC_RELEASE);
+  }
+
+  void describeGuC(uint32_t debugOffset, uint32_t debugBytes, uint32_t crashOffset, uint32_t crashBytes) {
+    if (!hdr) return;
+    hdr->gucDebugOffset = debugOffset;
+    hdr->gucDebugBytes = debugBytes;
+    hdr->gucCrashOffset = crashOffset;
+    hdr->gucCrashBytes = crashBytes;
+  }
+
+  void publishGuC(uint64_t written, uint32_t wrapOffset, uint64_t overflows, uint64_t flushes,
+                  uint64_t crashDumps) {
+    if (!hdr) return;
+    uint32_t s = hdr->gucSeq;
+    __atomic_store_n(&hdr->gucSeq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    hdr->gucWrapOffset = wrapOffset;
+    hdr->gucWritten = written;
+    hdr->gucOverflows = overflows;
+    hdr->gucFlushes = flushes;
+    hdr->gucCrashDumps = crashDumps;
+    __atomic_store_n(&hdr->gucSeq, s + 2, __ATOMIC_RELEASE);
+  }
+
+  uint64_t written() const { return head; }
+
+private:
+  XeLogRelayHeader* hdr {nullptr};
+  XeLogRecord*      records {nullptr};
+  uint64_t          head {0};
+};
+
+// ------------------------------ reader ------------------------------
+// Holds its own read pointers; any number of readers may share a mapping.
+// Starts at the oldest record still present unless told otherwise.
+class XeLogRelayReader {
+public:
+  bool attach(const void* relay, const void* gucLog, size_t gucLogBytes) {
+    hdr = (const XeLogRelayHeader*)relay;
+    if (hdr->magic != XeLogRelay::kMagic || hdr->version != XeLogRelay::kVersion ||
+        hdr->recordBytes != sizeof(XeLogRecord) || !hdr->capacity ||
+        (hdr->capacity & (hdr->capacity - 1))) {
+      hdr = nullptr;
+      return false;
+    }
+    records = (const XeLogRecord*)((const uint8_t*)relay + hdr->recordsOffset);
+    guc = nullptr;
+    if (gucLog && hdr->gucDebugBytes &&
+        (uint64_t)hdr->gucDebugOffset + hdr->gucDebugBytes <= gucLogBytes) {
+      guc = (const uint8_t*)gucLog + hdr->gucDebugOffset;
+    }
+    uint64_t h = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    tail = h > hdr->capacity ? h - hdr->capacity : 0;
+    gucTail = 0;
+    lost = gucLost = 0;
+    return true;
+  }
+
+  // Skip everything already in the log
+  void seekToEnd() {
+    tail = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    uint32_t wrap;
+    sampleGuC(&gucTail, &wrap);
+  }
+
+  // Next driver event; false when caught up
+  bool next(XeLogRecord* out) {
+    const uint64_t cap = hdr->capacity;
+    for (;;) {
+      uint64_t h = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+      if (tail >= h) return false;
+      if (h - tail > cap) {
+        lost += h - tail - cap;
+        tail = h - cap;
+      }
+      const XeLogRecord* r = &records[tail & (cap - 1)];
+      uint64_t s = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+      if (s == tail + 1) {
+        memcpy(out, (const void*)r, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == s) {
+          tail++;
+          return true;
+        }
+      }
+      lost++;    // rewritten while we looked
+      tail++;
+    }
+  }
+
+  // Copy up to max new bytes of GuC debug log; 0 when caught up. The GuC
+  // keeps writing for up to half its buffer before the kernel samples it
+  // again, so only the newest half of the buffer is trusted.
+  size_t readGuC(void* out, size_t max) {
+    if (!guc) return 0;
+    const uint64_t size = hdr->gucDebugBytes, window = size / 2;
+    for (;;) {
+      uint64_t w;
+      uint32_t wrap;
+      sampleGuC(&w, &wrap);
+      if (gucTail >= w) return 0;
+      if (w - gucTail > window) {
+        gucLost += w - window - gucTail;
+        gucTail = w - window;
+      }
+      // Skip the padding the GuC left when it last wrapped
+      uint64_t off = gucTail % size;
+      if (gucTail / size < w / size && off >= wrap) {
+        gucTail += size - off;
+        continue;
+      }
+      uint64_t end = gucTail / size < w / size ? (gucTail / size) * size + wrap : w;
+      size_t n = (size_t)(end - gucTail);
+      if (n > max) n = max;
+      memcpy(out, guc + off, n);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      uint64_t w2;
+      sampleGuC(&w2, &wrap);
+      if (w2 > window && gucTail < w2 - window) {   // overwritten meanwhile
+        gucLost += n;
+        gucTail += n;
+        continue;
+      }
+      gucTail += n;
+      return n;
+    }
+  }
+
+  const XeLogRelayHeader* header() const { return hdr; }
+  uint64_t lostRecords() const  { return lost; }
+  uint64_t lostGuCBytes() const { return gucLost; }
+  uint64_t readPointer() const  { return tail; }
+  uint64_t gucReadPointer() const { return gucTail; }
+
+private:
+  const XeLogRelayHeader* hdr {nullptr};
+  const XeLogRecord*      records {nullptr};
+  const uint8_t*          guc {nullptr};
+  uint64_t                tail {0};
+  uint64_t                gucTail {0};
+  uint64_t                lost {0};
+  uint64_t                gucLost {0};
+
+  void sampleGuC(uint64_t* written, uint32_t* wrap) const {
+    for (;;) {
+      uint32_t s = __atomic_load_n(&hdr->gucSeq, __ATOMIC_ACQUIRE);
+      *written = hdr->gucWritten;
+      *wrap = hdr->gucWrapOffset;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (!(s & 1) && __atomic_load_n(&hdr->gucSeq, __ATOMIC_RELAXED) == s) return;
+    }
+  }
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+
+// GPU memory accounting. Each user client owns an XeMemAccount whose
+// parent is the service's global one; charges go to both. Counters are
+// plain atomics so any path (gated or not) can charge without a lock.
+//
+//   allocated  kernel backing held by the client: its BOs and slabs
+//   pinned     user memory wired for it (userptr imports)
+//   bound      GGTT space mapping the above
+//   reserved   lazy BOs not backed yet: address space only, moved to
+//              allocated when their pages are first needed
+//
+// Memory cached in the BO pool belongs to no client; the service reports
+// it separately. A shared BO stays charged to the client that created it
+// until that client drops its handle.
+struct XeMemAccount {
+  enum Kind : uint32_t { kAllocated, kPinned, kBound, kReserved, kKindCount };
+
+  uint64_t      bytes[kKindCount] {};
+  XeMemAccount* parent {nullptr};
+
+  void charge(Kind k, uint64_t n) {
+    for (XeMemAccount* a = this; a; a = a->parent) __atomic_add_fetch(&a->bytes[k], n, __ATOMIC_RELAXED);
+  }
+  void uncharge(Kind k, uint64_t n) {
+    for (XeMemAccount* a = this; a; a = a->parent) __atomic_sub_fetch(&a->bytes[k], n, __ATOMIC_RELAXED);
+  }
+  uint64_t get(Kind k) const { return __atomic_load_n(&bytes[k], __ATOMIC_RELAXED); }
+
+  // A buffer: its backing and, if bound, a GGTT range of the same size
+  void chargeBuffer(uint64_t n, bool bound) {
+    charge(kAllocated, n);
+    if (bound) charge(kBound, n);
+  }
+  void unchargeBuffer(uint64_t n, bool bound) {
+    uncharge(kAllocated, n);
+    if (bound) uncharge(kBound, n);
+  }
+
+  // What limits apply to: memory that exists because of this account
+  uint64_t footprint() const { return get(kAllocated) + get(kPinned); }
+};
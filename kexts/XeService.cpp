@@ -7,6 +7,7 @@
 
 #include <IOKit/IOLib.h>            // IOLog, kprintf
 #include <kern/debug.h>              // panic
+#include <kern/clock.h>              // mach_absolute_time, absolutetime_to_nanoseconds
 
 #include <IOKit/IOBufferMemoryDescriptor.h> // for IOBufferMemoryDescriptor
 
@@ -168,17 +169,106 @@ bool XeService::start(IOService* provider) {
     // Read display pipeline state
     logDisplayState();
   }
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    m_cs[i].attach(mmio, kXeEngines[i]);
+  }
+  // Stolen memory comes first so the engines' rings and status pages land there
+  if (!gXeBoot.strictSafe && !gXeBoot.disableStolen) {
+    XeLog("XePCI: Probing stolen memory...\n");
+    if (!m_stolen.init(pci, mmio)) {
+      XeLog("XePCI: WARNING - stolen memory unavailable, engines use system RAM\n");
+    }
+  }
+  // Then a contiguous pool for what does not fit there, carved before
+  // physical memory fragments so engine bring-up never waits on the VM
+  if (!gXeBoot.strictSafe && !gXeBoot.disableKernelPool) {
+    if (!m_kpool.init(mmio, &m_ggttSpace)) {
+      XeLog("XePCI: WARNING - no contiguous pool, engine blocks come from the VM\n");
+    }
+  }
+  m_kmem.init(mmio, &m_ggttSpace, &m_stolen, &m_kpool);
+  if (gXeBoot.useExeclists && !gXeBoot.strictSafe) {
+    for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+      const XeEngineDesc& e = kXeEngines[i];
+      if (e.has(kXeEngineCapOptional)) {
+        XeLog("XePCI: SKIP - %s is optional on this SKU, not enabling\n", e.name);
+        continue;
+      }
+      XeLog("XePCI: Enabling execlist submission on %s (base 0x%05x)...\n", e.name, e.mmioBase);
+      IOReturn elr = m_cs[i].enableExeclists(m_kmem);
+      if (elr != kIOReturnSuccess) {
+        XeLog("XePCI: WARNING - %s execlists unavailable (0x%x), using legacy path\n", e.name, elr);
+        continue;
+      }
+      // Batches for this engine are pre-bound; other engines keep an
+      // unbound pool that grows on first use
+      m_batchPool[i].init(mmio, &m_ggttSpace, XeBatchPool::kMinBuffers);
+      m_copyPool[i].init(mmio, &m_ggttSpace, 0, kBatchCopyBytes);
+    }
+  }
   XeLog("XePCI: Step 6/7: COMPLETE - GPU probing finished\n");
 
+  // Submission work loop, gate and doorbell coalescing timer
+  m_workLoop = IOWorkLoop::workLoop();
+  if (!m_workLoop) {
+    XeLog("XePCI: ERROR - failed to create work loop\n");
+    return false;
+  }
+  m_gate = IOCommandGate::commandGate(this);
+  m_coalesceTimer = IOTimerEventSource::timerEventSource(this, &XeService::coalesceTimerFired);
+  m_hangcheckTimer = IOTimerEventSource::timerEventSource(this, &XeService::hangcheckTimerFired);
+  m_gucTimer = IOTimerEventSource::timerEventSource(this, &XeService::gucTimerFired);
+  m_waitTimer = IOTimerEventSource::timerEventSource(this, &XeService::waitTimerFired);
+  if (!m_gate || !m_coalesceTimer || !m_hangcheckTimer || !m_gucTimer || !m_waitTimer ||
+      m_workLoop->addEventSource(m_gate) != kIOReturnSuccess ||
+      m_workLoop->addEventSource(m_coalesceTimer) != kIOReturnSuccess ||
+      m_workLoop->addEventSource(m_hangcheckTimer) != kIOReturnSuccess ||
+      m_workLoop->addEventSource(m_gucTimer) != kIOReturnSuccess ||
+      m_workLoop->addEventSource(m_waitTimer) != kIOReturnSuccess) {
+    XeLog("XePCI: ERROR - failed to set up submission gate\n");
+    return false;
+  }
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (gXeBoot.disableCoalescing) m_coalesce[i].configure(0, 1);
+  }
+  XeLog("XePCI: Doorbell coalescing: window=%u us limit=%u%s\n",
+        XeSubmitCoalescer::kDefaultWindowUs, XeSubmitCoalescer::kDefaultBatchLimit,
+        gXeBoot.disableCoalescing ? " (disabled)" : "");
+  XeLog("XePCI: Hangcheck: period=%u ms, hang after %u idle periods%s\n",
+        XeHangcheck::kPeriodMs, XeHangcheck::kHangPeriods,
+        gXeBoot.disableHangcheck ? " (disabled)" : "");
+
+  // Event relay for userspace; the GuC mirrors its log position into it
+  m_relayMem = IOBufferMemoryDescriptor::withOptions(kIOMemoryKernelUserShared | kIODirectionInOut,
+                                                     XeLogRelay::kBytes, page_size);
+  if (m_relayMem) {
+    m_relay.init(m_relayMem->getBytesNoCopy());
+    m_guc.attachRelay(&m_relay);
+    XeLog("XePCI: Event relay: %u records\n", XeLogRelay::kCapacity);
+  } else {
+    XeLog("XePCI: WARNING - event relay unavailable\n");
+  }
+  if (gXeBoot.loadGuC && !gXeBoot.strictSafe) requestGuCFirmware();
+
   // Step 7: Initialize buffer object registry and register service
   XeLog("XePCI: Step 7/7: Registering service\n");
-  m_boList = OSArray::withCapacity(8);
-  if (!m_boList) {
-    XeLog("XePCI: ERROR - failed to allocate BO list\n");
+  if (!m_exports.init()) {
+    XeLog("XePCI: ERROR - failed to allocate BO export table\n");
     return false;
   }
+  if (!m_boPool.init(mmio, &m_ggttSpace)) {
+    XeLog("XePCI: ERROR - failed to initialize BO pool\n");
+    return false;
+  }
+  m_memSoft = (uint64_t)gXeBoot.memSoftMB << 20;
+  m_memHard = (uint64_t)gXeBoot.memHardMB << 20;
+  m_clientMemHard = (uint64_t)gXeBoot.clientMemMB << 20;
+  if (m_memSoft || m_memHard || m_clientMemHard) {
+    XeLog("XePCI: GPU memory limits: soft=%uMB hard=%uMB per client=%uMB\n", gXeBoot.memSoftMB,
+          gXeBoot.memHardMB, gXeBoot.clientMemMB);
+  }
   
-  XeLog("XePCI: BO registry initialized with capacity=8\n");
+  XeLog("XePCI: BO export table initialized (%u pooled size classes)\n", XeBoPool::kClassCount);
   registerService();
   
   XeLog("XePCI: Step 7/7: COMPLETE - Service registered\n");
@@ -285,16 +375,69 @@ void XeService::logDisplayState() {
 void XeService::stop(IOService* provider) {
   XeLog("XePCI: Stopping XeService...\n");
   
-  // Release any BOs left around
-  if (m_boList) {
-    uint32_t count = m_boList->getCount();
-    XeLog("XePCI: Releasing %u buffer objects\n", count);
-    for (unsigned i = 0; i < count; ++i) {
-      auto *md = OSDynamicCast(IOBufferMemoryDescriptor, m_boList->getObject(i));
-      if (md) md->release();
-    }
-    m_boList->release();
-    m_boList = nullptr;
+  // Clients have closed by now (their BOs went back to the pool); only
+  // exports whose holders never closed remain
+  XeLog("XePCI: Releasing %u exported buffer objects\n", m_exports.count());
+  m_exports.destroy(mmio);
+  m_boPool.destroy();
+
+  // A firmware request still in flight must not call into a stopped service
+  if (m_gucRequest != kOSKextRequestTagInvalid) {
+    void* context = nullptr;
+    if (OSKextCancelRequest(m_gucRequest, &context) == kOSReturnSuccess) release();
+    m_gucRequest = kOSKextRequestTagInvalid;
+  }
+
+  // Stop the timers before the engines and the GuC they touch go away
+  if (m_waitTimer) {
+    m_waitTimer->cancelTimeout();
+    if (m_workLoop) m_workLoop->removeEventSource(m_waitTimer);
+    m_waitTimer->release();
+    m_waitTimer = nullptr;
+  }
+  if (m_gucTimer) {
+    m_gucTimer->cancelTimeout();
+    if (m_workLoop) m_workLoop->removeEventSource(m_gucTimer);
+    m_gucTimer->release();
+    m_gucTimer = nullptr;
+  }
+  if (m_hangcheckTimer) {
+    m_hangcheckTimer->cancelTimeout();
+    if (m_workLoop) m_workLoop->removeEventSource(m_hangcheckTimer);
+    m_hangcheckTimer->release();
+    m_hangcheckTimer = nullptr;
+  }
+  if (m_coalesceTimer) {
+    m_coalesceTimer->cancelTimeout();
+    if (m_workLoop) m_workLoop->removeEventSource(m_coalesceTimer);
+    m_coalesceTimer->release();
+    m_coalesceTimer = nullptr;
+  }
+  if (m_gate) {
+    if (m_workLoop) m_workLoop->removeEventSource(m_gate);
+    m_gate->release();
+    m_gate = nullptr;
+  }
+  if (m_workLoop) {
+    m_workLoop->release();
+    m_workLoop = nullptr;
+  }
+
+  // Tear down execlist state while GGTT PTEs are still reachable
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    m_batchPool[i].destroy();
+    m_copyPool[i].destroy();
+    m_cs[i].disableExeclists();
+    m_cs[i].attach(nullptr, kXeEngines[i]);
+  }
+  m_kpool.destroy();
+  m_stolen.destroy();
+  m_guc.destroy();
+  m_guc.attachRelay(nullptr);
+  m_relay.reset();
+  if (m_relayMem) {
+    m_relayMem->release();     // user mappings keep their own reference
+    m_relayMem = nullptr;
   }
 
   if (bar0) { 
@@ -332,82 +475,1363 @@ IOReturn XeService::newUserClient(task_t task, void* secID, UInt32 type,
   return kIOReturnSuccess;
 }
 
-// -------------------------- BO helpers --------------------------
+// ------------------------------ GuC ------------------------------
+
+// The blob ships in XePCI.kext/Contents/Resources; kextd hands it to us
+// asynchronously, and we hold a reference until the callback has run.
+void XeService::requestGuCFirmware() {
+  retain();
+  OSReturn ret = OSKextRequestResource(OSKextGetCurrentIdentifier(), XeGuC::kFirmwareName,
+                                       &XeService::gucFirmwareLoaded, this, &m_gucRequest);
+  if (ret != kOSReturnSuccess) {
+    XeLog("XePCI: WARNING - GuC firmware request failed (0x%x)\n", ret);
+    m_gucRequest = kOSKextRequestTagInvalid;
+    release();
+    return;
+  }
+  XeLog("XePCI: Requested GuC firmware %s\n", XeGuC::kFirmwareName);
+}
+
+void XeService::gucFirmwareLoaded(OSKextRequestTag, OSReturn result, const void* data,
+                                  uint32_t length, void* context) {
+  auto self = (XeService*)context;
+  self->m_gucRequest = kOSKextRequestTagInvalid;
+  if (result != kOSReturnSuccess || !data) {
+    XeLog("XePCI: WARNING - GuC firmware %s unavailable (0x%x)\n", XeGuC::kFirmwareName, result);
+  } else if (self->m_gate) {
+    // data is only valid for the duration of this callback
+    self->m_gate->runAction(&XeService::gatedLoadGuC, (void*)data, &length);
+  }
+  self->release();
+}
+
+IOReturn XeService::gatedLoadGuC(OSObject* owner, void* blob, void* length, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !blob || !length) return kIOReturnBadArgument;
+  if (!self->m_guc.prepare(self->mmio, self->m_ggttSpace, blob, *(uint32_t*)length)) {
+    return kIOReturnInvalid;
+  }
+  IOReturn kr = self->m_guc.upload();
+  if (kr != kIOReturnSuccess) {
+    XeLog("XePCI: WARNING - GuC upload failed (0x%x, GUC_STATUS=0x%08x)\n", kr, self->m_guc.status());
+  }
+  if (kr == kIOReturnSuccess && gXeBoot.gucLogLevel) self->m_guc.setLogVerbosity(gXeBoot.gucLogLevel - 1);
+  // Without a CT channel the log still fills and is still sampled
+  if (self->m_guc.running() && self->m_gucTimer) self->m_gucTimer->setTimeoutMS(XeGuC::kPollMs);
+  return kr;
+}
 
-IOBufferMemoryDescriptor* XeService::boFromCookie(uint64_t cookie) {
-  if (!cookie || !m_boList) return nullptr;
-  uint64_t idx = cookie - 1;
-  if (idx >= m_boList->getCount()) return nullptr;
-  return OSDynamicCast(IOBufferMemoryDescriptor, m_boList->getObject((unsigned)idx));
+// Both buffers are created once and only freed in stop(); the gate keeps
+// that from racing with a client mapping them.
+IOReturn XeService::ucLogMemory(uint32_t type, IOMemoryDescriptor** out) {
+  if (!out) return kIOReturnBadArgument;
+  *out = nullptr;
+  if (!m_gate) return kIOReturnNotReady;
+  return m_gate->runAction(&XeService::gatedLogMemory, &type, out);
+}
+
+IOReturn XeService::gatedLogMemory(OSObject* owner, void* type, void* out, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !type || !out) return kIOReturnBadArgument;
+  IOMemoryDescriptor* md = nullptr;
+  switch (*(uint32_t*)type) {
+    case kXeMemoryLogRelay: md = self->m_relayMem; break;
+    case kXeMemoryGuCLog:   md = self->m_guc.logMemory(); break;
+    default:                return kIOReturnBadArgument;
+  }
+  if (!md) return kIOReturnNotReady;
+  md->retain();
+  *(IOMemoryDescriptor**)out = md;
+  return kIOReturnSuccess;
 }
 
 // ----------------------- UserClient methods ---------------------
 
-IOReturn XeService::ucCreateBuffer(uint32_t bytes, uint64_t* outCookie) {
-  XeLog("XePCI: ucCreateBuffer: requested %u bytes\n", bytes);
+IOReturn XeService::ucCreateBuffer(XeBoTable& bos, XeUserptrCache& userptrs, uint32_t bytes, uint32_t flags,
+                                   uint64_t* outCookie) {
+  XeLog("XePCI: ucCreateBuffer: requested %u bytes (flags 0x%x)\n", bytes, flags);
   
-  if (!m_boList) {
-    XeLog("XePCI: ucCreateBuffer: ERROR - BO list not ready\n");
+  if (!bos.ready()) {
+    XeLog("XePCI: ucCreateBuffer: ERROR - BO table not ready\n");
     return kIOReturnNotReady;
   }
 
-  // Page-align (4 KiB)
-  uint32_t sz = (bytes + 0xFFFu) & ~0xFFFu;
-  XeLog("XePCI: ucCreateBuffer: allocating %u bytes (page-aligned)\n", sz);
-
-  auto *md = IOBufferMemoryDescriptor::withOptions(
-      kIOMemoryKernelUserShared | kIODirectionInOut,
-      sz, page_size);
+  if (bytes == 0 || bytes > XeBoPool::kMaxBytes) {
+    XeLog("XePCI: ucCreateBuffer: ERROR - size %u outside 1..%u\n", bytes, XeBoPool::kMaxBytes);
+    return kIOReturnBadArgument;
+  }
+  if (flags & ~(kBufferFlagLazy | kBufferCacheMask | kBufferFlagScanout)) return kIOReturnBadArgument;
+  uint32_t mode = (flags & kBufferCacheMask) >> kBufferCacheShift;
+  if (mode >= kXeCacheModeCount) return kIOReturnBadArgument;
+  // Pageable memory only comes write-back, and scanout needs it resident
+  if ((flags & kBufferFlagLazy) && (mode != kXeCacheWB || (flags & kBufferFlagScanout))) {
+    return kIOReturnUnsupported;
+  }
+  if (flags & kBufferFlagScanout) {
+    uint64_t cookie = createStolenBuffer(bos, bytes);
+    if (cookie) {
+      *outCookie = cookie;
+      return kIOReturnSuccess;
+    }
+  }
 
+  // Rounded up to whole pages; a recycled BO keeps its GGTT binding.
+  // A reservation only counts against the limits once it gets pages.
+  XeMemAccount* acct = bos.account();
+  bool lazy = (flags & kBufferFlagLazy) != 0;
+  if (!lazy) {
+    IOReturn kr = reserveMemory(acct, &userptrs, XeBoPool::pageBytes(bytes));
+    if (kr != kIOReturnSuccess) return kr;
+  }
+  uint32_t completed[kXeEngineCount];
+  completedSeqnos(completed);
+  uint32_t ggtt = 0;
+  IOBufferMemoryDescriptor* md = lazy ? m_boPool.reserve(bytes, completed, &ggtt, &lazy)
+                                      : m_boPool.acquire(bytes, completed, &ggtt, mode);
   if (!md) {
     XeLog("XePCI: ucCreateBuffer: ERROR - allocation failed\n");
     return kIOReturnNoResources;
   }
+  uint32_t sz = (uint32_t)md->getLength();
 
-  if (!m_boList->setObject(md)) {
-    XeLog("XePCI: ucCreateBuffer: ERROR - failed to add to BO list\n");
+  if (acct && lazy) acct->charge(XeMemAccount::kReserved, sz);
+  else if (acct) acct->chargeBuffer(sz, ggtt != 0);
+  uint64_t cookie = bos.insert(md, md->getBytesNoCopy(), ggtt, acct, lazy, (uint8_t)mode);
+  if (!cookie) {
+    XeLog("XePCI: ucCreateBuffer: ERROR - failed to add to BO table\n");
+    if (acct && lazy) acct->uncharge(XeMemAccount::kReserved, sz);
+    else if (acct) acct->unchargeBuffer(sz, ggtt != 0);
+    uint32_t idle[kXeEngineCount] {};
+    // An unprepared reservation must never reach the pool
+    if (lazy) md->release();
+    else m_boPool.release(md, ggtt, idle, completed, mode);
+    return kIOReturnNoResources;
+  }
+  *outCookie = cookie;
+
+  XeLog("XePCI: ucCreateBuffer: SUCCESS - cookie=0x%llx size=%u %s vaddr=%p%s\n",
+        (unsigned long long)cookie, sz, XeCacheModeName(mode), md->getBytesNoCopy(),
+        lazy ? " (reserved)" : ggtt ? " (recycled)" : "");
+
+  return kIOReturnSuccess;
+}
+
+// A scanout BO in stolen memory: contiguous, bound for life and written
+// through the WC aperture, so it never needs its lines flushed. It costs
+// no system RAM, so nothing is charged. 0 (use system RAM) when stolen
+// memory is absent or has no room.
+uint64_t XeService::createStolenBuffer(XeBoTable& bos, uint32_t bytes) {
+  if (!m_stolen.ready()) return 0;
+  uint32_t completed[kXeEngineCount];
+  completedSeqnos(completed);
+  m_stolen.reap(completed);
+
+  uint32_t sz = (bytes + XeStolen::kPageBytes - 1) & ~(XeStolen::kPageBytes - 1);
+  uint32_t offset = 0;
+  if (!m_stolen.alloc(sz, XeStolen::kScanoutAlign, &offset)) {
+    XeLog("XePCI: ucCreateBuffer: stolen memory full, scanout BO of %u bytes goes to system RAM\n", sz);
+    return 0;
+  }
+  IOMemoryDescriptor* md = m_stolen.describe(offset, sz);
+  if (!md) {
+    m_stolen.free(offset, sz);
+    return 0;
+  }
+  bzero(m_stolen.cpu(offset), sz);
+  XeFlushFence();
+
+  // Published already marked stolen: a lookup or destroy racing this
+  // must never hand the descriptor to the BO pool
+  uint64_t cookie = bos.insert(md, m_stolen.cpu(offset), m_stolen.ggtt(offset), nullptr, false, kXeCacheWC, true);
+  if (!cookie) {
     md->release();
+    m_stolen.free(offset, sz);
+    return 0;
+  }
+  __atomic_add_fetch(&m_stolenBufferBytes, sz, __ATOMIC_RELAXED);
+  XeLog("XePCI: ucCreateBuffer: SUCCESS - cookie=0x%llx size=%u stolen+0x%x ggtt=0x%08x\n",
+        (unsigned long long)cookie, sz, offset, m_stolen.ggtt(offset));
+  return cookie;
+}
+
+IOReturn XeService::ucDestroyBuffer(XeBoTable& bos, uint64_t cookie) {
+  if (!m_gate || !bos.ready()) return kIOReturnNotReady;
+  // Under the gate: a submit may be looking the cookie up right now
+  IOReturn kr = m_gate->runAction(&XeService::gatedBufferOp, &bos, (void*)kBufferOpDestroy, &cookie);
+  XeLog("XePCI: ucDestroyBuffer: cookie=0x%llx result=0x%x\n", (unsigned long long)cookie, kr);
+  return kr;
+}
+
+IOReturn XeService::ucExportBuffer(XeBoTable& bos, uint64_t cookie, uint64_t* outName) {
+  if (!m_gate || !bos.ready() || !outName) return kIOReturnNotReady;
+  *outName = cookie;
+  IOReturn kr = m_gate->runAction(&XeService::gatedBufferOp, &bos, (void*)kBufferOpExport, outName);
+  XeLog("XePCI: ucExportBuffer: cookie=0x%llx name=0x%llx result=0x%x\n",
+        (unsigned long long)cookie, (unsigned long long)*outName, kr);
+  return kr;
+}
+
+IOReturn XeService::ucImportBuffer(XeBoTable& bos, uint64_t name, uint64_t* outCookie) {
+  if (!m_gate || !bos.ready() || !outCookie) return kIOReturnNotReady;
+  *outCookie = name;
+  IOReturn kr = m_gate->runAction(&XeService::gatedBufferOp, &bos, (void*)kBufferOpImport, outCookie);
+  XeLog("XePCI: ucImportBuffer: name=0x%llx cookie=0x%llx result=0x%x\n",
+        (unsigned long long)name, (unsigned long long)*outCookie, kr);
+  return kr;
+}
+
+IOReturn XeService::ucBufferMemory(XeBoTable& bos, uint32_t type, IOMemoryDescriptor** out) {
+  if (!out) return kIOReturnBadArgument;
+  *out = nullptr;
+  if (!m_gate || !bos.ready()) return kIOReturnNotReady;
+  // Under the gate so a concurrent destroy cannot recycle the BO between
+  // the lookup and the retain
+  return m_gate->runAction(&XeService::gatedBufferMemory, &bos, &type, out);
+}
+
+IOReturn XeService::gatedBufferMemory(OSObject* owner, void* bos, void* type, void* out, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !bos || !type || !out) return kIOReturnBadArgument;
+  uint32_t t = *(uint32_t*)type;
+  XeBoTable::Entry* bo = ((XeBoTable*)bos)->lookupSlot(t & 0xFFFFu, (t >> 16) & 0x7FFFu, 15);
+  if (!bo) return kIOReturnBadArgument;
+  if (!self->materializeBuffer(bo)) return kIOReturnNoMemory;
+  // The client can now write it at any time: copy and validate it on every submit
+  bo->mapped = true;
+  bo->md->retain();
+  *(IOMemoryDescriptor**)out = bo->md;
+  return kIOReturnSuccess;
+}
+
+IOReturn XeService::ucImportUserptr(XeBoTable& bos, XeUserptrCache& userptrs, task_t task, uint64_t addr,
+                                    uint64_t bytes, uint64_t* outCookie) {
+  if (!outCookie) return kIOReturnBadArgument;
+  if (!m_gate || !bos.ready()) return kIOReturnNotReady;
+  if (!addr || (addr & PAGE_MASK) || !bytes || (bytes & PAGE_MASK) || bytes > XeBoPool::kMaxBytes) {
+    XeLog("XePCI: ucImportUserptr: ERROR - range 0x%llx+%llu not page aligned or too large\n",
+          (unsigned long long)addr, (unsigned long long)bytes);
+    return kIOReturnBadArgument;
+  }
+
+  // A cached range costs one trip through the gate
+  UserptrArgs args = { &bos, &userptrs, addr, bytes, nullptr, nullptr, 0 };
+  IOReturn kr = m_gate->runAction(&XeService::gatedImportUserptr, &args);
+  if (kr == kIOReturnNotFound) {
+    kr = reserveMemory(bos.account(), &userptrs, bytes);
+    if (kr != kIOReturnSuccess) return kr;
+    // Pinning may fault pages in, so it happens outside the gate
+    IOMemoryDescriptor* md = IOMemoryDescriptor::withAddressRange(addr, bytes, kIODirectionInOut, task);
+    if (!md) return kIOReturnNoResources;
+    kr = md->prepare();
+    if (kr != kIOReturnSuccess) {
+      XeLog("XePCI: ucImportUserptr: ERROR - prepare failed (0x%x)\n", kr);
+      md->release();
+      return kr;
+    }
+    IOMemoryMap* map = md->createMappingInTask(kernel_task, 0, kIOMapAnywhere);
+    if (!map) {
+      md->complete();
+      md->release();
+      return kIOReturnNoResources;
+    }
+    args.md = md;
+    args.map = map;
+    kr = m_gate->runAction(&XeService::gatedImportUserptr, &args);
+    if (args.md) {
+      // Not taken: failed, or another thread imported the range first
+      map->release();
+      md->complete();
+      md->release();
+    }
+  }
+  if (kr == kIOReturnSuccess) *outCookie = args.cookie;
+  XeLog("XePCI: ucImportUserptr: 0x%llx+%llu cookie=0x%llx result=0x%x\n", (unsigned long long)addr,
+        (unsigned long long)bytes, (unsigned long long)args.cookie, kr);
+  return kr;
+}
+
+// kIOReturnNotFound: not cached and args->md not supplied yet. Clears
+// args->md once the cache has taken it over.
+IOReturn XeService::gatedImportUserptr(OSObject* owner, void* args, void*, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  auto a = (UserptrArgs*)args;
+  if (!self || !a) return kIOReturnBadArgument;
+  // The client is closing: nothing may be pinned for it any more
+  if (a->bos->closed()) return kIOReturnNotReady;
+
+  XeUserptrCache::Record* r = a->userptrs->find(a->addr, a->bytes);
+  if (!r) {
+    if (!a->md) return kIOReturnNotFound;
+    uint32_t ggtt = self->bindMemory(a->md);
+    if (!ggtt) return kIOReturnNoResources;
+    uint32_t completed[kXeEngineCount];
+    self->completedSeqnos(completed);
+    r = a->userptrs->add(a->addr, a->bytes, a->md, a->map, ggtt, completed, self->m_boPool);
+    if (!r) {
+      self->m_boPool.releaseGgtt(ggtt, (uint32_t)a->bytes);
+      return kIOReturnNoResources;
+    }
+    a->md = nullptr;
+    a->map = nullptr;
+  }
+
+  r->md->retain();
+  uint64_t cookie = a->bos->insert(r->md, (void*)r->map->getVirtualAddress(), r->ggtt);
+  if (!cookie) {
+    r->md->release();
     return kIOReturnNoResources;
   }
+  a->bos->lookup(cookie)->userptr = a->userptrs;
+  r->handles++;
+  a->cookie = cookie;
+  return kIOReturnSuccess;
+}
 
-  uint64_t cookie = m_boList->getCount(); // 1..N
-  *outCookie = cookie;
+IOReturn XeService::ucCreateSubBuffer(XeBoTable& bos, XeSubAllocator& subs, uint32_t bytes,
+                                      uint64_t* outCookie, uint32_t* outOffset) {
+  if (!outCookie || !outOffset) return kIOReturnBadArgument;
+  if (!m_gate || !bos.ready()) return kIOReturnNotReady;
+  if (bytes == 0 || bytes > XeSlabHeap::kMaxChunk) return kIOReturnBadArgument;
+  // Checked per chunk although charged per slab: at most 64K over a limit
+  IOReturn kr = reserveMemory(bos.account(), nullptr, XeSlabHeap::chunkBytes(XeSlabHeap::classOf(bytes)));
+  if (kr != kIOReturnSuccess) return kr;
+  // Under the gate: a new slab is bound into the GGTT
+  SubBufferArgs args = { &bos, &subs, bytes, 0, 0 };
+  kr = m_gate->runAction(&XeService::gatedCreateSubBuffer, &args);
+  if (kr == kIOReturnSuccess) {
+    *outCookie = args.cookie;
+    *outOffset = args.offset;
+  }
+  return kr;
+}
+
+IOReturn XeService::gatedCreateSubBuffer(OSObject* owner, void* args, void*, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  auto a = (SubBufferArgs*)args;
+  if (!self || !a) return kIOReturnBadArgument;
+  // The client is closing: its slabs are already released
+  if (a->bos->closed()) return kIOReturnNotReady;
+
+  uint32_t completed[kXeEngineCount];
+  self->completedSeqnos(completed);
+  XeSubAllocator::Chunk chunk;
+  IOReturn kr = a->subs->alloc(a->bytes, completed, self->m_boPool, self->mmio, &chunk);
+  if (kr != kIOReturnSuccess) return kr;
+
+  chunk.md->retain();
+  uint64_t cookie = a->bos->insert(chunk.md, chunk.cpu, chunk.ggtt);
+  if (!cookie) {
+    chunk.md->release();
+    uint32_t idle[kXeEngineCount] {};
+    a->subs->free(chunk.md, chunk.offset, idle, completed, self->m_boPool);
+    return kIOReturnNoResources;
+  }
+  XeBoTable::Entry* bo = a->bos->lookup(cookie);
+  bo->bytes = chunk.bytes;
+  bo->offset = chunk.offset;
+  bo->sub = a->subs;
+  a->cookie = cookie;
+  a->offset = chunk.offset;
+  return kIOReturnSuccess;
+}
+
+// The ranges are recorded and the dirty set taken under the gate; the
+// write-back runs outside it, so flushing a whole 16 MB surface (256K
+// lines) never holds up submission. The retained md keeps the BO's memory
+// in place meanwhile.
+IOReturn XeService::ucFlushBuffer(XeBoTable& bos, uint64_t cookie, uint32_t flags, const uint64_t* ranges,
+                                  uint32_t count, uint64_t* outLines) {
+  if (!outLines || (count && !ranges) || count > kFlushMaxRanges) return kIOReturnBadArgument;
+  if (flags & ~kFlushFlagDefer) return kIOReturnBadArgument;
+  if (!m_gate || !bos.ready()) return kIOReturnNotReady;
+  *outLines = 0;
+  FlushArgs args = { &bos, cookie, ranges, count, !(flags & kFlushFlagDefer), nullptr, nullptr, 0, {} };
+  IOReturn kr = m_gate->runAction(&XeService::gatedFlushBuffer, &args);
+  if (kr != kIOReturnSuccess || !args.md) return kr;
+
+  uint32_t lines = 0;
+  if (args.mode == kXeCacheWB) {
+    for (uint32_t i = 0; i < args.dirty.count; ++i) {
+      const XeDirtyRanges::Range& r = args.dirty.range[i];
+      lines += XeClflushLines(args.cpu + r.start, r.end - r.start);
+    }
+  }
+  // One fence for the whole batch; for a WC BO it drains the combining buffers
+  XeFlushFence();
+  args.md->release();
+
+  __atomic_add_fetch(&m_flushes, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&m_flushedLines, lines, __ATOMIC_RELAXED);
+  __atomic_store_n(&m_lastFlushLines, lines, __ATOMIC_RELAXED);
+  *outLines = lines;
+  return kIOReturnSuccess;
+}
+
+IOReturn XeService::gatedFlushBuffer(OSObject* owner, void* args, void*, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  auto a = (FlushArgs*)args;
+  if (!self || !a) return kIOReturnBadArgument;
+  XeBoTable::Entry* bo = a->bos->lookup(a->cookie);
+  if (!bo) return kIOReturnBadArgument;
+  // A reservation has no pages yet, so nothing can have written it
+  if (bo->lazy) return kIOReturnSuccess;
+
+  if (bo->cacheMode == kXeCacheWB && a->count) {
+    if (!bo->dirty) {
+      bo->dirty = (XeDirtyRanges*)IOMalloc(sizeof(XeDirtyRanges));
+      if (!bo->dirty) return kIOReturnNoMemory;
+      bzero(bo->dirty, sizeof(XeDirtyRanges));
+    }
+    for (uint32_t i = 0; i < a->count; ++i) {
+      bo->dirty->add((uint32_t)(a->ranges[i] >> 32), (uint32_t)a->ranges[i], bo->bytes);
+    }
+  }
+  if (!a->flush) return kIOReturnSuccess;
+  if (bo->dirty) {
+    a->dirty = *bo->dirty;
+    bo->dirty->clear();
+  }
+  bo->md->retain();
+  a->md = bo->md;
+  a->cpu = (uint8_t*)bo->cpu;
+  a->mode = bo->cacheMode;
+  return kIOReturnSuccess;
+}
+
+IOReturn XeService::ucMadvise(XeBoTable& bos, uint64_t cookie, uint32_t advice, uint64_t* outRetained) {
+  if (!outRetained || advice > kMadviseDontNeed) return kIOReturnBadArgument;
+  if (!m_gate || !bos.ready()) return kIOReturnNotReady;
+  *outRetained = 0;
+  return m_gate->runAction(&XeService::gatedMadvise, &bos, &cookie, &advice, outRetained);
+}
 
-  XeLog("XePCI: ucCreateBuffer: SUCCESS - cookie=%llu size=%u vaddr=%p\n",
-        (unsigned long long)cookie, sz, md->getBytesNoCopy());
+IOReturn XeService::gatedMadvise(OSObject* owner, void* bos, void* cookie, void* advice, void* outRetained) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !bos || !cookie || !advice || !outRetained) return kIOReturnBadArgument;
+  auto table = (XeBoTable*)bos;
+  XeBoTable::Entry* bo = table->lookup(*(uint64_t*)cookie);
+  if (!bo) return kIOReturnBadArgument;
+  // Shared and imported pages have other users, and only WB memory can
+  // come back as a pageable reservation
+  if (bo->userptr || bo->sub || bo->exportName || bo->cacheMode != kXeCacheWB) return kIOReturnUnsupported;
+
+  bool dontNeed = *(uint32_t*)advice == kMadviseDontNeed;
+  *(uint64_t*)outRetained = !bo->purged;
+  if (!dontNeed) bo->purged = false;
+  if (bo->purgeable != dontNeed) {
+    table->setPurgeable(bo, dontNeed);
+    if (dontNeed) self->m_purgeableBOs++;
+    else self->m_purgeableBOs--;
+  }
+  if (dontNeed && !table->purgeListed) {
+    table->purgeNext = self->m_purgeTables;
+    table->purgeListed = true;
+    self->m_purgeTables = table;
+  }
+  return kIOReturnSuccess;
+}
+
+// Client teardown: every BO the client still holds goes back in one pass,
+// then its imported ranges are unpinned and its slabs returned
+void XeService::releaseClientBuffers(XeBoTable& bos, XeUserptrCache& userptrs, XeSubAllocator& subs) {
+  if (!m_gate || !bos.ready()) return;
+  XeMemAccount* acct = bos.account();
+  if (acct && bos.count()) {
+    XeLog("XePCI: releaseClientBuffers: client left %u BOs (allocated=%llu pinned=%llu bound=%llu)\n",
+          bos.count(), (unsigned long long)acct->get(XeMemAccount::kAllocated),
+          (unsigned long long)acct->get(XeMemAccount::kPinned),
+          (unsigned long long)acct->get(XeMemAccount::kBound));
+  }
+  uint64_t drained = 0;
+  m_gate->runAction(&XeService::gatedBufferOp, &bos, (void*)kBufferOpDrain, &drained);
+  if (drained) XeLog("XePCI: releaseClientBuffers: released %llu buffer objects\n", (unsigned long long)drained);
+  m_gate->runAction(&XeService::gatedReleaseClientMemory, &userptrs, &subs);
+  // Whatever is still charged now outlives the client (e.g. a slab with a
+  // chunk entry that never drained) and stays in the global counters
+  if (acct && acct->footprint()) {
+    XeLog("XePCI: releaseClientBuffers: WARNING - %llu bytes still charged after close\n",
+          (unsigned long long)acct->footprint());
+  }
+}
+
+// Bytes by which an allocation of bytes for acct would end up over a
+// limit (0: fits). The soft limit only counts when soft is set and there
+// is pooled or purgeable memory to reclaim; past it with neither,
+// allocations stay off the gate.
+uint64_t XeService::memoryExcess(const XeMemAccount* acct, uint64_t bytes, bool soft) const {
+  uint64_t excess = 0;
+  uint64_t pooled = m_boPool.pooledBytes();
+  uint64_t global = m_mem.footprint() + pooled + bytes;
+  bool reclaimable = pooled || __atomic_load_n(&m_purgeableBOs, __ATOMIC_RELAXED);
+  if (soft && reclaimable && m_memSoft && global > m_memSoft) excess = global - m_memSoft;
+  if (m_memHard && global > m_memHard && global - m_memHard > excess) excess = global - m_memHard;
+  if (acct && m_clientMemHard) {
+    uint64_t own = acct->footprint() + bytes;
+    if (own > m_clientMemHard && own - m_clientMemHard > excess) excess = own - m_clientMemHard;
+  }
+  return excess;
+}
+
+// Below every limit this is a few counter loads and no gate. Limits are
+// checked, not reserved: concurrent allocations may overshoot by one each.
+IOReturn XeService::reserveMemory(XeMemAccount* acct, XeUserptrCache* userptrs, uint64_t bytes) {
+  if (!memoryExcess(acct, bytes, true)) return kIOReturnSuccess;
+  if (!m_gate) return kIOReturnNotReady;
+  return m_gate->runAction(&XeService::gatedReclaimMemory, acct, userptrs, &bytes);
+}
+
+// Pool first (cached BOs belong to no one), then BOs their clients
+// advised DONTNEED, then the caller's own idle userptrs. Over the soft
+// limit only the first two matter; at a hard limit the allocation fails
+// if reclaiming could not get under it.
+IOReturn XeService::gatedReclaimMemory(OSObject* owner, void* account, void* userptrs, void* bytes, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !bytes) return kIOReturnBadArgument;
+  auto acct = (XeMemAccount*)account;
+  uint64_t need = *(uint64_t*)bytes;
+  uint32_t completed[kXeEngineCount];
+  self->completedSeqnos(completed);
+
+  uint64_t excess = self->memoryExcess(nullptr, need, true);
+  if (excess) self->m_memTrimmed += self->m_boPool.trim(excess, completed);
+  excess = self->memoryExcess(acct, need, true);
+  if (excess) self->purgeBuffers(acct, excess, completed);
+  excess = self->memoryExcess(acct, need, false);
+  if (excess && userptrs) {
+    self->m_memEvicted += ((XeUserptrCache*)userptrs)->reclaim(excess, completed, self->m_boPool);
+    excess = self->memoryExcess(acct, need, false);
+  }
+  if (!excess) return kIOReturnSuccess;
+  self->m_memFailures++;
+  XeLog("XePCI: gatedReclaimMemory: ERROR - %llu bytes would be %llu over a hard limit (client footprint=%llu global=%llu)\n",
+        (unsigned long long)need, (unsigned long long)excess,
+        (unsigned long long)(acct ? acct->footprint() : 0), (unsigned long long)self->m_mem.footprint());
+  return kIOReturnNoMemory;
+}
+
+// Runs on the work loop. The caller's own DONTNEED BOs go first, since
+// only they help against its per-client limit, then everyone else's.
+uint64_t XeService::purgeBuffers(const XeMemAccount* acct, uint64_t bytes, const uint32_t completed[kXeEngineCount]) {
+  PurgeWalk walk = { this, completed, bytes, 0 };
+  for (int pass = 0; pass < 2 && walk.freed < bytes; ++pass) {
+    for (XeBoTable* t = m_purgeTables; t && walk.freed < bytes; t = t->purgeNext) {
+      if ((t->account() == acct) == (pass == 0)) t->forEachPurgeable(&XeService::purgeVisit, &walk);
+    }
+  }
+  if (walk.freed) {
+    XeLog("XePCI: purgeBuffers: dropped %llu bytes of DONTNEED BOs (wanted %llu)\n",
+          (unsigned long long)walk.freed, (unsigned long long)bytes);
+  }
+  return walk.freed;
+}
+
+bool XeService::purgeVisit(void* walk, XeBoTable::Entry* e) {
+  auto w = (PurgeWalk*)walk;
+  uint64_t len = e->md->getLength();
+  if (w->self->purgeBuffer(e, w->completed)) w->freed += len;
+  return w->freed < w->want;
+}
+
+// Runs on the work loop. Swaps a DONTNEED BO's pages for a fresh
+// reservation of the same size, as if it had been created lazy: the cookie
+// stays valid and the next map, bind or submit backs it with zeroed pages.
+// Not while the GPU may still read it, a user mapping holds its pages or
+// another client shares it.
+bool XeService::purgeBuffer(XeBoTable::Entry* bo, const uint32_t completed[kXeEngineCount]) {
+  if (bo->lazy || bo->exportName || !m_boPool.unmapped(bo->md)) return false;
+  for (uint32_t e = 0; e < kXeEngineCount; ++e) {
+    if ((int32_t)(completed[e] - bo->busy[e]) < 0) return false;
+  }
+  uint32_t len = (uint32_t)bo->md->getLength();
+  IOBufferMemoryDescriptor* fresh = m_boPool.reservation(len);
+  if (!fresh) return false;
+
+  if (bo->account) {
+    bo->account->unchargeBuffer(len, bo->ggtt != 0);
+    bo->account->charge(XeMemAccount::kReserved, len);
+  }
+  if (bo->ggtt) m_boPool.releaseGgtt(bo->ggtt, len);
+  if (bo->dirty) IOFree(bo->dirty, sizeof(XeDirtyRanges));
+  IOMemoryDescriptor* old = bo->md;
+  bo->ggtt = 0;
+  bo->dirty = nullptr;
+  bo->cpu = fresh->getBytesNoCopy();
+  bo->lazy = true;
+  bo->purged = true;
+  bo->mapped = false;
+  bo->generation = XeBoTable::freshGeneration();
+  __atomic_store_n(&bo->md, (IOMemoryDescriptor*)fresh, __ATOMIC_RELEASE);
+  old->release();
+  m_memPurged += len;
+  return true;
+}
+
+void XeService::unlistPurgeable(XeBoTable* bos) {
+  if (!bos->purgeListed) return;
+  for (XeBoTable** p = &m_purgeTables; *p; p = &(*p)->purgeNext) {
+    if (*p == bos) {
+      *p = bos->purgeNext;
+      break;
+    }
+  }
+  bos->purgeNext = nullptr;
+  bos->purgeListed = false;
+}
+
+IOReturn XeService::gatedReleaseClientMemory(OSObject* owner, void* userptrs, void* subs, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !userptrs || !subs) return kIOReturnBadArgument;
+  uint32_t completed[kXeEngineCount];
+  self->completedSeqnos(completed);
+  ((XeUserptrCache*)userptrs)->destroy(completed, self->m_boPool);
+  ((XeSubAllocator*)subs)->destroy(completed, self->m_boPool);
+  return kIOReturnSuccess;
+}
+
+// inout: cookie in, export name / imported cookie out; drain: count out
+IOReturn XeService::gatedBufferOp(OSObject* owner, void* bos, void* op, void* inout, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !bos || !inout) return kIOReturnBadArgument;
+  auto table = (XeBoTable*)bos;
+  uint64_t* value = (uint64_t*)inout;
+
+  switch ((uintptr_t)op) {
+  case kBufferOpDestroy: {
+    XeBoTable::Entry bo;
+    if (!table->remove(*value, &bo)) return kIOReturnBadArgument;
+    self->dropBuffer(bo);
+    return kIOReturnSuccess;
+  }
+  case kBufferOpExport:
+    return self->exportBufferGated(*table, value);
+  case kBufferOpImport: {
+    XeBoTable::Entry* x = self->m_exports.lookup(*value);
+    if (!x) return kIOReturnNotFound;
+    x->md->retain();
+    uint64_t cookie = table->insert(x->md, x->cpu, x->ggtt, nullptr, false, x->cacheMode, x->stolen);
+    if (!cookie) {
+      x->md->release();
+      return kIOReturnNoResources;
+    }
+    table->lookup(cookie)->exportName = *value;
+    x->holders++;
+    *value = cookie;
+    return kIOReturnSuccess;
+  }
+  case kBufferOpDrain:
+    *value = table->drain(&XeService::drainBuffer, self);
+    self->unlistPurgeable(table);
+    return kIOReturnSuccess;
+  }
+  return kIOReturnBadArgument;
+}
 
+// Runs on the work loop. The export record holds its own reference and
+// the one GGTT binding every holder submits through, so a shared BO is
+// bound before it is published.
+IOReturn XeService::exportBufferGated(XeBoTable& bos, uint64_t* inoutName) {
+  XeBoTable::Entry* bo = bos.lookup(*inoutName);
+  if (!bo) return kIOReturnBadArgument;
+  if (bo->exportName) {
+    *inoutName = bo->exportName;
+    return kIOReturnSuccess;
+  }
+  // An address range only means something in its own task, and a chunk
+  // shares its slab with the client's other small BOs
+  if (bo->userptr || bo->sub) return kIOReturnUnsupported;
+  if (!bindBuffer(bo)) return kIOReturnNoResources;
+  bo->md->retain();
+  uint64_t name = m_exports.insert(bo->md, bo->cpu, bo->ggtt, nullptr, false, bo->cacheMode, bo->stolen);
+  if (!name) {
+    bo->md->release();
+    return kIOReturnNoResources;
+  }
+  XeBoTable::Entry* x = m_exports.lookup(name);
+  for (uint32_t e = 0; e < kXeEngineCount; ++e) x->busy[e] = bo->busy[e];
+  x->holders = 1;
+  bo->exportName = name;
+  *inoutName = name;
   return kIOReturnSuccess;
 }
 
-IOReturn XeService::ucSubmitNoop() {
-  XeLog("XePCI: ucSubmitNoop: starting\n");
+void XeService::drainBuffer(void* ctx, const XeBoTable::Entry& e) {
+  static_cast<XeService*>(ctx)->dropBuffer(e);
+}
+
+// Runs on the work loop. A private BO goes back to the pool and is
+// reused only once the engines it was submitted to have passed e.busy. A
+// shared one only drops its reference; the last holder recycles it. A
+// userptr stays pinned in its client's cache. The creator's charge goes
+// with its handle; a shared BO it leaves behind is charged globally.
+void XeService::dropBuffer(const XeBoTable::Entry& e) {
+  uint32_t completed[kXeEngineCount];
+  completedSeqnos(completed);
+  if (e.dirty) IOFree(e.dirty, sizeof(XeDirtyRanges));
+  if (e.purgeable) m_purgeableBOs--;
+  if (e.sub) {
+    e.md->release();
+    e.sub->free(e.md, e.offset, e.busy, completed, m_boPool);
+    return;
+  }
+  if (e.userptr) {
+    e.userptr->put(e.md, e.busy);
+    e.md->release();
+    e.userptr->trim(completed, m_boPool);
+    return;
+  }
+  uint64_t len = e.md->getLength();
+  if (e.lazy) {
+    // Never backed, so never bound or shared either
+    if (e.account) e.account->uncharge(XeMemAccount::kReserved, len);
+    e.md->release();
+    return;
+  }
+  if (e.account) e.account->unchargeBuffer(len, e.ggtt != 0);
+  if (!e.exportName) {
+    if (e.stolen) retireStolen(e, completed);
+    else m_boPool.release(OSDynamicCast(IOBufferMemoryDescriptor, e.md), e.ggtt, e.busy, completed, e.cacheMode);
+    return;
+  }
+  e.md->release();
+  XeBoTable::Entry* x = m_exports.lookup(e.exportName);
+  if (!x) return;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if ((int32_t)(e.busy[i] - x->busy[i]) > 0) x->busy[i] = e.busy[i];
+  }
+  if (--x->holders) {
+    if (e.account && !x->account) {
+      x->account = &m_mem;
+      m_mem.chargeBuffer(len, x->ggtt != 0);
+    }
+    return;
+  }
+  XeBoTable::Entry last;
+  if (m_exports.remove(e.exportName, &last)) {
+    if (last.account) last.account->unchargeBuffer(len, last.ggtt != 0);
+    if (last.stolen) {
+      retireStolen(last, completed);
+      return;
+    }
+    m_boPool.release(OSDynamicCast(IOBufferMemoryDescriptor, last.md), last.ggtt, last.busy, completed,
+                     last.cacheMode);
+  }
+}
+
+// A stolen BO's range comes back once the engines and every mapping are
+// done with it; its PTEs stay, they are part of the stolen window
+void XeService::retireStolen(const XeBoTable::Entry& e, const uint32_t completed[kXeEngineCount]) {
+  uint32_t sz = (uint32_t)e.md->getLength();
+  __atomic_sub_fetch(&m_stolenBufferBytes, sz, __ATOMIC_RELAXED);
+  m_stolen.retire(e.md, m_stolen.offsetOf(e.ggtt), sz, e.busy, completed);
+}
+
+// Runs on the work loop; binds a BO into the GGTT on first use
+bool XeService::bindBuffer(XeBoTable::Entry* bo) {
+  if (!materializeBuffer(bo)) return false;
+  if (bo->ggtt) return true;
+  bo->ggtt = bindMemory(bo->md);
+  if (bo->ggtt && bo->account) bo->account->charge(XeMemAccount::kBound, bo->md->getLength());
+  return bo->ggtt != 0;
+}
+
+// Runs on the work loop. Gives a lazy BO its pages: prepare() wires the
+// pageable buffer, zero-filling pages the client never touched. This is
+// where its size starts to count against the memory limits.
+bool XeService::materializeBuffer(XeBoTable::Entry* bo) {
+  if (!bo->lazy) return true;
+  uint64_t bytes = bo->md->getLength();
+  if (memoryExcess(bo->account, bytes, true) &&
+      gatedReclaimMemory(this, bo->account, nullptr, &bytes, nullptr) != kIOReturnSuccess) {
+    return false;
+  }
+  IOReturn kr = bo->md->prepare();
+  if (kr != kIOReturnSuccess) {
+    XeLog("XePCI: materializeBuffer: ERROR - prepare failed (0x%x, %llu bytes)\n", kr, (unsigned long long)bytes);
+    return false;
+  }
+  if (bo->account) {
+    bo->account->uncharge(XeMemAccount::kReserved, bytes);
+    bo->account->charge(XeMemAccount::kAllocated, bytes);
+  }
+  bo->lazy = false;
+  m_memMaterialized += bytes;
+  return true;
+}
+
+// Runs on the work loop. The range covers the descriptor's pages and no
+// more; the pool's holes recycle ranges of the same size.
+uint32_t XeService::bindMemory(IOMemoryDescriptor* md) {
+  uint32_t bytes = XeBoPool::pageBytes((uint32_t)md->getLength());
+  uint32_t ggtt = m_boPool.allocGgtt(bytes);
+  if (!ggtt || !XeGGTT::insertPages(mmio, ggtt, md)) {
+    XeLog("XePCI: bindMemory: ERROR - GGTT bind failed (%u bytes)\n", bytes);
+    // Clears whatever PTEs were written and keeps the range for the next bind
+    m_boPool.releaseGgtt(ggtt, bytes);
+    return 0;
+  }
+  XeLog("XePCI: bindMemory: bound at GGTT 0x%08x\n", ggtt);
+  return ggtt;
+}
+
+void XeService::completedSeqnos(uint32_t out[kXeEngineCount]) {
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) out[i] = m_cs[i].completedSeqno();
+}
+
+IOReturn XeService::ucSubmitNoop(XeLogicalContext* contexts[kXeEngineCount], uint32_t engine, uint32_t flags,
+                                 uint32_t* outSeqno) {
+  XeLog("XePCI: ucSubmitNoop: starting (engine=%u flags=0x%x)\n", engine, flags);
   
-  if (!mmio) {
+  if (!outSeqno) return kIOReturnBadArgument;
+  *outSeqno = 0;
+  if (!mmio || !m_gate) {
     XeLog("XePCI: ucSubmitNoop: ERROR - mmio not ready\n");
     return kIOReturnNotReady;
   }
 
-  // Allocate a tiny 4K batch (kernel-user shared so we can write commands)
-  XeLog("XePCI: ucSubmitNoop: allocating 4K command buffer\n");
-  auto *md = IOBufferMemoryDescriptor::withOptions(
-      kIOMemoryKernelUserShared | kIODirectionInOut, 4096, page_size);
-  if (!md) {
-    XeLog("XePCI: ucSubmitNoop: ERROR - buffer allocation failed\n");
+  if (engine >= kXeEngineCount) {
+    XeLog("XePCI: ucSubmitNoop: ERROR - invalid engine %u\n", engine);
+    return kIOReturnBadArgument;
+  }
+
+  IOReturn kr = m_gate->runAction(&XeService::gatedSubmit, &engine, &flags, contexts, outSeqno);
+  XeLog("XePCI: ucSubmitNoop: result=0x%x seqno=%u\n", kr, *outSeqno);
+  return kr;
+}
+
+IOReturn XeService::gatedSubmit(OSObject* owner, void* engine, void* flags, void* contexts, void* outSeqno) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !engine || !flags || !outSeqno) return kIOReturnBadArgument;
+  uint32_t e = *(uint32_t*)engine;
+  self->clientContext((XeLogicalContext**)contexts, e);
+  return self->submitNoopGated(e, *(uint32_t*)flags, (uint32_t*)outSeqno);
+}
+
+// Runs on the work loop
+IOReturn XeService::submitNoopGated(uint32_t engine, uint32_t flags, uint32_t* outSeqno) {
+  XeCommandStream& cs = m_cs[engine];
+  uint64_t start = mach_absolute_time();
+
+  // Recycled 4K batch; only allocates when every buffer is still in flight
+  XeBatchPool::Buffer* buf = m_batchPool[engine].acquire(cs.completedSeqno());
+  if (!buf) {
+    XeLog("XePCI: ucSubmitNoop: ERROR - no batch buffer available (%u in flight)\n",
+          m_batchPool[engine].inFlight());
     return kIOReturnNoResources;
   }
+  IOBufferMemoryDescriptor* md = buf->md;
 
-  XeCommandStream cs(mmio);
-  XeLog("XePCI: ucSubmitNoop: calling XeCommandStream::submitNoop\n");
-  IOReturn kr = cs.submitNoop(md);
-  
-  XeLog("XePCI: ucSubmitNoop: result=0x%x\n", kr);
-  md->release();
+  bool inFlight = false;
+  IOReturn kr = cs.submitNoop(md, !gXeBoot.verbose);
+  if (kr == kIOReturnSuccess && cs.execlistsEnabled()) {
+    // Emit into the kernel LRC now; the doorbell may be deferred. A bound
+    // pool buffer is chained in place (the pool keeps it alive until the
+    // seqno retires), otherwise the batch is copied inline.
+    // Kernel-built batch: validated every time, nothing to cache against
+    if (buf->ggtt) {
+      XeBatchValidator::Link link = {
+        (const uint32_t*)md->getBytesNoCopy(), XeBatchPool::kBufferBytes / 4, buf->ggtt, 0, 0,
+      };
+      kr = cs.emitChain(&link, 1, nullptr, &m_lastSeqno[engine]);
+    } else {
+      kr = cs.emitExeclist(md, 0, 0, &m_lastSeqno[engine]);
+    }
+    if (kr == kIOReturnSuccess) {
+      m_batchPool[engine].commit(buf, m_lastSeqno[engine]);
+      inFlight = true;
+      *outSeqno = m_lastSeqno[engine];
+      noteEmitted(engine, flags);
+    }
+  }
+  if (!inFlight) m_batchPool[engine].release(buf);
+
+  noteSubmitLatency(engine, start);
   return kr;
 }
 
-IOReturn XeService::ucWait(uint32_t timeoutMs) {
-  XeLog("XePCI: ucWait: timeout=%u ms (stub)\n", timeoutMs);
-  // Stub: pretend completion (will become HWSP poll later)
+IOReturn XeService::ucSubmitBatch(XeBoTable& bos, XeLogicalContext* contexts[kXeEngineCount], uint32_t engine,
+                                  uint32_t flags, const uint64_t* cookies, uint32_t count,
+                                  uint32_t* outSeqno) {
+  XeLog("XePCI: ucSubmitBatch: engine=%u flags=0x%x batches=%u\n", engine, flags, count);
+
+  if (!outSeqno) return kIOReturnBadArgument;
+  *outSeqno = 0;
+  if (!mmio || !m_gate) return kIOReturnNotReady;
+  if (engine >= kXeEngineCount || !cookies || count == 0 || count > XeBatchValidator::kMaxLinks) {
+    XeLog("XePCI: ucSubmitBatch: ERROR - bad arguments\n");
+    return kIOReturnBadArgument;
+  }
+
+  SubmitBatchArgs args = { &bos, contexts, engine, flags, cookies, count, outSeqno };
+  IOReturn kr = m_gate->runAction(&XeService::gatedSubmitBatch, &args);
+  XeLog("XePCI: ucSubmitBatch: result=0x%x seqno=%u\n", kr, *outSeqno);
+  return kr;
+}
+
+IOReturn XeService::gatedSubmitBatch(OSObject* owner, void* args, void*, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  auto a = (const SubmitBatchArgs*)args;
+  if (!self || !a) return kIOReturnBadArgument;
+  self->clientContext(a->contexts, a->engine);
+  return self->submitBatchGated(*a->bos, a->engine, a->flags, a->cookies, a->count, a->outSeqno);
+}
+
+// Runs on the work loop. cookies[0] is the entry batch; the others are
+// only reachable through MI_BATCH_BUFFER_START from it (see
+// XeBatchValidator). Each BO is bound into the GGTT once. A batch nobody
+// can write behind our back runs in place; if any link could change
+// between validation and execution (mapped, userptr, shared or a chunk
+// of a mappable slab) every link is copied into a kernel buffer first,
+// and the copies are what gets validated and run.
+IOReturn XeService::submitBatchGated(XeBoTable& bos, uint32_t engine, uint32_t flags,
+                                     const uint64_t* cookies, uint32_t count, uint32_t* outSeqno) {
+  XeCommandStream& cs = m_cs[engine];
+  if (!cs.execlistsEnabled()) {
+    XeLog("XePCI: ucSubmitBatch: ERROR - %s has no execlist submission\n", cs.engine().name);
+    return kIOReturnUnsupported;
+  }
+  uint64_t start = mach_absolute_time();
+
+  XeBatchValidator::Link links[XeBatchValidator::kMaxLinks];
+  OSObject* refs[XeBatchValidator::kMaxLinks];
+  bool writable = false;
+  for (uint32_t i = 0; i < count; ++i) {
+    XeBoTable::Entry* bo = bos.lookup(cookies[i]);
+    if (!bo) {
+      XeLog("XePCI: ucSubmitBatch: ERROR - bad cookie 0x%llx\n", (unsigned long long)cookies[i]);
+      return kIOReturnBadArgument;
+    }
+    IOMemoryDescriptor* md = bo->md;
+    if (!bindBuffer(bo)) return kIOReturnNoResources;
+    // A mapped BO can change without a generation bump, another client may
+    // write a shared one, a userptr's pages belong to the client, and
+    // mapping any chunk exposes its whole slab: none of those verdicts is
+    // cached, and none of them runs in place
+    bool live = bo->exportName || bo->mapped || bo->sub || bo->userptr;
+    writable |= live;
+    links[i] = XeBatchValidator::Link {
+      (const uint32_t*)bo->cpu, bo->bytes / 4,
+      bo->ggtt, live ? 0 : cookies[i], bo->generation, 0,
+    };
+    refs[i] = md;
+  }
+
+  XeBatchPool::Buffer* copies[XeBatchValidator::kMaxLinks] = {};
+  if (writable) {
+    uint32_t done = cs.completedSeqno();
+    for (uint32_t i = 0; i < count; ++i) {
+      copies[i] = m_copyPool[engine].acquire(done);
+      if (!copies[i]) {
+        XeLog("XePCI: ucSubmitBatch: ERROR - no batch copy buffer (%u in flight)\n",
+              m_copyPool[engine].inFlight());
+        for (uint32_t j = 0; j < i; ++j) m_copyPool[engine].release(copies[j]);
+        return kIOReturnNoResources;
+      }
+      // Only the first kBatchCopyBytes are taken: a batch that does not end
+      // within them is rejected by the validator (no MI_BATCH_BUFFER_END)
+      uint32_t bytes = links[i].count * 4;
+      if (bytes > m_copyPool[engine].bufferBytes()) bytes = m_copyPool[engine].bufferBytes();
+      void* dst = copies[i]->md->getBytesNoCopy();
+      memcpy(dst, links[i].dw, bytes);
+      links[i].dw = (const uint32_t*)dst;
+      links[i].count = bytes / 4;
+      links[i].key = 0;
+      links[i].copyGgtt = copies[i]->ggtt;
+    }
+  }
+
+  IOReturn kr = cs.emitChain(links, count, refs, &m_lastSeqno[engine]);
+  if (kr == kIOReturnSuccess) {
+    // Destroyed BOs are not recycled, nor copies reused, before this seqno retires
+    for (uint32_t i = 0; i < count; ++i) {
+      bos.lookup(cookies[i])->busy[engine] = m_lastSeqno[engine];
+      if (copies[i]) m_copyPool[engine].commit(copies[i], m_lastSeqno[engine]);
+    }
+    *outSeqno = m_lastSeqno[engine];
+    noteEmitted(engine, flags);
+  } else {
+    for (uint32_t i = 0; i < count; ++i) {
+      if (copies[i]) m_copyPool[engine].release(copies[i]);
+    }
+  }
+  noteSubmitLatency(engine, start);
+  return kr;
+}
+
+// A request just landed in the ring: doorbell now or within the window
+void XeService::noteEmitted(uint32_t engine, uint32_t flags) {
+  logEvent(kXeLogSubmit, engine, m_lastSeqno[engine], flags);
+  XeSubmitCoalescer::FlushReason reason;
+  if (m_coalesce[engine].noteSubmit((flags & kSubmitFlagLatencyCritical) != 0, &reason)) {
+    flushEngine(engine, reason);
+  } else if (!m_coalesceArmed) {
+    m_coalesceArmed = true;
+    m_coalesceTimer->setTimeoutUS(m_coalesce[engine].windowUs());
+  }
+  armHangcheck();
+}
+
+void XeService::noteSubmitLatency(uint32_t engine, uint64_t start) {
+  uint64_t elapsedNs = 0;
+  absolutetime_to_nanoseconds(mach_absolute_time() - start, &elapsedNs);
+  uint32_t bucket = 0;
+  for (uint64_t us = elapsedNs / 1000; us && bucket < kSubmitLatencyBuckets - 1; us >>= 1) bucket++;
+  m_submitHist[engine][bucket]++;
+}
+
+// Runs on the work loop. A client only holds a context on the engines it
+// has submitted to, so clients that just map or query take none. Every
+// request still runs on the kernel context, so a client the pool has no
+// context left for shares that one instead of failing; it tries again on
+// its next submit.
+void XeService::clientContext(XeLogicalContext* contexts[kXeEngineCount], uint32_t engine) {
+  if (!contexts || contexts[engine] || !m_cs[engine].execlistsEnabled()) return;
+  contexts[engine] = m_cs[engine].acquireContext();
+  if (!contexts[engine]) {
+    XeLog("XePCI: clientContext: %s out of contexts, using the kernel context\n", kXeEngines[engine].name);
+  }
+}
+
+void XeService::closeClientContexts(XeLogicalContext* contexts[kXeEngineCount]) {
+  if (!m_gate) return;
+  m_gate->runAction(&XeService::gatedCloseContexts, contexts);
+}
+
+IOReturn XeService::gatedCloseContexts(OSObject* owner, void* contexts, void*, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !contexts) return kIOReturnBadArgument;
+  auto ctx = (XeLogicalContext**)contexts;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (ctx[i]) self->m_cs[i].releaseContext(ctx[i]);
+    ctx[i] = nullptr;
+  }
+  return kIOReturnSuccess;
+}
+
+// Ring the doorbell for everything emitted on one engine. A failed kick
+// (ELSP queue full) leaves the work pending for the next flush.
+void XeService::flushEngine(uint32_t engine, XeSubmitCoalescer::FlushReason reason) {
+  if (!m_coalesce[engine].hasPending()) return;
+  uint32_t covered = m_coalesce[engine].pendingSubmits();
+  IOReturn kr = m_cs[engine].kick();
+  if (kr != kIOReturnSuccess) {
+    XeLog("XePCI: flushEngine: %s kick failed (0x%x)\n", kXeEngines[engine].name, kr);
+    return;
+  }
+  m_coalesce[engine].noteFlush(reason);
+  logEvent(kXeLogDoorbell, engine, reason, covered);
+}
+
+// Timestamps are raw mach_absolute_time(); readers convert them
+void XeService::logEvent(uint16_t type, uint32_t engine, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+  m_relay.emit(mach_absolute_time(), type, (uint16_t)engine, arg0, arg1, arg2);
+}
+
+IOReturn XeService::gatedFlush(OSObject* owner, void* reason, void*, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !reason) return kIOReturnBadArgument;
+  auto r = *(XeSubmitCoalescer::FlushReason*)reason;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (self->m_cs[i].execlistsEnabled()) self->flushEngine(i, r);
+  }
+  return kIOReturnSuccess;
+}
+
+// Timer action: runs on the work loop, so it is serialized with submits
+void XeService::coalesceTimerFired(OSObject* owner, IOTimerEventSource*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self) return;
+  self->m_coalesceArmed = false;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    self->flushEngine(i, XeSubmitCoalescer::kFlushWindow);
+  }
+}
+
+void XeService::armHangcheck() {
+  if (m_hangcheckArmed || !m_hangcheckTimer) return;
+  m_hangcheckArmed = true;
+  m_hangcheckTimer->setTimeoutMS(XeHangcheck::kPeriodMs);
+}
+
+// Timer action: one ACTHD + seqno sample per busy engine, re-armed only
+// while work is outstanding so an idle GPU costs nothing. It doubles as the
+// batch pools' idle tick (also under nohangcheck): a pool shrinks back to
+// its floor within two periods of the load going away.
+void XeService::hangcheckTimerFired(OSObject* owner, IOTimerEventSource*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self) return;
+  self->m_hangcheckArmed = false;
+
+  bool rearm = false;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    XeCommandStream& cs = self->m_cs[i];
+    uint32_t done = cs.completedSeqno();
+    if (done != self->m_retired[i]) {
+      self->m_retired[i] = done;
+      self->logEvent(kXeLogRetire, i, done);
+    }
+    if (self->m_batchPool[i].trim(done)) rearm = true;
+    if (self->m_copyPool[i].trim(done)) rearm = true;
+    if (!cs.busy()) {
+      self->m_hangcheck[i].idle();
+      continue;
+    }
+    if (!gXeBoot.disableHangcheck &&
+        self->m_hangcheck[i].sample(cs.activeHead(), cs.completedSeqno())) {
+      self->recoverEngine(i);
+    }
+    if (cs.busy()) rearm = true;
+  }
+  if (rearm) self->armHangcheck();
+}
+
+// Timer action: there is no GuC interrupt yet, so G2H events and the GuC
+// log are serviced here. Runs for as long as the GuC does, so an idle GPU
+// still has its events drained and its log streamed.
+void XeService::gucTimerFired(OSObject* owner, IOTimerEventSource* sender) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !self->m_guc.running()) return;
+  self->m_guc.poll();
+  sender->setTimeoutMS(XeGuC::kPollMs);
+}
+
+// Timer action: armed by the first ucWait sleeper and re-armed until the
+// last one leaves. Processing the CSB also moves queued work onto free
+// ports; waiters are only woken when some seqno actually advanced.
+void XeService::waitTimerFired(OSObject* owner, IOTimerEventSource* sender) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !self->m_waiters) return;
+  bool advanced = false;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    XeCommandStream& cs = self->m_cs[i];
+    if (!cs.execlistsEnabled()) continue;
+    cs.pollSeqno(self->m_lastSeqno[i]);
+    uint32_t done = cs.completedSeqno();
+    if (done != self->m_waitSeen[i]) {
+      self->m_waitSeen[i] = done;
+      advanced = true;
+    }
+  }
+  if (advanced) self->m_gate->commandWakeup(&self->m_waiters);
+  sender->setTimeoutMS(kWaitPollMs);
+}
+
+// Per-engine reset + replay; downtime runs from the hang being declared
+// to the surviving work being back on the hardware.
+void XeService::recoverEngine(uint32_t engine) {
+  XeLog("XePCI: recoverEngine: %s hung, resetting\n", kXeEngines[engine].name);
+  logEvent(kXeLogHang, engine, (uint32_t)m_cs[engine].activeHead(), m_cs[engine].completedSeqno());
+
+  uint64_t start = mach_absolute_time();
+  uint32_t replayed = 0;
+  IOReturn kr = m_cs[engine].resetEngine(&replayed);
+  uint64_t elapsedNs = 0;
+  absolutetime_to_nanoseconds(mach_absolute_time() - start, &elapsedNs);
+
+  m_hangcheck[engine].noteReset(kr == kIOReturnSuccess, replayed, elapsedNs / 1000);
+  logEvent(kXeLogReset, engine, kr, replayed, (uint32_t)(elapsedNs / 1000));
+  // The guilty request now reads as complete; its waiter reports the reset
+  if (m_waiters) m_gate->commandWakeup(&m_waiters);
+  if (kr != kIOReturnSuccess) {
+    XeLog("XePCI: recoverEngine: ERROR - %s reset failed (0x%x), engine wedged\n",
+          kXeEngines[engine].name, kr);
+    return;
+  }
+  XeLog("XePCI: recoverEngine: %s back after %llu us, %u request(s) replayed\n",
+        kXeEngines[engine].name, (unsigned long long)(elapsedNs / 1000), replayed);
+}
+
+IOReturn XeService::ucWait(uint32_t engine, uint32_t seqno, uint32_t timeoutMs) {
+  XeLog("XePCI: ucWait: engine=%u seqno=%u timeout=%u ms\n", engine, seqno, timeoutMs);
+  if (engine > kXeEngineCount) return kIOReturnBadArgument;
+
+  bool anyEngine = false;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (m_cs[i].execlistsEnabled()) anyEngine = true;
+  }
+  if (!anyEngine || !m_gate) {
+    XeLog("XePCI: ucWait: timeout=%u ms (stub)\n", timeoutMs);
+    // Stub: pretend completion (legacy ring is not programmed)
+    return kIOReturnSuccess;
+  }
+
+  WaitArgs w = { seqno ? engine : kXeEngineCount, seqno, timeoutMs };
+  return m_gate->runAction(&XeService::gatedWait, &w);
+}
+
+IOReturn XeService::gatedWait(OSObject* owner, void* args, void*, void*, void*) {
+  auto self = OSDynamicCast(XeService, owner);
+  if (!self || !args) return kIOReturnBadArgument;
+  return self->waitGated(*(const WaitArgs*)args);
+}
+
+// True once every engine is past its target seqno (0: not waited on).
+// Processes CSB events on the engines still short of it.
+bool XeService::waitDone(const uint32_t target[kXeEngineCount]) {
+  bool done = true;
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (target[i] && m_cs[i].execlistsEnabled() && !m_cs[i].pollSeqno(target[i])) done = false;
+  }
+  return done;
+}
+
+// Runs on the work loop. commandSleep() drops the gate, so submits keep
+// flowing while we wait; the wait timer or a reset wakes us.
+IOReturn XeService::waitGated(const WaitArgs& w) {
+  if (w.engine < kXeEngineCount &&
+      (!m_cs[w.engine].execlistsEnabled() || (int32_t)(m_lastSeqno[w.engine] - w.seqno) < 0)) {
+    XeLog("XePCI: ucWait: ERROR - %s never issued seqno %u\n", kXeEngines[w.engine].name, w.seqno);
+    return kIOReturnBadArgument;
+  }
+
+  // Whatever is still coalescing must reach the hardware before we wait on it
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (m_cs[i].execlistsEnabled() && (w.engine == kXeEngineCount || w.engine == i)) {
+      flushEngine(i, XeSubmitCoalescer::kFlushWait);
+    }
+  }
+
+  // "Everything so far" is pinned at entry, not chased as others submit
+  uint32_t target[kXeEngineCount] = {};
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (w.engine == kXeEngineCount) target[i] = m_lastSeqno[i];
+  }
+  if (w.engine < kXeEngineCount) target[w.engine] = w.seqno;
+
+  uint64_t deadline = 0;
+  clock_interval_to_deadline(w.timeoutMs, kMillisecondScale, &deadline);
+  while (!waitDone(target)) {
+    if (m_waiters++ == 0) {
+      for (uint32_t i = 0; i < kXeEngineCount; ++i) m_waitSeen[i] = m_cs[i].completedSeqno();
+      m_waitTimer->setTimeoutMS(kWaitPollMs);
+    }
+    IOReturn res = m_gate->commandSleep(&m_waiters, deadline, THREAD_ABORTSAFE);
+    if (--m_waiters == 0) m_waitTimer->cancelTimeout();
+    if (res == THREAD_INTERRUPTED) return kIOReturnAborted;
+    if (res == THREAD_TIMED_OUT) {
+      // One last look: the seqno may have landed after the last tick
+      if (waitDone(target)) break;
+      XeLog("XePCI: ucWait: ERROR - timed out after %u ms\n", w.timeoutMs);
+      return kIOReturnTimeout;
+    }
+  }
+
+  // A request that hung and was reset "completes" without having run
+  for (uint32_t i = 0; i < kXeEngineCount; ++i) {
+    if (target[i] && m_cs[i].execlistsEnabled() && m_cs[i].isGuilty(target[i])) {
+      XeLog("XePCI: ucWait: %s seqno=%u was reset after a hang\n", kXeEngines[i].name, target[i]);
+      return kIOReturnIOError;
+    }
+  }
+  return kIOReturnSuccess;
+}
+
+IOReturn XeService::ucGetSubmitStats(uint32_t engine, uint64_t* out, uint32_t* outCount) {
+  if (!out || !outCount || engine >= kXeEngineCount) return kIOReturnBadArgument;
+  if (*outCount < kSubmitStatCount) return kIOReturnNoSpace;
+
+  const XeSubmitCoalescer::Stats& st = m_coalesce[engine].stats();
+  out[kSubmitStatSubmits]     = st.submits;
+  out[kSubmitStatDoorbells]   = st.doorbells;
+  out[kSubmitStatBypassed]    = st.bypassed;
+  out[kSubmitStatMaxBurst]    = st.maxBurst;
+  out[kSubmitStatFlushWindow] = st.flushes[XeSubmitCoalescer::kFlushWindow];
+  out[kSubmitStatFlushLimit]  = st.flushes[XeSubmitCoalescer::kFlushLimit];
+  out[kSubmitStatFlushBypass] = st.flushes[XeSubmitCoalescer::kFlushBypass];
+  out[kSubmitStatFlushWait]   = st.flushes[XeSubmitCoalescer::kFlushWait];
+
+  const XeHangcheck::Stats& hc = m_hangcheck[engine].stats();
+  out[kSubmitStatHangs]       = hc.hangs;
+  out[kSubmitStatResets]      = hc.resets;
+  out[kSubmitStatReplayed]    = hc.replayed;
+  out[kSubmitStatLastResetUs] = hc.lastDowntimeUs;
+  out[kSubmitStatMaxResetUs]  = hc.maxDowntimeUs;
+  *outCount = kSubmitStatCount;
+
+  XeLog("XePCI: ucGetSubmitStats: %s submits=%llu doorbells=%llu\n", kXeEngines[engine].name,
+        (unsigned long long)st.submits, (unsigned long long)st.doorbells);
+  return kIOReturnSuccess;
+}
+
+IOReturn XeService::ucGetSubmitLatency(uint32_t engine, uint64_t* out, uint32_t* outCount) {
+  if (!out || !outCount || engine >= kXeEngineCount) return kIOReturnBadArgument;
+  if (*outCount < kSubmitLatCount) return kIOReturnNoSpace;
+
+  const XeBatchPool::Stats& ps = m_batchPool[engine].stats();
+  out[kSubmitLatPoolBuffers] = m_batchPool[engine].buffers();
+  out[kSubmitLatPoolHits]    = ps.hits;
+  out[kSubmitLatPoolGrows]   = ps.grows;
+  out[kSubmitLatPoolShrinks] = ps.shrinks;
+  for (uint32_t b = 0; b < kSubmitLatencyBuckets; ++b) {
+    out[kSubmitLatBucket0 + b] = m_submitHist[engine][b];
+  }
+  *outCount = kSubmitLatCount;
+
+  XeLog("XePCI: ucGetSubmitLatency: %s pool=%u hits=%llu grows=%llu\n", kXeEngines[engine].name,
+        m_batchPool[engine].buffers(), (unsigned long long)ps.hits, (unsigned long long)ps.grows);
+  return kIOReturnSuccess;
+}
+
+IOReturn XeService::ucGetGuCStats(uint64_t* out, uint32_t* outCount) {
+  if (!out || !outCount) return kIOReturnBadArgument;
+  if (*outCount < kGuCStatCount) return kIOReturnNoSpace;
+
+  const XeGuCFirmware::Layout& fw = m_guc.layout();
+  const XeGuCCT::Stats& cs = m_guc.channel().stats();
+  out[kGuCStatStatus]           = m_guc.status();
+  out[kGuCStatVersion]          = ((uint64_t)fw.major << 16) | ((uint64_t)fw.minor << 8) | fw.patch;
+  out[kGuCStatUploads]          = m_guc.uploads();
+  out[kGuCStatCTEnabled]        = m_guc.ctEnabled() ? 1 : 0;
+  out[kGuCStatCTSends]          = cs.sends;
+  out[kGuCStatCTDoorbells]      = cs.doorbells;
+  out[kGuCStatCTResponses]      = cs.responses;
+  out[kGuCStatCTEvents]         = cs.events;
+  out[kGuCStatCTFailures]       = cs.failures;
+  out[kGuCStatCTMaxOutstanding] = cs.maxOutstanding;
+  out[kGuCStatLogWritten]       = m_guc.logWritten();
+  out[kGuCStatLogOverflows]     = m_guc.logOverflows();
+  *outCount = kGuCStatCount;
+
+  XeLog("XePCI: ucGetGuCStats: status=0x%08x ct=%d sends=%llu doorbells=%llu\n", m_guc.status(),
+        m_guc.ctEnabled() ? 1 : 0, (unsigned long long)cs.sends, (unsigned long long)cs.doorbells);
+  return kIOReturnSuccess;
+}
+
+IOReturn XeService::ucGetMemStats(XeBoTable& bos, uint64_t* out, uint32_t* outCount) {
+  if (!out || !outCount) return kIOReturnBadArgument;
+  if (*outCount < kMemStatCount) return kIOReturnNoSpace;
+
+  const XeMemAccount* acct = bos.account();
+  out[kMemStatClientAllocated] = acct ? acct->get(XeMemAccount::kAllocated) : 0;
+  out[kMemStatClientPinned]    = acct ? acct->get(XeMemAccount::kPinned) : 0;
+  out[kMemStatClientBound]     = acct ? acct->get(XeMemAccount::kBound) : 0;
+  out[kMemStatClientBOs]       = bos.count();
+  out[kMemStatAllocated]       = m_mem.get(XeMemAccount::kAllocated);
+  out[kMemStatPinned]          = m_mem.get(XeMemAccount::kPinned);
+  out[kMemStatBound]           = m_mem.get(XeMemAccount::kBound);
+  out[kMemStatPooled]          = m_boPool.pooledBytes();
+  out[kMemStatSoftLimit]       = m_memSoft;
+  out[kMemStatHardLimit]       = m_memHard;
+  out[kMemStatClientLimit]     = m_clientMemHard;
+  out[kMemStatTrimmed]         = m_memTrimmed;
+  out[kMemStatEvicted]         = m_memEvicted;
+  out[kMemStatFailures]        = m_memFailures;
+  out[kMemStatClientReserved]  = acct ? acct->get(XeMemAccount::kReserved) : 0;
+  out[kMemStatReserved]        = m_mem.get(XeMemAccount::kReserved);
+  out[kMemStatMaterialized]    = m_memMaterialized;
+  out[kMemStatFlushes]         = __atomic_load_n(&m_flushes, __ATOMIC_RELAXED);
+  out[kMemStatFlushedLines]    = __atomic_load_n(&m_flushedLines, __ATOMIC_RELAXED);
+  out[kMemStatLastFlushLines]  = __atomic_load_n(&m_lastFlushLines, __ATOMIC_RELAXED);
+  out[kMemStatPurgeableBOs]    = m_purgeableBOs;
+  out[kMemStatPurged]          = m_memPurged;
+  out[kMemStatStolenSize]      = m_stolen.size();
+  out[kMemStatStolenFree]      = m_stolen.freeBytes();
+  out[kMemStatStolenKernel]    = m_kmem.stats().stolenBytes;
+  out[kMemStatStolenBuffers]   = __atomic_load_n(&m_stolenBufferBytes, __ATOMIC_RELAXED);
+  out[kMemStatPoolSize]        = m_kpool.size();
+  out[kMemStatPoolUsed]        = m_kpool.stats().usedBytes;
+  out[kMemStatPoolFailures]    = m_kpool.stats().failures;
+  out[kMemStatKernelSystem]    = m_kmem.stats().systemBytes;
+  *outCount = kMemStatCount;
   return kIOReturnSuccess;
 }
 
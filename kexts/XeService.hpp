@@ -6,20 +6,187 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOBufferMemoryDescriptor.h>
 #include <IOKit/IOUserClient.h>
-#include <libkern/c++/OSArray.h>   // MacKernelSDK C++ header path
+#include <IOKit/IOWorkLoop.h>
+#include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <libkern/OSKextLib.h>
 #include "XeBootArgs.hpp"
+#include "XeCommandStream.hpp"
+#include "XeGGTT.hpp"
+#include "XeSubmitCoalescer.hpp"
+#include "XeHangcheck.hpp"
+#include "XeBatchPool.hpp"
+#include "XeGuC.hpp"
+#include "XeLogRelay.hpp"
+#include "XeBoTable.hpp"
+#include "XeBoPool.hpp"
+#include "XeUserptrCache.hpp"
+#include "XeSubAllocator.hpp"
+#include "XeMemAccount.hpp"
+#include "XeStolen.hpp"
+#include "XeBuddyPool.hpp"
+#include "XeKernelMemory.hpp"
+#include "XeCacheMode.hpp"
 
 // Central logging helper (Task 2). Declared here for use across kext.
 void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
 
 // IOUserClient selector IDs (keep in one place)
 enum {
-  kMethodCreateBuffer = 0,   // in:  [0]=bytes (u64)    out: [0]=cookie (u64)
-  kMethodSubmit       = 1,   // in:  (none)             out: (none)  -- NOOP (stub)
+  kMethodCreateBuffer = 0,   // in:  [0]=bytes (u64) [1]=flags (optional)  out: [0]=cookie (u64)
+  kMethodSubmit       = 1,   // in:  [0]=engine id [1]=flags  out: (none)  -- NOOP batch
   kMethodWait         = 2,   // in:  [0]=timeout_ms     out: (none)
   kMethodReadReg      = 3,   // in:  (none)             out: up to 8 u64 dwords
   kMethodGetGTConfig  = 4,   // in:  (none)             out: GT config (power wells, display, RC state)
   kMethodGetDisplayInfo = 5, // in:  (none)             out: Display pipe/plane info
+  kMethodGetSubmitStats = 6, // in:  [0]=engine id      out: coalescing + hang counters (u64)
+  kMethodGetSubmitLatency = 7, // in: [0]=engine id     out: batch pool counters + latency histogram (u64)
+  kMethodSubmitBatch  = 8,   // in:  [0]=engine id [1]=flags [2..]=BO cookies (1..8)  out: (none) -- chained
+  kMethodGetGuCStats  = 9,   // in:  (none)             out: GuC status + CT channel counters (u64)
+  kMethodDestroyBuffer = 10, // in:  [0]=cookie         out: (none)
+  kMethodExportBuffer = 11,  // in:  [0]=cookie         out: [0]=global name (u64)
+  kMethodImportBuffer = 12,  // in:  [0]=global name    out: [0]=cookie in this client's namespace
+  kMethodImportUserptr = 13, // in:  [0]=address [1]=bytes (page aligned)  out: [0]=cookie
+  kMethodCreateSubBuffer = 14, // in: [0]=bytes (1..2048) out: [0]=cookie [1]=offset in its slab
+  kMethodGetMemStats  = 15,  // in:  (none)             out: this client's and global memory counters (u64)
+  kMethodFlushBuffer  = 16,  // in:  [0]=cookie [1]=flags [2..]=dirty ranges (0..14)  out: [0]=lines flushed
+  kMethodMadvise      = 17,  // in:  [0]=cookie [1]=advice out: [0]=1 if the contents were retained
+};
+
+// clientMemoryForType types (IOConnectMapMemory64). The logs map
+// read-only; a BO maps read-write, with the cache mode it was created with
+// when the caller maps it with kIOMapDefaultCache.
+enum : uint32_t {
+  kXeMemoryLogRelay = 0,     // XeLogRelay.hpp: header + driver event records
+  kXeMemoryGuCLog   = 1,     // GuC log buffer as the firmware writes it
+  kXeMemoryBuffer   = 0x80000000u,   // | serial[14:0] << 16 | slot: see XeMemoryTypeForCookie
+};
+
+// A BO of the caller's namespace; carries the cookie's slot and the low 15
+// bits of its serial, enough to reject a recently recycled slot
+static inline uint32_t XeMemoryTypeForCookie(uint64_t cookie) {
+  return kXeMemoryBuffer | (((uint32_t)(cookie >> 32) & 0x7FFFu) << 16) | (((uint32_t)cookie - 1) & 0xFFFFu);
+}
+
+// kMethodSubmit flags
+enum : uint32_t {
+  kSubmitFlagLatencyCritical = 1u << 0,   // ring the doorbell now, skip coalescing
+};
+
+// kMethodCreateBuffer flags. The cache mode field holds an XeCacheMode
+// (XeCacheMode.hpp); lazy BOs must be WB and cannot be scanout BOs. A
+// scanout BO that lands in stolen memory is WC whatever the field says;
+// map it with kIOMapWriteCombineCache.
+enum : uint32_t {
+  kBufferFlagLazy    = 1u << 0,   // reserve only: pages are allocated on the first map, bind or submit
+  kBufferCacheShift  = 1,
+  kBufferCacheMask   = 3u << kBufferCacheShift,
+  kBufferFlagScanout = 1u << 3,   // framebuffer: stolen memory (always WC) when it fits, else as asked
+};
+
+// kMethodFlushBuffer. Each range is offset << 32 | bytes within the BO.
+// The ranges are added to the BO's dirty set, then (unless deferred) every
+// dirty line is written back for scanout. Only WB BOs track lines; a WC BO
+// just gets its combining buffers drained, a UC one needs nothing.
+enum : uint32_t {
+  kFlushFlagDefer = 1u << 0,   // record the ranges only; a later call flushes them
+  kFlushMaxRanges = 14,
+};
+
+// kMethodMadvise advice. A DONTNEED BO's pages are dropped under memory
+// pressure once it is idle and unmapped; it keeps its cookie and comes
+// back zero-filled. The reply says whether that happened since the last
+// WILLNEED. Only private WB BOs created with kMethodCreateBuffer take
+// advice.
+enum : uint32_t {
+  kMadviseWillNeed = 0,
+  kMadviseDontNeed = 1,
+};
+
+// kMethodGetSubmitStats output layout
+enum {
+  kSubmitStatSubmits = 0,
+  kSubmitStatDoorbells,
+  kSubmitStatBypassed,
+  kSubmitStatMaxBurst,
+  kSubmitStatFlushWindow,
+  kSubmitStatFlushLimit,
+  kSubmitStatFlushBypass,
+  kSubmitStatFlushWait,
+  kSubmitStatHangs,
+  kSubmitStatResets,
+  kSubmitStatReplayed,
+  kSubmitStatLastResetUs,
+  kSubmitStatMaxResetUs,
+  kSubmitStatCount
+};
+
+// kMethodGetSubmitLatency output layout. Bucket b counts submits that
+// spent [2^(b-1), 2^b) us in the gated submit path (bucket 0: < 1 us,
+// last bucket: everything slower).
+constexpr uint32_t kSubmitLatencyBuckets = 8;
+enum {
+  kSubmitLatPoolBuffers = 0,
+  kSubmitLatPoolHits,
+  kSubmitLatPoolGrows,
+  kSubmitLatPoolShrinks,
+  kSubmitLatBucket0,
+  kSubmitLatCount = kSubmitLatBucket0 + kSubmitLatencyBuckets
+};
+
+// kMethodGetGuCStats output layout. Version is major << 16 | minor << 8 |
+// patch; all zero when no GuC firmware was loaded.
+enum {
+  kGuCStatStatus = 0,        // last GUC_STATUS read
+  kGuCStatVersion,
+  kGuCStatUploads,
+  kGuCStatCTEnabled,
+  kGuCStatCTSends,
+  kGuCStatCTDoorbells,
+  kGuCStatCTResponses,
+  kGuCStatCTEvents,
+  kGuCStatCTFailures,
+  kGuCStatCTMaxOutstanding,
+  kGuCStatLogWritten,        // GuC debug log bytes relayed
+  kGuCStatLogOverflows,      // times the GuC found its debug log full
+  kGuCStatCount
+};
+
+// kMethodGetMemStats output layout, in bytes unless noted. Footprint (what
+// limits apply to) is allocated + pinned; the global limits also count
+// pooled memory. A limit of 0 means none.
+enum {
+  kMemStatClientAllocated = 0,
+  kMemStatClientPinned,
+  kMemStatClientBound,
+  kMemStatClientBOs,         // live handles in the client's table
+  kMemStatAllocated,         // all clients, plus shared BOs whose creator is gone
+  kMemStatPinned,
+  kMemStatBound,
+  kMemStatPooled,            // destroyed BOs cached by XeBoPool
+  kMemStatSoftLimit,         // global: crossing it trims the pool
+  kMemStatHardLimit,         // global: allocations fail once trimming can't get under it
+  kMemStatClientLimit,       // per client hard limit
+  kMemStatTrimmed,           // pool bytes freed under memory pressure
+  kMemStatEvicted,           // userptr bytes unpinned under memory pressure
+  kMemStatFailures,          // allocations refused at a hard limit
+  kMemStatClientReserved,    // lazy BOs with no pages yet (not part of the footprint)
+  kMemStatReserved,
+  kMemStatMaterialized,      // lazy BO bytes that have been backed since start
+  kMemStatFlushes,           // kMethodFlushBuffer calls that flushed (frames, for scanout BOs)
+  kMemStatFlushedLines,      // cache lines written back by them
+  kMemStatLastFlushLines,    // lines written back by the most recent one
+  kMemStatPurgeableBOs,      // BOs advised DONTNEED, all clients (count)
+  kMemStatPurged,            // bytes dropped from them under memory pressure
+  kMemStatStolenSize,        // usable stolen memory (0: none)
+  kMemStatStolenFree,
+  kMemStatStolenKernel,      // rings and status pages placed there
+  kMemStatStolenBuffers,     // scanout BOs placed there
+  kMemStatPoolSize,          // contiguous pool for engine blocks (0: none)
+  kMemStatPoolUsed,          // in whole buddy chunks
+  kMemStatPoolFailures,      // blocks that did not fit and went elsewhere
+  kMemStatKernelSystem,      // engine blocks that fell back to wired system RAM
+  kMemStatCount
 };
 
 // Maximum safe MMIO offset to prevent out-of-bounds access
@@ -42,12 +209,201 @@ private:
   volatile uint32_t     *mmio {nullptr};
   uint64_t              bar0Length {0};  // Track BAR0 size for bounds checking
 
-  // Minimal BO registry (kernel-only cookies)
-  OSArray               *m_boList {nullptr}; // holds IOBufferMemoryDescriptor*
+  // BOs live in each client's own XeBoTable and are bound into the GGTT
+  // on their first chained submit. Exported BOs are also entered here;
+  // their cookie in this table is the global name other clients import
+  // by, and the entry holds the shared binding and a holder count.
+  XeBoTable              m_exports;
+
+  // Destroyed BOs are recycled by size (see XeBoPool) instead of
+  // going back to the VM system
+  XeBoPool               m_boPool;
+
+  // Parent of every client's account (XeMemAccount) and the limits from
+  // xepci=memsoft/memhard/clientmem. The reclaim counters are only
+  // written under the gate.
+  XeMemAccount           m_mem;
+  uint64_t               m_memSoft {0};
+  uint64_t               m_memHard {0};
+  uint64_t               m_clientMemHard {0};
+  uint64_t               m_memTrimmed {0};
+  uint64_t               m_memEvicted {0};
+  uint64_t               m_memFailures {0};
+  uint64_t               m_memMaterialized {0};
+  uint64_t               m_memPurged {0};
+
+  // Client tables that have had DONTNEED BOs, walked by the reclaim path;
+  // a table leaves the list when its client closes (gate only)
+  XeBoTable*             m_purgeTables {nullptr};
+  uint64_t               m_purgeableBOs {0};
+
+  // kMethodFlushBuffer counters; the flushing itself runs off the gate,
+  // so these are updated atomically
+  uint64_t               m_flushes {0};
+  uint64_t               m_flushedLines {0};
+  uint64_t               m_lastFlushLines {0};
+
+  // One command stream per engine in kXeEngines (persistent so execlist
+  // state survives submits); engines run independently of each other.
+  XeCommandStream        m_cs[kXeEngineCount];
+  XeGGTTSpace            m_ggttSpace;
+
+  // Stolen memory, and the allocator the engines take their rings, status
+  // pages and context images from (stolen, then the contiguous pool, then
+  // system RAM; see XeKernelMemory)
+  XeStolen               m_stolen;
+  XeBuddyPool            m_kpool;
+  XeKernelMemory         m_kmem;
+  uint64_t               m_stolenBufferBytes {0};   // scanout BOs in stolen memory (atomic)
+  uint32_t               m_lastSeqno[kXeEngineCount] {};
+
+  // Recycled kernel batch buffers, one pool per engine, the copies chained
+  // submissions run from when the client could still write a batch, plus
+  // a log2 (us) histogram of how long each submit spent under the gate.
+  static constexpr uint32_t kBatchCopyBytes = 64 * 1024;
+  XeBatchPool            m_batchPool[kXeEngineCount];
+  XeBatchPool            m_copyPool[kXeEngineCount];
+  uint64_t               m_submitHist[kXeEngineCount][kSubmitLatencyBuckets] {};
+
+  // Submission is serialized on our own work loop. Doorbells are coalesced
+  // per engine; one timer flushes whatever is still pending when the
+  // window closes.
+  IOWorkLoop            *m_workLoop {nullptr};
+  IOCommandGate         *m_gate {nullptr};
+  IOTimerEventSource    *m_coalesceTimer {nullptr};
+  bool                   m_coalesceArmed {false};
+  XeSubmitCoalescer      m_coalesce[kXeEngineCount];
+
+  // Hang watchdog: runs only while some engine has work outstanding or a
+  // batch pool still has buffers to trim
+  IOTimerEventSource    *m_hangcheckTimer {nullptr};
+  bool                   m_hangcheckArmed {false};
+  XeHangcheck            m_hangcheck[kXeEngineCount];
+
+  // GuC firmware is fetched from the kext's Resources asynchronously at
+  // start, then parsed and pinned once; upload() reuses the pinned image.
+  // Its timer drains G2H and samples the log while the GuC runs, busy
+  // engines or not.
+  XeGuC                  m_guc;
+  IOTimerEventSource    *m_gucTimer {nullptr};
+  OSKextRequestTag       m_gucRequest {kOSKextRequestTagInvalid};
+
+  // ucWait callers sleep on the gate (event: m_waiters). There is no user
+  // interrupt yet, so the wait timer is the completion path: while anyone
+  // sleeps it processes CSB events every kWaitPollMs and wakes the waiters
+  // once an engine's seqno moves. m_waitSeen is the last seqno it saw.
+  static constexpr uint32_t kWaitPollMs = 1;
+  IOTimerEventSource    *m_waitTimer {nullptr};
+  uint32_t               m_waiters {0};
+  uint32_t               m_waitSeen[kXeEngineCount] {};
+
+  // Driver event log, mapped read-only by userspace (kXeMemoryLogRelay).
+  // Written only on the work loop; m_retired is the last seqno logged as
+  // retired per engine.
+  IOBufferMemoryDescriptor* m_relayMem {nullptr};
+  XeLogRelay             m_relay;
+  uint32_t               m_retired[kXeEngineCount] {};
+
+  static IOReturn gatedSubmit(OSObject* owner, void* engine, void* flags, void* contexts, void* outSeqno);
+  enum : uintptr_t { kBufferOpDestroy, kBufferOpExport, kBufferOpImport, kBufferOpDrain };
+  struct SubmitBatchArgs {
+    XeBoTable*      bos;
+    XeLogicalContext** contexts;
+    uint32_t        engine;
+    uint32_t        flags;
+    const uint64_t* cookies;
+    uint32_t        count;
+    uint32_t*       outSeqno;
+  };
+  // engine == kXeEngineCount waits for everything submitted so far
+  struct WaitArgs {
+    uint32_t        engine;
+    uint32_t        seqno;
+    uint32_t        timeoutMs;
+  };
+  struct SubBufferArgs {
+    XeBoTable*      bos;
+    XeSubAllocator* subs;
+    uint32_t        bytes;
+    uint64_t        cookie;
+    uint32_t        offset;
+  };
+  struct FlushArgs {
+    XeBoTable*          bos;
+    uint64_t            cookie;
+    const uint64_t*     ranges;
+    uint32_t            count;
+    bool                flush;
+    IOMemoryDescriptor* md;        // out, retained: the BO to flush
+    uint8_t*            cpu;
+    uint8_t             mode;
+    XeDirtyRanges       dirty;     // out: the lines to flush, taken from the BO
+  };
+  struct UserptrArgs {
+    XeBoTable*          bos;
+    XeUserptrCache*     userptrs;
+    uint64_t            addr;
+    uint64_t            bytes;
+    IOMemoryDescriptor* md;        // prepared on a cache miss
+    IOMemoryMap*        map;
+    uint64_t            cookie;
+  };
+
+  static IOReturn gatedBufferOp(OSObject* owner, void* bos, void* op, void* inout, void*);
+  static IOReturn gatedSubmitBatch(OSObject* owner, void* args, void*, void*, void*);
+  static IOReturn gatedBufferMemory(OSObject* owner, void* bos, void* type, void* out, void*);
+  static IOReturn gatedImportUserptr(OSObject* owner, void* args, void*, void*, void*);
+  static IOReturn gatedReleaseClientMemory(OSObject* owner, void* userptrs, void* subs, void*, void*);
+  static IOReturn gatedCreateSubBuffer(OSObject* owner, void* args, void*, void*, void*);
+  static IOReturn gatedFlushBuffer(OSObject* owner, void* args, void*, void*, void*);
+  struct PurgeWalk {
+    XeService*      self;
+    const uint32_t* completed;
+    uint64_t        want;
+    uint64_t        freed;
+  };
+  static bool     purgeVisit(void* walk, XeBoTable::Entry* e);
+  static IOReturn gatedMadvise(OSObject* owner, void* bos, void* cookie, void* advice, void* outRetained);
+  static IOReturn gatedReclaimMemory(OSObject* owner, void* account, void* userptrs, void* bytes, void*);
+  static IOReturn gatedCloseContexts(OSObject* owner, void* contexts, void*, void*, void*);
+  static IOReturn gatedFlush(OSObject* owner, void* reason, void*, void*, void*);
+  static IOReturn gatedWait(OSObject* owner, void* args, void*, void*, void*);
+  static IOReturn gatedLoadGuC(OSObject* owner, void* blob, void* length, void*, void*);
+  static IOReturn gatedLogMemory(OSObject* owner, void* type, void* out, void*, void*);
+  static void     gucFirmwareLoaded(OSKextRequestTag tag, OSReturn result, const void* data,
+                                    uint32_t length, void* context);
+  void            requestGuCFirmware();
+  static void     coalesceTimerFired(OSObject* owner, IOTimerEventSource* sender);
+  static void     hangcheckTimerFired(OSObject* owner, IOTimerEventSource* sender);
+  static void     gucTimerFired(OSObject* owner, IOTimerEventSource* sender);
+  static void     waitTimerFired(OSObject* owner, IOTimerEventSource* sender);
+  void            armHangcheck();
+  IOReturn        waitGated(const WaitArgs& w);
+  bool            waitDone(const uint32_t target[kXeEngineCount]);
+  void            recoverEngine(uint32_t engine);
+  IOReturn        submitNoopGated(uint32_t engine, uint32_t flags, uint32_t* outSeqno);
+  void            clientContext(XeLogicalContext* contexts[kXeEngineCount], uint32_t engine);
+  IOReturn        submitBatchGated(XeBoTable& bos, uint32_t engine, uint32_t flags,
+                                   const uint64_t* cookies, uint32_t count, uint32_t* outSeqno);
+  IOReturn        exportBufferGated(XeBoTable& bos, uint64_t* inoutName);
+  bool            bindBuffer(XeBoTable::Entry* bo);
+  bool            materializeBuffer(XeBoTable::Entry* bo);
+  uint32_t        bindMemory(IOMemoryDescriptor* md);
+  void            dropBuffer(const XeBoTable::Entry& e);
+  uint64_t        createStolenBuffer(XeBoTable& bos, uint32_t bytes);
+  void            retireStolen(const XeBoTable::Entry& e, const uint32_t completed[kXeEngineCount]);
+  bool            purgeBuffer(XeBoTable::Entry* bo, const uint32_t completed[kXeEngineCount]);
+  uint64_t        purgeBuffers(const XeMemAccount* acct, uint64_t bytes, const uint32_t completed[kXeEngineCount]);
+  void            unlistPurgeable(XeBoTable* bos);
+  uint64_t        memoryExcess(const XeMemAccount* acct, uint64_t bytes, bool soft) const;
+  IOReturn        reserveMemory(XeMemAccount* acct, XeUserptrCache* userptrs, uint64_t bytes);
+  static void     drainBuffer(void* ctx, const XeBoTable::Entry& e);
+  void            noteEmitted(uint32_t engine, uint32_t flags);
+  void            completedSeqnos(uint32_t out[kXeEngineCount]);
+  void            noteSubmitLatency(uint32_t engine, uint64_t start);
+  void            flushEngine(uint32_t engine, XeSubmitCoalescer::FlushReason reason);
+  void            logEvent(uint16_t type, uint32_t engine, uint32_t arg0, uint32_t arg1 = 0, uint32_t arg2 = 0);
 
-  // Helpers
-  IOBufferMemoryDescriptor* boFromCookie(uint64_t cookie);
-  
   // Internal logging helpers for GPU state
   void logPowerState();
   void logDisplayState();
@@ -65,9 +421,40 @@ public:
                             OSDictionary* props, IOUserClient** out) override;
 
   // Methods used by the user client
-  IOReturn    ucCreateBuffer(uint32_t bytes, uint64_t* outCookie);
-  IOReturn    ucSubmitNoop();                  // stub (will do MI_NOOP later)
-  IOReturn    ucWait(uint32_t timeoutMs);      // stub
+  // BO calls act on the calling client's table
+  IOReturn    ucCreateBuffer(XeBoTable& bos, XeUserptrCache& userptrs, uint32_t bytes, uint32_t flags,
+                             uint64_t* outCookie);
+  IOReturn    ucDestroyBuffer(XeBoTable& bos, uint64_t cookie);
+  IOReturn    ucExportBuffer(XeBoTable& bos, uint64_t cookie, uint64_t* outName);
+  IOReturn    ucImportBuffer(XeBoTable& bos, uint64_t name, uint64_t* outCookie);
+  IOReturn    ucImportUserptr(XeBoTable& bos, XeUserptrCache& userptrs, task_t task, uint64_t addr,
+                              uint64_t bytes, uint64_t* outCookie);
+  IOReturn    ucCreateSubBuffer(XeBoTable& bos, XeSubAllocator& subs, uint32_t bytes, uint64_t* outCookie,
+                                uint32_t* outOffset);
+  IOReturn    ucFlushBuffer(XeBoTable& bos, uint64_t cookie, uint32_t flags, const uint64_t* ranges,
+                            uint32_t count, uint64_t* outLines);
+  IOReturn    ucMadvise(XeBoTable& bos, uint64_t cookie, uint32_t advice, uint64_t* outRetained);
+  void        releaseClientBuffers(XeBoTable& bos, XeUserptrCache& userptrs, XeSubAllocator& subs);
+  IOReturn    ucBufferMemory(XeBoTable& bos, uint32_t type, IOMemoryDescriptor** out);   // retained
+  // Submits return the request's seqno for ucWait (0: nothing was queued)
+  IOReturn    ucSubmitNoop(XeLogicalContext* contexts[kXeEngineCount], uint32_t engine,
+                           uint32_t flags, uint32_t* outSeqno);  // legacy: prepare only
+  IOReturn    ucSubmitBatch(XeBoTable& bos, XeLogicalContext* contexts[kXeEngineCount], uint32_t engine,
+                            uint32_t flags, const uint64_t* cookies, uint32_t count, uint32_t* outSeqno);
+  // execlists: flush, then sleep until seqno retires on engine (seqno 0 or
+  // engine kXeEngineCount: everything submitted before the call); legacy: stub
+  IOReturn    ucWait(uint32_t engine, uint32_t seqno, uint32_t timeoutMs);
+  IOReturn    ucGetSubmitStats(uint32_t engine, uint64_t* out, uint32_t* outCount);
+  IOReturn    ucGetSubmitLatency(uint32_t engine, uint64_t* out, uint32_t* outCount);
+  IOReturn    ucGetGuCStats(uint64_t* out, uint32_t* outCount);
+  IOReturn    ucGetMemStats(XeBoTable& bos, uint64_t* out, uint32_t* outCount);
+  XeMemAccount* memAccount() { return &m_mem; }   // parent for client accounts
+  IOReturn    ucLogMemory(uint32_t type, IOMemoryDescriptor** out);   // retained, for clientMemoryForType
+
+  // One logical context per execlist engine for each user client, taken
+  // from the engine's context pool on the client's first submit to it and
+  // recycled on close
+  void        closeClientContexts(XeLogicalContext* contexts[kXeEngineCount]);
   IOReturn    ucReadRegs(uint32_t count, uint32_t* out, uint32_t* outCount);
   IOReturn    ucGetGTConfig(uint32_t* out, uint32_t* outCount);      // Read GT/power config
   IOReturn    ucGetDisplayInfo(uint32_t* out, uint32_t* outCount);   // Read display state
@@ -0,0 +1,136 @@
+#pragma once
+#include <stdint.h>
+
+// Bitmap sub-allocator for small BOs (header-only, no IOKit, so the host
+// benchmark in userspace/xeslab.cpp runs the same code).
+//
+// Requests of 1..kMaxChunk bytes are rounded up to a power-of-two chunk
+// (256, 512, 1K, 2K). Each kSlabBytes slab serves one chunk size and
+// tracks its chunks in a bitmap (bit set = allocated). The heap only does
+// the bookkeeping: the caller supplies each slab's backing (an opaque
+// pointer) and decides what to do with it once free() reports it empty.
+//
+// Allocation tries the class's last slab with room first, then scans the
+// class's slabs; free() is O(1). Not locked.
+class XeSlabHeap {
+public:
+  static constexpr uint32_t kSlabBytes   = 64 * 1024;
+  static constexpr uint32_t kMinChunk    = 256;
+  static constexpr uint32_t kMaxChunk    = 2048;
+  static constexpr uint32_t kClassCount  = 4;
+  static constexpr uint32_t kMaxSlabs    = 64;
+  static constexpr uint32_t kBitmapWords = kSlabBytes / kMinChunk / 64;
+  static constexpr uint32_t kNoSlab      = 0xFFFFFFFFu;
+
+  struct Slab {
+    void*    backing;           // null: unused slot
+    uint32_t cls;
+    uint32_t used;              // allocated chunks
+    uint64_t bitmap[kBitmapWords];
+  };
+
+  static uint32_t classOf(uint32_t bytes) {
+    uint32_t cls = 0;
+    while (cls < kClassCount && chunkBytes(cls) < bytes) cls++;
+    return cls;                 // kClassCount: too large for the heap
+  }
+  static uint32_t chunkBytes(uint32_t cls)    { return kMinChunk << cls; }
+  static uint32_t chunksPerSlab(uint32_t cls) { return kSlabBytes / chunkBytes(cls); }
+
+  // Carves a chunk of bytes' class out of a slab with room. false when
+  // every slab of the class is full: addSlab() one and retry.
+  bool alloc(uint32_t bytes, uint32_t* outSlab, uint32_t* outOffset) {
+    uint32_t cls = classOf(bytes);
+    if (bytes == 0 || cls >= kClassCount) return false;
+    uint32_t hint = hot[cls];
+    if (hint != kNoSlab && take(hint, outOffset)) {
+      *outSlab = hint;
+      return true;
+    }
+    for (uint32_t s = 0; s < kMaxSlabs; ++s) {
+      if (!slabs[s].backing || slabs[s].cls != cls || s == hint) continue;
+      if (take(s, outOffset)) {
+        hot[cls] = s;
+        *outSlab = s;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // A fresh, empty slab of class cls; kNoSlab when all slots are in use
+  uint32_t addSlab(void* backing, uint32_t cls) {
+    if (!backing || cls >= kClassCount) return kNoSlab;
+    for (uint32_t s = 0; s < kMaxSlabs; ++s) {
+      Slab& sl = slabs[s];
+      if (sl.backing) continue;
+      sl.backing = backing;
+      sl.cls = cls;
+      sl.used = 0;
+      // Bits past the last chunk stay set so they are never handed out
+      uint32_t chunks = chunksPerSlab(cls);
+      for (uint32_t w = 0; w < kBitmapWords; ++w) {
+        uint32_t first = w * 64;
+        if (first >= chunks)           sl.bitmap[w] = ~0ull;
+        else if (chunks - first >= 64) sl.bitmap[w] = 0;
+        else                           sl.bitmap[w] = ~0ull << (chunks - first);
+      }
+      hot[cls] = s;
+      slabCount++;
+      return s;
+    }
+    return kNoSlab;
+  }
+
+  // Returns true when the slab is now empty and its class has room
+  // elsewhere, i.e. the caller should removeSlab() it. One empty slab per
+  // class is kept so alternating alloc/free does not churn backings.
+  bool free(uint32_t slab, uint32_t offset) {
+    if (slab >= kMaxSlabs || !slabs[slab].backing) return false;
+    Slab& sl = slabs[slab];
+    uint32_t chunk = offset / chunkBytes(sl.cls);
+    uint64_t bit = 1ull << (chunk % 64);
+    if (!(sl.bitmap[chunk / 64] & bit)) return false;    // double free
+    sl.bitmap[chunk / 64] &= ~bit;
+    sl.used--;
+    hot[sl.cls] = slab;
+    if (sl.used) return false;
+    for (uint32_t s = 0; s < kMaxSlabs; ++s) {
+      if (s != slab && slabs[s].backing && slabs[s].cls == sl.cls &&
+          slabs[s].used < chunksPerSlab(sl.cls)) return true;
+    }
+    return false;
+  }
+
+  // Forgets an empty slab and hands its backing back
+  void* removeSlab(uint32_t slab) {
+    if (slab >= kMaxSlabs || !slabs[slab].backing || slabs[slab].used) return nullptr;
+    void* backing = slabs[slab].backing;
+    slabs[slab].backing = nullptr;
+    if (hot[slabs[slab].cls] == slab) hot[slabs[slab].cls] = kNoSlab;
+    slabCount--;
+    return backing;
+  }
+
+  const Slab& slab(uint32_t s) const { return slabs[s]; }
+  uint32_t    count() const { return slabCount; }
+
+private:
+  Slab     slabs[kMaxSlabs] {};
+  uint32_t hot[kClassCount] {kNoSlab, kNoSlab, kNoSlab, kNoSlab};
+  uint32_t slabCount {0};
+
+  bool take(uint32_t s, uint32_t* outOffset) {
+    Slab& sl = slabs[s];
+    if (sl.used == chunksPerSlab(sl.cls)) return false;
+    for (uint32_t w = 0; w < kBitmapWords; ++w) {
+      if (sl.bitmap[w] == ~0ull) continue;
+      uint32_t bit = (uint32_t)__builtin_ctzll(~sl.bitmap[w]);
+      sl.bitmap[w] |= 1ull << bit;
+      sl.used++;
+      *outOffset = (w * 64 + bit) * chunkBytes(sl.cls);
+      return true;
+    }
+    return false;
+  }
+};
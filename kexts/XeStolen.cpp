@@ -0,0 +1,278 @@
+#include "XeStolen.hpp"
+
+bool XeStolen::init(IOPCIDevice* pci, volatile uint32_t* mmio) {
+  if (lock) return true;
+  if (!pci || !mmio) {
+    XeLog("XeStolen::init: ERROR - invalid arguments\n");
+    return false;
+  }
+
+  // GMS counts 32MB units, or 4MB units from 0xF0 up
+  uint16_t ggc = pci->configRead16(XeHW::PCI_GGC);
+  uint32_t gms = ggc >> XeHW::GGC_GMS_SHIFT;
+  uint64_t dsmBytes = gms < 0xF0 ? (uint64_t)gms << 25 : (uint64_t)(gms - 0xF0 + 1) << 22;
+  uint64_t bdsm = (uint64_t)pci->configRead32(XeHW::PCI_BDSM) |
+                  ((uint64_t)pci->configRead32(XeHW::PCI_BDSM_HI) << 32);
+  dsmBase = bdsm & XeHW::BDSM_ADDR_MASK;
+  XeLog("XeStolen::init: GGC=0x%04x BDSM=0x%llx -> %lluMB at 0x%llx\n", ggc, (unsigned long long)bdsm,
+        (unsigned long long)(dsmBytes >> 20), (unsigned long long)dsmBase);
+  if (!dsmBytes || !dsmBase) {
+    XeLog("XeStolen::init: SKIP - no stolen memory\n");
+    return false;
+  }
+
+  uint64_t top = dsmBytes;
+  uint64_t res = (uint64_t)mmio[XeHW::GEN6_STOLEN_RESERVED >> 2] |
+                 ((uint64_t)mmio[(XeHW::GEN6_STOLEN_RESERVED + 4) >> 2] << 32);
+  if (res & XeHW::STOLEN_RES_ENABLE) {
+    uint64_t resBase = res & XeHW::STOLEN_RES_ADDR_MASK;
+    if (resBase > dsmBase && resBase < dsmBase + dsmBytes) top = resBase - dsmBase;
+    XeLog("XeStolen::init: hardware reserves %uMB at 0x%llx\n",
+          1u << ((res >> XeHW::STOLEN_RES_SIZE_SHIFT) & 3), (unsigned long long)resBase);
+  }
+
+  apertureMap = pci->mapDeviceMemoryWithRegister(kIOPCIConfigBaseAddress2, kIOMapWriteCombineCache);
+  if (!apertureMap || !apertureMap->getVirtualAddress()) {
+    XeLog("XeStolen::init: ERROR - failed to map the aperture (BAR2)\n");
+    destroy();
+    return false;
+  }
+  aperture = (uint8_t*)apertureMap->getVirtualAddress();
+  aperturePhys = apertureMap->getPhysicalAddress();
+  uint64_t apertureBytes = apertureMap->getLength();
+
+  // The firmware framebuffer keeps scanning out: leave its binding alone
+  // and its stolen pages off the free list
+  uint32_t fbGgtt = 0, fbBytes = 0;
+  uint64_t fbLo = top, fbHi = 0;
+  if (mmio[XeHW::DSPACNTR >> 2] & XeHW::DSPCNTR_ENABLE) {
+    uint32_t src = mmio[XeHW::PIPEASRC >> 2];
+    uint64_t bytes = (uint64_t)((src >> 16) + 1) * 4 * ((src & 0xFFFFu) + 1);
+    fbGgtt = mmio[XeHW::DSPASURF >> 2] & ~(kPageBytes - 1);
+    fbBytes = (uint32_t)((bytes + kWindowAlign - 1) & ~(uint64_t)(kWindowAlign - 1));   // tile-row padding
+    for (uint32_t off = 0; off < fbBytes; off += kPageBytes) {
+      uint64_t phys = XeGGTT::ptePhys(mmio, fbGgtt + off);
+      if (phys < dsmBase || phys >= dsmBase + top) continue;
+      if (phys - dsmBase < fbLo) fbLo = phys - dsmBase;
+      if (phys - dsmBase + kPageBytes > fbHi) fbHi = phys - dsmBase + kPageBytes;
+    }
+  }
+
+  // The window: a gap of the aperture around the firmware binding that
+  // holds all of DSM, else the larger gap with DSM clipped to it. GGTT
+  // address 0 means "unbound" everywhere, so the low gap starts one
+  // window alignment up.
+  uint64_t lowStart = kWindowAlign;
+  uint64_t lowEnd = fbBytes ? (fbGgtt & ~(uint64_t)(kWindowAlign - 1)) : apertureBytes;
+  if (lowEnd > apertureBytes) lowEnd = apertureBytes;
+  uint64_t lowGap = lowEnd > lowStart ? lowEnd - lowStart : 0;
+  uint64_t highStart = fbBytes ? ((uint64_t)fbGgtt + fbBytes + kWindowAlign - 1) & ~(uint64_t)(kWindowAlign - 1)
+                               : apertureBytes;
+  uint64_t highGap = highStart < apertureBytes ? apertureBytes - highStart : 0;
+  uint64_t span = top;
+  if (span <= lowGap) {
+    window = (uint32_t)lowStart;
+  } else if (span <= highGap) {
+    window = (uint32_t)highStart;
+  } else if (lowGap >= highGap) {
+    window = (uint32_t)lowStart;
+    span = lowGap;
+  } else {
+    window = (uint32_t)highStart;
+    span = highGap;
+  }
+  span &= ~(uint64_t)(kPageBytes - 1);
+  if (!span || !XeGGTT::insertPhys(mmio, window, dsmBase, (uint32_t)span)) {
+    XeLog("XeStolen::init: ERROR - no aperture window for %lluMB of stolen memory\n",
+          (unsigned long long)(top >> 20));
+    destroy();
+    return false;
+  }
+
+  lock = IOLockAlloc();
+  if (!lock) {
+    XeLog("XeStolen::init: ERROR - lock allocation failed\n");
+    XeGGTT::clearPages(mmio, window, (uint32_t)span);
+    destroy();
+    return false;
+  }
+  m = mmio;
+  usable = (uint32_t)span;
+  if (fbHi > usable) fbHi = usable;
+  if (fbLo < fbHi) {
+    if (fbLo) ext[extCount++] = Extent {0, (uint32_t)fbLo};
+    if (fbHi < usable) ext[extCount++] = Extent {(uint32_t)fbHi, usable};
+  } else {
+    ext[extCount++] = Extent {0, usable};
+  }
+
+  XeLog("XeStolen::init: %uMB usable at GGTT 0x%08x (aperture %lluMB)\n", usable >> 20, window,
+        (unsigned long long)(apertureBytes >> 20));
+  if (fbLo < fbHi) {
+    XeLog("XeStolen::init: firmware framebuffer keeps 0x%llx..0x%llx\n",
+          (unsigned long long)fbLo, (unsigned long long)fbHi);
+  }
+  return true;
+}
+
+void XeStolen::destroy() {
+  if (lock) {
+    // The GPU is stopped: nothing retired is still in use
+    for (uint32_t i = 0; i < retiredCount; ++i) retired[i].md->release();
+    retiredCount = 0;
+    if (m && usable) XeGGTT::clearPages(m, window, usable);
+    XeLog("XeStolen::destroy: allocs=%llu frees=%llu failures=%llu leaked=%llu\n",
+          (unsigned long long)st.allocs, (unsigned long long)st.frees,
+          (unsigned long long)st.failures, (unsigned long long)st.leaked);
+    IOLockFree(lock);
+    lock = nullptr;
+  }
+  if (apertureMap) {
+    apertureMap->release();
+    apertureMap = nullptr;
+  }
+  aperture = nullptr;
+  aperturePhys = 0;
+  usable = window = 0;
+  extCount = 0;
+  m = nullptr;
+}
+
+bool XeStolen::alloc(uint32_t bytes, uint32_t align, uint32_t* outOffset) {
+  if (!lock || !bytes || !outOffset || (align & (align - 1))) return false;
+  uint32_t sz = (bytes + kPageBytes - 1) & ~(kPageBytes - 1);
+  if (align < kPageBytes) align = kPageBytes;
+
+  IOLockLock(lock);
+  for (uint32_t i = 0; i < extCount; ++i) {
+    Extent e = ext[i];
+    uint32_t start = (e.start + align - 1) & ~(align - 1);
+    if (start < e.start || start >= e.end || e.end - start < sz) continue;
+    bool head = start > e.start;
+    bool tail = e.end - start > sz;
+    if (head && tail) {
+      // Splits in two; needs a free slot
+      if (extCount == kMaxExtents) continue;
+      for (uint32_t j = extCount; j > i + 1; --j) ext[j] = ext[j - 1];
+      ext[i].end = start;
+      ext[i + 1] = Extent {start + sz, e.end};
+      extCount++;
+    } else if (head) {
+      ext[i].end = start;
+    } else if (tail) {
+      ext[i].start = start + sz;
+    } else {
+      for (uint32_t j = i + 1; j < extCount; ++j) ext[j - 1] = ext[j];
+      extCount--;
+    }
+    st.allocs++;
+    IOLockUnlock(lock);
+    *outOffset = start;
+    return true;
+  }
+  st.failures++;
+  IOLockUnlock(lock);
+  return false;
+}
+
+// Insert in offset order, merging with the neighbours it touches (lock held)
+void XeStolen::freeLocked(uint32_t offset, uint32_t bytes) {
+  uint32_t end = offset + ((bytes + kPageBytes - 1) & ~(kPageBytes - 1));
+  uint32_t i = 0;
+  while (i < extCount && ext[i].start < offset) i++;
+  bool prev = i > 0 && ext[i - 1].end == offset;
+  bool next = i < extCount && ext[i].start == end;
+  if (prev && next) {
+    ext[i - 1].end = ext[i].end;
+    for (uint32_t j = i + 1; j < extCount; ++j) ext[j - 1] = ext[j];
+    extCount--;
+  } else if (prev) {
+    ext[i - 1].end = end;
+  } else if (next) {
+    ext[i].start = offset;
+  } else if (extCount < kMaxExtents) {
+    for (uint32_t j = extCount; j > i; --j) ext[j] = ext[j - 1];
+    ext[i] = Extent {offset, end};
+    extCount++;
+  } else {
+    st.leaked++;
+    return;
+  }
+  st.frees++;
+}
+
+void XeStolen::free(uint32_t offset, uint32_t bytes) {
+  if (!lock || !bytes || offset >= usable) return;
+  IOLockLock(lock);
+  freeLocked(offset, bytes);
+  IOLockUnlock(lock);
+}
+
+IOMemoryDescriptor* XeStolen::describe(uint32_t offset, uint32_t bytes) {
+  if (!usable || offset >= usable) return nullptr;
+  uint32_t sz = (bytes + kPageBytes - 1) & ~(kPageBytes - 1);
+  IOMemoryDescriptor* md = IOMemoryDescriptor::withAddressRange(aperturePhys + window + offset, sz,
+                                                                kIODirectionInOut | kIOMemoryTypePhysical64,
+                                                                TASK_NULL);
+  if (md && !baseRefs) __atomic_store_n(&baseRefs, (uint32_t)md->getRetainCount(), __ATOMIC_RELAXED);
+  return md;
+}
+
+// Frees every retired range the GPU and the clients are done with (lock held)
+void XeStolen::reapLocked(const uint32_t completed[kXeEngineCount]) {
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < retiredCount; ++i) {
+    Retired& r = retired[i];
+    bool idle = (uint32_t)r.md->getRetainCount() <= baseRefs;
+    for (uint32_t e = 0; idle && e < kXeEngineCount; ++e) {
+      if ((int32_t)(completed[e] - r.busy[e]) < 0) idle = false;
+    }
+    if (!idle) {
+      retired[kept++] = r;
+      continue;
+    }
+    r.md->release();
+    freeLocked(r.offset, r.bytes);
+  }
+  retiredCount = kept;
+}
+
+void XeStolen::retire(IOMemoryDescriptor* md, uint32_t offset, uint32_t bytes,
+                      const uint32_t busy[kXeEngineCount], const uint32_t completed[kXeEngineCount]) {
+  if (!md) return;
+  if (!lock) {
+    md->release();
+    return;
+  }
+  IOLockLock(lock);
+  reapLocked(completed);
+  if (retiredCount == kMaxRetired) {
+    XeLog("XeStolen::retire: WARNING - %u ranges retiring, dropping 0x%x+%u\n", kMaxRetired, offset, bytes);
+    md->release();
+    st.leaked++;
+  } else {
+    Retired& r = retired[retiredCount++];
+    r.md = md;
+    r.offset = offset;
+    r.bytes = bytes;
+    for (uint32_t e = 0; e < kXeEngineCount; ++e) r.busy[e] = busy[e];
+    reapLocked(completed);
+  }
+  IOLockUnlock(lock);
+}
+
+void XeStolen::reap(const uint32_t completed[kXeEngineCount]) {
+  if (!lock) return;
+  IOLockLock(lock);
+  reapLocked(completed);
+  IOLockUnlock(lock);
+}
+
+uint64_t XeStolen::freeBytes() const {
+  if (!lock) return 0;
+  IOLockLock(lock);
+  uint64_t n = 0;
+  for (uint32_t i = 0; i < extCount; ++i) n += ext[i].end - ext[i].start;
+  IOLockUnlock(lock);
+  return n;
+}
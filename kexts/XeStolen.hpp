@@ -0,0 +1,105 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOMemoryDescriptor.h>
+#include <IOKit/pci/IOPCIDevice.h>
+#include "xe_hw_offsets.hpp"
+#include "XeEngine.hpp"
+#include "XeGGTT.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Stolen memory (DSM): the physically contiguous range of system RAM the
+// BIOS sets aside for the iGPU. Its base comes from BDSM and its size from
+// GGC.GMS (PCI config); the top is clipped where GEN6_STOLEN_RESERVED
+// begins, and the pages the firmware framebuffer still scans out of are
+// kept off the free list.
+//
+// init() binds the whole usable range once into a window of the
+// CPU-visible GGTT (the BAR2 aperture) that avoids the firmware
+// framebuffer's binding. An object's GGTT address is then window + its
+// stolen offset and its kernel view is the aperture mapping (write-
+// combined) at that address, so allocating never writes a PTE. The CPU
+// only ever reaches stolen memory through the aperture, so writers sfence
+// and nothing needs a clflush.
+//
+// Free space is a sorted list of extents, allocated first-fit and
+// coalesced on free. Client objects are retire()d instead of freed: their
+// range comes back only once every engine is past their last seqno and no
+// user mapping of their descriptor is left.
+//
+// Every call takes the allocator's own lock.
+class XeStolen {
+public:
+  static constexpr uint32_t kMaxExtents   = 64;
+  static constexpr uint32_t kMaxRetired   = 32;
+  static constexpr uint32_t kPageBytes    = 4096;
+  static constexpr uint32_t kWindowAlign  = 1u << 20;
+  static constexpr uint32_t kScanoutAlign = 256 * 1024;   // surface base alignment
+
+  struct Stats {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;      // no extent large enough: the caller used system RAM
+    uint64_t leaked;        // ranges dropped with the extent or retire list full
+  };
+
+  bool init(IOPCIDevice* pci, volatile uint32_t* mmio);
+  void destroy();
+  bool ready() const { return usable != 0; }
+
+  // bytes is rounded up to pages, align is a power of two of at least a
+  // page. On success *outOffset is the object's offset into DSM.
+  bool alloc(uint32_t bytes, uint32_t align, uint32_t* outOffset);
+  void free(uint32_t offset, uint32_t bytes);
+
+  uint32_t ggtt(uint32_t offset) const { return window + offset; }
+  uint8_t* cpu(uint32_t offset) const  { return aperture + window + offset; }
+  bool     owns(uint32_t ggttAddr) const { return usable && ggttAddr - window < usable; }
+  uint32_t offsetOf(uint32_t ggttAddr) const { return ggttAddr - window; }
+
+  // A descriptor of the object's aperture range, for mapping it into a
+  // client. The caller owns the reference.
+  IOMemoryDescriptor* describe(uint32_t offset, uint32_t bytes);
+
+  // Takes over md's reference (from describe()); the range is freed once
+  // completed[] has passed busy[] on every engine and md is unmapped
+  void retire(IOMemoryDescriptor* md, uint32_t offset, uint32_t bytes,
+              const uint32_t busy[kXeEngineCount], const uint32_t completed[kXeEngineCount]);
+  void reap(const uint32_t completed[kXeEngineCount]);
+
+  uint64_t     size() const { return usable; }
+  uint64_t     freeBytes() const;
+  uint64_t     base() const { return dsmBase; }
+  const Stats& stats() const { return st; }
+
+private:
+  struct Extent {
+    uint32_t start;
+    uint32_t end;           // exclusive
+  };
+  struct Retired {
+    IOMemoryDescriptor* md;
+    uint32_t            offset;
+    uint32_t            bytes;
+    uint32_t            busy[kXeEngineCount];
+  };
+
+  IOLock*            lock {nullptr};
+  volatile uint32_t* m {nullptr};
+  IOMemoryMap*       apertureMap {nullptr};
+  uint8_t*           aperture {nullptr};
+  uint64_t           aperturePhys {0};
+  uint64_t           dsmBase {0};
+  uint32_t           usable {0};     // bytes of DSM the window maps
+  uint32_t           window {0};     // GGTT address of DSM offset 0
+  Extent             ext[kMaxExtents] {};
+  uint32_t           extCount {0};
+  Retired            retired[kMaxRetired] {};
+  uint32_t           retiredCount {0};
+  uint32_t           baseRefs {0};   // retain count of an unmapped descriptor
+  Stats              st {};
+
+  void freeLocked(uint32_t offset, uint32_t bytes);
+  void reapLocked(const uint32_t completed[kXeEngineCount]);
+};
@@ -0,0 +1,93 @@
+#include "XeSubAllocator.hpp"
+
+IOReturn XeSubAllocator::alloc(uint32_t bytes, const uint32_t completed[kXeEngineCount], XeBoPool& pool,
+                               volatile uint32_t* mmio, Chunk* out) {
+  uint32_t cls = XeSlabHeap::classOf(bytes);
+  if (!out || bytes == 0 || cls >= XeSlabHeap::kClassCount) return kIOReturnBadArgument;
+
+  uint32_t slab = XeSlabHeap::kNoSlab, offset = 0;
+  if (!heap.alloc(bytes, &slab, &offset)) {
+    // Every slab of the class is full: take a 64K BO from the pool
+    uint32_t ggtt = 0;
+    IOBufferMemoryDescriptor* md = pool.acquire(XeSlabHeap::kSlabBytes, completed, &ggtt);
+    if (!md) return kIOReturnNoResources;
+    if (!ggtt) {
+      ggtt = pool.allocGgtt(XeSlabHeap::kSlabBytes);
+      if (!ggtt || !XeGGTT::insertPages(mmio, ggtt, md)) {
+        XeLog("XeSubAllocator::alloc: ERROR - GGTT bind failed\n");
+        // Clears whatever PTEs were written before the pages go back
+        pool.releaseGgtt(ggtt, XeSlabHeap::kSlabBytes);
+        uint32_t idle[kXeEngineCount] {};
+        pool.release(md, 0, idle, completed);
+        return kIOReturnNoResources;
+      }
+    }
+    slab = heap.addSlab(md, cls);
+    if (slab == XeSlabHeap::kNoSlab) {
+      XeLog("XeSubAllocator::alloc: ERROR - %u slabs in use\n", XeSlabHeap::kMaxSlabs);
+      uint32_t idle[kXeEngineCount] {};
+      pool.release(md, ggtt, idle, completed);
+      return kIOReturnNoResources;
+    }
+    backing[slab] = Backing {md, ggtt, {}};
+    if (acct) acct->chargeBuffer(XeSlabHeap::kSlabBytes, true);
+    st.slabsAdded++;
+    if (!heap.alloc(bytes, &slab, &offset)) return kIOReturnNoResources;
+  }
+
+  Backing& b = backing[slab];
+  out->md = b.md;
+  out->cpu = (uint8_t*)b.md->getBytesNoCopy() + offset;
+  out->ggtt = b.ggtt + offset;
+  out->offset = offset;
+  out->bytes = XeSlabHeap::chunkBytes(cls);
+  // Chunks are recycled without a trip through the pool's bzero
+  bzero(out->cpu, out->bytes);
+  st.allocs++;
+  return kIOReturnSuccess;
+}
+
+uint32_t XeSubAllocator::slabOf(IOMemoryDescriptor* md) const {
+  for (uint32_t s = 0; s < XeSlabHeap::kMaxSlabs; ++s) {
+    if (heap.slab(s).backing && backing[s].md == md) return s;
+  }
+  return XeSlabHeap::kNoSlab;
+}
+
+void XeSubAllocator::returnSlab(uint32_t slab, const uint32_t completed[kXeEngineCount], XeBoPool& pool) {
+  Backing b = backing[slab];
+  heap.removeSlab(slab);
+  backing[slab] = Backing {};
+  if (acct) acct->unchargeBuffer(XeSlabHeap::kSlabBytes, true);
+  pool.release(b.md, b.ggtt, b.busy, completed);
+  st.slabsReturned++;
+}
+
+void XeSubAllocator::free(IOMemoryDescriptor* md, uint32_t offset, const uint32_t busy[kXeEngineCount],
+                          const uint32_t completed[kXeEngineCount], XeBoPool& pool) {
+  uint32_t slab = slabOf(md);
+  if (slab == XeSlabHeap::kNoSlab) return;
+  Backing& b = backing[slab];
+  for (uint32_t e = 0; e < kXeEngineCount; ++e) {
+    if ((int32_t)(busy[e] - b.busy[e]) > 0) b.busy[e] = busy[e];
+  }
+  st.frees++;
+  if (heap.free(slab, offset)) returnSlab(slab, completed, pool);
+}
+
+void XeSubAllocator::destroy(const uint32_t completed[kXeEngineCount], XeBoPool& pool) {
+  uint32_t n = heap.count();
+  for (uint32_t s = 0; s < XeSlabHeap::kMaxSlabs; ++s) {
+    if (!heap.slab(s).backing) continue;
+    if (heap.slab(s).used) {
+      // An entry outlived the client's table; leave the slab to its references
+      XeLog("XeSubAllocator::destroy: slab %u still has %u chunks\n", s, heap.slab(s).used);
+      continue;
+    }
+    returnSlab(s, completed, pool);
+  }
+  if (n) {
+    XeLog("XeSubAllocator::destroy: returned %u slabs (allocs=%llu frees=%llu)\n", n,
+          (unsigned long long)st.allocs, (unsigned long long)st.frees);
+  }
+}
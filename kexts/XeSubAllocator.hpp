@@ -0,0 +1,74 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "XeEngine.hpp"
+#include "XeBoPool.hpp"
+#include "XeSlab.hpp"
+#include "XeMemAccount.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Per-client small-BO allocator: XeSlabHeap bookkeeping over 64K backing
+// BOs taken from (and returned to) the size-class pool. Each slab is bound
+// into the GGTT once; a chunk is addressed as slab + offset, so small
+// command and state buffers cost neither their own descriptor nor their
+// own page of PTEs.
+//
+// Every BO table entry made from a chunk holds a reference on the slab's
+// descriptor, which keeps in-flight submits valid. The slab itself goes
+// back to the pool (with the merged busy seqnos of its chunks) once it is
+// empty and its class has room elsewhere, or when the client closes.
+// Slabs, not chunks, are charged to the client's account (allocated and
+// bound) for as long as the allocator holds them.
+//
+// Not locked: every call runs under the service's command gate.
+class XeSubAllocator {
+public:
+  static_assert(XeSlabHeap::kSlabBytes == XeBoPool::kMinBytes << 4, "slabs must be a pool size class");
+
+  struct Chunk {
+    IOBufferMemoryDescriptor* md;     // the slab; not retained for the caller
+    uint8_t*                  cpu;    // kernel address of the chunk
+    uint32_t                  ggtt;   // GGTT address of the chunk
+    uint32_t                  offset; // within the slab
+    uint32_t                  bytes;  // chunk size
+  };
+
+  struct Stats {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t slabsAdded;
+    uint64_t slabsReturned;
+  };
+
+  IOReturn alloc(uint32_t bytes, const uint32_t completed[kXeEngineCount], XeBoPool& pool,
+                 volatile uint32_t* mmio, Chunk* out);
+
+  // A table entry made from md + offset went away; busy[e] is its last
+  // seqno on engine e
+  void     free(IOMemoryDescriptor* md, uint32_t offset, const uint32_t busy[kXeEngineCount],
+                const uint32_t completed[kXeEngineCount], XeBoPool& pool);
+
+  // Client teardown, after every entry has been freed
+  void     destroy(const uint32_t completed[kXeEngineCount], XeBoPool& pool);
+
+  void         setAccount(XeMemAccount* account) { acct = account; }
+  uint32_t     slabs() const { return heap.count(); }
+  const Stats& stats() const { return st; }
+
+private:
+  struct Backing {
+    IOBufferMemoryDescriptor* md;
+    uint32_t                  ggtt;
+    uint32_t                  busy[kXeEngineCount];
+  };
+
+  XeMemAccount* acct {nullptr};
+  XeSlabHeap    heap;
+  Backing       backing[XeSlabHeap::kMaxSlabs] {};   // indexed like the heap's slabs
+  Stats         st {};
+
+  uint32_t slabOf(IOMemoryDescriptor* md) const;
+  void     returnSlab(uint32_t slab, const uint32_t completed[kXeEngineCount], XeBoPool& pool);
+};
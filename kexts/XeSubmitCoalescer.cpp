@@ -0,0 +1,25 @@
+#include "XeSubmitCoalescer.hpp"
+
+bool XeSubmitCoalescer::noteSubmit(bool latencyCritical, FlushReason* reason) {
+  st.submits++;
+  pending++;
+
+  if (latencyCritical) {
+    st.bypassed++;
+    *reason = kFlushBypass;
+    return true;
+  }
+  if (window == 0 || pending >= limit) {
+    *reason = kFlushLimit;
+    return true;
+  }
+  return false;
+}
+
+void XeSubmitCoalescer::noteFlush(FlushReason reason) {
+  if (!pending || reason >= kFlushReasonCount) return;
+  st.doorbells++;
+  st.flushes[reason]++;
+  if (pending > st.maxBurst) st.maxBurst = pending;
+  pending = 0;
+}
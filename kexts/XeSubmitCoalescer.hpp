@@ -0,0 +1,57 @@
+#pragma once
+#include <IOKit/IOLib.h>
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Per-engine doorbell coalescing.
+//
+// Every kick is an uncached MMIO write that may wake the engine. Submits
+// are emitted into the ring immediately, but the kick is deferred until the
+// coalescing window closes, the batch limit is hit, a latency-critical
+// submit arrives, or someone waits. The caller owns the timer and runs all
+// of this under the service's command gate.
+class XeSubmitCoalescer {
+public:
+  static constexpr uint32_t kDefaultWindowUs   = 50;
+  static constexpr uint32_t kDefaultBatchLimit = 8;
+
+  enum FlushReason : uint32_t {
+    kFlushWindow = 0,     // timer expired
+    kFlushLimit,          // batch limit reached
+    kFlushBypass,         // latency-critical submit
+    kFlushWait,           // a waiter needs the work on the hardware
+    kFlushReasonCount
+  };
+
+  struct Stats {
+    uint64_t submits;
+    uint64_t doorbells;
+    uint64_t bypassed;
+    uint64_t maxBurst;
+    uint64_t flushes[kFlushReasonCount];
+  };
+
+  void configure(uint32_t windowUs, uint32_t batchLimit) {
+    window = windowUs;
+    limit  = batchLimit ? batchLimit : 1;
+  }
+
+  // Record one submit already emitted into the ring. Returns true when the
+  // caller must kick now; *reason tells why.
+  bool noteSubmit(bool latencyCritical, FlushReason* reason);
+
+  // Record that the doorbell was rung for everything pending.
+  void noteFlush(FlushReason reason);
+
+  bool     hasPending() const { return pending != 0; }
+  uint32_t pendingSubmits() const { return pending; }
+  uint32_t windowUs() const   { return window; }
+  const Stats& stats() const  { return st; }
+
+private:
+  uint32_t window  {kDefaultWindowUs};
+  uint32_t limit   {kDefaultBatchLimit};
+  uint32_t pending {0};
+  Stats    st {};
+};
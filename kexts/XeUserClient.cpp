@@ -9,12 +9,24 @@ extern void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
 
 // Each entry: { function, scalarInCnt, structInSize, scalarOutCnt, structOutSize }
 const IOExternalMethodDispatch XeUserClient::sMethods[] = {
-  /* 0 kMethodCreateBuffer  */ { (IOExternalMethodAction)&XeUserClient::sCreateBuffer,   1, 0, 1, 0 },
-  /* 1 kMethodSubmit        */ { (IOExternalMethodAction)&XeUserClient::sSubmit,         0, 0, 0, 0 },
-  /* 2 kMethodWait          */ { (IOExternalMethodAction)&XeUserClient::sWait,           1, 0, 0, 0 },
+  /* 0 kMethodCreateBuffer  */ { (IOExternalMethodAction)&XeUserClient::sCreateBuffer,   kIOUCVariableStructureSize, 0, 1, 0 },
+  /* 1 kMethodSubmit        */ { (IOExternalMethodAction)&XeUserClient::sSubmit,         2, 0, 1, 0 },
+  /* 2 kMethodWait          */ { (IOExternalMethodAction)&XeUserClient::sWait,           kIOUCVariableStructureSize, 0, 0, 0 },
   /* 3 kMethodReadReg       */ { (IOExternalMethodAction)&XeUserClient::sReadRegs,       0, 0, 8, 0 },
   /* 4 kMethodGetGTConfig   */ { (IOExternalMethodAction)&XeUserClient::sGetGTConfig,    0, 0, 8, 0 },
   /* 5 kMethodGetDisplayInfo*/ { (IOExternalMethodAction)&XeUserClient::sGetDisplayInfo, 0, 0, 8, 0 },
+  /* 6 kMethodGetSubmitStats*/ { (IOExternalMethodAction)&XeUserClient::sGetSubmitStats, 1, 0, kSubmitStatCount, 0 },
+  /* 7 kMethodGetSubmitLatency*/ { (IOExternalMethodAction)&XeUserClient::sGetSubmitLatency, 1, 0, kSubmitLatCount, 0 },
+  /* 8 kMethodSubmitBatch   */ { (IOExternalMethodAction)&XeUserClient::sSubmitBatch,    kIOUCVariableStructureSize, 0, 1, 0 },
+  /* 9 kMethodGetGuCStats   */ { (IOExternalMethodAction)&XeUserClient::sGetGuCStats,    0, 0, kGuCStatCount, 0 },
+  /* 10 kMethodDestroyBuffer*/ { (IOExternalMethodAction)&XeUserClient::sDestroyBuffer,  1, 0, 0, 0 },
+  /* 11 kMethodExportBuffer */ { (IOExternalMethodAction)&XeUserClient::sExportBuffer,   1, 0, 1, 0 },
+  /* 12 kMethodImportBuffer */ { (IOExternalMethodAction)&XeUserClient::sImportBuffer,   1, 0, 1, 0 },
+  /* 13 kMethodImportUserptr*/ { (IOExternalMethodAction)&XeUserClient::sImportUserptr,  2, 0, 1, 0 },
+  /* 14 kMethodCreateSubBuffer*/ { (IOExternalMethodAction)&XeUserClient::sCreateSubBuffer, 1, 0, 2, 0 },
+  /* 15 kMethodGetMemStats  */ { (IOExternalMethodAction)&XeUserClient::sGetMemStats,    0, 0, kMemStatCount, 0 },
+  /* 16 kMethodFlushBuffer  */ { (IOExternalMethodAction)&XeUserClient::sFlushBuffer,    kIOUCVariableStructureSize, 0, 1, 0 },
+  /* 17 kMethodMadvise      */ { (IOExternalMethodAction)&XeUserClient::sMadvise,        2, 0, 1, 0 },
 };
 
 bool XeUserClient::initWithTask(task_t owningTask, void*, UInt32) {
@@ -24,6 +36,10 @@ bool XeUserClient::initWithTask(task_t owningTask, void*, UInt32) {
     return false;
   }
   clientTask = owningTask;
+  if (!bos.init(&mem)) {
+    XeLog("XeUserClient::initWithTask: ERROR - BO table allocation failed\n");
+    return false;
+  }
   return true;
 }
 
@@ -38,16 +54,44 @@ bool XeUserClient::start(IOService* provider) {
     XeLog("XeUserClient::start: ERROR - provider is not XeService\n");
     return false;
   }
+  // Charges made from here on also count towards the service's totals
+  mem.parent = providerSvc->memAccount();
+  userptrs.setAccount(&mem);
+  subs.setAccount(&mem);
   XeLog("XeUserClient::start: SUCCESS\n");
   return true;
 }
 
 IOReturn XeUserClient::clientClose() {
   XeLog("XeUserClient::clientClose\n");
+  if (providerSvc) {
+    providerSvc->releaseClientBuffers(bos, userptrs, subs);
+    providerSvc->closeClientContexts(contexts);
+  }
+  bos.destroy(nullptr);
   terminate();
   return kIOReturnSuccess;
 }
 
+// Log relay and GuC log (kXeMemory*): shared read-only, so a client can
+// stream them without a call per record and cannot disturb the writer.
+// kXeMemoryBuffer types map one of this client's BOs read-write, in the
+// cache mode it was created with unless the caller's map options ask for
+// another one.
+IOReturn XeUserClient::clientMemoryForType(UInt32 type, IOOptionBits* options, IOMemoryDescriptor** memory) {
+  if (!providerSvc || !options || !memory) return kIOReturnNotReady;
+  IOMemoryDescriptor* md = nullptr;
+  bool buffer = (type & kXeMemoryBuffer) != 0;
+  IOReturn kr = buffer ? providerSvc->ucBufferMemory(bos, type, &md) : providerSvc->ucLogMemory(type, &md);
+  if (kr != kIOReturnSuccess) {
+    XeLog("XeUserClient::clientMemoryForType: type 0x%x unavailable (0x%x)\n", (unsigned)type, kr);
+    return kr;
+  }
+  *options = buffer ? 0 : kIOMapReadOnly;
+  *memory = md;      // retained; IOUserClient releases it once mapped
+  return kIOReturnSuccess;
+}
+
 IOReturn XeUserClient::externalMethod(uint32_t selector,
                                       IOExternalMethodArguments* args,
                                       IOExternalMethodDispatch* dispatch,
@@ -102,9 +146,10 @@ IOReturn XeUserClient::sCreateBuffer(OSObject* t, void*, IOExternalMethodArgumen
     if (bytes == 0) bytes = 4096;
     if (bytes > 64 * 1024 * 1024) bytes = 64 * 1024 * 1024;
   }
+  uint32_t flags = (a->scalarInputCount >= 2) ? (uint32_t)a->scalarInput[1] : 0;
 
   uint64_t cookie = 0;
-  IOReturn kr = self->providerSvc->ucCreateBuffer(bytes, &cookie);
+  IOReturn kr = self->providerSvc->ucCreateBuffer(self->bos, self->userptrs, bytes, flags, &cookie);
   if (kr == kIOReturnSuccess && a->scalarOutputCount >= 1) {
     a->scalarOutput[0] = cookie;
     a->scalarOutputCount = 1;
@@ -115,16 +160,65 @@ IOReturn XeUserClient::sCreateBuffer(OSObject* t, void*, IOExternalMethodArgumen
 IOReturn XeUserClient::sSubmit(OSObject* t, void*, IOExternalMethodArguments* a) {
   XeLog("XeUserClient::sSubmit\n");
   
-  if (!t) return kIOReturnBadArgument;
+  if (!t || !a) return kIOReturnBadArgument;
   
   auto self = OSDynamicCast(XeUserClient, t);
   if (!self || !self->providerSvc) {
     XeLog("XeUserClient::sSubmit: ERROR - not ready\n");
     return kIOReturnNotReady;
   }
-  return self->providerSvc->ucSubmitNoop();
+
+  // Engine index into kXeEngines (0 = rcs0)
+  uint32_t engine = kXeEngineRCS0;
+  if (a->scalarInputCount >= 1) {
+    if (a->scalarInput[0] >= kXeEngineCount) return kIOReturnBadArgument;
+    engine = (uint32_t)a->scalarInput[0];
+  }
+  uint32_t flags = 0;
+  if (a->scalarInputCount >= 2) {
+    flags = (uint32_t)a->scalarInput[1] & kSubmitFlagLatencyCritical;
+  }
+  uint32_t seqno = 0;
+  IOReturn kr = self->providerSvc->ucSubmitNoop(self->contexts, engine, flags, &seqno);
+  if (kr == kIOReturnSuccess && a->scalarOutputCount >= 1) {
+    a->scalarOutput[0] = seqno;
+    a->scalarOutputCount = 1;
+  }
+  return kr;
 }
 
+// in: engine, flags, then 1..XeBatchValidator::kMaxLinks BO cookies
+// out: seqno for kMethodWait
+IOReturn XeUserClient::sSubmitBatch(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sSubmitBatch\n");
+
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sSubmitBatch: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+
+  if (a->scalarInputCount < 3 || a->scalarInputCount > 2 + XeBatchValidator::kMaxLinks) {
+    XeLog("XeUserClient::sSubmitBatch: ERROR - %u scalar inputs\n", a->scalarInputCount);
+    return kIOReturnBadArgument;
+  }
+  if (a->scalarInput[0] >= kXeEngineCount) return kIOReturnBadArgument;
+  uint32_t engine = (uint32_t)a->scalarInput[0];
+  uint32_t flags  = (uint32_t)a->scalarInput[1] & kSubmitFlagLatencyCritical;
+  uint32_t seqno  = 0;
+  IOReturn kr = self->providerSvc->ucSubmitBatch(self->bos, self->contexts, engine, flags, &a->scalarInput[2],
+                                                 a->scalarInputCount - 2, &seqno);
+  if (kr == kIOReturnSuccess && a->scalarOutputCount >= 1) {
+    a->scalarOutput[0] = seqno;
+    a->scalarOutputCount = 1;
+  }
+  return kr;
+}
+
+// in: timeoutMs, optionally engine + seqno from a submit (without them:
+// everything submitted so far on every engine)
 IOReturn XeUserClient::sWait(OSObject* t, void*, IOExternalMethodArguments* a) {
   XeLog("XeUserClient::sWait\n");
   
@@ -143,7 +237,17 @@ IOReturn XeUserClient::sWait(OSObject* t, void*, IOExternalMethodArguments* a) {
     if (timeoutMs == 0) timeoutMs = 1000;
     if (timeoutMs > 60000) timeoutMs = 60000;
   }
-  return self->providerSvc->ucWait(timeoutMs);
+  uint32_t engine = kXeEngineCount;
+  uint32_t seqno  = 0;
+  if (a->scalarInputCount == 3) {
+    if (a->scalarInput[1] >= kXeEngineCount) return kIOReturnBadArgument;
+    engine = (uint32_t)a->scalarInput[1];
+    seqno  = (uint32_t)a->scalarInput[2];
+  } else if (a->scalarInputCount > 1) {
+    XeLog("XeUserClient::sWait: ERROR - %u scalar inputs\n", a->scalarInputCount);
+    return kIOReturnBadArgument;
+  }
+  return self->providerSvc->ucWait(engine, seqno, timeoutMs);
 }
 
 IOReturn XeUserClient::sReadRegs(OSObject* t, void*, IOExternalMethodArguments* a) {
@@ -219,6 +323,247 @@ IOReturn XeUserClient::sGetDisplayInfo(OSObject* t, void*, IOExternalMethodArgum
   return kr;
 }
 
+IOReturn XeUserClient::sGetSubmitStats(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sGetSubmitStats\n");
+  
+  if (!t || !a) return kIOReturnBadArgument;
+  
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sGetSubmitStats: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+
+  if (a->scalarInputCount < 1 || a->scalarInput[0] >= kXeEngineCount) return kIOReturnBadArgument;
+  uint32_t engine = (uint32_t)a->scalarInput[0];
+
+  uint64_t tmp[kSubmitStatCount] = {};
+  uint32_t n = kSubmitStatCount;
+  IOReturn kr = self->providerSvc->ucGetSubmitStats(engine, tmp, &n);
+  if (kr == kIOReturnSuccess) {
+    uint32_t outMax = (a->scalarOutputCount < n) ? a->scalarOutputCount : n;
+    for (uint32_t i = 0; i < outMax; ++i) {
+      a->scalarOutput[i] = tmp[i];
+    }
+    a->scalarOutputCount = outMax;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sGetSubmitLatency(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sGetSubmitLatency\n");
+
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sGetSubmitLatency: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+
+  if (a->scalarInputCount < 1 || a->scalarInput[0] >= kXeEngineCount) return kIOReturnBadArgument;
+  uint32_t engine = (uint32_t)a->scalarInput[0];
+
+  uint64_t tmp[kSubmitLatCount] = {};
+  uint32_t n = kSubmitLatCount;
+  IOReturn kr = self->providerSvc->ucGetSubmitLatency(engine, tmp, &n);
+  if (kr == kIOReturnSuccess) {
+    uint32_t outMax = (a->scalarOutputCount < n) ? a->scalarOutputCount : n;
+    for (uint32_t i = 0; i < outMax; ++i) {
+      a->scalarOutput[i] = tmp[i];
+    }
+    a->scalarOutputCount = outMax;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sGetGuCStats(OSObject* t, void*, IOExternalMethodArguments* a) {
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sGetGuCStats: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+
+  uint64_t tmp[kGuCStatCount] = {};
+  uint32_t n = kGuCStatCount;
+  IOReturn kr = self->providerSvc->ucGetGuCStats(tmp, &n);
+  if (kr == kIOReturnSuccess) {
+    uint32_t outMax = (a->scalarOutputCount < n) ? a->scalarOutputCount : n;
+    for (uint32_t i = 0; i < outMax; ++i) {
+      a->scalarOutput[i] = tmp[i];
+    }
+    a->scalarOutputCount = outMax;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sDestroyBuffer(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sDestroyBuffer\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sDestroyBuffer: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+  return self->providerSvc->ucDestroyBuffer(self->bos, a->scalarInput[0]);
+}
+
+IOReturn XeUserClient::sExportBuffer(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sExportBuffer\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sExportBuffer: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+  uint64_t name = 0;
+  IOReturn kr = self->providerSvc->ucExportBuffer(self->bos, a->scalarInput[0], &name);
+  if (kr == kIOReturnSuccess) {
+    a->scalarOutput[0] = name;
+    a->scalarOutputCount = 1;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sImportBuffer(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sImportBuffer\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sImportBuffer: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+  uint64_t cookie = 0;
+  IOReturn kr = self->providerSvc->ucImportBuffer(self->bos, a->scalarInput[0], &cookie);
+  if (kr == kIOReturnSuccess) {
+    a->scalarOutput[0] = cookie;
+    a->scalarOutputCount = 1;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sImportUserptr(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sImportUserptr\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sImportUserptr: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+  uint64_t cookie = 0;
+  IOReturn kr = self->providerSvc->ucImportUserptr(self->bos, self->userptrs, self->clientTask,
+                                                   a->scalarInput[0], a->scalarInput[1], &cookie);
+  if (kr == kIOReturnSuccess) {
+    a->scalarOutput[0] = cookie;
+    a->scalarOutputCount = 1;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sCreateSubBuffer(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sCreateSubBuffer\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sCreateSubBuffer: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+  if (a->scalarInput[0] == 0 || a->scalarInput[0] > XeSlabHeap::kMaxChunk) return kIOReturnBadArgument;
+  uint64_t cookie = 0;
+  uint32_t offset = 0;
+  IOReturn kr = self->providerSvc->ucCreateSubBuffer(self->bos, self->subs, (uint32_t)a->scalarInput[0],
+                                                     &cookie, &offset);
+  if (kr == kIOReturnSuccess) {
+    a->scalarOutput[0] = cookie;
+    a->scalarOutput[1] = offset;
+    a->scalarOutputCount = 2;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sGetMemStats(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sGetMemStats\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sGetMemStats: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+
+  uint64_t tmp[kMemStatCount] = {};
+  uint32_t n = kMemStatCount;
+  IOReturn kr = self->providerSvc->ucGetMemStats(self->bos, tmp, &n);
+  if (kr == kIOReturnSuccess) {
+    uint32_t outMax = (a->scalarOutputCount < n) ? a->scalarOutputCount : n;
+    for (uint32_t i = 0; i < outMax; ++i) {
+      a->scalarOutput[i] = tmp[i];
+    }
+    a->scalarOutputCount = outMax;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sFlushBuffer(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sFlushBuffer\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sFlushBuffer: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+  if (a->scalarInputCount < 2 || a->scalarInputCount > 2 + kFlushMaxRanges) return kIOReturnBadArgument;
+  uint64_t lines = 0;
+  IOReturn kr = self->providerSvc->ucFlushBuffer(self->bos, a->scalarInput[0], (uint32_t)a->scalarInput[1],
+                                                 &a->scalarInput[2], a->scalarInputCount - 2, &lines);
+  if (kr == kIOReturnSuccess) {
+    a->scalarOutput[0] = lines;
+    a->scalarOutputCount = 1;
+  }
+  return kr;
+}
+
+IOReturn XeUserClient::sMadvise(OSObject* t, void*, IOExternalMethodArguments* a) {
+  XeLog("XeUserClient::sMadvise\n");
+
+  // Safety: validate all pointers
+  if (!t || !a) return kIOReturnBadArgument;
+
+  auto self = OSDynamicCast(XeUserClient, t);
+  if (!self || !self->providerSvc) {
+    XeLog("XeUserClient::sMadvise: ERROR - not ready\n");
+    return kIOReturnNotReady;
+  }
+  if (a->scalarInput[1] > kMadviseDontNeed) return kIOReturnBadArgument;
+  uint64_t retained = 0;
+  IOReturn kr = self->providerSvc->ucMadvise(self->bos, a->scalarInput[0], (uint32_t)a->scalarInput[1], &retained);
+  if (kr == kIOReturnSuccess) {
+    a->scalarOutput[0] = retained;
+    a->scalarOutputCount = 1;
+  }
+  return kr;
+}
+
 // Factory used by XeService::newUserClient
 extern "C" IOUserClient* XeCreateUserClient(XeService* provider, task_t task, void* secID, UInt32 type) {
   XeLog("XeCreateUserClient: creating user client\n");
@@ -10,6 +10,11 @@ class XeUserClient final : public IOUserClient {
 private:
   task_t     clientTask {nullptr};
   XeService* providerSvc {nullptr};
+  XeLogicalContext* contexts[kXeEngineCount] {};   // taken on first submit; null: kernel context
+  XeBoTable  bos;                                   // this client's BO namespace
+  XeUserptrCache userptrs;                          // ranges of clientTask pinned as BOs
+  XeSubAllocator subs;                              // slabs for this client's small BOs
+  XeMemAccount   mem;                               // what bos, userptrs and subs hold (kMethodGetMemStats)
 
   // Static dispatchers used by IOExternalMethodDispatch
   static IOReturn sCreateBuffer  (OSObject* target, void* ref, IOExternalMethodArguments* args);
@@ -18,6 +23,18 @@ private:
   static IOReturn sReadRegs      (OSObject* target, void* ref, IOExternalMethodArguments* args);
   static IOReturn sGetGTConfig   (OSObject* target, void* ref, IOExternalMethodArguments* args);
   static IOReturn sGetDisplayInfo(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sGetSubmitStats(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sGetSubmitLatency(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sSubmitBatch(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sGetGuCStats(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sDestroyBuffer(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sExportBuffer(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sImportBuffer(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sImportUserptr(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sCreateSubBuffer(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sGetMemStats(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sFlushBuffer(OSObject* target, void* ref, IOExternalMethodArguments* args);
+  static IOReturn sMadvise(OSObject* target, void* ref, IOExternalMethodArguments* args);
 
   static const IOExternalMethodDispatch sMethods[];
 
@@ -26,6 +43,7 @@ public:
   bool     initWithTask(task_t owningTask, void* securityID, UInt32 type) override;
   bool     start(IOService* provider) override;
   IOReturn clientClose() override;
+  IOReturn clientMemoryForType(UInt32 type, IOOptionBits* options, IOMemoryDescriptor** memory) override;
 
   IOReturn externalMethod(uint32_t selector,
                           IOExternalMethodArguments* args,
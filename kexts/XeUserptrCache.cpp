@@ -0,0 +1,130 @@
+#include "XeUserptrCache.hpp"
+
+XeUserptrCache::Record* XeUserptrCache::find(uint64_t addr, uint64_t bytes) {
+  for (uint32_t i = 0; i < count; ++i) {
+    Record& r = records[i];
+    if (r.addr == addr && r.bytes == bytes) {
+      r.lastUse = ++clock;
+      st.hits++;
+      return &r;
+    }
+  }
+  st.misses++;
+  return nullptr;
+}
+
+bool XeUserptrCache::idle(const Record& r, const uint32_t completed[kXeEngineCount]) const {
+  if (r.handles) return false;
+  for (uint32_t e = 0; e < kXeEngineCount; ++e) {
+    if ((int32_t)(completed[e] - r.busy[e]) < 0) return false;
+  }
+  return true;
+}
+
+// Least recently used idle record; count when there is none
+uint32_t XeUserptrCache::lruIdle(const uint32_t completed[kXeEngineCount]) const {
+  uint32_t victim = count;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!idle(records[i], completed)) continue;
+    if (victim == count || records[i].lastUse < records[victim].lastUse) victim = i;
+  }
+  return victim;
+}
+
+bool XeUserptrCache::overLimit(uint64_t extraBytes) const {
+  return count + (extraBytes ? 1 : 0) > kMaxRecords || pinned + extraBytes > kMaxPinnedBytes;
+}
+
+// Drop record i. Unpinning and reusing its GGTT range is only safe once idle.
+void XeUserptrCache::evict(uint32_t i, bool unpin, XeBoPool& pool) {
+  Record r = records[i];
+  records[i] = records[--count];
+  pinned -= r.bytes;
+  if (acct) {
+    acct->uncharge(XeMemAccount::kPinned, r.bytes);
+    if (r.ggtt) acct->uncharge(XeMemAccount::kBound, r.bytes);
+  }
+  if (unpin) {
+    if (r.ggtt) pool.releaseGgtt(r.ggtt, (uint32_t)r.bytes);
+    r.md->complete();
+    st.unpinned++;
+  } else {
+    st.forced++;
+  }
+  if (r.map) r.map->release();
+  r.md->release();
+}
+
+void XeUserptrCache::trim(const uint32_t completed[kXeEngineCount], XeBoPool& pool) {
+  while (overLimit(0)) {
+    uint32_t victim = lruIdle(completed);
+    if (victim == count) return;
+    evict(victim, true, pool);
+  }
+}
+
+uint64_t XeUserptrCache::reclaim(uint64_t bytes, const uint32_t completed[kXeEngineCount], XeBoPool& pool) {
+  uint64_t freed = 0;
+  while (freed < bytes) {
+    uint32_t victim = lruIdle(completed);
+    if (victim == count) break;
+    freed += records[victim].bytes;
+    evict(victim, true, pool);
+  }
+  return freed;
+}
+
+XeUserptrCache::Record* XeUserptrCache::add(uint64_t addr, uint64_t bytes, IOMemoryDescriptor* md,
+                                            IOMemoryMap* map, uint32_t ggtt,
+                                            const uint32_t completed[kXeEngineCount], XeBoPool& pool) {
+  // Make room for the new range: least recently used idle records first
+  while (overLimit(bytes)) {
+    uint32_t victim = lruIdle(completed);
+    if (victim == count) {
+      XeLog("XeUserptrCache::add: ERROR - %u ranges / %llu bytes pinned, none idle\n", count,
+            (unsigned long long)pinned);
+      return nullptr;
+    }
+    evict(victim, true, pool);
+  }
+
+  Record& r = records[count++];
+  r = Record {};
+  r.addr = addr;
+  r.bytes = bytes;
+  r.md = md;
+  r.map = map;
+  r.ggtt = ggtt;
+  r.lastUse = ++clock;
+  pinned += bytes;
+  if (acct) {
+    acct->charge(XeMemAccount::kPinned, bytes);
+    if (ggtt) acct->charge(XeMemAccount::kBound, bytes);
+  }
+  return &r;
+}
+
+void XeUserptrCache::put(IOMemoryDescriptor* md, const uint32_t busy[kXeEngineCount]) {
+  for (uint32_t i = 0; i < count; ++i) {
+    Record& r = records[i];
+    if (r.md != md) continue;
+    for (uint32_t e = 0; e < kXeEngineCount; ++e) {
+      if ((int32_t)(busy[e] - r.busy[e]) > 0) r.busy[e] = busy[e];
+    }
+    if (r.handles) r.handles--;
+    return;
+  }
+}
+
+void XeUserptrCache::destroy(const uint32_t completed[kXeEngineCount], XeBoPool& pool) {
+  uint32_t n = count;
+  while (count) {
+    bool unpin = idle(records[count - 1], completed);
+    evict(count - 1, unpin, pool);
+  }
+  if (n) {
+    XeLog("XeUserptrCache::destroy: released %u ranges (hits=%llu misses=%llu unpinned=%llu forced=%llu)\n",
+          n, (unsigned long long)st.hits, (unsigned long long)st.misses,
+          (unsigned long long)st.unpinned, (unsigned long long)st.forced);
+  }
+}
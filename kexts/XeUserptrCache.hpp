@@ -0,0 +1,92 @@
+#pragma once
+#include <IOKit/IOLib.h>
+#include <IOKit/IOMemoryDescriptor.h>
+#include "XeEngine.hpp"
+#include "XeBoPool.hpp"
+#include "XeMemAccount.hpp"
+
+// Forward declaration for XeLog
+void XeLog(const char* fmt, ...) __attribute__((format(printf,1,2)));
+
+// Per-client cache of imported user memory (userptr BOs).
+//
+// An import wraps [addr, addr + bytes) of the client's task, pins it, maps
+// it into the kernel (for batch validation) and binds it into the GGTT.
+// The record outlives the BO handles made from it: destroying the last
+// handle leaves the range pinned and bound, so importing the same range
+// again costs one lookup. Records are unpinned lazily, least recently used
+// first, once the cache holds more than kMaxRecords ranges or
+// kMaxPinnedBytes, and only when no handle is left and every engine has
+// retired the last request that used them.
+//
+// Records are matched by address range only. The pages stay the ones that
+// were pinned first, so a client must not unmap and remap a range while it
+// may still be cached.
+//
+// Each record is charged to the client's account as pinned and bound
+// bytes from add() until it is dropped.
+//
+// Not locked: every call runs under the service's command gate.
+class XeUserptrCache {
+public:
+  static constexpr uint32_t kMaxRecords     = 32;
+  static constexpr uint64_t kMaxPinnedBytes = 256ull << 20;
+
+  struct Record {
+    uint64_t            addr;
+    uint64_t            bytes;
+    IOMemoryDescriptor* md;        // prepared; the cache's own reference
+    IOMemoryMap*        map;       // kernel mapping
+    uint32_t            ggtt;      // bound at import, range of exactly bytes
+    uint32_t            busy[kXeEngineCount];
+    uint32_t            handles;   // live BO table entries made from this record
+    uint64_t            lastUse;
+  };
+
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t unpinned;
+    uint64_t forced;        // released while still busy at teardown
+  };
+
+  // Existing record for exactly this range (hit), or nullptr
+  Record* find(uint64_t addr, uint64_t bytes);
+
+  // Takes over md (prepared), map and the GGTT binding. Makes room first;
+  // nullptr when every record is still in use.
+  Record* add(uint64_t addr, uint64_t bytes, IOMemoryDescriptor* md, IOMemoryMap* map, uint32_t ggtt,
+              const uint32_t completed[kXeEngineCount], XeBoPool& pool);
+
+  // A handle made from md went away; busy[e] is its last seqno on engine e
+  void    put(IOMemoryDescriptor* md, const uint32_t busy[kXeEngineCount]);
+
+  // Unpins idle, unreferenced records while over the limits
+  void    trim(const uint32_t completed[kXeEngineCount], XeBoPool& pool);
+
+  // Memory pressure: unpins idle, unreferenced records, least recently
+  // used first, until at least bytes are gone. Returns the bytes unpinned.
+  uint64_t reclaim(uint64_t bytes, const uint32_t completed[kXeEngineCount], XeBoPool& pool);
+
+  // Client teardown: drops everything. Busy records are released without
+  // unpinning (the in-flight request's reference keeps them pinned until
+  // it retires) and their GGTT range is abandoned.
+  void    destroy(const uint32_t completed[kXeEngineCount], XeBoPool& pool);
+
+  void         setAccount(XeMemAccount* account) { acct = account; }
+  uint64_t     pinnedBytes() const { return pinned; }
+  const Stats& stats() const { return st; }
+
+private:
+  XeMemAccount* acct {nullptr};
+  Record        records[kMaxRecords] {};
+  uint32_t      count {0};
+  uint64_t      pinned {0};
+  uint64_t      clock {0};
+  Stats         st {};
+
+  bool     idle(const Record& r, const uint32_t completed[kXeEngineCount]) const;
+  uint32_t lruIdle(const uint32_t completed[kXeEngineCount]) const;
+  void     evict(uint32_t i, bool unpin, XeBoPool& pool);
+  bool     overLimit(uint64_t extraBytes) const;
+};
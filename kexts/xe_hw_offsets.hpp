@@ -21,11 +21,18 @@ constexpr uint32_t DEVICE_ID_REG5     = 0x00000104;  // Capabilities pointer
 // Verified from Linux dump:
 constexpr uint32_t RCS0_BASE          = 0x00002000;
 
-// Common Gen11+/Gen12 ring register layout (relative to engine base)
-constexpr uint32_t RCS0_RING_TAIL     = RCS0_BASE + 0x30;  // dword tail
-constexpr uint32_t RCS0_RING_HEAD     = RCS0_BASE + 0x34;  // dword head
-constexpr uint32_t RCS0_RING_CTL      = RCS0_BASE + 0x2C;  // size/enable bits
-constexpr uint32_t RCS0_MI_MODE       = RCS0_BASE + 0x9C;  // optional (read-only)
+// Common Gen11+/Gen12 ring register layout (relative to engine base).
+// Per-engine bases live in XeEngine.hpp.
+constexpr uint32_t RING_TAIL_OFF      = 0x030;             // dword tail
+constexpr uint32_t RING_HEAD_OFF      = 0x034;             // dword head
+constexpr uint32_t RING_START_OFF     = 0x038;             // ring GGTT address
+constexpr uint32_t RING_CTL_OFF       = 0x03C;             // size/enable bits
+constexpr uint32_t RING_MI_MODE_OFF   = 0x09C;
+
+constexpr uint32_t RCS0_RING_TAIL     = RCS0_BASE + RING_TAIL_OFF;
+constexpr uint32_t RCS0_RING_HEAD     = RCS0_BASE + RING_HEAD_OFF;
+constexpr uint32_t RCS0_RING_CTL      = RCS0_BASE + RING_CTL_OFF;
+constexpr uint32_t RCS0_MI_MODE       = RCS0_BASE + RING_MI_MODE_OFF;  // optional (read-only)
 
 constexpr uint32_t GFX_MODE           = 0x00002500;        // graphics mode
 
@@ -37,7 +44,245 @@ constexpr uint32_t GGTT_ApertureBytes = 256u * 1024u * 1024u;
 
 // MI opcodes
 constexpr uint32_t MI_NOOP            = 0x00000000;
-constexpr uint32_t MI_BATCH_BUFFER_END= 0x0A000000;
+constexpr uint32_t MI_BATCH_BUFFER_END= 0x05000000;        // MI opcode 0x0A
+constexpr uint32_t MI_USER_INTERRUPT  = 0x01000000;
+constexpr uint32_t MI_ARB_CHECK       = 0x02800000;
+// MI_LOAD_REGISTER_IMM: (n) = number of reg/value pairs
+inline constexpr uint32_t MI_LOAD_REGISTER_IMM(uint32_t n) { return 0x11000000 | (2 * n - 1); }
+constexpr uint32_t MI_LRI_FORCE_POSTED = 1u << 12;
+// MI_STORE_DATA_IMM with GGTT addressing, one dword payload (4 dwords total)
+constexpr uint32_t MI_STORE_DATA_IMM_GGTT = 0x10000000 | (1u << 22) | 2;
+
+// MI_BATCH_BUFFER_START (Gen8+, 3 dwords: header, addr lo, addr hi)
+constexpr uint32_t MI_BATCH_BUFFER_START = 0x18800000 | 1;  // MI opcode 0x31
+constexpr uint32_t MI_BB_START_2ND_LEVEL = 1u << 22;
+constexpr uint32_t MI_BB_START_PPGTT     = 1u << 8;         // clear = GGTT
+
+// Command header decode
+constexpr uint32_t CMD_TYPE_SHIFT     = 29;                // [31:29] command type
+constexpr uint32_t CMD_TYPE_MI        = 0;
+constexpr uint32_t CMD_TYPE_BLT       = 2;
+constexpr uint32_t CMD_TYPE_GFXPIPE   = 3;
+constexpr uint32_t MI_OPCODE_SHIFT    = 23;                // [28:23] MI opcode
+constexpr uint32_t MI_OPCODE_MASK     = 0x3F;
+constexpr uint32_t MI_USE_GGTT        = 1u << 22;          // SDI/SRM/LRM/ATOMIC/SEMAPHORE_WAIT
+constexpr uint32_t MI_LRI_REG_MASK    = 0x007FFFFC;        // register field in LRI/LRM/SRM
+
+// ============================================================================
+// Execlists (Gen11+/Gen12), relative to engine base
+// ============================================================================
+
+constexpr uint32_t RING_HWS_PGA_OFF           = 0x080;  // HW status page GGTT address
+constexpr uint32_t RING_ELSP_OFF              = 0x230;  // legacy ELSP port (pre-Gen11)
+constexpr uint32_t RING_EXECLIST_STATUS_LO_OFF= 0x234;
+constexpr uint32_t RING_EXECLIST_STATUS_HI_OFF= 0x238;
+constexpr uint32_t RING_MODE_GEN7_OFF         = 0x29C;
+constexpr uint32_t RING_CSB_BUF_LO_OFF        = 0x370;  // CSB entry n at +n*8 (lo), +n*8+4 (hi)
+constexpr uint32_t RING_CSB_PTR_OFF           = 0x3A0;  // [11:8]=read ptr, [3:0]=write ptr
+constexpr uint32_t RING_EXECLIST_SQ_LO_OFF    = 0x510;  // port n at +n*8 (lo), +n*8+4 (hi)
+constexpr uint32_t RING_EXECLIST_CONTROL_OFF  = 0x550;
+
+constexpr uint32_t RCS0_HWS_PGA               = RCS0_BASE + RING_HWS_PGA_OFF;
+constexpr uint32_t RCS0_MODE_GEN7             = RCS0_BASE + RING_MODE_GEN7_OFF;
+constexpr uint32_t RCS0_CSB_PTR               = RCS0_BASE + RING_CSB_PTR_OFF;
+constexpr uint32_t RCS0_EXECLIST_CONTROL      = RCS0_BASE + RING_EXECLIST_CONTROL_OFF;
+
+constexpr uint32_t EXECLIST_PORTS             = 2;
+constexpr uint32_t EXECLIST_CSB_ENTRIES       = 12;     // Gen11+
+constexpr uint32_t EL_CTRL_LOAD               = 1u << 0;
+constexpr uint32_t GFX_DISABLE_LEGACY_MODE    = 1u << 3; // RING_MODE_GEN7, masked
+
+// Masked register helpers ([31:16] = write-enable mask)
+inline constexpr uint32_t MASKED_BIT_ENABLE(uint32_t b)  { return (b << 16) | b; }
+inline constexpr uint32_t MASKED_BIT_DISABLE(uint32_t b) { return b << 16; }
+
+// Gen12 CSB entry decode (same layout in both dwords)
+constexpr uint32_t CSB_SW_CTX_ID_SHIFT        = 15;
+constexpr uint32_t CSB_SW_CTX_ID_MASK         = 0x7FFu << CSB_SW_CTX_ID_SHIFT;
+constexpr uint32_t CSB_IDLE_CTX_ID            = 0x7FF;
+constexpr uint32_t CSB_SWITCHED_TO_NEW_QUEUE  = 1u << 2;  // lower dword
+
+// Context descriptor bits
+constexpr uint64_t CTX_DESC_VALID             = 1ull << 0;
+constexpr uint64_t CTX_DESC_LEGACY_32B        = 1ull << 3;
+constexpr uint64_t CTX_DESC_PRIVILEGE         = 1ull << 8;
+constexpr uint32_t CTX_DESC_SW_CTX_ID_SHIFT   = 37;
+constexpr uint32_t CTX_DESC_SW_CTX_ID_MAX     = 0x7FE;    // 0x7FF is the idle id
+
+// Logical ring context (LRC) image: page 0 = PPHWSP, page 1+ = register state.
+// Dword indices below point at the *value* slot of each LRI pair.
+constexpr uint32_t LRC_PPHWSP_BYTES           = 4096;
+constexpr uint32_t CTX_CONTEXT_CONTROL        = 0x02 + 1;
+constexpr uint32_t CTX_RING_HEAD              = 0x04 + 1;
+constexpr uint32_t CTX_RING_TAIL              = 0x06 + 1;
+constexpr uint32_t CTX_RING_START             = 0x08 + 1;
+constexpr uint32_t CTX_RING_CTL               = 0x0A + 1;
+constexpr uint32_t RING_CONTEXT_CONTROL_OFF   = 0x244;
+constexpr uint32_t CTX_CTRL_RESTORE_INHIBIT   = 1u << 0;
+constexpr uint32_t CTX_CTRL_INHIBIT_SYN_SWITCH= 1u << 3;
+constexpr uint32_t RING_CTL_VALID             = 1u << 0;
+
+// HW status page layout (dword index)
+constexpr uint32_t HWSP_SEQNO_INDEX           = 0x40;
+
+// GGTT PTEs live in the upper half of GTTMMADR (BAR0 + 8MB on Gen12)
+constexpr uint32_t GGTT_PTE_BASE              = 0x00800000;
+constexpr uint64_t GGTT_PTE_PRESENT           = 1ull << 0;
+constexpr uint64_t GGTT_PTE_ADDR_MASK         = 0x0000007FFFFFF000ull;
+
+// Stolen memory (DSM). GGC and BDSM live in the iGPU's PCI config space;
+// GEN6_STOLEN_RESERVED is the top of DSM the hardware keeps for itself.
+constexpr uint32_t PCI_GGC                    = 0x50;   // 16-bit; GMS = bits 15:8
+constexpr uint32_t GGC_GMS_SHIFT              = 8;
+constexpr uint32_t PCI_BDSM                   = 0xC0;   // Gen11+: 64-bit, low dword first
+constexpr uint32_t PCI_BDSM_HI                = 0xC4;
+constexpr uint64_t BDSM_ADDR_MASK             = ~0xFFFFFull;           // 1MB aligned
+constexpr uint32_t GEN6_STOLEN_RESERVED       = 0x001082C0;           // 64-bit on Gen11+
+constexpr uint64_t STOLEN_RES_ENABLE          = 1ull << 0;
+constexpr uint32_t STOLEN_RES_SIZE_SHIFT      = 7;      // 2 bits: 1, 2, 4 or 8MB
+constexpr uint64_t STOLEN_RES_ADDR_MASK       = ~0xFFFFFull;
+
+// Hang detection / per-engine reset (Gen11+)
+constexpr uint32_t RING_ACTHD_OFF             = 0x074;  // active head, low dword
+constexpr uint32_t RING_ACTHD_UDW_OFF         = 0x05C;
+constexpr uint32_t RING_RESET_CTL_OFF         = 0x0D0;  // masked
+constexpr uint32_t RESET_CTL_REQUEST_RESET    = 1u << 0;
+constexpr uint32_t RESET_CTL_READY_TO_RESET   = 1u << 1;
+constexpr uint32_t GEN6_GDRST                 = 0x0000941C;
+constexpr uint32_t GEN11_GRDOM_RENDER         = 1u << 1;
+constexpr uint32_t GEN11_GRDOM_BLT            = 1u << 2;
+inline constexpr uint32_t GEN11_GRDOM_MEDIA(uint32_t n) { return 1u << (5 + n); }
+inline constexpr uint32_t GEN11_GRDOM_VECS(uint32_t n)  { return 1u << (13 + n); }
+constexpr uint32_t GEN11_GRDOM_GUC            = 1u << 3;
+
+// ============================================================================
+// GuC microcontroller (Gen12 layout, i915 intel_guc_reg.h)
+// ============================================================================
+
+constexpr uint32_t GUC_STATUS                 = 0x0000C000;
+constexpr uint32_t GS_MIA_IN_RESET            = 1u << 0;
+constexpr uint32_t GS_BOOTROM_SHIFT           = 1;
+constexpr uint32_t GS_BOOTROM_MASK            = 0x7Fu << GS_BOOTROM_SHIFT;
+constexpr uint32_t GS_BOOTROM_RSA_FAILED      = 0x50u << GS_BOOTROM_SHIFT;
+constexpr uint32_t GS_UKERNEL_SHIFT           = 8;
+constexpr uint32_t GS_UKERNEL_MASK            = 0xFFu << GS_UKERNEL_SHIFT;
+constexpr uint32_t GS_UKERNEL_READY           = 0xF0u << GS_UKERNEL_SHIFT;
+
+constexpr uint32_t GUC_WOPCM_SIZE             = 0x0000C050;  // write-once, [0]=locked
+constexpr uint32_t GUC_WOPCM_SIZE_LOCKED      = 1u << 0;
+constexpr uint32_t GUC_WOPCM_SIZE_MASK        = 0xFFFFFu << 12;
+constexpr uint32_t DMA_GUC_WOPCM_OFFSET       = 0x0000C340;  // write-once, [0]=valid
+constexpr uint32_t GUC_WOPCM_OFFSET_VALID     = 1u << 0;
+constexpr uint32_t HUC_LOADING_AGENT_GUC      = 1u << 1;
+constexpr uint32_t GUC_WOPCM_OFFSET_MASK      = 0x3FFFFu << 14;
+constexpr uint32_t GEN11_WOPCM_BYTES          = 2u << 20;
+constexpr uint32_t WOPCM_RESERVED_BYTES       = 16u << 10;   // bottom of WOPCM, below GuC
+constexpr uint32_t WOPCM_HW_CTX_RESERVED      = (36u + 128u) << 10;  // top of WOPCM (ICL+)
+constexpr uint32_t GUC_WOPCM_STACK_RESERVED   = 8u << 10;
+constexpr uint32_t GUC_WOPCM_RESERVED         = 16u << 10;
+
+constexpr uint32_t GUC_SHIM_CONTROL           = 0x0000C064;
+constexpr uint32_t GUC_DISABLE_SRAM_INIT_TO_ZEROES      = 1u << 0;
+constexpr uint32_t GUC_ENABLE_READ_CACHE_LOGIC          = 1u << 1;
+constexpr uint32_t GUC_ENABLE_MIA_CACHING               = 1u << 2;
+constexpr uint32_t GUC_ENABLE_READ_CACHE_FOR_SRAM_DATA  = 1u << 9;
+constexpr uint32_t GUC_ENABLE_READ_CACHE_FOR_WOPCM_DATA = 1u << 10;
+constexpr uint32_t GUC_ENABLE_MIA_CLOCK_GATING          = 1u << 15;
+constexpr uint32_t GEN9_GT_PM_CONFIG          = 0x0013816C;
+constexpr uint32_t GT_DOORBELL_ENABLE         = 1u << 0;
+
+// Boot parameters: SOFT_SCRATCH(0) is the mailbox, 1..14 the GUC_CTL words
+inline constexpr uint32_t SOFT_SCRATCH(uint32_t n) { return 0x0000C180 + n * 4; }
+constexpr uint32_t GUC_CTL_MAX_DWORDS         = 14;
+inline constexpr uint32_t UOS_RSA_SCRATCH(uint32_t n) { return 0x0000C200 + n * 4; }
+constexpr uint32_t UOS_RSA_SCRATCH_COUNT      = 64;
+
+// uC DMA engine: GGTT source -> WOPCM destination
+constexpr uint32_t DMA_ADDR_0_LOW             = 0x0000C300;
+constexpr uint32_t DMA_ADDR_0_HIGH            = 0x0000C304;
+constexpr uint32_t DMA_ADDR_1_LOW             = 0x0000C308;
+constexpr uint32_t DMA_ADDR_1_HIGH            = 0x0000C30C;
+constexpr uint32_t DMA_ADDRESS_SPACE_WOPCM    = 7u << 16;
+constexpr uint32_t DMA_COPY_SIZE              = 0x0000C310;
+constexpr uint32_t DMA_CTRL                   = 0x0000C314;  // masked
+constexpr uint32_t DMA_CTRL_START             = 1u << 0;
+constexpr uint32_t DMA_CTRL_UOS_MOVE          = 1u << 4;
+constexpr uint32_t GUC_DMA_DEST_OFFSET        = 0x2000;      // GuC image lands here in WOPCM
+
+// Host <-> GuC MMIO mailbox (Gen11+): request in SOFT_SCRATCH, then trigger
+inline constexpr uint32_t GEN11_SOFT_SCRATCH(uint32_t n) { return 0x00190240 + n * 4; }
+constexpr uint32_t GEN11_SOFT_SCRATCH_COUNT   = 4;
+constexpr uint32_t GEN11_GUC_HOST_INTERRUPT   = 0x001901F0;
+constexpr uint32_t GUC_SEND_TRIGGER           = 1u << 0;
+
+// HXG message dword 0 (GuC interface v70, i915 guc_messages_abi.h)
+constexpr uint32_t GUC_HXG_ORIGIN_GUC         = 1u << 31;
+constexpr uint32_t GUC_HXG_TYPE_SHIFT         = 28;
+constexpr uint32_t GUC_HXG_TYPE_MASK          = 0x7u << GUC_HXG_TYPE_SHIFT;
+constexpr uint32_t GUC_HXG_TYPE_REQUEST       = 0;
+constexpr uint32_t GUC_HXG_TYPE_EVENT         = 1;
+constexpr uint32_t GUC_HXG_TYPE_FAST_REQUEST  = 2;
+constexpr uint32_t GUC_HXG_TYPE_NO_RESPONSE_BUSY  = 3;
+constexpr uint32_t GUC_HXG_TYPE_NO_RESPONSE_RETRY = 5;
+constexpr uint32_t GUC_HXG_TYPE_RESPONSE_FAILURE  = 6;
+constexpr uint32_t GUC_HXG_TYPE_RESPONSE_SUCCESS  = 7;
+constexpr uint32_t GUC_HXG_DATA0_SHIFT        = 16;          // requests/events: [27:16]
+constexpr uint32_t GUC_HXG_DATA0_MASK         = 0xFFFu << GUC_HXG_DATA0_SHIFT;
+constexpr uint32_t GUC_HXG_ACTION_MASK        = 0xFFFFu;
+constexpr uint32_t GUC_HXG_RESPONSE_DATA0_MASK= 0x0FFFFFFFu; // success: [27:0]
+constexpr uint32_t GUC_HXG_FAILURE_ERROR_MASK = 0xFFFFu;
+inline constexpr uint32_t GUC_HXG_REQUEST(uint32_t action, uint32_t data0) {
+  return (GUC_HXG_TYPE_REQUEST << GUC_HXG_TYPE_SHIFT) |
+         ((data0 << GUC_HXG_DATA0_SHIFT) & GUC_HXG_DATA0_MASK) | (action & GUC_HXG_ACTION_MASK);
+}
+
+constexpr uint32_t GUC_ACTION_REGISTER_CTB    = 0x4505;
+constexpr uint32_t GUC_ACTION_CONTROL_CTB     = 0x4509;
+constexpr uint32_t GUC_CTB_CONTROL_DISABLE    = 0;
+constexpr uint32_t GUC_CTB_CONTROL_ENABLE     = 1;
+constexpr uint32_t GUC_CTB_TYPE_HOST2GUC      = 0;
+constexpr uint32_t GUC_CTB_TYPE_GUC2HOST      = 1;
+constexpr uint32_t GUC_REGISTER_CTB_SIZE_SHIFT= 12;          // msg[1] [19:12] = 4K pages - 1
+
+// CT buffer message header: [31:16] fence, [15:12] format, [7:0] payload dwords
+constexpr uint32_t GUC_CTB_MSG_FENCE_SHIFT    = 16;
+constexpr uint32_t GUC_CTB_MSG_FORMAT_SHIFT   = 12;
+constexpr uint32_t GUC_CTB_MSG_FORMAT_MASK    = 0xFu << GUC_CTB_MSG_FORMAT_SHIFT;
+constexpr uint32_t GUC_CTB_FORMAT_HXG         = 0;
+constexpr uint32_t GUC_CTB_MSG_NUM_DWORDS_MASK= 0xFFu;
+constexpr uint32_t GUC_CTB_HXG_MSG_MAX_DW     = 1 + 0xFF;
+constexpr uint32_t GUC_CTB_STATUS_OVERFLOW    = 1u << 0;
+constexpr uint32_t GUC_CTB_STATUS_UNDERFLOW   = 1u << 1;
+constexpr uint32_t GUC_CTB_STATUS_MISMATCH    = 1u << 2;
+
+// GuC log buffer, passed in GUC_CTL word 1. One page of per-section state
+// headers, then the debug, crash dump and capture sections; section sizes
+// are encoded as 4K units - 1.
+constexpr uint32_t GUC_CTL_LOG_PARAMS         = 1;
+constexpr uint32_t GUC_LOG_VALID              = 1u << 0;
+constexpr uint32_t GUC_LOG_NOTIFY_ON_HALF_FULL= 1u << 1;
+constexpr uint32_t GUC_LOG_CRASH_SHIFT        = 4;           // 2 bits
+constexpr uint32_t GUC_LOG_DEBUG_SHIFT        = 6;           // 4 bits
+constexpr uint32_t GUC_LOG_CAPTURE_SHIFT      = 10;          // 2 bits
+constexpr uint32_t GUC_LOG_BUF_ADDR_SHIFT     = 12;          // GGTT page number
+constexpr uint32_t GUC_LOG_UNIT_BYTES         = 4096;
+constexpr uint32_t GUC_LOG_STATE_BYTES        = 4096;
+constexpr uint32_t GUC_LOG_DEBUG_BYTES        = 64u << 10;
+constexpr uint32_t GUC_LOG_CRASH_BYTES        = 8u << 10;
+constexpr uint32_t GUC_LOG_CAPTURE_BYTES      = 16u << 10;
+constexpr uint32_t GUC_LOG_BUFFER_DEBUG       = 0;           // state header index
+constexpr uint32_t GUC_LOG_BUFFER_CRASH_DUMP  = 1;
+constexpr uint32_t GUC_LOG_BUFFER_CAPTURE     = 2;
+constexpr uint32_t GUC_LOG_BUFFER_FULL_SHIFT  = 1;           // state flags [4:1], wraps at 16
+constexpr uint32_t GUC_LOG_BUFFER_FULL_MASK   = 0xFu << GUC_LOG_BUFFER_FULL_SHIFT;
+
+constexpr uint32_t GUC_ACTION_LOG_BUFFER_FILE_FLUSH_COMPLETE  = 0x0030;  // H2G, data: section
+constexpr uint32_t GUC_ACTION_UK_LOG_ENABLE_LOGGING = 0xE000;  // H2G, data: GUC_LOG_CONTROL_*
+constexpr uint32_t GUC_LOG_CONTROL_LOGGING_ENABLED  = 1u << 0;
+constexpr uint32_t GUC_LOG_CONTROL_VERBOSITY_SHIFT  = 4;       // 0..3
+constexpr uint32_t GUC_LOG_CONTROL_DEFAULT_LOGGING  = 1u << 8;
+constexpr uint32_t GUC_ACTION_NOTIFY_FLUSH_LOG_BUFFER_TO_FILE = 0x8003;  // G2H event
+constexpr uint32_t GUC_ACTION_NOTIFY_CRASH_DUMP_POSTED        = 0x8004;  // G2H event
 
 // ============================================================================
 // Forcewake Registers (Gen12 Raptor Lake)
@@ -48,6 +293,12 @@ constexpr uint32_t MI_BATCH_BUFFER_END= 0x0A000000;
 constexpr uint32_t FORCEWAKE_REQ      = 0x000A188;         // _MT
 constexpr uint32_t FORCEWAKE_ACK      = 0x000A18C;         // _MT
 
+// Gen11+ media forcewake domains (per VDBOX / VEBOX instance)
+inline constexpr uint32_t FORCEWAKE_MEDIA_VDBOX_REQ(uint32_t n) { return 0x0000A540 + n * 4; }
+inline constexpr uint32_t FORCEWAKE_MEDIA_VDBOX_ACK(uint32_t n) { return 0x00000D50 + n * 4; }
+inline constexpr uint32_t FORCEWAKE_MEDIA_VEBOX_REQ(uint32_t n) { return 0x0000A560 + n * 4; }
+inline constexpr uint32_t FORCEWAKE_MEDIA_VEBOX_ACK(uint32_t n) { return 0x00000D70 + n * 4; }
+
 // ============================================================================
 // Power Management Registers (from raptor_lake_regs.txt)
 // ============================================================================
@@ -226,6 +477,7 @@ constexpr uint32_t DSPACNTR                = 0x00070180;  // value: 0x84000400 (
 constexpr uint32_t DSPASTRIDE              = 0x00070188;  // value: 0x00000014 (stride value from dump)
 constexpr uint32_t DSPASURF                = 0x0007019C;  // value: 0x0ca40000 (surface address)
 constexpr uint32_t DSPATILEOFF             = 0x000701A4;  // tile offset
+constexpr uint32_t DSPCNTR_ENABLE          = 1u << 31;
 
 // Plane B
 constexpr uint32_t DSPBCNTR                = 0x00071180;
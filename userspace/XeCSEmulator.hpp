@@ -0,0 +1,373 @@
+// userspace/XeCSEmulator.hpp — host-side software command streamer
+//
+// Header-only, no IOKit: builds on Linux or macOS with any C++17 compiler.
+//
+// The emulator owns a 16MB BAR0 stand-in and consumes exactly what the kext
+// writes through it: GGTT PTEs at BAR0 + 8MB, the Gen12 submit queue / ELSP
+// control registers, logical ring context images and their rings. It
+// reports back the way the hardware does: CSB entries plus the CSB write
+// pointer, ACTHD, and memory writes from MI_STORE_DATA_IMM (the HWSP seqno).
+//
+// It is cooperative rather than threaded: the harness calls service() where
+// the GPU would otherwise make progress (after a kick, inside a wait loop).
+// Masked registers can't be trapped on plain memory, so service() also
+// re-asserts the CSB write pointer the driver clobbers when it updates the
+// read pointer.
+//
+// PTE "physical" addresses are host pointers (identity mapping), so a
+// harness binds memory by writing (uintptr_t)ptr | GGTT_PTE_PRESENT.
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "xe_hw_offsets.hpp"
+
+class XeCSEmulator {
+public:
+  struct Config {
+    uint32_t engineBase      = XeHW::RCS0_BASE;
+    uint32_t cmdLatencyNs    = 20;     // cost of every parsed command
+    uint32_t ctxSwitchNs     = 2000;   // full context load / save
+    uint32_t liteRestoreNs   = 200;    // tail update of the running context
+    uint32_t maxCmdsPerCall  = 4096;   // bound on work done by one service()
+    bool     realtime        = false;  // spin for the modelled latency
+  };
+
+  struct Stats {
+    uint64_t commands;
+    uint64_t noops;
+    uint64_t batches;        // MI_BATCH_BUFFER_START taken
+    uint64_t storeDw;        // dwords written by MI_STORE_DATA_IMM
+    uint64_t lriWrites;
+    uint64_t interrupts;     // MI_USER_INTERRUPT
+    uint64_t unknown;        // skipped by length only
+    uint64_t elspLoads;
+    uint64_t ctxSwitches;
+    uint64_t liteRestores;
+    uint64_t completions;
+    uint64_t csbEvents;
+    uint64_t faults;         // GGTT miss / runaway batch
+    uint64_t simNs;          // modelled device time
+  };
+
+  static constexpr uint32_t kBarBytes = 16u * 1024 * 1024;
+
+  XeCSEmulator() : XeCSEmulator(Config()) {}
+  explicit XeCSEmulator(const Config& cfg) : c(cfg), regs(kBarBytes / 4, 0) {
+    // Both CSB pointers start on the last entry; the first event lands in 0
+    reg(XeHW::RING_CSB_PTR_OFF) = (csbWp << 8) | csbWp;
+  }
+
+  volatile uint32_t* mmio() { return regs.data(); }
+  const Stats&       stats() const { return st; }
+  bool               idle() const { return !active.valid && !pending.valid; }
+
+  // GGTT address -> host pointer through the PTEs in the BAR.
+  void* ggttToHost(uint64_t ggtt) const {
+    uint64_t idx = ggtt >> 12;
+    if (XeHW::GGTT_PTE_BASE + idx * 8 + 8 > kBarBytes) return nullptr;
+    uint64_t pte;
+    memcpy(&pte, (const uint8_t*)regs.data() + XeHW::GGTT_PTE_BASE + idx * 8, sizeof(pte));
+    if (!(pte & XeHW::GGTT_PTE_PRESENT)) return nullptr;
+    return (void*)(uintptr_t)((pte & ~0xFFFull) + (ggtt & 0xFFF));
+  }
+
+  // One step of device progress: take a pending ELSP load, then run the
+  // active context for at most maxCmdsPerCall commands. Returns true if
+  // anything happened.
+  bool service() {
+    bool progress = false;
+    syncCsbPtr();
+
+    uint32_t& ctl = reg(XeHW::RING_EXECLIST_CONTROL_OFF);
+    if (ctl & XeHW::EL_CTRL_LOAD) {
+      ctl = 0;
+      loadPorts();
+      progress = true;
+    }
+
+    uint32_t budget = c.maxCmdsPerCall;
+    while (active.valid && budget) {
+      if (active.head == active.tail) {
+        completeActive();
+        progress = true;
+        continue;
+      }
+      uint32_t used = runRing(budget);
+      budget -= used;
+      if (used) progress = true;
+    }
+
+    syncCsbPtr();
+    return progress;
+  }
+
+  // Service until both ports drain (or nothing can move).
+  void runUntilIdle() {
+    while (!idle() && service()) {}
+  }
+
+private:
+  struct Ctx {
+    bool     valid {false};
+    uint64_t desc {0};
+    uint32_t swId {0};
+    uint32_t lrca {0};
+    uint32_t ringStart {0};
+    uint32_t ringSize {0};
+    uint32_t head {0};
+    uint32_t tail {0};
+  };
+
+  Config                c;
+  std::vector<uint32_t> regs;
+  Ctx                   active, pending;
+  uint32_t              csbWp {XeHW::EXECLIST_CSB_ENTRIES - 1};
+  Stats                 st {};
+
+  uint32_t& reg(uint32_t off) { return regs[(c.engineBase + off) >> 2]; }
+
+  void syncCsbPtr() {
+    uint32_t& p = reg(XeHW::RING_CSB_PTR_OFF);
+    uint32_t wp = p & 0xF;
+    // The driver's reset write (both pointers = last entry) is the one
+    // write that legitimately moves our write pointer.
+    if ((p & 0xFFFF0000u) == 0x0F0F0000u && wp < XeHW::EXECLIST_CSB_ENTRIES) csbWp = wp;
+    p = (p & 0x0F00u) | csbWp;
+  }
+
+  void charge(uint64_t ns) {
+    st.simNs += ns;
+    if (!c.realtime || !ns) return;
+    auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+    while (std::chrono::steady_clock::now() < until) {}
+  }
+
+  uint32_t* imageRegs(const Ctx& x) const {
+    uint8_t* img = (uint8_t*)ggttToHost(x.lrca);
+    return img ? (uint32_t*)(img + XeHW::LRC_PPHWSP_BYTES) : nullptr;
+  }
+
+  bool loadCtx(uint64_t desc, Ctx* out) {
+    *out = Ctx {};
+    if (!(desc & XeHW::CTX_DESC_VALID)) return false;
+    out->desc = desc;
+    out->swId = (uint32_t)(desc >> XeHW::CTX_DESC_SW_CTX_ID_SHIFT) & 0x7FF;
+    out->lrca = (uint32_t)desc & 0xFFFFF000u;
+    uint32_t* r = imageRegs(*out);
+    if (!r) {
+      st.faults++;
+      return false;
+    }
+    out->ringStart = r[XeHW::CTX_RING_START];
+    out->ringSize  = (r[XeHW::CTX_RING_CTL] & 0x001FF000u) + 4096;
+    out->head      = r[XeHW::CTX_RING_HEAD] & (out->ringSize - 1);
+    out->tail      = r[XeHW::CTX_RING_TAIL] & (out->ringSize - 1);
+    out->valid     = true;
+    return true;
+  }
+
+  void saveCtx(const Ctx& x) {
+    if (uint32_t* r = imageRegs(x)) r[XeHW::CTX_RING_HEAD] = x.head;
+  }
+
+  void writeCsb(uint32_t toId, uint32_t awayId, bool newQueue) {
+    csbWp = (csbWp + 1) % XeHW::EXECLIST_CSB_ENTRIES;
+    reg(XeHW::RING_CSB_BUF_LO_OFF + csbWp * 8) =
+      (toId << XeHW::CSB_SW_CTX_ID_SHIFT) | (newQueue ? XeHW::CSB_SWITCHED_TO_NEW_QUEUE : 0);
+    reg(XeHW::RING_CSB_BUF_LO_OFF + csbWp * 8 + 4) = awayId << XeHW::CSB_SW_CTX_ID_SHIFT;
+    st.csbEvents++;
+  }
+
+  void loadPorts() {
+    st.elspLoads++;
+    uint64_t desc[XeHW::EXECLIST_PORTS];
+    for (uint32_t i = 0; i < XeHW::EXECLIST_PORTS; ++i) {
+      desc[i] = reg(XeHW::RING_EXECLIST_SQ_LO_OFF + i * 8) |
+                ((uint64_t)reg(XeHW::RING_EXECLIST_SQ_LO_OFF + i * 8 + 4) << 32);
+    }
+
+    Ctx next;
+    if (!loadCtx(desc[0], &next)) return;
+
+    if (active.valid && next.lrca == active.lrca) {
+      // Lite-restore: keep executing, pick up the new tail
+      active.tail = next.tail;
+      writeCsb(active.swId, active.swId, true);
+      st.liteRestores++;
+      charge(c.liteRestoreNs);
+    } else {
+      if (active.valid) {
+        saveCtx(active);
+        writeCsb(next.swId, active.swId, true);     // preempted
+      } else {
+        writeCsb(next.swId, XeHW::CSB_IDLE_CTX_ID, false);
+      }
+      active = next;
+      st.ctxSwitches++;
+      charge(c.ctxSwitchNs);
+    }
+
+    if (!loadCtx(desc[1], &pending)) pending = Ctx {};
+  }
+
+  void completeActive() {
+    saveCtx(active);
+    st.completions++;
+    if (pending.valid) {
+      writeCsb(pending.swId, active.swId, false);
+      active = pending;
+      pending = Ctx {};
+      if (uint32_t* r = imageRegs(active)) active.tail = r[XeHW::CTX_RING_TAIL] & (active.ringSize - 1);
+      st.ctxSwitches++;
+      charge(c.ctxSwitchNs);
+    } else {
+      writeCsb(XeHW::CSB_IDLE_CTX_ID, active.swId, false);
+      active = Ctx {};
+    }
+  }
+
+  static constexpr uint32_t kMaxCmdDw = 0x3FF + 2;   // longest MI_STORE_DATA_IMM
+
+  enum Flow { kFlowNext, kFlowEnd, kFlowCall, kFlowJump };
+
+  // Length in dwords of the command at hdr (MI opcodes < 0x10 are one dword)
+  static uint32_t cmdLength(uint32_t hdr) {
+    uint32_t type = hdr >> XeHW::CMD_TYPE_SHIFT;
+    if (type == XeHW::CMD_TYPE_MI) {
+      uint32_t op = (hdr >> XeHW::MI_OPCODE_SHIFT) & XeHW::MI_OPCODE_MASK;
+      if (op < 0x10) return 1;
+      if (op == 0x20) return (hdr & 0x3FF) + 2;     // MI_STORE_DATA_IMM
+      if (op == 0x22) return (hdr & 0xFF) + 2;      // MI_LOAD_REGISTER_IMM
+      return (hdr & 0x3F) + 2;
+    }
+    return (hdr & 0xFF) + 2;
+  }
+
+  // Copy one command out of GGTT memory; addrOf(i) gives dword i's address
+  // (rings wrap, batches don't). Pages need not be contiguous on the host.
+  template <typename AddrFn>
+  bool fetch(AddrFn addrOf, uint32_t* cmd, uint32_t* len) {
+    const uint32_t* h = (const uint32_t*)ggttToHost(addrOf(0));
+    if (!h) return false;
+    cmd[0] = *h;
+    *len = cmdLength(cmd[0]);
+    for (uint32_t i = 1; i < *len; ++i) {
+      const uint32_t* d = (const uint32_t*)ggttToHost(addrOf(i));
+      if (!d) return false;
+      cmd[i] = *d;
+    }
+    return true;
+  }
+
+  // Execute one fetched command.
+  Flow exec(const uint32_t* dw, uint32_t len, uint64_t* target, bool* secondLevel) {
+    uint32_t hdr = dw[0];
+    st.commands++;
+    charge(c.cmdLatencyNs);
+
+    if (hdr == XeHW::MI_NOOP) {
+      st.noops++;
+      return kFlowNext;
+    }
+    if (hdr >> XeHW::CMD_TYPE_SHIFT != XeHW::CMD_TYPE_MI) {
+      st.unknown++;
+      return kFlowNext;
+    }
+
+    switch ((hdr >> XeHW::MI_OPCODE_SHIFT) & XeHW::MI_OPCODE_MASK) {
+      case 0x02:                                    // MI_USER_INTERRUPT
+        st.interrupts++;
+        return kFlowNext;
+      case 0x0A:                                    // MI_BATCH_BUFFER_END
+        return kFlowEnd;
+      case 0x20: {                                  // MI_STORE_DATA_IMM
+        if (len < 4) return kFlowNext;
+        uint64_t addr = dw[1] | ((uint64_t)dw[2] << 32);
+        for (uint32_t i = 3; i < len; ++i, addr += 4) {
+          uint32_t* dst = (uint32_t*)ggttToHost(addr);
+          if (!dst) { st.faults++; break; }
+          *dst = dw[i];
+          st.storeDw++;
+        }
+        return kFlowNext;
+      }
+      case 0x22:                                    // MI_LOAD_REGISTER_IMM
+        for (uint32_t i = 1; i + 1 < len; i += 2) {
+          uint32_t r = dw[i] & XeHW::MI_LRI_REG_MASK;
+          if (r < XeHW::GGTT_PTE_BASE) regs[r >> 2] = dw[i + 1];
+          st.lriWrites++;
+        }
+        return kFlowNext;
+      case 0x31:                                    // MI_BATCH_BUFFER_START
+        if (len < 3) return kFlowNext;
+        *target = (dw[1] & ~3u) | ((uint64_t)dw[2] << 32);
+        *secondLevel = (hdr & XeHW::MI_BB_START_2ND_LEVEL) != 0;
+        st.batches++;
+        return kFlowCall;
+      default:
+        st.unknown++;
+        return kFlowNext;
+    }
+  }
+
+  // Run a batch until MI_BATCH_BUFFER_END. From the ring every batch start
+  // is a call; inside a first-level batch only a second-level start is a
+  // call (its END returns here), anything else chains.
+  void runBatch(uint64_t addr, uint32_t level) {
+    uint32_t cmd[kMaxCmdDw];
+    for (uint32_t guard = 0; guard < (1u << 20); ++guard) {
+      uint32_t len = 0;
+      if (!fetch([&](uint32_t i) { return addr + i * 4; }, cmd, &len)) {
+        st.faults++;
+        return;
+      }
+      reg(XeHW::RING_ACTHD_OFF) = (uint32_t)addr;
+      reg(XeHW::RING_ACTHD_UDW_OFF) = (uint32_t)(addr >> 32);
+
+      uint64_t target = 0;
+      bool second = false;
+      Flow f = exec(cmd, len, &target, &second);
+      if (f == kFlowEnd) return;
+      if (f == kFlowCall) {
+        if (level == 1 && second) {
+          runBatch(target, 2);
+        } else {
+          addr = target;                              // chain
+          continue;
+        }
+      }
+      addr += len * 4;
+    }
+    st.faults++;                                      // runaway batch
+  }
+
+  uint32_t runRing(uint32_t budget) {
+    uint32_t cmd[kMaxCmdDw];
+    uint32_t used = 0;
+    while (active.head != active.tail && used < budget) {
+      uint32_t head = active.head;
+      uint32_t len = 0;
+      auto addrOf = [&](uint32_t i) {
+        return (uint64_t)active.ringStart + ((head + i * 4) & (active.ringSize - 1));
+      };
+      if (!fetch(addrOf, cmd, &len)) {
+        st.faults++;
+        active.head = active.tail;
+        break;
+      }
+      reg(XeHW::RING_ACTHD_OFF) = active.ringStart + head;
+      reg(XeHW::RING_ACTHD_UDW_OFF) = 0;
+      reg(XeHW::RING_HEAD_OFF) = head;
+
+      uint64_t target = 0;
+      bool second = false;
+      if (exec(cmd, len, &target, &second) == kFlowCall) runBatch(target, 1);
+      used++;
+      active.head = (head + len * 4) & (active.ringSize - 1);
+    }
+    reg(XeHW::RING_HEAD_OFF) = active.head;
+    return used;
+  }
+};
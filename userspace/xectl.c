@@ -1,13 +1,15 @@
 // userspace/xectl.c — updated to match class "XeService" and method indices
 
 // Build: clang xectl.c -framework IOKit -framework CoreFoundation -o xectl
-// Usage: sudo ./xectl info | regdump | noop | mkbuf [bytes]
+// Usage: sudo ./xectl info | regdump | noop [engine] [urgent] | stats [engine] | lat [engine] | batch engine cookie... | guc | log [guc FILE] | mkbuf [bytes] [lazy] | rmbuf cookie | run [engine] [wb|wc|uc] | uptr [engine] | mem | cachebench [MB] | scanout [frames] | purge [MB]
 
 #include <CoreFoundation/CoreFoundation.h>
 #include <IOKit/IOKitLib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <mach/mach_time.h>
 
 static const char *kServiceClass = "XeService";
 
@@ -17,8 +19,54 @@ enum {
   kMethodSubmit       = 1,
   kMethodWait         = 2,
   kMethodReadRegs     = 3,
+  kMethodGetSubmitStats = 6,
+  kMethodGetSubmitLatency = 7,
+  kMethodSubmitBatch  = 8,
+  kMethodGetGuCStats  = 9,
+  kMethodDestroyBuffer = 10,
+  kMethodExportBuffer = 11,
+  kMethodImportBuffer = 12,
+  kMethodImportUserptr = 13,
+  kMethodCreateSubBuffer = 14,
+  kMethodGetMemStats  = 15,
+  kMethodFlushBuffer  = 16,
+  kMethodMadvise      = 17,
 };
 
+// kMethodSubmit / kMethodCreateBuffer flags (kexts/XeService.hpp)
+#define kSubmitFlagLatencyCritical (1u << 0)
+#define kBufferFlagLazy            (1u << 0)
+#define kBufferCacheShift          1
+#define kBufferFlagScanout         (1u << 3)
+#define kFlushFlagDefer            (1u << 0)
+#define kFlushMaxRanges            14
+enum { kMadviseWillNeed = 0, kMadviseDontNeed = 1 };
+enum { kXeCacheWB = 0, kXeCacheWC = 1, kXeCacheUC = 2 };
+
+// clientMemoryForType types and relay layout; must match kexts/XeService.hpp
+// and kexts/XeLogRelay.hpp
+enum { kXeMemoryLogRelay = 0, kXeMemoryGuCLog = 1 };
+#define kXeMemoryBuffer 0x80000000u
+static uint32_t memory_type_for_cookie(uint64_t cookie) {
+  return kXeMemoryBuffer | (((uint32_t)(cookie >> 32) & 0x7FFFu) << 16) | (((uint32_t)cookie - 1) & 0xFFFFu);
+}
+#define kXeLogRelayMagic   0x584C4F47u
+#define kXeLogRelayVersion 1u
+
+typedef struct {
+  uint64_t seq, time;
+  uint16_t type, engine;
+  uint32_t arg0, arg1, arg2;
+} XeLogRecord;
+
+typedef struct {
+  uint32_t magic, version, recordBytes, capacity, recordsOffset;
+  uint32_t gucDebugOffset, gucDebugBytes, gucCrashOffset, gucCrashBytes, reserved0;
+  uint64_t head;
+  uint32_t gucSeq, gucWrapOffset;
+  uint64_t gucWritten, gucOverflows, gucFlushes, gucCrashDumps;
+} XeLogRelayHeader;
+
 static io_connect_t open_connection(void) {
   CFMutableDictionaryRef match = IOServiceMatching(kServiceClass);
   if (!match) { fprintf(stderr, "No matching dict\n"); exit(1); }
@@ -52,14 +100,26 @@ static void cmd_regdump(io_connect_t c) {
     printf("  [%u] = 0x%08x\n", i, (uint32_t)out[i]);
 }
 
-static void cmd_noop(io_connect_t c) {
-  kern_return_t kr = IOConnectCallMethod(c, kMethodSubmit, NULL, 0, NULL, 0,
-                                         NULL, NULL, NULL, 0);
+// Engine indices match kXeEngines in kexts/XeEngine.hpp
+static const char *kEngineNames[] = { "rcs0", "bcs0", "vcs0", "vcs2", "vecs0", "ccs0" };
+
+static uint32_t parse_engine(const char *s) {
+  for (uint32_t i = 0; i < sizeof(kEngineNames) / sizeof(kEngineNames[0]); ++i)
+    if (!strcmp(s, kEngineNames[i])) return i;
+  return (uint32_t)strtoul(s, NULL, 0);
+}
+
+static void cmd_noop(io_connect_t c, uint32_t engine, uint32_t flags) {
+  uint64_t sin[2] = { engine, flags };
+  uint64_t seqno = 0; uint32_t outCnt = 1;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodSubmit, sin, 2, NULL, 0,
+                                         &seqno, &outCnt, NULL, 0);
   if (kr != KERN_SUCCESS) {
     fprintf(stderr, "submit failed: 0x%x\n", kr);
     return;
   }
-  uint64_t in[1] = { 1000 }; uint32_t inCnt = 1;
+  // Wait on this request only (seqno 0: legacy path, waits for everything)
+  uint64_t in[3] = { 1000, engine, seqno }; uint32_t inCnt = seqno ? 3 : 1;
   kr = IOConnectCallMethod(c, kMethodWait, in, inCnt, NULL, 0,
                            NULL, NULL, NULL, 0);
   if (kr != KERN_SUCCESS) {
@@ -69,16 +129,514 @@ static void cmd_noop(io_connect_t c) {
   printf("NOOP completed (stub)\n");
 }
 
-static void cmd_mkbuf(io_connect_t c, uint32_t bytes) {
+// Chained submission of existing BOs: the first cookie is the entry batch
+static void cmd_batch(io_connect_t c, uint32_t engine, int n, char **cookies) {
+  uint64_t sin[2 + 8] = { engine, 0 };
+  if (n < 1 || n > 8) { fprintf(stderr, "batch: 1..8 cookies\n"); return; }
+  for (int i = 0; i < n; ++i) sin[2 + i] = strtoull(cookies[i], NULL, 0);
+  uint64_t seqno = 0; uint32_t outCnt = 1;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodSubmitBatch, sin, 2 + n, NULL, 0,
+                                         &seqno, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "batch submit failed: 0x%x\n", kr); return; }
+  uint64_t in[3] = { 1000, engine, seqno };
+  kr = IOConnectCallMethod(c, kMethodWait, in, 3, NULL, 0, NULL, NULL, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "wait failed: 0x%x\n", kr); return; }
+  printf("batch of %d BO(s) completed (seqno %llu)\n", n, (unsigned long long)seqno);
+}
+
+static void cmd_stats(io_connect_t c, uint32_t engine) {
+  uint64_t in[1] = { engine };
+  uint64_t out[13] = {}; uint32_t outCnt = 13;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodGetSubmitStats, in, 1, NULL, 0, out, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "stats failed: 0x%x\n", kr); return; }
+  if (outCnt < 8) { fprintf(stderr, "stats: short reply (%u)\n", outCnt); return; }
+  printf("%s: submits=%llu doorbells=%llu bypassed=%llu max_burst=%llu\n",
+         engine < sizeof(kEngineNames) / sizeof(kEngineNames[0]) ? kEngineNames[engine] : "?",
+         (unsigned long long)out[0], (unsigned long long)out[1],
+         (unsigned long long)out[2], (unsigned long long)out[3]);
+  printf("  flushes: window=%llu limit=%llu bypass=%llu wait=%llu\n",
+         (unsigned long long)out[4], (unsigned long long)out[5],
+         (unsigned long long)out[6], (unsigned long long)out[7]);
+  if (out[1])
+    printf("  submits per doorbell: %.2f\n", (double)out[0] / (double)out[1]);
+  if (outCnt >= 13)
+    printf("  hangs=%llu resets=%llu replayed=%llu downtime last=%lluus max=%lluus\n",
+           (unsigned long long)out[8], (unsigned long long)out[9], (unsigned long long)out[10],
+           (unsigned long long)out[11], (unsigned long long)out[12]);
+}
+
+static void cmd_lat(io_connect_t c, uint32_t engine) {
+  static const char *kBuckets[8] = { "<1us", "1-2us", "2-4us", "4-8us", "8-16us", "16-32us", "32-64us", ">=64us" };
+  uint64_t in[1] = { engine };
+  uint64_t out[12] = {}; uint32_t outCnt = 12;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodGetSubmitLatency, in, 1, NULL, 0, out, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "lat failed: 0x%x\n", kr); return; }
+  if (outCnt < 12) { fprintf(stderr, "lat: short reply (%u)\n", outCnt); return; }
+  printf("%s: batch pool buffers=%llu hits=%llu grows=%llu shrinks=%llu\n",
+         engine < sizeof(kEngineNames) / sizeof(kEngineNames[0]) ? kEngineNames[engine] : "?",
+         (unsigned long long)out[0], (unsigned long long)out[1],
+         (unsigned long long)out[2], (unsigned long long)out[3]);
+  for (int b = 0; b < 8; ++b)
+    printf("  %-8s %llu\n", kBuckets[b], (unsigned long long)out[4 + b]);
+}
+
+static void cmd_guc(io_connect_t c) {
+  uint64_t out[12] = {}; uint32_t outCnt = 12;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodGetGuCStats, NULL, 0, NULL, 0, out, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "guc failed: 0x%x\n", kr); return; }
+  if (outCnt < 12) { fprintf(stderr, "guc: short reply (%u)\n", outCnt); return; }
+  printf("GuC: status=0x%08x v%u.%u.%u uploads=%llu ct=%s\n", (uint32_t)out[0],
+         (unsigned)(out[1] >> 16) & 0xff, (unsigned)(out[1] >> 8) & 0xff, (unsigned)out[1] & 0xff,
+         (unsigned long long)out[2], out[3] ? "enabled" : "off");
+  printf("  ct sends=%llu doorbells=%llu responses=%llu events=%llu failures=%llu max_outstanding=%llu\n",
+         (unsigned long long)out[4], (unsigned long long)out[5], (unsigned long long)out[6],
+         (unsigned long long)out[7], (unsigned long long)out[8], (unsigned long long)out[9]);
+  printf("  log written=%llu overflows=%llu\n", (unsigned long long)out[10], (unsigned long long)out[11]);
+}
+
+// kMethodGetMemStats: a fresh connection holds nothing, so the client
+// columns only show what this invocation's own connection holds (zero)
+static void cmd_mem(io_connect_t c) {
+  uint64_t out[30] = {}; uint32_t outCnt = 30;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodGetMemStats, NULL, 0, NULL, 0, out, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "mem failed: 0x%x\n", kr); return; }
+  if (outCnt < 30) { fprintf(stderr, "mem: short reply (%u)\n", outCnt); return; }
+  const double mb = 1024.0 * 1024.0;
+  printf("GPU memory (MB): allocated=%.1f pinned=%.1f bound=%.1f pooled=%.1f reserved=%.1f (%.1f backed later)\n",
+         out[4] / mb, out[5] / mb, out[6] / mb, out[7] / mb, out[15] / mb, out[16] / mb);
+  printf("  this client: allocated=%.1f pinned=%.1f bound=%.1f reserved=%.1f bos=%llu\n",
+         out[0] / mb, out[1] / mb, out[2] / mb, out[14] / mb, (unsigned long long)out[3]);
+  printf("  limits: soft=%.0f hard=%.0f per client=%.0f (0 = none)\n", out[8] / mb, out[9] / mb, out[10] / mb);
+  printf("  reclaimed: pool=%.1f userptr=%.1f  refused allocations=%llu\n",
+         out[11] / mb, out[12] / mb, (unsigned long long)out[13]);
+  printf("  scanout flushes: %llu, %llu lines (%.0f per flush, last %llu)\n", (unsigned long long)out[17],
+         (unsigned long long)out[18], out[17] ? (double)out[18] / out[17] : 0.0, (unsigned long long)out[19]);
+  printf("  purgeable BOs: %llu, purged %.1f\n", (unsigned long long)out[20], out[21] / mb);
+  printf("  stolen: size=%.1f free=%.1f rings/status pages=%.1f scanout BOs=%.1f\n",
+         out[22] / mb, out[23] / mb, out[24] / mb, out[25] / mb);
+  printf("  engine pool: size=%.1f used=%.1f did not fit=%llu  engine blocks in system RAM=%.1f\n",
+         out[26] / mb, out[27] / mb, (unsigned long long)out[28], out[29] / mb);
+}
+
+// ------------------------------- log relay -------------------------------
+// Same protocol as XeLogRelayReader in kexts/XeLogRelay.hpp: our own read
+// pointers, sequence checks to spot records rewritten under us, and only the
+// newest half of the GuC debug log trusted.
+
+static const char *kLogEvents[] = { "?", "submit", "doorbell", "retire", "hang", "reset", "guc-flush", "guc-crash" };
+
+static void guc_sample(const XeLogRelayHeader *h, uint64_t *written, uint32_t *wrap) {
+  for (;;) {
+    uint32_t s = __atomic_load_n(&h->gucSeq, __ATOMIC_ACQUIRE);
+    *written = h->gucWritten;
+    *wrap = h->gucWrapOffset;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (!(s & 1) && __atomic_load_n(&h->gucSeq, __ATOMIC_RELAXED) == s) return;
+  }
+}
+
+static int log_next(const XeLogRelayHeader *h, const XeLogRecord *recs, uint64_t *tail, uint64_t *lost,
+                    XeLogRecord *out) {
+  const uint64_t cap = h->capacity;
+  for (;;) {
+    uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    if (*tail >= head) return 0;
+    if (head - *tail > cap) { *lost += head - *tail - cap; *tail = head - cap; }
+    const XeLogRecord *r = &recs[*tail & (cap - 1)];
+    uint64_t s = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+    if (s == *tail + 1) {
+      memcpy(out, (const void *)r, sizeof(*out));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == s) { (*tail)++; return 1; }
+    }
+    (*lost)++;
+    (*tail)++;
+  }
+}
+
+static size_t guc_read(const XeLogRelayHeader *h, const uint8_t *debug, uint64_t *tail, uint64_t *lost,
+                       uint8_t *out, size_t max) {
+  const uint64_t size = h->gucDebugBytes, window = size / 2;
+  for (;;) {
+    uint64_t w, w2;
+    uint32_t wrap;
+    guc_sample(h, &w, &wrap);
+    if (*tail >= w) return 0;
+    if (w - *tail > window) { *lost += w - window - *tail; *tail = w - window; }
+    uint64_t off = *tail % size;
+    int older = *tail / size < w / size;
+    if (older && off >= wrap) { *tail += size - off; continue; }
+    uint64_t end = older ? (*tail / size) * size + wrap : w;
+    size_t n = (size_t)(end - *tail);
+    if (n > max) n = max;
+    memcpy(out, debug + off, n);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    guc_sample(h, &w2, &wrap);
+    *tail += n;
+    if (w2 > window && *tail - n < w2 - window) { *lost += n; continue; }
+    return n;
+  }
+}
+
+// Streams driver events to stdout (and raw GuC debug log bytes to a file)
+// until interrupted; sleeps 1 ms whenever both are caught up.
+static void cmd_log(io_connect_t c, const char *gucPath) {
+  mach_vm_address_t relayAddr = 0, gucAddr = 0;
+  mach_vm_size_t relaySize = 0, gucSize = 0;
+  kern_return_t kr = IOConnectMapMemory64(c, kXeMemoryLogRelay, mach_task_self(), &relayAddr, &relaySize,
+                                          kIOMapAnywhere | kIOMapReadOnly);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "log: relay map failed: 0x%x\n", kr); return; }
+  const XeLogRelayHeader *h = (const XeLogRelayHeader *)(uintptr_t)relayAddr;
+  if (h->magic != kXeLogRelayMagic || h->version != kXeLogRelayVersion ||
+      h->recordBytes != sizeof(XeLogRecord)) {
+    fprintf(stderr, "log: relay layout mismatch (magic 0x%08x version %u)\n", h->magic, h->version);
+    return;
+  }
+  const XeLogRecord *recs = (const XeLogRecord *)(uintptr_t)(relayAddr + h->recordsOffset);
+
+  FILE *gucOut = NULL;
+  const uint8_t *debug = NULL;
+  if (gucPath) {
+    kr = IOConnectMapMemory64(c, kXeMemoryGuCLog, mach_task_self(), &gucAddr, &gucSize,
+                              kIOMapAnywhere | kIOMapReadOnly);
+    if (kr != KERN_SUCCESS || !h->gucDebugBytes || h->gucDebugOffset + h->gucDebugBytes > gucSize) {
+      fprintf(stderr, "log: no GuC log (0x%x)\n", kr);
+      return;
+    }
+    debug = (const uint8_t *)(uintptr_t)(gucAddr + h->gucDebugOffset);
+    gucOut = fopen(gucPath, "ab");
+    if (!gucOut) { perror(gucPath); return; }
+  }
+
+  mach_timebase_info_data_t tb;
+  mach_timebase_info(&tb);
+  uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+  uint64_t tail = head > h->capacity ? head - h->capacity : 0, lost = 0, reported = 0;
+  uint64_t gucTail = 0, gucLost = 0, gucReported = 0;
+  uint32_t wrap;
+  guc_sample(h, &gucTail, &wrap);    // GuC bytes from now on only
+  printf("relay: %u records, write pointer %llu\n", h->capacity, (unsigned long long)head);
+
+  static uint8_t buf[16384];
+  for (;;) {
+    int idle = 1;
+    XeLogRecord r;
+    while (log_next(h, recs, &tail, &lost, &r)) {
+      idle = 0;
+      const char *name = r.type < sizeof(kLogEvents) / sizeof(kLogEvents[0]) ? kLogEvents[r.type] : "?";
+      const char *eng = r.engine < sizeof(kEngineNames) / sizeof(kEngineNames[0]) ? kEngineNames[r.engine] : "guc";
+      printf("%14.3f us  %-5s %-9s %u %u %u\n", (double)r.time * tb.numer / tb.denom / 1000.0,
+             eng, name, r.arg0, r.arg1, r.arg2);
+    }
+    size_t n;
+    while (gucOut && (n = guc_read(h, debug, &gucTail, &gucLost, buf, sizeof(buf))) > 0) {
+      idle = 0;
+      fwrite(buf, 1, n, gucOut);
+    }
+    if (lost != reported || gucLost != gucReported) {
+      fprintf(stderr, "log: lost %llu records, %llu GuC bytes (GuC overflows %llu)\n",
+              (unsigned long long)lost, (unsigned long long)gucLost, (unsigned long long)h->gucOverflows);
+      reported = lost;
+      gucReported = gucLost;
+    }
+    if (idle) {
+      fflush(stdout);
+      if (gucOut) fflush(gucOut);
+      usleep(1000);
+    }
+  }
+}
+
+// With lazy, the BO is only a reservation; the accounting printed after
+// it shows where the bytes went (the BO dies with the connection).
+static void cmd_mkbuf(io_connect_t c, uint32_t bytes, int lazy) {
   // Clamp to something modest and page-aligned
   if (bytes == 0) bytes = 4096;
   if (bytes > (16u * 1024 * 1024)) bytes = 16u * 1024 * 1024; // 16 MiB max
 
-  uint64_t in[1] = { bytes }; uint32_t inCnt = 1;
+  uint64_t in[2] = { bytes, lazy ? kBufferFlagLazy : 0 }; uint32_t inCnt = 2;
   uint64_t out[1]; uint32_t outCnt = 1;
   kern_return_t kr = IOConnectCallMethod(c, kMethodCreateBuffer, in, inCnt, NULL, 0, out, &outCnt, NULL, 0);
   if (kr != KERN_SUCCESS) { fprintf(stderr, "createBuffer failed: 0x%x\n", kr); return; }
-  printf("Created buffer cookie=0x%llx (size=%u)\n", (unsigned long long)out[0], bytes);
+  printf("Created buffer cookie=0x%llx (size=%u%s)\n", (unsigned long long)out[0], bytes, lazy ? ", lazy" : "");
+  cmd_mem(c);
+}
+
+static uint32_t parse_cache(const char *mode) {
+  if (mode && !strcmp(mode, "wc")) return kXeCacheWC;
+  if (mode && !strcmp(mode, "uc")) return kXeCacheUC;
+  return kXeCacheWB;
+}
+
+// Creates a BO in the given cache mode, writes a batch into it in place
+// and runs it. BOs belong to the connection, so this has to happen in one
+// process.
+static void cmd_run(io_connect_t c, uint32_t engine, const char *mode) {
+  uint32_t cache = parse_cache(mode);
+  uint64_t in[2] = { 4096, (uint64_t)cache << kBufferCacheShift }, cookie = 0;
+  uint32_t outCnt = 1;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodCreateBuffer, in, 2, NULL, 0, &cookie, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "createBuffer failed: 0x%x\n", kr); return; }
+
+  // kIOMapDefaultCache: the mapping takes the BO's own mode
+  mach_vm_address_t addr = 0;
+  mach_vm_size_t size = 0;
+  kr = IOConnectMapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), &addr, &size,
+                            kIOMapAnywhere | kIOMapDefaultCache);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "map failed: 0x%x\n", kr); return; }
+  volatile uint32_t *batch = (volatile uint32_t *)(uintptr_t)addr;
+  batch[0] = 0;                    // MI_NOOP
+  batch[1] = 0x0A << 23;           // MI_BATCH_BUFFER_END
+  if (cache == kXeCacheWC) __asm__ volatile("sfence" ::: "memory");   // drain the combining buffers
+  printf("BO 0x%llx mapped at 0x%llx (%llu bytes, cache=%s)\n", (unsigned long long)cookie,
+         (unsigned long long)addr, (unsigned long long)size, mode ? mode : "wb");
+
+  char arg[32];
+  char *argv[1] = { arg };
+  snprintf(arg, sizeof(arg), "0x%llx", (unsigned long long)cookie);
+  cmd_batch(c, engine, 1, argv);
+
+  IOConnectUnmapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), addr);
+  in[0] = cookie;
+  IOConnectCallMethod(c, kMethodDestroyBuffer, in, 1, NULL, 0, NULL, NULL, NULL, 0);
+}
+
+// CPU write and read bandwidth through a BO mapping in each cache mode,
+// including what it costs to make the writes visible to the GPU: an
+// sfence for WC, nothing for WB (the GPU snoops the LLC), and a clflush
+// of every line for WB that scanout will read. Each pass touches every
+// byte once; the best of a few passes is reported.
+static volatile uint64_t cachebench_sink;
+
+static double cachebench_pass(volatile uint64_t *p, size_t words, int write, int flush, double ticksPerNs) {
+  uint64_t t0 = mach_absolute_time(), sum = 0;
+  if (write) {
+    for (size_t i = 0; i < words; ++i) p[i] = i;
+    if (flush == 1) __asm__ volatile("sfence" ::: "memory");
+    if (flush == 2) {
+      __asm__ volatile("mfence" ::: "memory");
+      for (size_t i = 0; i < words; i += 8) __asm__ volatile("clflush (%0)" :: "r"(p + i) : "memory");
+      __asm__ volatile("mfence" ::: "memory");
+    }
+  } else {
+    for (size_t i = 0; i < words; ++i) sum += p[i];
+  }
+  uint64_t t1 = mach_absolute_time();
+  cachebench_sink = sum;
+  return (double)(words * 8) / ((double)(t1 - t0) / ticksPerNs);   // bytes per ns = GB/s
+}
+
+static void cmd_cachebench(io_connect_t c, uint32_t mb) {
+  static const struct { const char *name; uint32_t mode; int flush; } kModes[] = {
+    { "wb", kXeCacheWB, 0 }, { "wb+clflush", kXeCacheWB, 2 }, { "wc", kXeCacheWC, 1 }, { "uc", kXeCacheUC, 0 },
+  };
+  if (mb == 0) mb = 16;
+  if (mb > 64) mb = 64;
+  mach_timebase_info_data_t tb;
+  mach_timebase_info(&tb);
+  double ticksPerNs = (double)tb.denom / tb.numer;
+  printf("%u MB per pass\n%-11s %10s %10s\n", mb, "mode", "write GB/s", "read GB/s");
+
+  for (size_t m = 0; m < sizeof(kModes) / sizeof(kModes[0]); ++m) {
+    uint64_t in[2] = { (uint64_t)mb << 20, (uint64_t)kModes[m].mode << kBufferCacheShift }, cookie = 0;
+    uint32_t outCnt = 1;
+    kern_return_t kr = IOConnectCallMethod(c, kMethodCreateBuffer, in, 2, NULL, 0, &cookie, &outCnt, NULL, 0);
+    if (kr != KERN_SUCCESS) { fprintf(stderr, "createBuffer failed: 0x%x\n", kr); return; }
+    mach_vm_address_t addr = 0;
+    mach_vm_size_t size = 0;
+    kr = IOConnectMapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), &addr, &size,
+                              kIOMapAnywhere | kIOMapDefaultCache);
+    if (kr != KERN_SUCCESS) { fprintf(stderr, "map failed: 0x%x\n", kr); return; }
+
+    volatile uint64_t *p = (volatile uint64_t *)(uintptr_t)addr;
+    size_t words = (size_t)in[0] / 8;
+    // UC is slow enough that one pass says it all
+    int passes = kModes[m].mode == kXeCacheUC ? 1 : 3;
+    double wr = 0, rd = 0;
+    for (int i = 0; i < passes; ++i) {
+      double w = cachebench_pass(p, words, 1, kModes[m].flush, ticksPerNs);
+      double r = cachebench_pass(p, words, 0, 0, ticksPerNs);
+      if (w > wr) wr = w;
+      if (r > rd) rd = r;
+    }
+    printf("%-11s %10.2f %10.2f\n", kModes[m].name, wr, rd);
+
+    IOConnectUnmapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), addr);
+    in[0] = cookie;
+    IOConnectCallMethod(c, kMethodDestroyBuffer, in, 1, NULL, 0, NULL, NULL, NULL, 0);
+  }
+}
+
+// A 2560x1600 XRGB framebuffer in a WB BO. Each frame redraws a 64x64
+// pixel block that moves across the screen, reports its 64 rows as dirty
+// ranges and flushes only those lines; then the same number of frames
+// flush the whole surface, as a driver without damage tracking would.
+// With "stolen" the BO is created as a scanout BO: in stolen memory it is
+// written through the WC aperture and every flush is just a fence.
+static uint64_t scanout_flush(io_connect_t c, uint64_t cookie, uint32_t flags, const uint64_t *ranges,
+                              uint32_t count) {
+  uint64_t in[2 + kFlushMaxRanges] = { cookie, flags }, lines = 0;
+  uint32_t outCnt = 1;
+  memcpy(in + 2, ranges, count * sizeof(uint64_t));
+  kern_return_t kr = IOConnectCallMethod(c, kMethodFlushBuffer, in, 2 + count, NULL, 0, &lines, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) fprintf(stderr, "flushBuffer failed: 0x%x\n", kr);
+  return lines;
+}
+
+static void cmd_scanout(io_connect_t c, uint32_t frames, int stolen) {
+  const uint32_t width = 2560, height = 1600, pitch = width * 4, block = 64;
+  if (frames == 0) frames = 600;
+  uint64_t before[30] = {}, after[30] = {};
+  uint32_t statCnt = 30;
+  IOConnectCallMethod(c, kMethodGetMemStats, NULL, 0, NULL, 0, before, &statCnt, NULL, 0);
+  uint64_t in[2] = { (uint64_t)pitch * height, (uint64_t)kXeCacheWB << kBufferCacheShift }, cookie = 0;
+  if (stolen) in[1] |= kBufferFlagScanout;
+  uint32_t outCnt = 1;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodCreateBuffer, in, 2, NULL, 0, &cookie, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "createBuffer failed: 0x%x\n", kr); return; }
+  statCnt = 30;
+  IOConnectCallMethod(c, kMethodGetMemStats, NULL, 0, NULL, 0, after, &statCnt, NULL, 0);
+  // Landed in stolen memory when the stolen BO bytes grew; that BO is WC
+  int inStolen = stolen && statCnt >= 30 && after[25] > before[25];
+  if (stolen && !inStolen) printf("no room in stolen memory: using a WB BO in system RAM\n");
+  mach_vm_address_t addr = 0;
+  mach_vm_size_t size = 0;
+  kr = IOConnectMapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), &addr, &size,
+                            kIOMapAnywhere | (inStolen ? kIOMapWriteCombineCache : kIOMapDefaultCache));
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "map failed: 0x%x\n", kr); return; }
+  uint8_t *fb = (uint8_t *)(uintptr_t)addr;
+  mach_timebase_info_data_t tb;
+  mach_timebase_info(&tb);
+
+  uint64_t damageLines = 0, damageTicks = 0, fullLines = 0, fullTicks = 0;
+  for (uint32_t f = 0; f < frames; ++f) {
+    uint32_t x = (f * 8) % (width - block), y = (f * 5) % (height - block);
+    uint64_t rows[block];
+    for (uint32_t row = 0; row < block; ++row) {
+      uint32_t offset = (y + row) * pitch + x * 4;
+      memset(fb + offset, (int)f, block * 4);
+      rows[row] = (uint64_t)offset << 32 | (block * 4);
+    }
+    uint64_t t0 = mach_absolute_time();
+    uint32_t sent = 0;
+    while (sent < block) {
+      uint32_t n = block - sent < kFlushMaxRanges ? block - sent : kFlushMaxRanges;
+      damageLines += scanout_flush(c, cookie, sent + n < block ? kFlushFlagDefer : 0, rows + sent, n);
+      sent += n;
+    }
+    damageTicks += mach_absolute_time() - t0;
+  }
+  for (uint32_t f = 0; f < frames; ++f) {
+    uint64_t whole = (uint64_t)pitch * height;   // offset 0
+    uint64_t t0 = mach_absolute_time();
+    fullLines += scanout_flush(c, cookie, 0, &whole, 1);
+    fullTicks += mach_absolute_time() - t0;
+  }
+  printf("%u frames of a %ux%u %s framebuffer, %ux%u damage per frame\n", frames, width, height,
+         inStolen ? "stolen WC" : "WB", block, block);
+  printf("  damage ranges: %8.0f lines/frame %8.1f us/frame\n", (double)damageLines / frames,
+         (double)damageTicks * tb.numer / tb.denom / 1000.0 / frames);
+  printf("  whole surface: %8.0f lines/frame %8.1f us/frame\n", (double)fullLines / frames,
+         (double)fullTicks * tb.numer / tb.denom / 1000.0 / frames);
+
+  IOConnectUnmapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), addr);
+  in[0] = cookie;
+  IOConnectCallMethod(c, kMethodDestroyBuffer, in, 1, NULL, 0, NULL, NULL, NULL, 0);
+  cmd_mem(c);
+}
+
+// Fills a BO, advises DONTNEED and then allocates past the soft limit
+// (xepci=memsoft=) so the kernel has to reclaim; WILLNEED then tells
+// whether the BO's contents survived.
+static uint64_t madvise_bo(io_connect_t c, uint64_t cookie, uint32_t advice) {
+  uint64_t in[2] = { cookie, advice }, retained = 0;
+  uint32_t outCnt = 1;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodMadvise, in, 2, NULL, 0, &retained, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) fprintf(stderr, "madvise failed: 0x%x\n", kr);
+  return retained;
+}
+
+static void cmd_purge(io_connect_t c, uint32_t mb) {
+  if (mb == 0) mb = 16;
+  if (mb > 64) mb = 64;
+  uint64_t stats[30] = {}; uint32_t statCnt = 30;
+  kern_return_t kr = IOConnectCallMethod(c, kMethodGetMemStats, NULL, 0, NULL, 0, stats, &statCnt, NULL, 0);
+  if (kr != KERN_SUCCESS || statCnt < 30) { fprintf(stderr, "mem failed: 0x%x\n", kr); return; }
+  if (!stats[8]) printf("no soft limit (xepci=memsoft=MB): the BO will only be purged at a hard limit\n");
+
+  uint64_t in[2] = { (uint64_t)mb << 20, 0 }, cookie = 0;
+  uint32_t outCnt = 1;
+  kr = IOConnectCallMethod(c, kMethodCreateBuffer, in, 2, NULL, 0, &cookie, &outCnt, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "createBuffer failed: 0x%x\n", kr); return; }
+  mach_vm_address_t addr = 0;
+  mach_vm_size_t size = 0;
+  kr = IOConnectMapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), &addr, &size,
+                            kIOMapAnywhere | kIOMapDefaultCache);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "map failed: 0x%x\n", kr); return; }
+  memset((void *)(uintptr_t)addr, 0xA5, (size_t)size);
+  // A mapping pins the pages: unmap before giving them up
+  IOConnectUnmapMemory64(c, memory_type_for_cookie(cookie), mach_task_self(), addr);
+  madvise_bo(c, cookie, kMadviseDontNeed);
+  printf("BO 0x%llx (%u MB) advised DONTNEED\n", (unsigned long long)cookie, mb);
+
+  // Push the footprint past the soft limit, 16 MB at a time
+  uint64_t filler[64];
+  uint32_t fillers = 0;
+  uint64_t target = stats[8] ? stats[8] + ((uint64_t)mb << 20) : 0;
+  while (fillers < 64) {
+    statCnt = 30;
+    IOConnectCallMethod(c, kMethodGetMemStats, NULL, 0, NULL, 0, stats, &statCnt, NULL, 0);
+    if (!target || stats[4] + stats[5] + stats[7] >= target || stats[21]) break;
+    in[0] = 16u << 20;
+    in[1] = 0;
+    outCnt = 1;
+    if (IOConnectCallMethod(c, kMethodCreateBuffer, in, 2, NULL, 0, &filler[fillers], &outCnt, NULL, 0) != KERN_SUCCESS) break;
+    fillers++;
+  }
+  printf("allocated %u MB on top\n", fillers * 16);
+
+  uint64_t retained = madvise_bo(c, cookie, kMadviseWillNeed);
+  printf("WILLNEED: contents %s\n", retained ? "retained" : "purged (BO is zero-filled again)");
+  cmd_mem(c);
+  for (uint32_t i = 0; i < fillers; ++i) {
+    in[0] = filler[i];
+    IOConnectCallMethod(c, kMethodDestroyBuffer, in, 1, NULL, 0, NULL, NULL, NULL, 0);
+  }
+  in[0] = cookie;
+  IOConnectCallMethod(c, kMethodDestroyBuffer, in, 1, NULL, 0, NULL, NULL, NULL, 0);
+}
+
+// Runs a batch straight out of this process's own memory. The second
+// import of the same range is served from the kernel's userptr cache.
+static void cmd_uptr(io_connect_t c, uint32_t engine) {
+  void *mem = NULL;
+  if (posix_memalign(&mem, 4096, 4096)) { fprintf(stderr, "uptr: no memory\n"); return; }
+  memset(mem, 0, 4096);
+  ((uint32_t *)mem)[0] = 0x0A << 23;   // MI_BATCH_BUFFER_END
+  for (int pass = 0; pass < 2; ++pass) {
+    uint64_t in[2] = { (uint64_t)(uintptr_t)mem, 4096 }, cookie = 0;
+    uint32_t outCnt = 1;
+    uint64_t t0 = mach_absolute_time();
+    kern_return_t kr = IOConnectCallMethod(c, kMethodImportUserptr, in, 2, NULL, 0, &cookie, &outCnt, NULL, 0);
+    uint64_t t1 = mach_absolute_time();
+    if (kr != KERN_SUCCESS) { fprintf(stderr, "importUserptr failed: 0x%x\n", kr); break; }
+    printf("import %d: cookie=0x%llx (%llu ticks)\n", pass, (unsigned long long)cookie,
+           (unsigned long long)(t1 - t0));
+    char arg[32];
+    char *argv[1] = { arg };
+    snprintf(arg, sizeof(arg), "0x%llx", (unsigned long long)cookie);
+    cmd_batch(c, engine, 1, argv);
+    in[0] = cookie;
+    IOConnectCallMethod(c, kMethodDestroyBuffer, in, 1, NULL, 0, NULL, NULL, NULL, 0);
+  }
+  free(mem);   // still pinned by the kernel until the connection closes
+}
+
+static void cmd_rmbuf(io_connect_t c, uint64_t cookie) {
+  uint64_t in[1] = { cookie };
+  kern_return_t kr = IOConnectCallMethod(c, kMethodDestroyBuffer, in, 1, NULL, 0, NULL, NULL, NULL, 0);
+  if (kr != KERN_SUCCESS) { fprintf(stderr, "destroyBuffer failed: 0x%x\n", kr); return; }
+  printf("Destroyed buffer cookie=0x%llx\n", (unsigned long long)cookie);
 }
 
 static void cmd_gtconfig(io_connect_t c) {
@@ -95,14 +653,36 @@ static void cmd_gtconfig(io_connect_t c) {
 
 int main(int argc, char **argv) {
   if (argc < 2) {
-    fprintf(stderr, "usage: %s [info|regdump|noop|mkbuf BYTES]\n", argv[0]);
+    fprintf(stderr, "usage: %s [info|regdump|noop [ENGINE] [urgent]|stats [ENGINE]|lat [ENGINE]|batch ENGINE COOKIE...|guc|log [guc FILE]|mkbuf BYTES [lazy]|rmbuf COOKIE|run [ENGINE] [wb|wc|uc]|uptr [ENGINE]|mem|cachebench [MB]|scanout [FRAMES] [stolen]|purge [MB]]\n", argv[0]);
     return 1;
   }
   io_connect_t c = open_connection();
   if (!strcmp(argv[1], "info"))         cmd_info(c);
   else if (!strcmp(argv[1], "regdump")) cmd_regdump(c);
-  else if (!strcmp(argv[1], "noop"))    cmd_noop(c);
-  else if (!strcmp(argv[1], "mkbuf") && argc >= 3) cmd_mkbuf(c, (uint32_t)strtoul(argv[2], NULL, 0));
+  else if (!strcmp(argv[1], "noop"))
+    cmd_noop(c, argc >= 3 ? parse_engine(argv[2]) : 0,
+             (argc >= 4 && !strcmp(argv[3], "urgent")) ? kSubmitFlagLatencyCritical : 0);
+  else if (!strcmp(argv[1], "stats"))   cmd_stats(c, argc >= 3 ? parse_engine(argv[2]) : 0);
+  else if (!strcmp(argv[1], "lat"))     cmd_lat(c, argc >= 3 ? parse_engine(argv[2]) : 0);
+  else if (!strcmp(argv[1], "batch") && argc >= 4)
+    cmd_batch(c, parse_engine(argv[2]), argc - 3, argv + 3);
+  else if (!strcmp(argv[1], "guc"))     cmd_guc(c);
+  else if (!strcmp(argv[1], "log"))
+    cmd_log(c, (argc >= 4 && !strcmp(argv[2], "guc")) ? argv[3] : NULL);
+  else if (!strcmp(argv[1], "mkbuf") && argc >= 3)
+    cmd_mkbuf(c, (uint32_t)strtoul(argv[2], NULL, 0), argc >= 4 && !strcmp(argv[3], "lazy"));
+  else if (!strcmp(argv[1], "run"))
+    cmd_run(c, argc >= 3 ? parse_engine(argv[2]) : 0, argc >= 4 ? argv[3] : NULL);
+  else if (!strcmp(argv[1], "uptr"))    cmd_uptr(c, argc >= 3 ? parse_engine(argv[2]) : 0);
+  else if (!strcmp(argv[1], "mem"))     cmd_mem(c);
+  else if (!strcmp(argv[1], "cachebench"))
+    cmd_cachebench(c, argc >= 3 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0);
+  else if (!strcmp(argv[1], "purge"))
+    cmd_purge(c, argc >= 3 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0);
+  else if (!strcmp(argv[1], "scanout"))
+    cmd_scanout(c, argc >= 3 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0,
+                argc >= 4 && !strcmp(argv[3], "stolen"));
+  else if (!strcmp(argv[1], "rmbuf") && argc >= 3) cmd_rmbuf(c, strtoull(argv[2], NULL, 0));
   else fprintf(stderr, "unknown cmd\n");
   IOServiceClose(c);
   return 0;
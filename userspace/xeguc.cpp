@@ -0,0 +1,223 @@
+// userspace/xeguc.cpp — GuC firmware blob checker
+
+// Build (host, no GPU or IOKit needed):
+//   c++ -std=c++17 -O2 -I../kexts xeguc.cpp -o xeguc
+// Usage: ./xeguc [-w WOPCM_BYTES] BLOB...
+//        ./xeguc -s REQUESTS [-d DEPTH]
+//   -w  room the GuC WOPCM partition offers for header + uCode + private
+//       data (default: no limit)
+//   -s  drive the CT channel against a simulated GuC instead
+//   -d  requests kept in flight (1 = one round trip at a time, like the
+//       MMIO mailbox; default XeGuCCT::kMaxOutstanding)
+//
+// Blob mode runs the kext's own parser (XeGuCFirmware.hpp) over each blob
+// and prints the layout the loader would upload. Exits non-zero if any
+// blob is rejected, so sample blobs can be checked in a script before they
+// go into XePCI.kext/Contents/Resources.
+//
+// Simulation mode runs XeGuCCT unchanged against a peer thread that plays
+// the GuC: it wakes on the doorbell, drains H2G, answers every request in
+// reverse order (so fences complete out of order), stalls some with a
+// NO_RESPONSE_BUSY first and slips in G2H events. Every response is checked
+// against its request; exits non-zero on any mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "XeGuCFirmware.hpp"
+#include "XeGuCCT.hpp"
+
+static bool readFile(const char* path, std::vector<uint8_t>* out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out->insert(out->end(), buf, buf + n);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+static bool check(const char* path, uint32_t wopcm) {
+  std::vector<uint8_t> blob;
+  if (!readFile(path, &blob)) {
+    fprintf(stderr, "%s: cannot read\n", path);
+    return false;
+  }
+
+  XeGuCFirmware::Layout fw {};
+  XeGuCFirmware::Result r = XeGuCFirmware::parse(blob.data(), blob.size(), wopcm, &fw);
+  if (r != XeGuCFirmware::kFwOk) {
+    printf("%s: REJECTED (%s), %zu bytes\n", path, XeGuCFirmware::resultName(r), blob.size());
+    return false;
+  }
+
+  XeGuCCssHeader css;
+  memcpy(&css, blob.data(), sizeof(css));
+  char build[sizeof(css.buildNumber) + 1] = {};
+  memcpy(build, css.buildNumber, sizeof(css.buildNumber));
+  printf("%s: GuC v%u.%u.%u (build %s, %08x) module type 0x%x\n",
+         path, fw.major, fw.minor, fw.patch, build, css.date, css.moduleType);
+  printf("  uCode   %7u bytes @ 0x%x\n", fw.ucodeBytes, fw.ucodeOffset);
+  printf("  RSA     %7u bytes @ 0x%x\n", fw.rsaBytes, fw.rsaOffset);
+  printf("  upload  %7u bytes (header + uCode), private data %u bytes\n",
+         fw.uploadBytes, fw.privateBytes);
+  size_t tail = blob.size() - (fw.rsaOffset + fw.rsaBytes);
+  if (tail) printf("  %zu trailing bytes (modulus / exponent / padding) ignored\n", tail);
+  return true;
+}
+
+// ------------------------------ CT simulation ------------------------------
+
+static constexpr uint32_t kSimAction = 0x5555;
+
+class SimGuC {
+public:
+  std::atomic<uint32_t> doorbells {0};
+  std::atomic<bool>     stop {false};
+  uint64_t              requests = 0;
+
+  void join(uint8_t* blob) {
+    h2g.attach((XeGuCCTDesc*)(blob + XeGuCCT::kH2GDescOffset), (uint32_t*)(blob + XeGuCCT::kH2GOffset),
+               XeGuCCT::kH2GBytes / 4);
+    g2h.attach((XeGuCCTDesc*)(blob + XeGuCCT::kG2HDescOffset), (uint32_t*)(blob + XeGuCCT::kG2HOffset),
+               XeGuCCT::kG2HBytes / 4);
+  }
+
+  void run() {
+    uint32_t seen = 0;
+    uint32_t msg[XeHW::GUC_CTB_HXG_MSG_MAX_DW];
+    std::vector<uint32_t> replies;     // fence, payload pairs
+    while (!stop.load(std::memory_order_relaxed)) {
+      uint32_t db = doorbells.load(std::memory_order_acquire);
+      if (db == seen) { std::this_thread::yield(); continue; }
+      seen = db;
+
+      replies.clear();
+      uint32_t dw;
+      while ((dw = h2g.read(msg)) != 0) {
+        uint32_t type = (msg[1] & XeHW::GUC_HXG_TYPE_MASK) >> XeHW::GUC_HXG_TYPE_SHIFT;
+        if (type != XeHW::GUC_HXG_TYPE_REQUEST || dw < 3) continue;
+        replies.push_back(msg[0] >> XeHW::GUC_CTB_MSG_FENCE_SHIFT);
+        replies.push_back(msg[2]);
+      }
+      // Newest first: the host must match by fence, not by order
+      for (size_t i = replies.size(); i >= 2; i -= 2) {
+        uint32_t fence = replies[i - 2], payload = replies[i - 1];
+        requests++;
+        if (requests % 7 == 0) reply(fence, XeHW::GUC_HXG_TYPE_NO_RESPONSE_BUSY, 0);
+        if (requests % 64 == 0) reply(0, XeHW::GUC_HXG_TYPE_EVENT, requests);
+        reply(fence, XeHW::GUC_HXG_TYPE_RESPONSE_SUCCESS, payload);
+      }
+    }
+  }
+
+private:
+  XeGuCCTBuffer h2g;   // consumer
+  XeGuCCTBuffer g2h;   // producer
+
+  void reply(uint32_t fence, uint32_t type, uint64_t data0) {
+    uint32_t out[2] = {
+      (fence << XeHW::GUC_CTB_MSG_FENCE_SHIFT) | (XeHW::GUC_CTB_FORMAT_HXG << XeHW::GUC_CTB_MSG_FORMAT_SHIFT) | 1,
+      XeHW::GUC_HXG_ORIGIN_GUC | (type << XeHW::GUC_HXG_TYPE_SHIFT) |
+        ((uint32_t)data0 & XeHW::GUC_HXG_RESPONSE_DATA0_MASK),
+    };
+    while (!g2h.write(out, 2)) {
+      if (g2h.broken() || stop.load(std::memory_order_relaxed)) return;
+      std::this_thread::yield();
+    }
+  }
+};
+
+static void simDoorbell(void* context) {
+  ((SimGuC*)context)->doorbells.fetch_add(1, std::memory_order_release);
+}
+
+static uint64_t gSimEvents;
+static void simEvent(void*, const uint32_t*, uint32_t) { gSimEvents++; }
+
+static bool simulate(uint32_t requests, uint32_t depth) {
+  if (depth == 0 || depth > XeGuCCT::kMaxOutstanding) depth = XeGuCCT::kMaxOutstanding;
+  uint8_t* blob = (uint8_t*)aligned_alloc(4096, XeGuCCT::kBlobBytes);
+  if (!blob) { fprintf(stderr, "out of memory\n"); return false; }
+
+  // The host zeroes and owns the blob; the GuC joins afterwards
+  static XeGuCCT ct;
+  SimGuC guc;
+  ct.init(blob, simDoorbell, &guc, simEvent);
+  guc.join(blob);
+  std::thread peer(&SimGuC::run, &guc);
+
+  struct Inflight { uint16_t fence; uint32_t payload; };
+  std::vector<Inflight> inflight;
+  uint32_t sent = 0, done = 0, bad = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  while (done < requests && !ct.broken()) {
+    while (sent < requests && inflight.size() < depth) {
+      uint32_t hxg[2] = { XeHW::GUC_HXG_REQUEST(kSimAction, 0), sent & XeHW::GUC_HXG_RESPONSE_DATA0_MASK };
+      uint16_t fence = 0;
+      XeGuCCT::Result r = ct.send(hxg, 2, &fence);
+      if (r == XeGuCCT::kCTNoSpace || r == XeGuCCT::kCTBusy) break;
+      if (r != XeGuCCT::kCTOk) { fprintf(stderr, "send failed: %u\n", r); bad++; break; }
+      inflight.push_back({ fence, hxg[1] });
+      sent++;
+    }
+    ct.flush();
+    ct.process();
+    for (size_t i = 0; i < inflight.size();) {
+      uint32_t resp[XeGuCCT::kMaxResponseDw], n = 0;
+      XeGuCCT::Result r = ct.poll(inflight[i].fence, resp, &n);
+      if (r == XeGuCCT::kCTPending) { ++i; continue; }
+      if (r != XeGuCCT::kCTOk || n < 1 || resp[0] != inflight[i].payload) bad++;
+      done++;
+      inflight[i] = inflight.back();
+      inflight.pop_back();
+    }
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  guc.stop = true;
+  peer.join();
+
+  const XeGuCCT::Stats& st = ct.stats();
+  printf("CT simulation: %u requests, depth %u, %.3f s (%.0f req/s)\n",
+         done, depth, secs, secs > 0 ? done / secs : 0.0);
+  printf("  doorbells=%llu (%.1f req/doorbell) responses=%llu events=%llu max_outstanding=%llu\n",
+         (unsigned long long)st.doorbells, st.doorbells ? (double)st.sends / st.doorbells : 0.0,
+         (unsigned long long)st.responses, (unsigned long long)gSimEvents,
+         (unsigned long long)st.maxOutstanding);
+  printf("  unmatched=%llu failures=%llu mismatched=%u%s\n",
+         (unsigned long long)st.unmatched, (unsigned long long)st.failures, bad,
+         ct.broken() ? " CHANNEL BROKEN" : "");
+  bool ok = bad == 0 && done == requests && !ct.broken();
+  free(blob);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  uint32_t wopcm = 0, simRequests = 0, depth = XeGuCCT::kMaxOutstanding;
+  int opt;
+  while ((opt = getopt(argc, argv, "w:s:d:")) != -1) {
+    switch (opt) {
+      case 'w': wopcm = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 's': simRequests = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'd': depth = (uint32_t)strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-w WOPCM_BYTES] BLOB... | -s REQUESTS [-d DEPTH]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (simRequests) return simulate(simRequests, depth) ? 0 : 1;
+  if (optind >= argc) {
+    fprintf(stderr, "usage: %s [-w WOPCM_BYTES] BLOB... | -s REQUESTS [-d DEPTH]\n", argv[0]);
+    return 1;
+  }
+
+  bool ok = true;
+  for (int i = optind; i < argc; ++i) ok = check(argv[i], wopcm) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+// userspace/xeslab.cpp — small-BO sub-allocator benchmark
+
+// Build (host, no GPU or IOKit needed):
+//   c++ -std=c++17 -O2 -I../kexts xeslab.cpp -o xeslab
+// Usage: ./xeslab [-n LIVE] [-o OPS] [-s SEED]
+//   -n  small BOs kept live (default 2000; at most what 64 slabs hold)
+//   -o  alloc/free operations after the warm-up fill (default 2000000)
+//   -s  random seed (default 1)
+//
+// Runs the same churn twice: once with one page-aligned allocation per BO
+// (what ucCreateBuffer does for any size), once through the kext's
+// XeSlabHeap over 64K backings. Request sizes are log-uniform over
+// 16..2048 bytes, like a mix of state, constant and small batch buffers.
+// Reports the memory and GGTT PTEs held per live BO and the sustained
+// alloc+free rate. The bookkeeping is timed together with the backing
+// allocations it causes, not against IOKit, so rates only compare the two
+// schemes with each other.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "XeSlab.hpp"
+
+struct Result {
+  double   opsPerSec;
+  uint64_t requested;     // bytes asked for by the live BOs at the end
+  uint64_t backing;       // bytes of memory holding them
+  uint64_t ptes;          // 4K GGTT PTEs that memory needs
+};
+
+static std::vector<uint32_t> makeSizes(uint32_t count, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> logSize(4.0, 11.0);   // 16..2048
+  std::vector<uint32_t> sizes(count);
+  for (auto& s : sizes) s = (uint32_t)std::exp2(logSize(rng));
+  return sizes;
+}
+
+// One page-rounded allocation per BO
+static Result runPages(uint32_t live, uint32_t ops, const std::vector<uint32_t>& sizes) {
+  std::vector<void*> ptr(live, nullptr);
+  std::vector<uint32_t> sz(live, 0);
+  uint64_t backing = 0, requested = 0;
+  size_t next = 0;
+  auto allocOne = [&](uint32_t i) {
+    uint32_t bytes = sizes[next++ % sizes.size()];
+    uint32_t rounded = (bytes + 0xFFFu) & ~0xFFFu;
+    if (posix_memalign(&ptr[i], 4096, rounded)) { perror("posix_memalign"); exit(1); }
+    memset(ptr[i], 0, rounded);
+    sz[i] = bytes;
+    backing += rounded;
+    requested += bytes;
+  };
+  auto freeOne = [&](uint32_t i) {
+    backing -= (sz[i] + 0xFFFu) & ~0xFFFu;
+    requested -= sz[i];
+    free(ptr[i]);
+  };
+  for (uint32_t i = 0; i < live; ++i) allocOne(i);
+
+  std::mt19937 rng(7);
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < ops; ++n) {
+    uint32_t i = rng() % live;
+    freeOne(i);
+    allocOne(i);
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  Result r = { ops / secs, requested, backing, backing / 4096 };
+  for (uint32_t i = 0; i < live; ++i) freeOne(i);
+  return r;
+}
+
+// XeSlabHeap over 64K backings, freed as the heap hands them back
+static Result runSlabs(uint32_t live, uint32_t ops, const std::vector<uint32_t>& sizes) {
+  XeSlabHeap* heap = new XeSlabHeap();
+  std::vector<uint32_t> slab(live), offset(live), sz(live);
+  uint64_t requested = 0;
+  size_t next = 0;
+  auto allocOne = [&](uint32_t i) {
+    uint32_t bytes = sizes[next++ % sizes.size()];
+    if (!heap->alloc(bytes, &slab[i], &offset[i])) {
+      void* backing = nullptr;
+      if (posix_memalign(&backing, 4096, XeSlabHeap::kSlabBytes)) { perror("posix_memalign"); exit(1); }
+      if (heap->addSlab(backing, XeSlabHeap::classOf(bytes)) == XeSlabHeap::kNoSlab ||
+          !heap->alloc(bytes, &slab[i], &offset[i])) {
+        fprintf(stderr, "slab heap full: lower -n\n");
+        exit(1);
+      }
+    }
+    const XeSlabHeap::Slab& s = heap->slab(slab[i]);
+    memset((uint8_t*)s.backing + offset[i], 0, XeSlabHeap::chunkBytes(s.cls));
+    sz[i] = bytes;
+    requested += bytes;
+  };
+  auto freeOne = [&](uint32_t i) {
+    requested -= sz[i];
+    if (heap->free(slab[i], offset[i])) free(heap->removeSlab(slab[i]));
+  };
+  for (uint32_t i = 0; i < live; ++i) allocOne(i);
+
+  std::mt19937 rng(7);
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < ops; ++n) {
+    uint32_t i = rng() % live;
+    freeOne(i);
+    allocOne(i);
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  uint64_t backing = (uint64_t)heap->count() * XeSlabHeap::kSlabBytes;
+  Result r = { ops / secs, requested, backing, backing / 4096 };
+  for (uint32_t i = 0; i < live; ++i) freeOne(i);
+  for (uint32_t s = 0; s < XeSlabHeap::kMaxSlabs; ++s) {
+    if (heap->slab(s).backing) free(heap->removeSlab(s));
+  }
+  delete heap;
+  return r;
+}
+
+static void report(const char* name, const Result& r, uint32_t live) {
+  printf("%-6s %10.0f ops/s  %8.1f KB backing  %6.2fx requested  %7llu PTEs  %6.0f B/BO\n", name,
+         r.opsPerSec, r.backing / 1024.0, r.requested ? (double)r.backing / r.requested : 0.0,
+         (unsigned long long)r.ptes, (double)r.backing / live);
+}
+
+int main(int argc, char** argv) {
+  uint32_t live = 2000, ops = 2000000, seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:o:s:")) != -1) {
+    switch (opt) {
+      case 'n': live = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'o': ops = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-n LIVE] [-o OPS] [-s SEED]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (live == 0 || ops == 0) return 1;
+
+  std::vector<uint32_t> sizes = makeSizes(1u << 16, seed);
+  printf("%u live BOs, %u alloc+free ops, sizes 16..2048 log-uniform\n", live, ops);
+  Result pages = runPages(live, ops, sizes);
+  Result slabs = runSlabs(live, ops, sizes);
+  report("pages", pages, live);
+  report("slabs", slabs, live);
+  printf("slabs use %.1f%% of the memory and PTEs at %.2fx the allocation rate\n",
+         100.0 * slabs.backing / pages.backing, slabs.opsPerSec / pages.opsPerSec);
+  return 0;
+}
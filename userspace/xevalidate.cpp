@@ -0,0 +1,262 @@
+// userspace/xevalidate.cpp — batch validator throughput benchmark
+
+// Build (host, no GPU or IOKit needed):
+//   c++ -std=c++17 -O2 -I../kexts xevalidate.cpp ../kexts/XeBatchValidator.cpp -o xevalidate
+// Usage: ./xevalidate [-k KB] [-i ITERS] [-e ENGINE] [-v]
+//        ./xevalidate -r [-v]
+//   -k  batch size in KB (default 64)
+//   -i  validations per measurement (default 20000)
+//   -e  engine index into kXeEngines (default 0, rcs0)
+//   -r  run the rejection cases instead
+//   -v  print the validator's log lines
+//
+// Rejection mode feeds rcs0's validator packets a user batch must never
+// run (kernel-only post-sync writes, GGTT perf reports, CS-relative
+// register offsets), each once as is and once with the offending bit
+// cleared, which must pass. Exits non-zero on any other verdict.
+//
+// Runs the kext's XeBatchValidator over two synthetic batches: a NOOP-heavy
+// one (padding with a store every 256 dwords, like a ring-aligned batch)
+// and a state-heavy one (3DSTATE, PIPE_CONTROL, LRI to the GPRs, MI_MATH,
+// 3DPRIMITIVE back to back; copy engines get only the MI part). Each is
+// timed as:
+//
+//   cold   validate(): full parse, what every submit of a mapped BO costs
+//   miss   validateCached() with a fresh generation each time
+//   hit    validateCached() with an unchanged (key, generation)
+//   chain  validateChain() of a first-level batch calling three
+//          second-level links; "chain hit" lets the callees hit the cache
+//
+// MB/s counts the bytes of the batch(es) per validation, so the hit rows
+// show what a cached verdict saves rather than parser speed.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "XeBatchValidator.hpp"
+
+static bool gVerbose = false;
+
+void XeLog(const char* fmt, ...) {
+  if (!gVerbose) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+namespace {
+
+constexpr uint32_t kSdi          = 0x10000002;   // MI_STORE_DATA_IMM, PPGTT, one dword
+constexpr uint32_t kMiMath       = 0x0D000000;   // MI_MATH, length in [7:0]
+constexpr uint32_t k3dStateVs    = 0x78100000;   // 3DSTATE_VS, length in [7:0]
+constexpr uint32_t k3dStateCc    = 0x780E0000;   // 3DSTATE_CC_STATE_POINTERS
+constexpr uint32_t kPipeControl  = 0x7A000004;   // 6 dwords
+constexpr uint32_t kPcCsStall    = 1u << 20;
+constexpr uint32_t k3dPrimitive  = 0x7B000005;   // 7 dwords
+
+// Pads with NOOPs to dwords - 1 and ends the batch
+void finish(std::vector<uint32_t>& b, uint32_t dwords) {
+  while (b.size() < dwords - 1) b.push_back(XeHW::MI_NOOP);
+  b.push_back(XeHW::MI_BATCH_BUFFER_END);
+}
+
+std::vector<uint32_t> noopBatch(uint32_t dwords) {
+  std::vector<uint32_t> b;
+  b.reserve(dwords);
+  while (b.size() + 4 < dwords - 1) {
+    b.insert(b.end(), {kSdi, 0x1000, 0, (uint32_t)b.size()});
+    for (uint32_t i = 0; i < 252 && b.size() < dwords - 1; ++i) b.push_back(XeHW::MI_NOOP);
+  }
+  finish(b, dwords);
+  return b;
+}
+
+std::vector<uint32_t> stateBatch(uint32_t dwords, const XeEngineDesc& eng) {
+  const uint32_t gpr = eng.reg(0x600);
+  std::vector<uint32_t> b;
+  b.reserve(dwords);
+  const bool render = !eng.has(kXeEngineCapCopy);
+  while (b.size() + 40 < dwords - 1) {
+    if (render) {
+      b.insert(b.end(), {k3dStateVs | 7, 0, 0, 0, 0, 0, 0, 0, 0});
+      b.insert(b.end(), {k3dStateCc | 0, 0x40});
+      b.insert(b.end(), {kPipeControl, kPcCsStall, 0, 0, 0, 0});
+      b.insert(b.end(), {k3dPrimitive, 0, 3, 0, 1, 0, 0});
+    }
+    b.insert(b.end(), {XeHW::MI_LOAD_REGISTER_IMM(2), gpr, 1, gpr + 8, 2});
+    b.insert(b.end(), {kMiMath | 3, 0x00800000, 0x00800001, 0x01000000, 0x0CA00000});
+    b.insert(b.end(), {kSdi, 0x2000, 0, (uint32_t)b.size()});
+  }
+  finish(b, dwords);
+  return b;
+}
+
+struct Row {
+  const char* name;
+  double      mbPerSec;
+  double      nsPerCall;
+};
+
+template <typename Fn>
+Row measure(const char* name, uint32_t iters, uint64_t bytesPerCall, Fn fn) {
+  for (uint32_t i = 0; i < iters / 10 + 1; ++i) fn(i);    // warm up
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iters; ++i) fn(i);
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  return Row {name, (double)bytesPerCall * iters / secs / 1e6, secs * 1e9 / iters};
+}
+
+void check(XeBatchValidator::Result r, const char* what) {
+  if (r == XeBatchValidator::kBatchOk) return;
+  fprintf(stderr, "%s rejected: %s (rerun with -v)\n", what, XeBatchValidator::resultName(r));
+  exit(1);
+}
+
+// One packet that is valid until bit is set in dword word
+struct Case {
+  const char*               name;
+  uint32_t                  dw[6];
+  uint32_t                  count;
+  uint32_t                  word;
+  uint32_t                  bit;
+  XeBatchValidator::Result  expect;
+};
+
+constexpr uint32_t kFlushDw   = 0x13000002;   // MI_FLUSH_DW, 4 dwords
+constexpr uint32_t kPerfCount = 0x14000002;   // MI_REPORT_PERF_COUNT, 4 dwords
+constexpr uint32_t kSrm       = 0x12000002;   // MI_STORE_REGISTER_MEM, 4 dwords
+constexpr uint32_t kLrm       = 0x14800002;   // MI_LOAD_REGISTER_MEM, 4 dwords
+constexpr uint32_t kLrr       = 0x15000001;   // MI_LOAD_REGISTER_REG, 3 dwords
+constexpr uint32_t kGpr0      = 0x2600;       // rcs0 CS_GPR0
+
+const Case kCases[] = {
+  { "PIPE_CONTROL GGTT post-sync",  { kPipeControl, 1u << 14, 0x1000, 0, 0, 0 }, 6, 1, 1u << 24,
+    XeBatchValidator::kBatchPrivileged },
+  { "PIPE_CONTROL MMIO write",      { kPipeControl, kPcCsStall, 0, 0, 0, 0 }, 6, 1, 1u << 23,
+    XeBatchValidator::kBatchPrivileged },
+  { "PIPE_CONTROL store index",     { kPipeControl, kPcCsStall, 0, 0, 0, 0 }, 6, 1, 1u << 21,
+    XeBatchValidator::kBatchPrivileged },
+  { "PIPE_CONTROL notify",          { kPipeControl, kPcCsStall, 0, 0, 0, 0 }, 6, 1, 1u << 8,
+    XeBatchValidator::kBatchPrivileged },
+  { "MI_FLUSH_DW GGTT post-sync",   { kFlushDw | 1u << 14, 0x1000, 0, 0 }, 4, 1, 1u << 2,
+    XeBatchValidator::kBatchPrivileged },
+  { "MI_FLUSH_DW store index",      { kFlushDw, 0, 0, 0 }, 4, 0, 1u << 21,
+    XeBatchValidator::kBatchPrivileged },
+  { "MI_FLUSH_DW notify",           { kFlushDw, 0, 0, 0 }, 4, 0, 1u << 8,
+    XeBatchValidator::kBatchPrivileged },
+  { "MI_REPORT_PERF_COUNT GGTT",    { kPerfCount, 0x1000, 0, 0 }, 4, 1, 1u << 0,
+    XeBatchValidator::kBatchPrivileged },
+  { "MI_LOAD_REGISTER_IMM CS MMIO", { XeHW::MI_LOAD_REGISTER_IMM(1), kGpr0, 1 }, 3, 0, 1u << 19,
+    XeBatchValidator::kBatchBadRegister },
+  { "MI_STORE_REGISTER_MEM CS MMIO",{ kSrm, kGpr0, 0x1000, 0 }, 4, 0, 1u << 19,
+    XeBatchValidator::kBatchBadRegister },
+  { "MI_LOAD_REGISTER_MEM CS MMIO", { kLrm, kGpr0, 0x1000, 0 }, 4, 0, 1u << 19,
+    XeBatchValidator::kBatchBadRegister },
+  { "MI_LOAD_REGISTER_REG CS src",  { kLrr, kGpr0, kGpr0 + 8 }, 3, 0, 1u << 18,
+    XeBatchValidator::kBatchBadRegister },
+  { "MI_LOAD_REGISTER_REG CS dst",  { kLrr, kGpr0, kGpr0 + 8 }, 3, 0, 1u << 19,
+    XeBatchValidator::kBatchBadRegister },
+};
+
+bool runCases() {
+  XeBatchValidator* v = new XeBatchValidator();
+  v->attach(kXeEngines[kXeEngineRCS0]);
+  bool ok = true;
+  for (const Case& c : kCases) {
+    uint32_t batch[8] = {};
+    memcpy(batch, c.dw, c.count * 4);
+    batch[c.count] = XeHW::MI_BATCH_BUFFER_END;
+    XeBatchValidator::Result clean = v->validate(batch, c.count + 1, nullptr);
+    batch[c.word] |= c.bit;
+    XeBatchValidator::Result bad = v->validate(batch, c.count + 1, nullptr);
+    bool pass = clean == XeBatchValidator::kBatchOk && bad == c.expect;
+    printf("%-4s %-30s clean=%s set=%s\n", pass ? "ok" : "FAIL", c.name,
+           XeBatchValidator::resultName(clean), XeBatchValidator::resultName(bad));
+    ok = ok && pass;
+  }
+  delete v;
+  return ok;
+}
+
+void run(const char* kind, const std::vector<uint32_t>& batch, const XeEngineDesc& eng, uint32_t iters) {
+  XeBatchValidator* v = new XeBatchValidator();
+  v->attach(eng);
+  const uint32_t n = (uint32_t)batch.size();
+  const uint64_t bytes = (uint64_t)n * 4;
+  XeBatchValidator::Report rep {};
+  check(v->validate(batch.data(), n, &rep), kind);
+
+  // First-level link calling three copies of the batch as second-level
+  constexpr uint32_t kBase = 0x100000;
+  const uint32_t stride = (n * 4 + 0xFFFu) & ~0xFFFu;
+  uint32_t head[16] = {};
+  for (uint32_t i = 0; i < 3; ++i) {
+    head[i * 3 + 0] = XeHW::MI_BATCH_BUFFER_START | XeHW::MI_BB_START_2ND_LEVEL;
+    head[i * 3 + 1] = kBase + (i + 1) * stride;
+    head[i * 3 + 2] = 0;
+  }
+  head[9] = XeHW::MI_BATCH_BUFFER_END;
+  XeBatchValidator::Link links[4] = {
+    { head, 10, kBase, 0, 0, 0 },
+    { batch.data(), n, kBase + 1 * stride, 0, 0, 0 },
+    { batch.data(), n, kBase + 2 * stride, 0, 0, 0 },
+    { batch.data(), n, kBase + 3 * stride, 0, 0, 0 },
+  };
+  XeBatchValidator::Link cached[4];
+  memcpy(cached, links, sizeof(links));
+  for (uint32_t i = 1; i < 4; ++i) cached[i].key = 0x100 + i;
+  uint32_t bad = 0;
+  check(v->validateChain(links, 4, &rep, &bad), kind);
+
+  Row rows[] = {
+    measure("cold", iters, bytes, [&](uint32_t) { v->validate(batch.data(), n, &rep); }),
+    measure("miss", iters, bytes, [&](uint32_t i) { v->validateCached(0x42, i + 1, batch.data(), n, &rep); }),
+    measure("hit", iters, bytes, [&](uint32_t) { v->validateCached(0x43, 1, batch.data(), n, &rep); }),
+    measure("chain", iters / 3 + 1, 3 * bytes + 40, [&](uint32_t) { v->validateChain(links, 4, &rep, &bad); }),
+    measure("chain hit", iters, 3 * bytes + 40, [&](uint32_t) { v->validateChain(cached, 4, &rep, &bad); }),
+  };
+  for (const Row& r : rows) {
+    printf("%-6s %-10s %10.0f MB/s  %10.0f ns/call\n", kind, r.name, r.mbPerSec, r.nsPerCall);
+  }
+  const XeBatchValidator::Stats& st = v->stats();
+  printf("%-6s %llu batches parsed, %.1f%% of their dwords in NOOP runs, %llu cache hits\n", kind,
+         (unsigned long long)st.batches, st.dwords ? 100.0 * st.noopDwords / st.dwords : 0.0,
+         (unsigned long long)st.cacheHits);
+  delete v;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  uint32_t kb = 64, iters = 20000, engine = kXeEngineRCS0;
+  bool cases = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "k:i:e:rv")) != -1) {
+    switch (opt) {
+      case 'k': kb = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'i': iters = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'e': engine = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'r': cases = true; break;
+      case 'v': gVerbose = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-k KB] [-i ITERS] [-e ENGINE] [-v] | -r [-v]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (!kb || kb > 4096 || !iters || engine >= kXeEngineCount) {
+    fprintf(stderr, "bad arguments\n");
+    return 2;
+  }
+  if (cases) return runCases() ? 0 : 1;
+  const XeEngineDesc& eng = kXeEngines[engine];
+  uint32_t dwords = kb * 1024 / 4;
+  printf("%s, %u KB batches, %u validations each\n", eng.name, kb, iters);
+  run("noop", noopBatch(dwords), eng, iters);
+  run("state", stateBatch(dwords, eng), eng, iters);
+  return 0;
+}